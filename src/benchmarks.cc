@@ -0,0 +1,200 @@
+#include "benchmarks.hh"
+
+#include "buffer.hh"
+#include "clock.hh"
+#include "command_manager.hh"
+#include "context.hh"
+#include "diff.hh"
+#include "file.hh"
+#include "hash.hh"
+#include "memory.hh"
+#include "parameters_parser.hh"
+#include "ranked_match.hh"
+#include "regex.hh"
+#include "shell_manager.hh"
+#include "string_utils.hh"
+#include "utf8.hh"
+
+namespace Kakoune
+{
+
+Benchmark* Benchmark::list = nullptr;
+volatile size_t benchmark_sink = 0;
+
+static void write_stdout(StringView str) { try { write(1, str); } catch (runtime_error&) {} }
+
+static size_t total_allocation_count()
+{
+    size_t total = 0;
+    for (auto& stats : memory_stats)
+        total += stats.total_allocation_count;
+    return total;
+}
+
+void Benchmark::run_all_benchmarks()
+{
+    write_stdout("[\n");
+    for (const Benchmark* bench = list; bench; bench = bench->next)
+    {
+        // warm up caches and one time setup so timings are stable
+        bench->func(1);
+
+        const size_t allocations_before = total_allocation_count();
+        const auto start = Clock::now();
+        bench->func(bench->iterations);
+        const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start);
+        const size_t allocations = total_allocation_count() - allocations_before;
+
+        write_stdout(format("  \\{\"name\": \"{}\", \"iterations\": {}, "
+                            "\"total_ns\": {}, \"ns_per_iteration\": {}, "
+                            "\"allocations_per_iteration\": {}}{}\n",
+                            bench->name, bench->iterations,
+                            (size_t)duration.count(),
+                            (size_t)duration.count() / bench->iterations,
+                            allocations / bench->iterations,
+                            bench->next ? "," : ""));
+    }
+    write_stdout("]\n");
+}
+
+namespace
+{
+
+const String& corpus()
+{
+    static const String corpus = []
+    {
+        constexpr StringView chunk =
+            "#include \"séquence.hh\"\n"
+            "static int compute_élan(const char* données, size_t size)\n"
+            "{\n"
+            "    int total = 0x1F;\n"
+            "    for (size_t i = 0; i < size; ++i)\n"
+            "        total += données[i] ^ 0xA5;\n"
+            "    return total; // voilà\n"
+            "}\n";
+        String res;
+        while (res.length() < 64 * 1024)
+            res += chunk;
+        return res;
+    }();
+    return corpus;
+}
+
+Benchmark bench_regex_exec{"regex_exec", 20, [](size_t iterations)
+{
+    const Regex regexes[] = {
+        Regex{R"(\b[a-zA-Z_]\w*\b)", RegexCompileFlags::Optimize},
+        Regex{R"(0x[0-9a-fA-F]+)", RegexCompileFlags::Optimize},
+        Regex{R"(^\h*#\h*\w+)", RegexCompileFlags::Optimize},
+    };
+    const String& subject = corpus();
+    size_t matches = 0;
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        for (auto& regex : regexes)
+        {
+            for (auto&& match : RegexIterator{subject.begin(), subject.end(), regex})
+                matches += match.size();
+        }
+    }
+    benchmark_sink += matches;
+}};
+
+Benchmark bench_utf8_iteration{"utf8_iteration", 200, [](size_t iterations)
+{
+    const String& subject = corpus();
+    size_t total = 0;
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        for (auto it = subject.begin(); it != subject.end();)
+            total += utf8::read_codepoint(it, subject.end());
+    }
+    benchmark_sink += total;
+}};
+
+Benchmark bench_hash_data{"hash_data", 1000, [](size_t iterations)
+{
+    const String& subject = corpus();
+    size_t total = 0;
+    for (size_t i = 0; i < iterations; ++i)
+        total += hash_data(subject.data(), (size_t)(int)subject.length());
+    benchmark_sink += total;
+}};
+
+Benchmark bench_ranked_match{"ranked_match", 2000, [](size_t iterations)
+{
+    constexpr StringView candidates[] = {
+        "buffer_manager.cc", "buffer_manager.hh", "command_manager.cc",
+        "insert_completer.cc", "highlighters.cc", "regex_impl.hh",
+        "register_manager.cc", "ranked_match.cc", "string_utils.hh",
+        "option_manager.hh", "event_manager.cc", "window.cc",
+    };
+    constexpr StringView queries[] = { "bm", "buf", "mgr", "incom", "rx" };
+
+    size_t total = 0;
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        for (auto& query : queries)
+        {
+            for (auto& candidate : candidates)
+            {
+                if (RankedMatch match{candidate, query})
+                    ++total;
+            }
+        }
+    }
+    benchmark_sink += total;
+}};
+
+Benchmark bench_buffer_insert{"buffer_insert", 20, [](size_t iterations)
+{
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        Buffer buffer("*bench*", Buffer::Flags::NoUndo, "\n");
+        for (int line = 0; line < 1000; ++line)
+            buffer.insert(buffer.back_coord(),
+                          "int identifier = 0xDEADBEEF; // insert storm\n");
+        benchmark_sink += (size_t)(int)buffer.line_count();
+    }
+}};
+
+Benchmark bench_expand{"expand_params", 2000, [](size_t iterations)
+{
+    auto& command_manager = CommandManager::instance();
+    if (not command_manager.command_defined("bench-sink"))
+        command_manager.register_command("bench-sink",
+            [](const ParametersParser& parser, Context&, const ShellContext&) {
+                for (auto& param : parser)
+                    benchmark_sink += (size_t)(int)param.length();
+            }, "", {});
+
+    const Vector<String> args(4, corpus());
+    Context context{Context::EmptyContextFlag{}};
+    const ShellContext shell_context{args, {}};
+    for (size_t i = 0; i < iterations; ++i)
+        command_manager.execute("bench-sink %arg{1} \"= %arg{2} =\" %arg{@}",
+                                context, shell_context);
+}};
+
+Benchmark bench_diff{"diff", 50, [](size_t iterations)
+{
+    const String& base = corpus();
+    String modified = base;
+    for (ByteCount i = 100; i < modified.length(); i += 1000)
+        modified[i] = '!';
+
+    size_t total = 0;
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        auto diff = find_diff(base.data(), (int)base.length(),
+                              modified.data(), (int)modified.length());
+        total += diff.size();
+    }
+    benchmark_sink += total;
+}};
+
+}
+
+}
@@ -0,0 +1,34 @@
+#ifndef benchmarks_hh_INCLUDED
+#define benchmarks_hh_INCLUDED
+
+#include <cstddef>
+
+namespace Kakoune
+{
+
+// Microbenchmarks register themselves the way unit tests do; each one
+// runs its kernel a fixed number of iterations so that results stay
+// comparable across runs and releases. run_all_benchmarks times every
+// registered benchmark and writes a json array to stdout, one object
+// per benchmark (invoked with `kak -bench`, or `make bench`).
+struct Benchmark
+{
+    Benchmark(const char* name, size_t iterations, void (*func)(size_t))
+        : name{name}, iterations{iterations}, func{func}, next{list} { list = this; }
+
+    const char* name;
+    size_t iterations;
+    void (*func)(size_t iterations);
+    const Benchmark* next;
+
+    static void run_all_benchmarks();
+    static Benchmark* list;
+};
+
+// accumulating results here keeps the compiler from optimizing the
+// benchmarked kernels away
+extern volatile size_t benchmark_sink;
+
+}
+
+#endif // benchmarks_hh_INCLUDED
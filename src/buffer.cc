@@ -7,7 +7,9 @@
 #include "context.hh"
 #include "diff.hh"
 #include "file.hh"
+#include "file_change_watcher.hh"
 #include "flags.hh"
+#include "hash.hh"
 #include "option_types.hh"
 #include "ranges.hh"
 #include "shared_string.hh"
@@ -16,6 +18,7 @@
 #include "window.hh"
 
 #include <algorithm>
+#include <cstring>
 
 namespace Kakoune
 {
@@ -37,38 +40,216 @@ static ParsedLines parse_lines(StringView data)
         pos = data.begin() + 3;
     }
 
+    // memchr lets the libc scan for line ends a full vector register at
+    // a time instead of walking the data byte per byte
     bool has_crlf = false, has_lf = false;
-    for (auto it = pos; it != data.end(); ++it)
+    size_t line_count = 0;
+    for (auto it = pos;
+         (it = static_cast<const char*>(memchr(it, '\n', data.end() - it))); ++it)
     {
-        if (*it == '\n')
-            ((it != pos and *(it-1) == '\r') ? has_crlf : has_lf) = true;
+        ((it != pos and *(it-1) == '\r') ? has_crlf : has_lf) = true;
+        ++line_count;
     }
     const bool crlf = has_crlf and not has_lf;
     res.eolformat = crlf ? EolFormat::Crlf : EolFormat::Lf;
 
+    res.lines.reserve(line_count + 1);
     while (pos < data.end())
     {
-        const char* eol = std::find(pos, data.end(), '\n');
-        res.lines.emplace_back(StringData::create({{pos, eol - (crlf and eol != data.end() ? 1 : 0)}, "\n"}));
+        const char* eol = static_cast<const char*>(memchr(pos, '\n', data.end() - pos));
+        if (not eol)
+            eol = data.end();
+        res.lines.emplace_back(StringData::create_line({{pos, eol - (crlf and eol != data.end() ? 1 : 0)}, "\n"}));
         pos = eol + 1;
     }
 
     if (res.lines.empty())
-        res.lines.emplace_back(StringData::create({"\n"}));
+        res.lines.emplace_back(StringData::create_line({"\n"}));
 
     return res;
 }
 
-static void apply_options(OptionManager& options, const ParsedLines& parsed_lines)
+// Single pass over the data finding line boundaries without materializing
+// a StringData per line, for lazily loaded buffers.
+struct ParsedLineViews
 {
-    options.get_local_option("eolformat").set(parsed_lines.eolformat);
-    options.get_local_option("BOM").set(parsed_lines.bom);
+    Vector<StringView, MemoryDomain::BufferContent> lines;
+    size_t scanned = 0; // bytes of data consumed, cut at a line boundary
+    ByteOrderMark bom = ByteOrderMark::None;
+    EolFormat eolformat = EolFormat::Lf;
+};
+
+static ParsedLineViews parse_line_views(StringView data, size_t max_bytes)
+{
+    ParsedLineViews res;
+    const char* pos = data.begin();
+    if (data.substr(0, 3_byte) == "\xEF\xBB\xBF")
+    {
+        res.bom = ByteOrderMark::Utf8;
+        pos = data.begin() + 3;
+    }
+
+    const char* begin = pos;
+    bool has_crlf = false, has_lf = false;
+    while (pos < data.end() and (size_t)(pos - data.begin()) < max_bytes)
+    {
+        const char* eol = static_cast<const char*>(memchr(pos, '\n', data.end() - pos));
+        if (not eol)
+            eol = data.end();
+        else
+            ((eol != begin and *(eol-1) == '\r') ? has_crlf : has_lf) = true;
+        res.lines.push_back({pos, eol});
+        pos = eol + 1;
+    }
+    res.scanned = std::min(pos, data.end()) - data.begin();
+
+    const bool crlf = has_crlf and not has_lf;
+    res.eolformat = crlf ? EolFormat::Crlf : EolFormat::Lf;
+    if (crlf)
+    {
+        // every \n terminated line ends with \r here, else has_lf would
+        // have been set; lines are rematerialized with a single \n eol.
+        // lines are always terminated when the scan stopped before the
+        // end of the data, as it cuts at a line boundary.
+        const size_t terminated =
+            (res.scanned != (size_t)(int)data.length() or
+             data.empty() or data.back() == '\n') ?
+            res.lines.size() : res.lines.size() - 1;
+        for (size_t i = 0; i < terminated; ++i)
+            res.lines[i] = res.lines[i].substr(0_byte, res.lines[i].length() - 1);
+    }
+
+    return res;
+}
+
+static void apply_options(OptionManager& options, EolFormat eolformat, ByteOrderMark bom)
+{
+    options.get_local_option("eolformat").set(eolformat);
+    options.get_local_option("BOM").set(bom);
 }
 
 Buffer::HistoryNode::HistoryNode(HistoryId parent)
     : parent{parent}, timepoint{Clock::now()}
 {}
 
+void Buffer::LineList::reset(BufferLines lines)
+{
+    m_storage = std::move(lines);
+    m_gap_pos = m_storage.size();
+    m_gap_len = 0;
+    m_backing.reset();
+    m_lazy_lines = {};
+}
+
+void Buffer::LineList::reset(std::unique_ptr<MappedFile> backing,
+                             Vector<StringView, MemoryDomain::BufferContent> line_views,
+                             size_t scanned_bytes, bool crlf)
+{
+    m_storage.clear();
+    m_storage.resize(line_views.size());
+    m_gap_pos = m_storage.size();
+    m_gap_len = 0;
+    m_backing = std::move(backing);
+    m_lazy_lines = std::move(line_views);
+    m_backing_scanned = scanned_bytes;
+    m_backing_crlf = crlf;
+}
+
+bool Buffer::LineList::scan_backing(size_t max_bytes)
+{
+    if (not m_backing)
+        return false;
+    kak_assert(m_gap_len == 0); // lazy buffers have not been edited yet
+
+    const StringView data = *m_backing;
+    const char* const start = data.begin() + m_backing_scanned;
+    const char* pos = start;
+    while (pos < data.end() and (size_t)(pos - start) < max_bytes)
+    {
+        const char* eol = static_cast<const char*>(memchr(pos, '\n', data.end() - pos));
+        if (not eol)
+            eol = data.end();
+        const char* end = eol;
+        if (m_backing_crlf and eol != data.end() and eol != pos and *(eol-1) == '\r')
+            --end;
+        m_lazy_lines.push_back({pos, end});
+        m_storage.emplace_back();
+        pos = eol + 1;
+    }
+    m_backing_scanned = std::min(pos, data.end()) - data.begin();
+    m_gap_pos = m_storage.size();
+    return pos < data.end();
+}
+
+void Buffer::LineList::materialize_all()
+{
+    if (not m_backing)
+        return;
+    for (size_t i = 0; i < m_lazy_lines.size(); ++i)
+    {
+        if (auto& storage = m_storage[i]; not storage)
+            storage = StringData::create_line({m_lazy_lines[i], "\n"});
+    }
+    m_lazy_lines = {};
+    m_backing.reset();
+}
+
+void Buffer::LineList::move_gap(size_t pos)
+{
+    if (m_gap_len != 0)
+    {
+        if (pos < m_gap_pos)
+            std::move_backward(m_storage.begin() + pos,
+                               m_storage.begin() + m_gap_pos,
+                               m_storage.begin() + m_gap_pos + m_gap_len);
+        else if (pos > m_gap_pos)
+            std::move(m_storage.begin() + m_gap_pos + m_gap_len,
+                      m_storage.begin() + pos + m_gap_len,
+                      m_storage.begin() + m_gap_pos);
+    }
+    m_gap_pos = pos;
+}
+
+void Buffer::LineList::grow_gap(size_t pos, size_t count)
+{
+    const size_t old_size = size();
+    const size_t gap = count + std::max<size_t>(32, old_size / 16);
+    if (m_storage.capacity() >= old_size + gap)
+    {
+        // enough capacity to open the gap in place instead of
+        // reallocating and moving the whole line array
+        move_gap(pos);
+        const size_t grow = gap - m_gap_len;
+        m_storage.resize(m_storage.size() + grow);
+        std::move_backward(m_storage.begin() + m_gap_pos + m_gap_len,
+                           m_storage.end() - grow, m_storage.end());
+        m_gap_len = gap;
+        return;
+    }
+    BufferLines storage;
+    storage.reserve(old_size + gap);
+    for (size_t i = 0; i < pos; ++i)
+        storage.push_back(std::move(slot(i)));
+    storage.resize(pos + gap);
+    for (size_t i = pos; i < old_size; ++i)
+        storage.push_back(std::move(slot(i)));
+    m_storage = std::move(storage);
+    m_gap_pos = pos;
+    m_gap_len = gap;
+}
+
+Buffer::LineList::iterator Buffer::LineList::erase(iterator first, iterator last)
+{
+    materialize_all();
+    const size_t index = (size_t)first.m_index;
+    const size_t count = (size_t)(last - first);
+    move_gap(index);
+    for (size_t i = 0; i < count; ++i)
+        m_storage[m_gap_pos + m_gap_len + i] = StringDataPtr{};
+    m_gap_len += count;
+    return first;
+}
+
 Buffer::Buffer(String name, Flags flags, StringView data,
                timespec fs_timestamp)
     : Scope{GlobalScope::instance()},
@@ -87,17 +268,69 @@ Buffer::Buffer(String name, Flags flags, StringView data,
         kak_assert(not (line->length == 0) and
                    line->data()[line->length-1] == '\n');
     #endif
-    static_cast<BufferLines&>(m_lines) = std::move(parsed_lines.lines);
+    m_lines.reset(std::move(parsed_lines.lines));
+
+    record_change({ Change::Insert, {0,0}, line_count() });
+
+    apply_options(options(), parsed_lines.eolformat, parsed_lines.bom);
+
+    // now we may begin to record undo data
+    if (not (flags & Flags::NoUndo))
+        m_flags &= ~Flags::NoUndo;
+}
+
+Buffer::Buffer(String name, Flags flags, std::unique_ptr<MappedFile> file,
+               timespec fs_timestamp)
+    : Scope{GlobalScope::instance()},
+      m_name{(flags & Flags::File) ? real_path(parse_filename(name)) : std::move(name)},
+      m_display_name{(flags & Flags::File) ? compact_path(m_name) : m_name},
+      m_flags{flags | Flags::NoUndo},
+      m_history{{HistoryId::Invalid}},
+      m_history_id{HistoryId::First},
+      m_last_save_history_id{HistoryId::First},
+      m_fs_timestamp{fs_timestamp.tv_sec, fs_timestamp.tv_nsec}
+{
+    // Scan a first chunk synchronously so the buffer can be displayed
+    // immediately; the rest of the file is scanned in chunks from the
+    // event loop so one client opening a huge file stalls nobody else.
+    constexpr size_t initial_scan_bytes = 1024 * 1024;
+
+    const StringView data = *file;
+    ParsedLineViews parsed = parse_line_views(data, initial_scan_bytes);
+
+    if (parsed.lines.empty()) // empty file, no point in keeping the mapping
+        m_lines.reset(parse_lines(data).lines);
+    else
+    {
+        if (parsed.scanned != (size_t)(int)data.length())
+            m_flags |= Flags::Loading;
+        m_lines.reset(std::move(file), std::move(parsed.lines),
+                      parsed.scanned, parsed.eolformat == EolFormat::Crlf);
+    }
 
-    m_changes.push_back({ Change::Insert, {0,0}, line_count() });
+    record_change({ Change::Insert, {0,0}, line_count() });
 
-    apply_options(options(), parsed_lines);
+    apply_options(options(), parsed.eolformat, parsed.bom);
 
     // now we may begin to record undo data
     if (not (flags & Flags::NoUndo))
         m_flags &= ~Flags::NoUndo;
 }
 
+bool Buffer::extend_load(size_t max_bytes)
+{
+    if (not (m_flags & Flags::Loading))
+        return false;
+
+    const LineCount old_count = line_count();
+    const bool more = m_lines.scan_backing(max_bytes);
+    if (line_count() != old_count)
+        record_change({ Change::Insert, old_count, line_count() });
+    if (not more)
+        m_flags &= ~Flags::Loading;
+    return more;
+}
+
 void Buffer::on_registered()
 {
     // Ignore debug buffer, as it can be created in many
@@ -140,6 +373,9 @@ void Buffer::on_unregistered()
 
     options().unregister_watcher(*this);
     run_hook_in_own_context(Hook::BufClose, m_name);
+
+    if ((m_flags & Flags::File) and FileChangeWatcher::has_instance())
+        FileChangeWatcher::instance().unwatch(m_name);
 }
 
 Buffer::~Buffer()
@@ -152,8 +388,11 @@ bool Buffer::set_name(String name)
     Buffer* other = BufferManager::instance().get_buffer_ifp(name);
     if (other == nullptr or other == this)
     {
+        const String old_name = std::move(m_name);
         if (m_flags & Flags::File)
         {
+            if (FileChangeWatcher::has_instance())
+                FileChangeWatcher::instance().unwatch(old_name);
             m_name = real_path(name);
             m_display_name = compact_path(m_name);
         }
@@ -162,6 +401,7 @@ bool Buffer::set_name(String name)
             m_name = std::move(name);
             m_display_name = m_name;
         }
+        BufferManager::instance().on_buffer_renamed(*this, old_name);
         return true;
     }
     return false;
@@ -171,6 +411,8 @@ void Buffer::throw_if_read_only() const
 {
     if (m_flags & Flags::ReadOnly)
         throw runtime_error("buffer is read-only");
+    if (m_flags & Flags::Loading)
+        throw runtime_error("buffer is still loading");
 }
 
 void Buffer::update_display_name()
@@ -212,6 +454,9 @@ BufferCoordAndTarget Buffer::offset_coord(BufferCoordAndTarget coord, LineCount
 String Buffer::string(BufferCoord begin, BufferCoord end) const
 {
     String res;
+    // measure first so multi-line content gets a single allocation
+    if (end.line > begin.line)
+        res.reserve(distance(begin, end));
     const auto last_line = std::min(end.line, line_count()-1);
     for (auto line = begin.line; line <= last_line; ++line)
     {
@@ -226,6 +471,15 @@ String Buffer::string(BufferCoord begin, BufferCoord end) const
     return res;
 }
 
+BufferLines Buffer::lines_snapshot() const
+{
+    BufferLines lines;
+    lines.reserve((size_t)(int)line_count());
+    for (LineCount line = 0_line; line < line_count(); ++line)
+        lines.push_back(m_lines.get_storage(line));
+    return lines;
+}
+
 // A Modification holds a single atomic modification to Buffer
 struct Buffer::Modification
 {
@@ -243,6 +497,8 @@ struct Buffer::Modification
 
 void Buffer::reload(StringView data, timespec fs_timestamp)
 {
+    invalidate_line_offsets(0_line);
+
     ParsedLines parsed_lines = parse_lines(data);
 
     const bool record_undo = not (m_flags & Flags::NoUndo);
@@ -255,17 +511,20 @@ void Buffer::reload(StringView data, timespec fs_timestamp)
         m_history_id = HistoryId::First;
         m_last_save_history_id = HistoryId::First;
         m_history = {HistoryNode{HistoryId::Invalid}};
+        m_history_memory = 0;
 
-        m_changes.push_back({ Change::Erase, {0,0}, line_count() });
-        static_cast<BufferLines&>(m_lines) = std::move(parsed_lines.lines);
-        m_changes.push_back({ Change::Insert, {0,0}, line_count() });
+        record_change({ Change::Erase, {0,0}, line_count() });
+        m_lines.reset(std::move(parsed_lines.lines));
+        record_change({ Change::Insert, {0,0}, line_count() });
     }
     else
     {
-        auto diff = find_diff(m_lines.begin(), m_lines.size(),
-                              parsed_lines.lines.begin(), parsed_lines.lines.size(),
+        auto diff = find_diff(m_lines.begin(), (int)line_count(),
+                              parsed_lines.lines.begin(), (int)parsed_lines.lines.size(),
                               [](const StringDataPtr& lhs, const StringDataPtr& rhs)
-                              { return lhs->strview() == rhs->strview(); });
+                              { return lhs->strview() == rhs->strview(); },
+                              [](const StringDataPtr& line)
+                              { return hash_data(line->data(), (size_t)line->length); });
 
         auto it = m_lines.begin();
         for (auto& d : diff)
@@ -281,8 +540,8 @@ void Buffer::reload(StringView data, timespec fs_timestamp)
                         Modification::Insert, cur_line + line,
                         parsed_lines.lines[(int)(d.posB + line)]});
 
-                m_changes.push_back({ Change::Insert, cur_line, cur_line + d.len });
                 m_lines.insert(it, &parsed_lines.lines[d.posB], &parsed_lines.lines[d.posB + d.len]);
+                record_change({ Change::Insert, cur_line, cur_line + d.len });
                 it = m_lines.begin() + (int)(cur_line + d.len);
             }
             else if (d.mode == Diff::Remove)
@@ -295,24 +554,80 @@ void Buffer::reload(StringView data, timespec fs_timestamp)
                         m_lines.get_storage(cur_line + line)});
 
                 it = m_lines.erase(it, it + d.len);
-                m_changes.push_back({ Change::Erase, cur_line, cur_line + d.len });
+                record_change({ Change::Erase, cur_line, cur_line + d.len });
             }
         }
     }
 
     commit_undo_group();
 
-    apply_options(options(), parsed_lines);
+    apply_options(options(), parsed_lines.eolformat, parsed_lines.bom);
 
     m_last_save_history_id = m_history_id;
     m_fs_timestamp = fs_timestamp;
 }
 
+void Buffer::record_change(Change change)
+{
+    m_changes.push_back(change);
+    // track the biggest line space ever exposed; after a trim it bounds
+    // the coordinates a stale timestamp holder may still refer to
+    m_max_line_count = std::max(m_max_line_count, line_count());
+
+    for (auto* watcher : m_change_watchers)
+        watcher->on_buffer_changed();
+}
+
+void Buffer::register_change_watcher(BufferChangeWatcher& watcher) const
+{
+    kak_assert(not contains(m_change_watchers, &watcher));
+    m_change_watchers.push_back(&watcher);
+}
+
+void Buffer::unregister_change_watcher(BufferChangeWatcher& watcher) const
+{
+    auto it = find(m_change_watchers, &watcher);
+    kak_assert(it != m_change_watchers.end());
+    m_change_watchers.erase(it);
+}
+
+void Buffer::trim_changes()
+{
+    constexpr size_t max_retained_changes = 64 * 1024;
+    constexpr size_t kept_changes = 16 * 1024;
+    if (m_changes.size() < max_retained_changes)
+        return;
+
+    const size_t trimmed = m_changes.size() - kept_changes;
+    m_changes.erase(m_changes.begin(), m_changes.begin() + trimmed);
+    // pre-trim timestamps cannot be replayed precisely anymore; leave a
+    // synthetic erase covering every line they can refer to, collapsing
+    // their coordinates to {0,0} before the retained changes replay
+    m_changes.insert(m_changes.begin(),
+                     { Change::Erase, {0,0}, {m_max_line_count, 0} });
+    m_timestamp_bias += trimmed - 1;
+    m_max_line_count = line_count();
+}
+
+void Buffer::flush_pending_insert()
+{
+    if (m_pending_insert.empty())
+        return;
+
+    m_current_undo_group.push_back({Modification::Insert, m_pending_insert_coord,
+                                    intern(m_pending_insert)});
+    m_pending_insert.clear();
+}
+
 void Buffer::commit_undo_group()
 {
+    trim_changes();
+
     if (m_flags & Flags::NoUndo)
         return;
 
+    flush_pending_insert();
+
     if (m_current_undo_group.empty())
         return;
 
@@ -322,6 +637,141 @@ void Buffer::commit_undo_group()
     m_current_undo_group.clear();
     current_history_node().redo_child = id;
     m_history_id = id;
+    m_history_memory += node_memory(m_history.back());
+    compact_history();
+}
+
+size_t Buffer::node_memory(const HistoryNode& node)
+{
+    size_t size = sizeof(HistoryNode);
+    for (auto& modification : node.undo_group)
+        size += sizeof(Modification) + (int)modification.content->strview().length();
+    return size;
+}
+
+// Keep the undo history within the "history_size_limit" budget by
+// forgetting the oldest states: the root gets folded into its only
+// child, and when the root forks, the oldest branch not holding the
+// current or last saved state is dropped wholesale. Stale HistoryIds
+// reconcile the same way as with trim_changes: this only runs at
+// quiescent points, when no in-flight operation holds one.
+void Buffer::compact_history()
+{
+    const int limit = options()["history_size_limit"].get<int>();
+    if (limit <= 0 or m_history_memory <= (size_t)limit)
+        return;
+
+    Vector<char, MemoryDomain::BufferMeta> removed(m_history.size(), 0);
+    Vector<HistoryId, MemoryDomain::BufferMeta> children;
+    bool mutated = false;
+    HistoryId root = HistoryId::First;
+    while (m_history_memory > (size_t)limit)
+    {
+        children.clear();
+        for (size_t i = 0; i < m_history.size(); ++i)
+        {
+            if (not removed[i] and (HistoryId)i != root and
+                m_history[i].parent == root)
+                children.push_back((HistoryId)i);
+        }
+
+        if (children.size() == 1 and root != m_history_id)
+        {
+            // fold the root into its only child, whose state becomes the
+            // oldest one reachable
+            HistoryNode& child = history_node(children[0]);
+            m_history_memory -= node_memory(history_node(root));
+            m_history_memory -= node_memory(child) - sizeof(HistoryNode);
+            child.undo_group = UndoGroup{};
+            child.parent = HistoryId::Invalid;
+            if (m_last_save_history_id == root)
+                m_last_save_history_id = HistoryId::Invalid;
+            removed[(size_t)root] = 1;
+            root = children[0];
+            mutated = true;
+            continue;
+        }
+
+        // drop the oldest branch that holds neither the current nor the
+        // last saved state
+        HistoryId victim = HistoryId::Invalid;
+        for (auto child : children)
+        {
+            bool protected_branch = false;
+            for (size_t i = 0; i < m_history.size(); ++i)
+            {
+                if (removed[i])
+                    continue;
+                auto id = (HistoryId)i;
+                if (id != m_history_id and id != m_last_save_history_id)
+                    continue;
+                for (; id != HistoryId::Invalid and id != root; id = history_node(id).parent)
+                {
+                    if (id == child)
+                    {
+                        protected_branch = true;
+                        break;
+                    }
+                }
+            }
+            if (protected_branch)
+                continue;
+            if (victim == HistoryId::Invalid or
+                history_node(child).timepoint < history_node(victim).timepoint)
+                victim = child;
+        }
+        if (victim == HistoryId::Invalid)
+            break;
+
+        if (history_node(root).redo_child == victim)
+            history_node(root).redo_child = HistoryId::Invalid;
+        // remove the whole subtree; parents precede children in the
+        // vector so a single forward pass finds every descendant
+        removed[(size_t)victim] = 1;
+        m_history_memory -= node_memory(history_node(victim));
+        for (size_t i = (size_t)victim + 1; i < m_history.size(); ++i)
+        {
+            if (not removed[i] and m_history[i].parent != HistoryId::Invalid and
+                removed[(size_t)m_history[i].parent])
+            {
+                removed[i] = 1;
+                m_history_memory -= node_memory(m_history[i]);
+            }
+        }
+        mutated = true;
+    }
+
+    if (not mutated)
+        return;
+
+    // compact the vector and renumber every id; the new root has the
+    // smallest kept index, so it lands on HistoryId::First
+    Vector<size_t, MemoryDomain::BufferMeta> remap(m_history.size());
+    size_t kept = 0;
+    for (size_t i = 0; i < m_history.size(); ++i)
+    {
+        remap[i] = kept;
+        if (not removed[i])
+        {
+            if (i != kept)
+                m_history[kept] = std::move(m_history[i]);
+            ++kept;
+        }
+    }
+    m_history.erase(m_history.begin() + kept, m_history.end());
+
+    auto remap_id = [&](HistoryId& id) {
+        if (id != HistoryId::Invalid)
+            id = (HistoryId)remap[(size_t)id];
+    };
+    for (auto& node : m_history)
+    {
+        remap_id(node.parent);
+        remap_id(node.redo_child);
+    }
+    remap_id(m_history_id);
+    remap_id(m_last_save_history_id);
+    kak_assert(m_history[0].parent == HistoryId::Invalid);
 }
 
 bool Buffer::undo(size_t count)
@@ -351,7 +801,7 @@ bool Buffer::redo(size_t count)
     if (current_history_node().redo_child == HistoryId::Invalid)
         return false;
 
-    kak_assert(m_current_undo_group.empty());
+    kak_assert(m_current_undo_group.empty() and m_pending_insert.empty());
 
     while (count-- != 0 and current_history_node().redo_child != HistoryId::Invalid)
     {
@@ -436,6 +886,22 @@ void Buffer::check_invariant() const
 #endif
 }
 
+void Buffer::ensure_line_offsets(LineCount line) const
+{
+    kak_assert(line <= line_count());
+    const size_t target = (size_t)(int)line + 1;
+    if (m_line_offsets_valid >= target)
+        return;
+
+    m_line_offsets.resize((size_t)(int)line_count() + 1);
+    size_t i = m_line_offsets_valid;
+    if (i == 0)
+        m_line_offsets[i++] = 0;
+    for (; i < target; ++i)
+        m_line_offsets[i] = m_line_offsets[i-1] + (size_t)(int)m_lines[LineCount{(int)i-1}].length();
+    m_line_offsets_valid = target;
+}
+
 BufferCoord Buffer::do_insert(BufferCoord pos, StringView content)
 {
     kak_assert(is_valid(pos));
@@ -443,6 +909,8 @@ BufferCoord Buffer::do_insert(BufferCoord pos, StringView content)
     if (content.empty())
         return pos;
 
+    invalidate_line_offsets(pos.line);
+
     const bool at_end = is_end(pos);
     const bool append_lines = at_end and (m_lines.empty() or byte_at(back_coord()) == '\n');
 
@@ -451,21 +919,27 @@ BufferCoord Buffer::do_insert(BufferCoord pos, StringView content)
     const StringView suffix = at_end ?
         StringView{} : m_lines[pos.line].substr(pos.column);
 
-    LineList new_lines;
+    // split on newlines found by memchr rather than per byte, and stage
+    // every line before splicing so bulk appends (paste, fifo reads) cost
+    // one splice and one change record however large the content is
+    BufferLines new_lines;
+    new_lines.reserve((size_t)std::count(content.begin(), content.end(), '\n') + 1);
     ByteCount start = 0;
-    for (ByteCount i = 0; i < content.length(); ++i)
+    while (auto* eol = (const char*)memchr(content.begin() + (int)start, '\n',
+                                           (size_t)(int)(content.length() - start)))
     {
-        if (content[i] == '\n')
-        {
-            StringView line = content.substr(start, i + 1 - start);
-            new_lines.push_back(StringData::create(start == 0 ? prefix + line : line));
-            start = i + 1;
-        }
+        const ByteCount end{(int)(eol + 1 - content.begin())};
+        StringView line = content.substr(start, end - start);
+        if (start == 0) // empty prefix contributes nothing on append
+            new_lines.push_back(StringData::create_line({prefix, line}));
+        else
+            new_lines.push_back(StringData::create_line(line));
+        start = end;
     }
     if (start == 0)
-        new_lines.push_back(StringData::create({prefix, content, suffix}));
+        new_lines.push_back(StringData::create_line({prefix, content, suffix}));
     else if (start != content.length() or not suffix.empty())
-        new_lines.push_back(StringData::create({content.substr(start), suffix}));
+        new_lines.push_back(StringData::create_line({content.substr(start), suffix}));
 
     auto line_it = m_lines.begin() + (int)pos.line;
     auto new_lines_it = new_lines.begin();
@@ -480,7 +954,7 @@ BufferCoord Buffer::do_insert(BufferCoord pos, StringView content)
     const auto end = at_end ? line_count()
                             : BufferCoord{ last_line, m_lines[last_line].length() - suffix.length() };
 
-    m_changes.push_back({ Change::Insert, pos, end });
+    record_change({ Change::Insert, pos, end });
     return end;
 }
 
@@ -491,13 +965,16 @@ BufferCoord Buffer::do_erase(BufferCoord begin, BufferCoord end)
 
     kak_assert(is_valid(begin));
     kak_assert(is_valid(end));
+
+    invalidate_line_offsets(begin.line);
+
     StringView prefix = m_lines[begin.line].substr(0, begin.column);
     StringView suffix = end.line == line_count() ? StringView{} : m_lines[end.line].substr(end.column);
 
     BufferCoord next;
     if (not prefix.empty() or not suffix.empty())
     {
-        auto new_line = StringData::create({prefix, suffix});
+        auto new_line = StringData::create_line({prefix, suffix});
         m_lines.erase(m_lines.begin() + (int)begin.line, m_lines.begin() + (int)end.line);
         m_lines.get_storage(begin.line) = std::move(new_line);
         next = begin;
@@ -508,7 +985,7 @@ BufferCoord Buffer::do_erase(BufferCoord begin, BufferCoord end)
         next = begin.line;
     }
 
-    m_changes.push_back({ Change::Erase, begin, end });
+    record_change({ Change::Erase, begin, end });
     return next;
 }
 
@@ -535,6 +1012,29 @@ void Buffer::apply_modification(const Modification& modification)
     }
 }
 
+// Coordinate one past content inserted at coord, following the one past
+// last line convention used for insertions at end of buffer.
+static BufferCoord insert_end(BufferCoord coord, StringView content)
+{
+    LineCount line = coord.line;
+    ByteCount column = coord.column;
+    for (const char* it = content.begin(), *end = content.end(); it != end; )
+    {
+        if (auto* eol = static_cast<const char*>(memchr(it, '\n', end - it)))
+        {
+            ++line;
+            column = 0;
+            it = eol + 1;
+        }
+        else
+        {
+            column += ByteCount{(int)(end - it)};
+            break;
+        }
+    }
+    return {line, column};
+}
+
 BufferCoord Buffer::insert(BufferCoord pos, StringView content)
 {
     throw_if_read_only();
@@ -543,18 +1043,37 @@ BufferCoord Buffer::insert(BufferCoord pos, StringView content)
     if (content.empty())
         return pos;
 
-    StringDataPtr real_content;
+    String end_content;
+    StringView real_content = content;
     if (is_end(pos) and content.back() != '\n')
-        real_content = intern(content + "\n");
-    else
-        real_content = intern(content);
+    {
+        end_content = content + "\n";
+        real_content = end_content;
+    }
 
     // for undo and redo purpose it is better to use one past last line rather
     // than one past last char coord.
     auto coord = is_end(pos) ? line_count() : pos;
     if (not (m_flags & Flags::NoUndo))
-        m_current_undo_group.push_back({Modification::Insert, coord, real_content});
-    return do_insert(pos, real_content->strview());
+    {
+        // coalesce runs of insertions that each continue the previous one
+        // (typing, most notably) into a single in place growing string, so
+        // that a run costs one interned modification when it gets flushed,
+        // not a re-interned concatenation per keystroke; bound the run size
+        // so a single record never grows quadratically on huge pastes
+        constexpr ByteCount max_pending_insert_size{512};
+        if (not m_pending_insert.empty() and m_pending_insert_end == coord and
+            m_pending_insert.length() < max_pending_insert_size)
+            m_pending_insert += real_content;
+        else
+        {
+            flush_pending_insert();
+            m_pending_insert = real_content.str();
+            m_pending_insert_coord = coord;
+        }
+        m_pending_insert_end = insert_end(coord, real_content);
+    }
+    return do_insert(pos, real_content);
 }
 
 BufferCoord Buffer::erase(BufferCoord begin, BufferCoord end)
@@ -571,11 +1090,27 @@ BufferCoord Buffer::erase(BufferCoord begin, BufferCoord end)
         return begin;
 
     if (not (m_flags & Flags::NoUndo))
+    {
+        flush_pending_insert();
         m_current_undo_group.push_back({Modification::Erase, begin,
                                         intern(string(begin, end))});
+    }
     return do_erase(begin, end);
 }
 
+void Buffer::apply(ConstArrayView<Replacement> replacements)
+{
+    throw_if_read_only();
+
+    for (auto& rep : replacements | reverse())
+    {
+        kak_assert(is_valid(rep.begin) and is_valid(rep.end));
+        auto pos = erase(rep.begin, rep.end);
+        if (not rep.content.empty())
+            insert(pos, rep.content);
+    }
+}
+
 BufferCoord Buffer::replace(BufferCoord begin, BufferCoord end, StringView content)
 {
     throw_if_read_only();
@@ -597,12 +1132,13 @@ bool Buffer::is_modified() const
 {
     return m_flags & Flags::File and
            (m_history_id != m_last_save_history_id or
-            not m_current_undo_group.empty());
+            not m_current_undo_group.empty() or
+            not m_pending_insert.empty());
 }
 
 void Buffer::notify_saved()
 {
-    if (not m_current_undo_group.empty())
+    if (not m_current_undo_group.empty() or not m_pending_insert.empty())
         commit_undo_group();
 
     m_flags &= ~Flags::New;
@@ -807,6 +1343,160 @@ UnitTest test_buffer{[]()
     kak_assert(buffer.string(buffer.advance(buffer.end_coord(), -6), buffer.end_coord()) == "mutch\n"_sv);
 }};
 
+UnitTest test_history_compaction{[]()
+{
+    Buffer buffer("test", Buffer::Flags::None, "start\n");
+    buffer.options().get_local_option("history_size_limit").set<int>(1024);
+    for (int i = 0; i < 200; ++i)
+    {
+        buffer.insert(buffer.end_coord(), format("line {}\n", i));
+        buffer.commit_undo_group();
+    }
+    kak_assert(buffer.line_count() == 201);
+    // the oldest groups were merged away while recent undos stay precise
+    kak_assert((size_t)buffer.next_history_id() < 200);
+    buffer.undo();
+    kak_assert(buffer[buffer.line_count()-1] == "line 198\n");
+    size_t undone = 1;
+    while (buffer.undo())
+        ++undone;
+    kak_assert(undone < 200);
+    kak_assert(buffer.line_count() > 1);
+}};
+
+UnitTest test_distance{[]()
+{
+    Buffer buffer("test", Buffer::Flags::None, "tchou\nmutch\nkanaky\n");
+    kak_assert(buffer.distance({0, 0}, buffer.end_coord()) == 19);
+    kak_assert(buffer.distance({0, 2}, {2, 3}) == 13);
+    kak_assert(buffer.distance({2, 3}, {0, 2}) == -13);
+
+    buffer.insert(1_line, "foo\n");
+    kak_assert(buffer.distance({0, 0}, buffer.end_coord()) == 23);
+    buffer.erase({0, 0}, {1, 0});
+    kak_assert(buffer.distance({0, 0}, buffer.end_coord()) == 17);
+    kak_assert(buffer.advance({0, 0}, buffer.distance({0, 0}, {2, 4})) == BufferCoord{2, 4});
+
+    // long spans go through the lazily revalidated line offset index
+    Buffer big("test-big", Buffer::Flags::None, "line 0\n");
+    for (int i = 1; i < 100; ++i)
+        big.insert(big.end_coord(), format("line {}\n", i));
+    size_t total = 0;
+    for (int i = 0; i < 100; ++i)
+        total += (int)big[LineCount{i}].length();
+    kak_assert(big.distance({0, 0}, big.end_coord()) == ByteCount{(int)total});
+    big.erase({50, 0}, {51, 0}); // "line 50\n"
+    kak_assert(big.distance({0, 0}, big.end_coord()) == ByteCount{(int)total - 8});
+    kak_assert(big.distance({10, 2}, {90, 3}) ==
+               big.distance({0, 0}, {90, 3}) - big.distance({0, 0}, {10, 2}));
+}};
+
+UnitTest test_apply{[]()
+{
+    Buffer buffer("test", Buffer::Flags::None, "alpha\nbravo\ncharlie\ndelta\n");
+    buffer.apply({Buffer::Replacement{{0, 0}, {0, 5}, "one"},
+                  Buffer::Replacement{{1, 0}, {2, 0}, {}},
+                  Buffer::Replacement{{3, 0}, {3, 5}, "four"}});
+    kak_assert(buffer.line_count() == 3);
+    kak_assert(buffer[0_line] == "one\n");
+    kak_assert(buffer[1_line] == "charlie\n");
+    kak_assert(buffer[2_line] == "four\n");
+
+    buffer.commit_undo_group();
+    buffer.undo();
+    kak_assert(buffer.line_count() == 4);
+    kak_assert(buffer[0_line] == "alpha\n");
+    kak_assert(buffer[1_line] == "bravo\n");
+    kak_assert(buffer[3_line] == "delta\n");
+}};
+
+UnitTest test_undo_compaction{[]()
+{
+    Buffer buffer("test", Buffer::Flags::None, "x\n");
+    // consecutive insertions merge into a single modification, including
+    // across the line break; the end of buffer insertion starts a new one
+    buffer.insert({0, 1}, "a");
+    buffer.insert({0, 2}, "b");
+    buffer.insert({0, 3}, "\n");
+    buffer.insert({1, 0}, "c");
+    buffer.insert(buffer.end_coord(), "tail");
+    buffer.commit_undo_group();
+    kak_assert(buffer.line_count() == 3);
+    kak_assert(buffer[0_line] == "xab\n");
+    kak_assert(buffer[1_line] == "c\n");
+    kak_assert(buffer[2_line] == "tail\n");
+
+    buffer.undo();
+    kak_assert(buffer.line_count() == 1 and buffer[0_line] == "x\n");
+    buffer.redo();
+    kak_assert(buffer.line_count() == 3);
+    kak_assert(buffer[0_line] == "xab\n");
+    kak_assert(buffer[1_line] == "c\n");
+    kak_assert(buffer[2_line] == "tail\n");
+}};
+
+UnitTest test_snapshot{[]()
+{
+    Buffer buffer("test", Buffer::Flags::None, "alpha\nbravo\ncharlie\n");
+    auto snapshot = buffer.lines_snapshot();
+    // snapshotted lines share storage with the buffer
+    kak_assert(snapshot[1].get() == buffer.line_storage(1_line).get());
+
+    buffer.erase({1, 0}, {2, 0});
+    buffer.insert({0, 0}, "zero\n");
+    kak_assert(snapshot.size() == 3);
+    kak_assert(snapshot[0]->strview() == "alpha\n");
+    kak_assert(snapshot[1]->strview() == "bravo\n");
+    kak_assert(snapshot[2]->strview() == "charlie\n");
+}};
+
+UnitTest test_line_gap{[]()
+{
+    Buffer buffer("test", Buffer::Flags::None, "line 0\n");
+    // grow the line storage enough to force several gap reallocations
+    for (int i = 1; i < 100; ++i)
+        buffer.insert(buffer.end_coord(), format("line {}\n", i));
+    kak_assert(buffer.line_count() == 100);
+    for (int i = 0; i < 100; ++i)
+        kak_assert(buffer[LineCount{i}] == format("line {}\n", i));
+
+    // erase in the middle, then insert before the old gap position
+    buffer.erase({50, 0}, {60, 0});
+    kak_assert(buffer.line_count() == 90);
+    kak_assert(buffer[50_line] == "line 60\n");
+    buffer.insert({10, 0}, "inserted\n");
+    kak_assert(buffer[10_line] == "inserted\n");
+    kak_assert(buffer[11_line] == "line 10\n");
+    kak_assert(buffer[90_line] == "line 99\n");
+}};
+
+UnitTest test_changes_trim{[]()
+{
+    Buffer buffer("test", Buffer::Flags::NoUndo, "first\n");
+    const size_t old_timestamp = buffer.timestamp();
+    for (int i = 0; i < 70000; ++i)
+        buffer.insert(buffer.end_coord(), "x\n");
+    const size_t recent_timestamp = buffer.timestamp();
+    buffer.insert(buffer.end_coord(), "last\n");
+
+    buffer.trim_changes();
+
+    // timestamps keep counting from where they were before the trim
+    kak_assert(buffer.timestamp() > 70000);
+    kak_assert(buffer.changes_since(buffer.timestamp()).empty());
+
+    // recent timestamps still replay their exact changes
+    auto recent = buffer.changes_since(recent_timestamp);
+    kak_assert(recent.size() == 1 and recent[0].type == Buffer::Change::Insert);
+
+    // pre-trim timestamps see the conservative whole buffer erase first
+    auto stale = buffer.changes_since(old_timestamp);
+    kak_assert(stale.size() > 1 and
+               stale[0].type == Buffer::Change::Erase and
+               stale[0].begin == BufferCoord{0, 0} and
+               stale[0].end.line >= buffer.line_count());
+}};
+
 UnitTest test_undo{[]()
 {
     Buffer buffer("test", Buffer::Flags::None, "allo ?\nmais que fais la police\n hein ?\n youpi\n");
@@ -13,6 +13,9 @@
 #include "vector.hh"
 
 #include <ctime>
+#include <iterator>
+#include <memory>
+#include <type_traits>
 
 namespace Kakoune
 {
@@ -46,6 +49,7 @@ constexpr auto enum_desc(Meta::Type<ByteOrderMark>)
 }
 
 class Buffer;
+struct MappedFile;
 
 constexpr timespec InvalidTime = { -1, -1 };
 
@@ -102,6 +106,15 @@ private:
 
 using BufferLines = Vector<StringDataPtr, MemoryDomain::BufferContent>;
 
+class BufferChangeWatcher
+{
+public:
+    virtual void on_buffer_changed() = 0;
+
+protected:
+    ~BufferChangeWatcher() = default;
+};
+
 // A Buffer is a in-memory representation of a file
 //
 // The Buffer class permits to read and mutate this file
@@ -120,6 +133,7 @@ public:
         NoHooks  = 1 << 4,
         Debug    = 1 << 5,
         ReadOnly = 1 << 6,
+        Loading  = 1 << 7,
     };
     friend constexpr bool with_bit_ops(Meta::Type<Flags>) { return true; }
 
@@ -127,10 +141,24 @@ public:
 
     Buffer(String name, Flags flags, StringView data = {},
            timespec fs_timestamp = InvalidTime);
+    // Takes ownership of the file mapping; lines are kept as views into
+    // it and only materialized as StringData when they are accessed.
+    Buffer(String name, Flags flags, std::unique_ptr<MappedFile> file,
+           timespec fs_timestamp);
     Buffer(const Buffer&) = delete;
     Buffer& operator= (const Buffer&) = delete;
     ~Buffer();
 
+    // Scan up to max_bytes more of the backing file of a buffer created
+    // with Flags::Loading, appending the new lines as a regular insertion
+    // change; returns true while more data remains. Driven from the event
+    // loop by buffer_utils so a huge file load never stalls other clients.
+    bool extend_load(size_t max_bytes);
+
+    // Give up lazy line views into the originating file's mapping, needed
+    // before that file gets truncated by an in place overwrite.
+    void materialize_backing() { m_lines.materialize_all(); }
+
     Flags flags() const { return m_flags; }
     Flags& flags() { return m_flags; }
 
@@ -141,6 +169,28 @@ public:
     BufferCoord erase(BufferCoord begin, BufferCoord end);
     BufferCoord replace(BufferCoord begin, BufferCoord end, StringView content);
 
+    struct Replacement
+    {
+        BufferCoord begin;
+        BufferCoord end;
+        StringView content;
+    };
+    // Apply a batch of non overlapping replacements sorted by position in
+    // a single backward pass: already applied replacements never shift the
+    // coordinates of pending ones, so no per edit coordinate update is
+    // needed. The recorded changes are backward sorted, which the
+    // update_ranges machinery handles.
+    void apply(ConstArrayView<Replacement> replacements);
+
+    // An immutable snapshot of the current content: lines are shared with
+    // the buffer through their refcount, so taking one costs a pointer copy
+    // per line and no content copy. StringData is never mutated once
+    // created, so background threads may read the snapshotted lines while
+    // the buffer keeps being edited; as refcounts are not atomic, the
+    // snapshot itself must be created, copied and destroyed on the main
+    // thread only.
+    BufferLines    lines_snapshot() const;
+
     size_t         timestamp() const;
     timespec       fs_timestamp() const;
     void           set_fs_timestamp(timespec ts);
@@ -219,6 +269,18 @@ public:
     };
     ConstArrayView<Change> changes_since(size_t timestamp) const;
 
+    // Watchers are notified on every content change, so per buffer
+    // caches can reduce clean accesses to testing a dirty flag instead
+    // of comparing timestamps and walking the change log.
+    void register_change_watcher(BufferChangeWatcher& watcher) const;
+    void unregister_change_watcher(BufferChangeWatcher& watcher) const;
+
+    // Drop the oldest retained changes once the log got big enough;
+    // timestamps predating the trim then reconcile through a synthetic
+    // whole buffer erase instead of a precise replay. Only call at
+    // quiescent points, when no in-flight operation holds a timestamp.
+    void trim_changes();
+
     String debug_description() const;
 
     // Methods called by the buffer manager
@@ -232,27 +294,135 @@ private:
     BufferCoord do_insert(BufferCoord pos, StringView content);
     BufferCoord do_erase(BufferCoord begin, BufferCoord end);
 
+    void flush_pending_insert();
+
     struct Modification;
 
     void apply_modification(const Modification& modification);
     void revert_modification(const Modification& modification);
 
-    struct LineList : BufferLines
+    // Line storage keeping a gap of free slots at the last modification
+    // point, gap buffer style, so that clustered line insertions and
+    // erases do not shuffle the whole line vector on every edit.
+    struct LineList
     {
+        template<typename Value>
+        struct IteratorImpl
+        {
+            using value_type = StringDataPtr;
+            using difference_type = ptrdiff_t;
+            using pointer = Value*;
+            using reference = Value&;
+            using iterator_category = std::random_access_iterator_tag;
+            using List = std::conditional_t<std::is_const_v<Value>,
+                                            const LineList, LineList>;
+
+            Value& operator*() const { return m_list->slot(m_index); }
+            Value* operator->() const { return &m_list->slot(m_index); }
+            Value& operator[](difference_type n) const { return m_list->slot(m_index + n); }
+
+            IteratorImpl& operator++() { ++m_index; return *this; }
+            IteratorImpl& operator--() { --m_index; return *this; }
+            IteratorImpl operator++(int) { return {m_list, m_index++}; }
+            IteratorImpl operator--(int) { return {m_list, m_index--}; }
+            IteratorImpl& operator+=(difference_type n) { m_index += n; return *this; }
+            IteratorImpl& operator-=(difference_type n) { m_index -= n; return *this; }
+
+            friend IteratorImpl operator+(IteratorImpl it, difference_type n) { return {it.m_list, it.m_index + n}; }
+            friend IteratorImpl operator+(difference_type n, IteratorImpl it) { return {it.m_list, it.m_index + n}; }
+            friend IteratorImpl operator-(IteratorImpl it, difference_type n) { return {it.m_list, it.m_index - n}; }
+            friend difference_type operator-(IteratorImpl lhs, IteratorImpl rhs) { return lhs.m_index - rhs.m_index; }
+            friend bool operator==(IteratorImpl lhs, IteratorImpl rhs) { return lhs.m_index == rhs.m_index; }
+            friend bool operator!=(IteratorImpl lhs, IteratorImpl rhs) { return lhs.m_index != rhs.m_index; }
+            friend bool operator< (IteratorImpl lhs, IteratorImpl rhs) { return lhs.m_index <  rhs.m_index; }
+            friend bool operator<=(IteratorImpl lhs, IteratorImpl rhs) { return lhs.m_index <= rhs.m_index; }
+            friend bool operator> (IteratorImpl lhs, IteratorImpl rhs) { return lhs.m_index >  rhs.m_index; }
+            friend bool operator>=(IteratorImpl lhs, IteratorImpl rhs) { return lhs.m_index >= rhs.m_index; }
+
+            List* m_list;
+            difference_type m_index;
+        };
+        using iterator = IteratorImpl<StringDataPtr>;
+        using const_iterator = IteratorImpl<const StringDataPtr>;
+
         [[gnu::always_inline]]
         StringDataPtr& get_storage(LineCount line)
-        { return BufferLines::operator[]((int)line); }
+        { return slot((size_t)(int)line); }
 
         [[gnu::always_inline]]
         const StringDataPtr& get_storage(LineCount line) const
-        { return BufferLines::operator[]((int)line); }
+        { return slot((size_t)(int)line); }
 
         [[gnu::always_inline]]
         StringView operator[](LineCount line) const
         { return get_storage(line)->strview(); }
 
-        StringView front() const { return BufferLines::front()->strview(); }
-        StringView back() const { return BufferLines::back()->strview(); }
+        StringView front() const { return slot(0)->strview(); }
+        StringView back() const { return slot(size() - 1)->strview(); }
+
+        size_t size() const { return m_storage.size() - m_gap_len; }
+        bool empty() const { return size() == 0; }
+
+        iterator begin() { return {this, 0}; }
+        iterator end() { return {this, (ptrdiff_t)size()}; }
+        const_iterator begin() const { return {this, 0}; }
+        const_iterator end() const { return {this, (ptrdiff_t)size()}; }
+
+        void reset(BufferLines lines);
+        void reset(std::unique_ptr<MappedFile> backing,
+                   Vector<StringView, MemoryDomain::BufferContent> line_views,
+                   size_t scanned_bytes, bool crlf);
+
+        // scan line views for up to max_bytes more of the backing file,
+        // cutting at a line boundary; returns true while data remains
+        bool scan_backing(size_t max_bytes);
+
+        void materialize_all();
+
+        template<typename It>
+        iterator insert(iterator pos, It first, It last)
+        {
+            materialize_all();
+            const size_t index = (size_t)pos.m_index;
+            const size_t count = (size_t)std::distance(first, last);
+            if (count > m_gap_len)
+                grow_gap(index, count);
+            else
+                move_gap(index);
+            for (auto it = first; it != last; ++it)
+                m_storage[m_gap_pos++] = *it;
+            m_gap_len -= count;
+            return pos;
+        }
+
+        iterator erase(iterator first, iterator last);
+
+    private:
+        [[gnu::always_inline]]
+        const StringDataPtr& slot(size_t index) const
+        {
+            auto& storage = m_storage[index < m_gap_pos ? index : index + m_gap_len];
+            if (not storage and m_backing)
+                storage = StringData::create_line({m_lazy_lines[index], "\n"});
+            return storage;
+        }
+
+        [[gnu::always_inline]]
+        StringDataPtr& slot(size_t index)
+        { return const_cast<StringDataPtr&>(static_cast<const LineList&>(*this).slot(index)); }
+
+        void move_gap(size_t pos);
+        void grow_gap(size_t pos, size_t count);
+
+        mutable BufferLines m_storage;
+        size_t m_gap_pos = 0;
+        size_t m_gap_len = 0;
+
+        // set while lines are still lazy views into m_backing
+        std::unique_ptr<MappedFile> m_backing;
+        Vector<StringView, MemoryDomain::BufferContent> m_lazy_lines;
+        size_t m_backing_scanned = 0;
+        bool m_backing_crlf = false;
     };
     LineList m_lines;
 
@@ -276,13 +446,55 @@ private:
     HistoryId           m_history_id = HistoryId::Invalid;
     HistoryId           m_last_save_history_id = HistoryId::Invalid;
     UndoGroup           m_current_undo_group;
+    // running estimate of the history memory use, kept up to date by
+    // commit_undo_group and compact_history
+    size_t              m_history_memory = 0;
+
+    // Run of consecutive insertions, each continuing the previous one,
+    // coalesced in place and interned as a single modification when the
+    // run is broken (see Buffer::insert)
+    String              m_pending_insert;
+    BufferCoord         m_pending_insert_coord;
+    BufferCoord         m_pending_insert_end;
+
+    static size_t node_memory(const HistoryNode& node);
+    void compact_history();
 
           HistoryNode& history_node(HistoryId id)       { return m_history[(size_t)id]; }
     const HistoryNode& history_node(HistoryId id) const { return m_history[(size_t)id]; }
           HistoryNode& current_history_node()           { return m_history[(size_t)m_history_id]; }
     const HistoryNode& current_history_node()     const { return m_history[(size_t)m_history_id]; }
 
+    // Lazily computed byte offsets of line starts, valid for the first
+    // m_line_offsets_valid entries and invalidated from the first
+    // modified line, making coord <-> byte offset conversion cheap for
+    // repeated queries on unmodified regions.
+    void ensure_line_offsets(LineCount line) const;
+
+    [[gnu::always_inline]]
+    size_t line_offset(LineCount line) const
+    { return m_line_offsets[(size_t)(int)line]; }
+
+    [[gnu::always_inline]]
+    void invalidate_line_offsets(LineCount line) const
+    {
+        const size_t limit = (size_t)((int)line + 1);
+        if (m_line_offsets_valid > limit)
+            m_line_offsets_valid = limit;
+    }
+
+    mutable Vector<size_t, MemoryDomain::BufferMeta> m_line_offsets;
+    mutable size_t m_line_offsets_valid = 0;
+
+    void record_change(Change change);
+
     Vector<Change, MemoryDomain::BufferMeta> m_changes;
+    mutable Vector<BufferChangeWatcher*, MemoryDomain::BufferMeta> m_change_watchers;
+    // changes discarded by trim_changes, minus the synthetic entry left
+    // in their place; timestamps are indices into the untrimmed log
+    size_t m_timestamp_bias = 0;
+    // upper bound on any line a live timestamp holder may refer to
+    LineCount m_max_line_count = 0;
 
     timespec m_fs_timestamp;
 
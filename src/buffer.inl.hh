@@ -34,11 +34,20 @@ inline ByteCount Buffer::distance(BufferCoord begin, BufferCoord end) const
     if (begin.line == end.line)
         return end.column - begin.column;
 
-    ByteCount res = m_lines[begin.line].length() - begin.column;
-    for (LineCount l = begin.line+1; l < end.line; ++l)
-        res += m_lines[l].length();
-    res += end.column;
-    return res;
+    // short spans are cheaper to walk directly than to revalidate the
+    // offset index for
+    if (end.line - begin.line < 64)
+    {
+        ByteCount res = m_lines[begin.line].length() - begin.column;
+        for (LineCount l = begin.line+1; l < end.line; ++l)
+            res += m_lines[l].length();
+        res += end.column;
+        return res;
+    }
+
+    ensure_line_offsets(end.line);
+    return ByteCount{(int)(line_offset(end.line) - line_offset(begin.line))}
+           + end.column - begin.column;
 }
 
 inline bool Buffer::is_valid(BufferCoord c) const
@@ -71,7 +80,7 @@ inline LineCount Buffer::line_count() const
 
 inline size_t Buffer::timestamp() const
 {
-    return m_changes.size();
+    return m_timestamp_bias + m_changes.size();
 }
 
 inline StringView Buffer::substr(BufferCoord begin, BufferCoord end) const
@@ -82,8 +91,13 @@ inline StringView Buffer::substr(BufferCoord begin, BufferCoord end) const
 
 inline ConstArrayView<Buffer::Change> Buffer::changes_since(size_t timestamp) const
 {
-    if (timestamp < m_changes.size())
-        return { m_changes.data() + timestamp,
+    // timestamps predating the last trim get the whole retained log,
+    // whose first entry erases every line they can refer to (see
+    // trim_changes), degrading to a conservative full invalidation
+    const size_t index = timestamp > m_timestamp_bias ?
+        timestamp - m_timestamp_bias : 0;
+    if (index < m_changes.size())
+        return { m_changes.data() + index,
                  m_changes.data() + m_changes.size() };
     return {};
 }
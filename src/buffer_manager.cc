@@ -15,6 +15,7 @@ BufferManager::~BufferManager()
 {
     // Move buffers to avoid running BufClose with buffers remaining in that list
     BufferList buffers = std::move(m_buffers);
+    m_buffer_index.clear();
 
     for (auto& buffer : buffers)
         buffer->on_unregistered();
@@ -24,25 +25,38 @@ BufferManager::~BufferManager()
         ClientManager::instance().clear(true);
 }
 
-Buffer* BufferManager::create_buffer(String name, Buffer::Flags flags,
-                                     StringView data, timespec fs_timestamp)
+void BufferManager::throw_if_name_in_use(StringView name) const
 {
-    auto path = real_path(parse_filename(name));
-    for (auto& buf : m_buffers)
-    {
-        if (buf->name() == name or
-            (buf->flags() & Buffer::Flags::File and buf->name() == path))
-            throw runtime_error{"buffer name is already in use"};
-    }
+    if (find_indexed_buffer(name))
+        throw runtime_error{"buffer name is already in use"};
+}
 
-    m_buffers.push_back(std::make_unique<Buffer>(std::move(name), flags, data, fs_timestamp));
-    auto* buffer = m_buffers.back().get();
-    buffer->on_registered();
+Buffer* BufferManager::register_buffer(std::unique_ptr<Buffer> buffer)
+{
+    m_buffers.push_back(std::move(buffer));
+    auto* res = m_buffers.back().get();
+    m_buffer_index.insert({res->name(), res});
+    res->on_registered();
 
-    if (contains(m_buffer_trash, buffer))
+    if (contains(m_buffer_trash, res))
         throw runtime_error{"buffer got removed during its creation"};
 
-    return buffer;
+    return res;
+}
+
+Buffer* BufferManager::create_buffer(String name, Buffer::Flags flags,
+                                     StringView data, timespec fs_timestamp)
+{
+    throw_if_name_in_use(name);
+    return register_buffer(std::make_unique<Buffer>(std::move(name), flags, data, fs_timestamp));
+}
+
+Buffer* BufferManager::create_buffer(String name, Buffer::Flags flags,
+                                     std::unique_ptr<MappedFile> file,
+                                     timespec fs_timestamp)
+{
+    throw_if_name_in_use(name);
+    return register_buffer(std::make_unique<Buffer>(std::move(name), flags, std::move(file), fs_timestamp));
 }
 
 void BufferManager::delete_buffer(Buffer& buffer)
@@ -54,23 +68,30 @@ void BufferManager::delete_buffer(Buffer& buffer)
 
     m_buffer_trash.emplace_back(std::move(*it));
     m_buffers.erase(it);
+    m_buffer_index.remove(buffer.name());
 
     if (ClientManager::has_instance())
         ClientManager::instance().ensure_no_client_uses_buffer(buffer);
 }
 
-Buffer* BufferManager::get_buffer_ifp(StringView name)
+Buffer* BufferManager::find_indexed_buffer(StringView name) const
 {
-    auto path = real_path(parse_filename(name));
-    for (auto& buf : m_buffers)
-    {
-        if (buf->name() == name or
-            (buf->flags() & Buffer::Flags::File and buf->name() == path))
-            return buf.get();
-    }
+    auto it = m_buffer_index.find(name);
+    if (it != m_buffer_index.end())
+        return it->value;
+
+    it = m_buffer_index.find(real_path(parse_filename(name)));
+    if (it != m_buffer_index.end() and it->value->flags() & Buffer::Flags::File)
+        return it->value;
+
     return nullptr;
 }
 
+Buffer* BufferManager::get_buffer_ifp(StringView name)
+{
+    return find_indexed_buffer(name);
+}
+
 Buffer& BufferManager::get_buffer(StringView name)
 {
     Buffer* res = get_buffer_ifp(name);
@@ -104,4 +125,10 @@ void BufferManager::clear_buffer_trash()
     m_buffer_trash.clear();
 }
 
+void BufferManager::on_buffer_renamed(Buffer& buffer, StringView old_name)
+{
+    m_buffer_index.remove(old_name);
+    m_buffer_index.insert({buffer.name(), &buffer});
+}
+
 }
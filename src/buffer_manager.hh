@@ -2,6 +2,7 @@
 #define buffer_manager_hh_INCLUDED
 
 #include "buffer.hh"
+#include "hash_map.hh"
 #include "vector.hh"
 
 #include <memory>
@@ -20,6 +21,9 @@ public:
     Buffer* create_buffer(String name, Buffer::Flags flags,
                           StringView data = {},
                           timespec fs_timestamp = InvalidTime);
+    Buffer* create_buffer(String name, Buffer::Flags flags,
+                          std::unique_ptr<MappedFile> file,
+                          timespec fs_timestamp);
 
     void delete_buffer(Buffer& buffer);
 
@@ -35,9 +39,18 @@ public:
     void backup_modified_buffers();
 
     void clear_buffer_trash();
+
+    void on_buffer_renamed(Buffer& buffer, StringView old_name);
 private:
+    void throw_if_name_in_use(StringView name) const;
+    Buffer* find_indexed_buffer(StringView name) const;
+    Buffer* register_buffer(std::unique_ptr<Buffer> buffer);
+
     BufferList m_buffers;
     BufferList m_buffer_trash;
+    // name to buffer index, so that buffer lookup does not scan the
+    // buffer list; kept in sync on registration and renames
+    HashMap<String, Buffer*, MemoryDomain::BufferMeta> m_buffer_index;
 };
 
 }
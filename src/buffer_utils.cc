@@ -4,7 +4,9 @@
 #include "event_manager.hh"
 #include "file.hh"
 #include "selection.hh"
+#include "value.hh"
 
+#include <algorithm>
 #include <unistd.h>
 
 #if defined(__APPLE__)
@@ -15,15 +17,97 @@
 namespace Kakoune
 {
 
+namespace
+{
+
+// Per buffer memo of the last long line whose columns were walked:
+// cursor moves and redraws convert coordinates on the same line many
+// times, and columns on long lines are expensive to recompute from the
+// line start every time. Checkpoints sampled along the line bound the
+// walk to the distance from the nearest one.
+struct ColumnCache
+{
+    struct Checkpoint { ByteCount byte; ColumnCount column; };
+
+    StringDataPtr storage;
+    ColumnCount tabstop = -1;
+    Vector<Checkpoint, MemoryDomain::BufferMeta> checkpoints;
+};
+
+constexpr ByteCount column_cache_min_line = 256;
+constexpr ByteCount column_cache_interval = 64;
+
+const ColumnCache& get_column_cache(const Buffer& buffer, LineCount line,
+                                    ColumnCount tabstop)
+{
+    static const ValueId column_cache_id = get_free_value_id();
+    Value& cache_val = buffer.values()[column_cache_id];
+    if (not cache_val)
+        cache_val = Value(ColumnCache{});
+    auto& cache = cache_val.as<ColumnCache>();
+
+    auto storage = buffer.line_storage(line);
+    if (cache.storage != storage or cache.tabstop != tabstop)
+    {
+        cache.storage = storage;
+        cache.tabstop = tabstop;
+        cache.checkpoints.clear();
+        StringView content = storage->strview();
+        auto col = 0_col;
+        auto next = column_cache_interval;
+        cache.checkpoints.push_back({0, 0});
+        for (auto it = content.begin(); it != content.end(); )
+        {
+            if (const unsigned char c = *it; c >= 0x20 and c < 0x7f)
+            {
+                ++col;
+                ++it;
+            }
+            else if (c == '\t')
+            {
+                col = (col / tabstop + 1) * tabstop;
+                ++it;
+            }
+            else
+                col += codepoint_width(utf8::read_codepoint(it, content.end()));
+
+            if (it - content.begin() >= (int)next)
+            {
+                cache.checkpoints.push_back({it - content.begin(), col});
+                next = (it - content.begin()) + column_cache_interval;
+            }
+        }
+    }
+    return cache;
+}
+
+}
+
 ColumnCount get_column(const Buffer& buffer,
                        ColumnCount tabstop, BufferCoord coord)
 {
     auto line = buffer[coord.line];
     auto col = 0_col;
-    for (auto it = line.begin();
-         it != line.end() and coord.column > (int)(it - line.begin()); )
+    auto it = line.begin();
+    if (line.length() >= column_cache_min_line)
+    {
+        auto& checkpoints = get_column_cache(buffer, coord.line, tabstop).checkpoints;
+        // resume from the last checkpoint at or before the requested byte
+        auto cp = std::upper_bound(checkpoints.begin(), checkpoints.end(), coord.column,
+                                   [](ByteCount byte, const ColumnCache::Checkpoint& c)
+                                   { return byte < c.byte; }) - 1;
+        it = line.begin() + (int)cp->byte;
+        col = cp->column;
+    }
+    for (; it != line.end() and coord.column > (int)(it - line.begin()); )
     {
-        if (*it == '\t')
+        // printable ascii is single column, no need to decode
+        if (const unsigned char c = *it; c >= 0x20 and c < 0x7f)
+        {
+            ++col;
+            ++it;
+        }
+        else if (c == '\t')
         {
             col = (col / tabstop + 1) * tabstop;
             ++it;
@@ -39,9 +123,29 @@ ByteCount get_byte_to_column(const Buffer& buffer, ColumnCount tabstop, DisplayC
     auto line = buffer[coord.line];
     auto col = 0_col;
     auto it = line.begin();
+    if (line.length() >= column_cache_min_line and coord.column > 0)
+    {
+        auto& checkpoints = get_column_cache(buffer, coord.line, tabstop).checkpoints;
+        // resume from the last checkpoint strictly before the requested
+        // column, so runs of zero width codepoints are not skipped over
+        auto cp = std::lower_bound(checkpoints.begin(), checkpoints.end(), coord.column,
+                                   [](const ColumnCache::Checkpoint& c, ColumnCount column)
+                                   { return c.column < column; });
+        if (cp != checkpoints.begin())
+            --cp;
+        it = line.begin() + (int)cp->byte;
+        col = cp->column;
+    }
     while (it != line.end() and coord.column > col)
     {
-        if (*it == '\t')
+        if (const unsigned char c = *it; c >= 0x20 and c < 0x7f)
+        {
+            ++col;
+            if (col > coord.column)
+                break;
+            ++it;
+        }
+        else if (c == '\t')
         {
             col = (col / tabstop + 1) * tabstop;
             if (col > coord.column) // the target column was in the tab
@@ -60,11 +164,38 @@ ByteCount get_byte_to_column(const Buffer& buffer, ColumnCount tabstop, DisplayC
     return (int)(it - line.begin());
 }
 
+// Continue scanning a partially loaded buffer from the event loop, one
+// chunk per iteration, so that loading a huge file never blocks other
+// clients; the buffer refuses modifications until the load completes.
+static void start_progressive_load(Buffer& buffer)
+{
+    static ValueId s_load_timer_id = get_free_value_id();
+    // capture a non static one to silence a warning.
+    ValueId load_timer_id = s_load_timer_id;
+
+    Buffer* buf = &buffer;
+    buffer.values()[load_timer_id] = Value(std::make_unique<Timer>(
+        Clock::now(), [buf, load_timer_id](Timer& timer) {
+            constexpr size_t load_chunk_bytes = 4 * 1024 * 1024;
+            if (buf->extend_load(load_chunk_bytes))
+                timer.set_next_date(Clock::now());
+            else
+                buf->values().erase(load_timer_id); // will delete this
+        }));
+}
+
 Buffer* open_file_buffer(StringView filename, Buffer::Flags flags)
 {
-    MappedFile file_data{parse_filename(filename)};
-    return BufferManager::instance().create_buffer(
-        filename.str(), Buffer::Flags::File | flags, file_data, file_data.st.st_mtim);
+    auto file_data = std::make_unique<MappedFile>(parse_filename(filename));
+    const timespec fs_timestamp = file_data->st.st_mtim;
+    const bool decompressed = file_data->is_decompressed();
+    Buffer* buffer = BufferManager::instance().create_buffer(
+        filename.str(), Buffer::Flags::File | flags, std::move(file_data), fs_timestamp);
+    if (decompressed) // saving would overwrite the archive with plain bytes
+        buffer->flags() |= Buffer::Flags::ReadOnly;
+    if (buffer->flags() & Buffer::Flags::Loading)
+        start_progressive_load(*buffer);
+    return buffer;
 }
 
 Buffer* open_or_create_file_buffer(StringView filename, Buffer::Flags flags)
@@ -73,13 +204,20 @@ Buffer* open_or_create_file_buffer(StringView filename, Buffer::Flags flags)
     auto path = parse_filename(filename);
     if (file_exists(path))
     {
-        MappedFile file_data{path};
-        return buffer_manager.create_buffer(filename.str(), Buffer::Flags::File | flags,
-                                            file_data, file_data.st.st_mtim);
+        auto file_data = std::make_unique<MappedFile>(path);
+        const timespec fs_timestamp = file_data->st.st_mtim;
+        const bool decompressed = file_data->is_decompressed();
+        Buffer* buffer = buffer_manager.create_buffer(filename.str(), Buffer::Flags::File | flags,
+                                                      std::move(file_data), fs_timestamp);
+        if (decompressed)
+            buffer->flags() |= Buffer::Flags::ReadOnly;
+        if (buffer->flags() & Buffer::Flags::Loading)
+            start_progressive_load(*buffer);
+        return buffer;
     }
     return buffer_manager.create_buffer(
         filename.str(), Buffer::Flags::File | Buffer::Flags::New,
-        {}, InvalidTime);
+        StringView{}, InvalidTime);
 }
 
 void reload_file_buffer(Buffer& buffer)
@@ -118,37 +256,51 @@ Buffer* create_fifo_buffer(String name, int fd, Buffer::Flags flags, bool scroll
 
     std::unique_ptr<FDWatcher, decltype(watcher_deleter)> watcher(
         new FDWatcher(fd, FdEvents::Read,
-                      [buffer, scroll, fifo_watcher_id](FDWatcher& watcher, FdEvents, EventMode mode) {
+                      [buffer, scroll, fifo_watcher_id,
+                       read_size = (size_t)2048,
+                       data = Vector<char, MemoryDomain::BufferContent>{}]
+                      (FDWatcher& watcher, FdEvents, EventMode mode) mutable {
         if (mode != EventMode::Normal)
             return;
 
         kak_assert(buffer->flags() & Buffer::Flags::Fifo);
 
-        constexpr size_t buffer_size = 2048;
-        // if we read data slower than it arrives in the fifo, limiting the
-        // iteration number allows us to go back go back to the event loop and
+        // Reads grow adaptively: while the producer keeps the fifo full
+        // the read size doubles toward 1MB so fast writers cost few
+        // buffer insert/redraw cycles, and shrinks back once the flow
+        // dries up.
+        constexpr size_t min_read_size = 2048;
+        constexpr size_t max_read_size = 1024 * 1024;
+
+        // if we read data slower than it arrives in the fifo, bounding the
+        // time spent reading allows us to go back to the event loop and
         // handle other events sources (such as input)
-        constexpr size_t max_loop = 16;
+        constexpr auto max_duration = std::chrono::milliseconds{10};
+        const auto start_time = Clock::now();
         bool closed = false;
-        size_t loop = 0;
-        char data[buffer_size];
         BufferCoord insert_coord = buffer->back_coord();
         const int fifo = watcher.fd();
         do
         {
-            const ssize_t count = ::read(fifo, data, buffer_size);
+            data.resize(read_size);
+            const ssize_t count = ::read(fifo, data.data(), read_size);
             if (count <= 0)
             {
                 closed = true;
                 break;
             }
 
+            if ((size_t)count == read_size)
+                read_size = std::min(read_size * 2, max_read_size);
+            else
+                read_size = std::max(read_size / 2, min_read_size);
+
             auto pos = buffer->back_coord();
             const bool prevent_scrolling = pos == BufferCoord{0,0} and not scroll;
             if (prevent_scrolling)
                 pos = buffer->next(pos);
 
-            buffer->insert(pos, StringView(data, data+count));
+            buffer->insert(pos, StringView(data.data(), data.data()+count));
 
             if (prevent_scrolling)
             {
@@ -159,7 +311,11 @@ Buffer* create_fifo_buffer(String name, int fd, Buffer::Flags flags, bool scroll
                     buffer->insert(buffer->end_coord(), "\n");
             }
         }
-        while (++loop < max_loop  and fd_readable(fifo));
+        while (Clock::now() - start_time < max_duration and fd_readable(fifo));
+
+        // fifo buffers are NoUndo and never commit undo groups, so bound
+        // the change log here, between batches
+        buffer->trim_changes();
 
         if (insert_coord != buffer->back_coord())
         {
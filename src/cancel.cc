@@ -0,0 +1,50 @@
+#include "cancel.hh"
+
+#include "clock.hh"
+#include "event_manager.hh"
+
+#include <csignal>
+
+namespace Kakoune
+{
+
+static volatile sig_atomic_t s_cancel_requested = 0;
+
+void request_cancel()
+{
+    s_cancel_requested = 1;
+}
+
+void clear_cancel()
+{
+    s_cancel_requested = 0;
+}
+
+void cancellation_point(bool pump_events)
+{
+    if (s_cancel_requested)
+    {
+        s_cancel_requested = 0;
+        throw cancel{};
+    }
+
+    // gate the clock read behind a counter, cancellation points sit in
+    // tight loops
+    static size_t calls = 0;
+    if (not pump_events or ++calls % 1024 != 0 or
+        not EventManager::has_instance())
+        return;
+
+    static TimePoint last_pump{};
+    const auto now = Clock::now();
+    if (now - last_pump >= std::chrono::milliseconds{20})
+    {
+        last_pump = now;
+        // answer urgent events only, as during shell evals; actual
+        // command execution stays deferred until we get back to the
+        // main loop
+        EventManager::instance().handle_next_events(EventMode::Urgent, nullptr, false);
+    }
+}
+
+}
@@ -0,0 +1,29 @@
+#ifndef cancel_hh_INCLUDED
+#define cancel_hh_INCLUDED
+
+#include "exception.hh"
+
+namespace Kakoune
+{
+
+// A long operation got aborted by a client pressing <c-c>
+struct cancel : runtime_error
+{
+    cancel() : runtime_error{"interrupted"} {}
+};
+
+// Cooperative cancellation of long operations: the SIGINT raised when a
+// client presses <c-c> requests cancellation, and long loops regularly
+// reach a cancellation point that aborts them with a cancel exception.
+void request_cancel();
+void clear_cancel();
+
+// Throw cancel{} if a cancellation got requested; cheap enough to call
+// every loop iteration. Unless pump_events is false it also answers
+// urgent events at a bounded rate so that other clients' messages do
+// not queue behind the running operation.
+void cancellation_point(bool pump_events = true);
+
+}
+
+#endif // cancel_hh_INCLUDED
@@ -1,5 +1,7 @@
 #include "changes.hh"
 
+#include "unit_tests.hh"
+
 namespace Kakoune
 {
 void ForwardChangesTracker::update(const Buffer::Change& change)
@@ -94,4 +96,41 @@ const Buffer::Change* backward_sorted_until(const Buffer::Change* first, const B
     return last;
 }
 
+namespace
+{
+
+struct TestRange { BufferCoord first, last; };
+BufferCoord& get_first(TestRange& range) { return range.first; }
+BufferCoord& get_last(TestRange& range) { return range.last; }
+
+}
+
+UnitTest test_update_ranges{[]()
+{
+    { // insert of a full line at line 1
+        const Buffer::Change changes[] = {{Buffer::Change::Insert, {1,0}, {2,0}}};
+        TestRange ranges[] = {{{0,0}, {0,5}}, {{1,0}, {1,3}}, {{5,0}, {5,2}}};
+        update_forward(changes, ranges);
+        kak_assert((ranges[0].first == BufferCoord{0,0} and ranges[0].last == BufferCoord{0,5}));
+        kak_assert((ranges[1].first == BufferCoord{2,0} and ranges[1].last == BufferCoord{2,3}));
+        kak_assert((ranges[2].first == BufferCoord{6,0} and ranges[2].last == BufferCoord{6,2}));
+    }
+    { // erase of line 1, batched as a backward run
+        const Buffer::Change changes[] = {{Buffer::Change::Erase, {1,0}, {2,0}}};
+        TestRange ranges[] = {{{0,0}, {0,5}}, {{2,1}, {2,4}}, {{5,0}, {5,2}}};
+        update_backward(changes, ranges);
+        kak_assert((ranges[0].first == BufferCoord{0,0} and ranges[0].last == BufferCoord{0,5}));
+        kak_assert((ranges[1].first == BufferCoord{1,1} and ranges[1].last == BufferCoord{1,4}));
+        kak_assert((ranges[2].first == BufferCoord{4,0} and ranges[2].last == BufferCoord{4,2}));
+    }
+    { // insert on the same line only shifts columns after it
+        const Buffer::Change changes[] = {{Buffer::Change::Insert, {1,2}, {1,5}}};
+        TestRange ranges[] = {{{1,0}, {1,1}}, {{1,3}, {1,6}}, {{2,0}, {2,2}}};
+        update_forward(changes, ranges);
+        kak_assert((ranges[0].first == BufferCoord{1,0} and ranges[0].last == BufferCoord{1,1}));
+        kak_assert((ranges[1].first == BufferCoord{1,6} and ranges[1].last == BufferCoord{1,9}));
+        kak_assert((ranges[2].first == BufferCoord{2,0} and ranges[2].last == BufferCoord{2,2}));
+    }
+}};
+
 }
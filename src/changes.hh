@@ -28,56 +28,116 @@ struct ForwardChangesTracker
 const Buffer::Change* forward_sorted_until(const Buffer::Change* first, const Buffer::Change* last);
 const Buffer::Change* backward_sorted_until(const Buffer::Change* first, const Buffer::Change* last);
 
+// Once a batch of changes is fully consumed, the coordinates left to
+// update only take the batch's cumulative offset: a plain line shift
+// for those past the last changed line, the full translation for the
+// few still on it (or before it, for unsorted containers).
+template<typename Iterator>
+void apply_remaining_offset(const ForwardChangesTracker& changes_tracker,
+                            Iterator it, Iterator end)
+{
+    const auto last_line = changes_tracker.old_pos.line;
+    const auto line_delta = changes_tracker.cur_pos.line - last_line;
+    for (; it != end; ++it)
+    {
+        auto update = [&](BufferCoord& coord) {
+            if (coord.line > last_line)
+                coord.line += line_delta;
+            else
+                coord = changes_tracker.get_new_coord_tolerant(coord);
+        };
+        // both references must be taken before updating either, for
+        // selections get_first/get_last recompute min/max on each call
+        auto& first = get_first(*it);
+        auto& last = get_last(*it);
+        update(first);
+        update(last);
+    }
+}
+
 template<typename RangeContainer>
 void update_forward(ConstArrayView<Buffer::Change> changes, RangeContainer& ranges)
 {
+    if (changes.empty())
+        return;
+
     ForwardChangesTracker changes_tracker;
-    auto advance_while_relevant = [&, it = changes.begin()]
-                                  (const BufferCoord& pos) mutable {
-        while (it != changes.end() and changes_tracker.relevant(*it, pos))
-            changes_tracker.update(*it++);
+    auto change_it = changes.begin();
+    auto advance_while_relevant = [&](const BufferCoord& pos) {
+        while (change_it != changes.end() and changes_tracker.relevant(*change_it, pos))
+            changes_tracker.update(*change_it++);
     };
 
-    for (auto& range : ranges)
+    auto it = std::begin(ranges);
+    const auto end = std::end(ranges);
+    // ranges that end before the first change cannot move
+    while (it != end and get_last(*it) < changes.front().begin)
+        ++it;
+
+    for (; it != end; ++it)
     {
-        auto& first = get_first(range);
-        auto& last = get_last(range);
+        auto& first = get_first(*it);
+        auto& last = get_last(*it);
         advance_while_relevant(first);
         first = changes_tracker.get_new_coord_tolerant(first);
 
         advance_while_relevant(last);
         last = changes_tracker.get_new_coord_tolerant(last);
+
+        if (change_it == changes.end())
+        {
+            ++it;
+            break;
+        }
     }
+    apply_remaining_offset(changes_tracker, it, end);
 }
 
 template<typename RangeContainer>
 void update_backward(ConstArrayView<Buffer::Change> changes, RangeContainer& ranges)
 {
+    if (changes.empty())
+        return;
+
     ForwardChangesTracker changes_tracker;
-    auto advance_while_relevant = [&, it = changes.rbegin()]
-                                  (const BufferCoord& pos) mutable {
-        while (it != changes.rend())
+    auto change_it = changes.rbegin();
+    auto advance_while_relevant = [&](const BufferCoord& pos) {
+        while (change_it != changes.rend())
         {
-            const Buffer::Change change{it->type,
-                                        changes_tracker.get_new_coord(it->begin),
-                                        changes_tracker.get_new_coord(it->end)};
+            const Buffer::Change change{change_it->type,
+                                        changes_tracker.get_new_coord(change_it->begin),
+                                        changes_tracker.get_new_coord(change_it->end)};
             if (not changes_tracker.relevant(change, pos))
                 break;
             changes_tracker.update(change);
-            ++it;
+            ++change_it;
         }
     };
 
-    for (auto& range : ranges)
+    auto it = std::begin(ranges);
+    const auto end = std::end(ranges);
+    // the batch was applied at decreasing positions, so in the current
+    // coordinate space its lowest change is the last applied one
+    while (it != end and get_last(*it) < changes.back().begin)
+        ++it;
+
+    for (; it != end; ++it)
     {
-        auto& first = get_first(range);
-        auto& last = get_last(range);
+        auto& first = get_first(*it);
+        auto& last = get_last(*it);
         advance_while_relevant(first);
         first = changes_tracker.get_new_coord_tolerant(first);
 
         advance_while_relevant(last);
         last = changes_tracker.get_new_coord_tolerant(last);
+
+        if (change_it == changes.rend())
+        {
+            ++it;
+            break;
+        }
     }
+    apply_remaining_offset(changes_tracker, it, end);
 }
 
 template<typename RangeContainer>
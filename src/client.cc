@@ -5,9 +5,11 @@
 #include "buffer_manager.hh"
 #include "buffer_utils.hh"
 #include "file.hh"
+#include "file_change_watcher.hh"
 #include "remote.hh"
 #include "option.hh"
 #include "option_types.hh"
+#include "profile.hh"
 #include "client_manager.hh"
 #include "command_manager.hh"
 #include "event_manager.hh"
@@ -34,7 +36,11 @@ Client::Client(std::unique_ptr<UserInterface>&& ui,
       m_on_exit{std::move(on_exit)},
       m_env_vars(std::move(env_vars)),
       m_input_handler{std::move(selections), Context::Flags::None,
-                      std::move(name)}
+                      std::move(name)},
+      m_prefetch_timer{TimePoint::max(), [this](Timer&) {
+          m_window->prefetch_highlighting(context(), m_window->dimensions().line);
+      }},
+      m_redraw_timer{TimePoint::max(), [](Timer&) {}}
 {
     m_window->set_client(this);
 
@@ -56,6 +62,10 @@ Client::Client(std::unique_ptr<UserInterface>&& ui,
         else
             m_pending_keys.push_back(key);
     });
+    m_ui->set_on_paste([this](StringView content) {
+        m_pending_pastes.push_back(content.str());
+        m_pending_keys.push_back(Key{Key::Invalid});
+    });
 
     m_window->hooks().run_hook(Hook::WinDisplay, m_window->buffer().name(), context());
 
@@ -86,6 +96,24 @@ bool Client::process_pending_inputs()
     {
         try
         {
+            if (key == Key{Key::Invalid} and not m_pending_pastes.empty())
+            {
+                String content = std::move(m_pending_pastes.front());
+                m_pending_pastes.erase(m_pending_pastes.begin());
+
+                if (debug_keys)
+                    write_to_debug_buffer(format("Client '{}' got {} bytes paste",
+                                                 context().name(), content.length()));
+
+                m_input_handler.paste(content);
+                continue;
+            }
+
+            // the user interface only received a page of the menu,
+            // translate its selection back into the full item list
+            if (key.modifiers == Key::Modifiers::MenuSelect)
+                key.key += m_menu.first_sent;
+
             if (debug_keys)
                 write_to_debug_buffer(format("Client '{}' got key '{}'",
                                              context().name(), key_to_str(key)));
@@ -142,26 +170,89 @@ String generate_context_info(const Context& context)
     return s;
 }
 
-DisplayLine Client::generate_mode_line() const
+// The modelinefmt option compiled into literal tokens and value slots so
+// that steady state redraws only refresh the slot values, and reparse the
+// mode line when one of them actually changed
+struct ModeLineTemplate
+{
+    String format;        // source the template was compiled from
+    Vector<Token> tokens; // Raw tokens are literals, others are value slots
+    Vector<String> values;
+    DisplayLine mode_info;
+    String context_info;
+    uint32_t faces_hash = 0;
+};
+
+bool Client::update_mode_line()
 {
-    DisplayLine modeline;
     try
     {
         const String& modelinefmt = context().options()["modelinefmt"].get<String>();
-        HashMap<String, DisplayLine> atoms{{ "mode_info", context().client().input_handler().mode_line() },
-                                           { "context_info", {generate_context_info(context()),
+        if (not m_mode_line_template)
+            m_mode_line_template.reset(new ModeLineTemplate{});
+        auto& tmpl = *m_mode_line_template;
+
+        bool dirty = false;
+        if (tmpl.format != modelinefmt)
+        {
+            tmpl.tokens = parse_expansions(modelinefmt);
+            tmpl.format = modelinefmt;
+            tmpl.values.clear();
+            tmpl.values.resize(tmpl.tokens.size());
+            dirty = true;
+        }
+
+        for (size_t i = 0; i < tmpl.tokens.size(); ++i)
+        {
+            auto& token = tmpl.tokens[i];
+            if (token.type == Token::Type::Raw)
+                continue;
+            String value = escape(expand_single_token(token, context(), ShellContext{}),
+                                  '{', '\\');
+            if (value != tmpl.values[i])
+            {
+                tmpl.values[i] = std::move(value);
+                dirty = true;
+            }
+        }
+
+        DisplayLine mode_info = context().client().input_handler().mode_line();
+        String context_info = generate_context_info(context());
+        const uint32_t faces_hash = compute_faces_hash(context().faces());
+        if (mode_info.atoms() != tmpl.mode_info.atoms() or
+            context_info != tmpl.context_info or
+            faces_hash != tmpl.faces_hash)
+        {
+            tmpl.mode_info = std::move(mode_info);
+            tmpl.context_info = std::move(context_info);
+            tmpl.faces_hash = faces_hash;
+            dirty = true;
+        }
+
+        if (not dirty)
+            return false;
+
+        String expanded;
+        for (size_t i = 0; i < tmpl.tokens.size(); ++i)
+            expanded += tmpl.tokens[i].type == Token::Type::Raw ?
+                StringView{tmpl.tokens[i].content} : StringView{tmpl.values[i]};
+
+        HashMap<String, DisplayLine> atoms{{ "mode_info", tmpl.mode_info },
+                                           { "context_info", {tmpl.context_info,
                                                               context().faces()["Information"]}}};
-        auto expanded = expand(modelinefmt, context(), ShellContext{},
-                               [](String s) { return escape(s, '{', '\\'); });
-        modeline = parse_display_line(expanded, context().faces(), atoms);
+        m_mode_line = parse_display_line(expanded, context().faces(), atoms);
+        return true;
     }
     catch (runtime_error& err)
     {
         write_to_debug_buffer(format("Error while parsing modelinefmt: {}", err.what()));
-        modeline.push_back({ "modelinefmt error, see *debug* buffer", context().faces()["Error"] });
+        m_mode_line_template.reset();
+        DisplayLine error{ "modelinefmt error, see *debug* buffer", context().faces()["Error"] };
+        if (error.atoms() == m_mode_line.atoms())
+            return false;
+        m_mode_line = std::move(error);
+        return true;
     }
-
-    return modeline;
 }
 
 void Client::change_buffer(Buffer& buffer)
@@ -196,27 +287,47 @@ static bool is_inline(InfoStyle style)
            style == InfoStyle::InlineBelow;
 }
 
+// number of menu items sent to the user interface per page, large
+// enough to fill any realistic menu layout
+static constexpr int menu_page_size = 1000;
+
 void Client::redraw_ifn()
 {
     Window& window = context().window();
     if (window.needs_redraw(context()))
         m_ui_pending |= Draw;
 
-    DisplayLine mode_line = generate_mode_line();
-    if (mode_line.atoms() != m_mode_line.atoms())
-    {
+    if (update_mode_line())
         m_ui_pending |= StatusLine;
-        m_mode_line = std::move(mode_line);
-    }
 
     if (m_ui_pending == 0)
         return;
 
+    using namespace std::chrono;
+    const auto interval = milliseconds{context().options()["redraw_interval"].get<int>()};
+    const auto now = Clock::now();
+    if (interval > milliseconds{0} and now < m_last_redraw + interval)
+    {
+        // coalesce with later triggers, the timer only has to wake up
+        // the event loop for the redraw to be retried
+        m_redraw_timer.set_next_date(m_last_redraw + interval);
+        return;
+    }
+    m_last_redraw = now;
+
+    ProfileTimer profile_timer{context(), ProfileCategory::Redraw};
+    TraceTimer trace_timer{"draw flush"};
+
     auto& faces = context().faces();
 
     if (m_ui_pending & Draw)
+    {
         m_ui->draw(window.update_display_buffer(context()),
                    faces["Default"], faces["BufferPadding"]);
+        // once the event loop goes idle, warm the highlighter caches
+        // around the displayed range so scrolling finds them ready
+        m_prefetch_timer.set_next_date(Clock::now() + std::chrono::milliseconds{10});
+    }
 
     const bool update_menu_anchor = (m_ui_pending & Draw) and not (m_ui_pending & MenuHide) and
                                     not m_menu.items.empty() and m_menu.style == MenuStyle::Inline;
@@ -229,12 +340,25 @@ void Client::redraw_ifn()
         m_menu.ui_anchor = anchor;
     }
 
-    if (m_ui_pending & MenuShow and m_menu.ui_anchor)
-        m_ui->menu_show(m_menu.items, *m_menu.ui_anchor,
-                        faces["MenuForeground"], faces["MenuBackground"],
-                        m_menu.style);
-    if (m_ui_pending & MenuSelect and m_menu.ui_anchor)
-        m_ui->menu_select(m_menu.selected);
+    if (m_ui_pending & (MenuShow | MenuSelect) and m_menu.ui_anchor)
+    {
+        // only send the page of items around the selection, so that
+        // layout and serialization cost do not depend on the total
+        // number of candidates
+        const int page = m_menu.selected < 0 ?
+            m_menu.first_sent : m_menu.selected / menu_page_size * menu_page_size;
+        if ((m_ui_pending & MenuShow) or page != m_menu.first_sent)
+        {
+            m_menu.first_sent = page;
+            m_ui->menu_show(ConstArrayView<DisplayLine>{m_menu.items}.subrange(page, menu_page_size),
+                            *m_menu.ui_anchor,
+                            faces["MenuForeground"], faces["MenuBackground"],
+                            m_menu.style);
+        }
+        if (m_ui_pending & MenuSelect)
+            m_ui->menu_select(m_menu.selected < 0 ? m_menu.selected
+                                                  : m_menu.selected - page);
+    }
     if (m_ui_pending & MenuHide)
         m_ui->menu_hide();
 
@@ -263,10 +387,27 @@ void Client::redraw_ifn()
 
     m_ui->refresh(m_ui_pending | Refresh);
     m_ui_pending = 0;
+
+    record_frame_time(Clock::now() - now);
+}
+
+void Client::record_frame_time(Clock::duration duration)
+{
+    m_last_frame_duration = duration;
+    constexpr size_t max_frame_times = 256;
+    if (m_frame_times.size() < max_frame_times)
+        m_frame_times.push_back(duration);
+    else
+        m_frame_times[m_frame_time_pos] = duration;
+    m_frame_time_pos = (m_frame_time_pos + 1) % max_frame_times;
 }
 
 void Client::force_redraw()
 {
+    // drop the window's recyclable state so that the next draw runs the
+    // highlighters from scratch
+    if (context().has_window())
+        context().window().force_redraw();
     m_ui_pending |= Refresh | Draw | StatusLine |
         (m_menu.items.empty() ? MenuHide : MenuShow | MenuSelect) |
         (m_info.content.empty() ? InfoHide : InfoShow);
@@ -354,6 +495,12 @@ void Client::check_if_buffer_needs_reloading()
         return;
 
     const String& filename = buffer.name();
+    // when the file is watched, spare the timestamp check (which can
+    // block on remote filesystems) until an event was seen on it
+    if (FileChangeWatcher::has_instance() and
+        FileChangeWatcher::instance().watch(filename) and
+        not FileChangeWatcher::instance().poll_changed(filename))
+        return;
     timespec ts = get_fs_timestamp(filename);
     if (ts == InvalidTime or ts == buffer.fs_timestamp())
         return;
@@ -4,6 +4,7 @@
 #include "constexpr_utils.hh"
 #include "display_buffer.hh"
 #include "env_vars.hh"
+#include "event_manager.hh"
 #include "input_handler.hh"
 #include "safe_ptr.hh"
 #include "utils.hh"
@@ -17,6 +18,7 @@ class Window;
 class UserInterface;
 class String;
 struct Key;
+struct ModeLineTemplate;
 
 enum class InfoStyle;
 enum class MenuStyle;
@@ -72,6 +74,9 @@ public:
 
     int pid() const { return m_pid; }
 
+    Clock::duration last_frame_duration() const { return m_last_frame_duration; }
+    ConstArrayView<Clock::duration> frame_times() const { return m_frame_times; }
+
 private:
     void on_option_changed(const Option& option) override;
 
@@ -79,7 +84,9 @@ private:
     void close_buffer_reload_dialog();
     void reload_buffer();
 
-    DisplayLine generate_mode_line() const;
+    // Refresh m_mode_line from the compiled modelinefmt template,
+    // returns true when its content changed
+    bool update_mode_line();
 
     std::unique_ptr<UserInterface> m_ui;
     std::unique_ptr<Window> m_window;
@@ -94,6 +101,7 @@ private:
 
     DisplayLine m_status_line;
     DisplayLine m_mode_line;
+    std::unique_ptr<ModeLineTemplate> m_mode_line_template;
 
     enum PendingUI : int
     {
@@ -115,6 +123,10 @@ private:
         Optional<DisplayCoord> ui_anchor;
         MenuStyle style;
         int selected;
+        // first item of the page currently sent to the user interface,
+        // huge menus are paged so that their cost does not depend on
+        // the total number of items
+        int first_sent = 0;
     } m_menu{};
 
     struct Info
@@ -127,6 +139,24 @@ private:
     } m_info{};
 
     Vector<Key, MemoryDomain::Client> m_pending_keys;
+    // pasted content, queued as Key::Invalid placeholders in
+    // m_pending_keys to keep ordering with regular keys
+    Vector<String, MemoryDomain::Client> m_pending_pastes;
+
+    Timer m_prefetch_timer;
+
+    // when redraw_interval caps the frame rate, wakes up the event
+    // loop once the pending redraw is allowed to be flushed
+    Timer m_redraw_timer;
+    TimePoint m_last_redraw = {};
+
+    void record_frame_time(Clock::duration duration);
+
+    // rolling window of recent redraw durations, overwritten oldest
+    // first (see %val{frame_time_ms} and `debug frame-times`)
+    Clock::duration m_last_frame_duration{};
+    Vector<Clock::duration, MemoryDomain::Client> m_frame_times;
+    size_t m_frame_time_pos = 0;
 
     bool m_buffer_reload_dialog_opened = false;
 };
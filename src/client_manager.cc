@@ -95,7 +95,11 @@ void ClientManager::process_pending_inputs()
         // if a client triggers client removal)
         for (int i = 0; i < m_clients.size(); )
         {
-            if (not m_clients[i]->is_ui_ok())
+            // the ui can close right behind its final keys (json ui fed
+            // from a script), those still must be handled before the
+            // client gets dropped
+            if (not m_clients[i]->is_ui_ok() and
+                not m_clients[i]->has_pending_inputs())
             {
                 remove_client(*m_clients[i], false, -1);
                 continue;
@@ -1,5 +1,6 @@
 #include "color.hh"
 
+#include "constexpr_utils.hh"
 #include "exception.hh"
 #include "ranges.hh"
 #include "string_utils.hh"
@@ -29,16 +30,55 @@ static constexpr const char* color_names[] = {
     "bright-white",
 };
 
+constexpr uint32_t color_name_hash(const char* data, size_t len)
+{
+    uint32_t hash = 0x811c9dc5;
+    for (size_t i = 0; i < len; ++i)
+        hash = (hash ^ (uint8_t)data[i]) * 0x01000193;
+    return hash;
+}
+
+constexpr size_t color_name_length(const char* name)
+{
+    size_t len = 0;
+    while (name[len] != '\0')
+        ++len;
+    return len;
+}
+
+template<size_t... Indices>
+constexpr Array<uint32_t, sizeof...(Indices)>
+make_color_name_hashes(std::index_sequence<Indices...>)
+{
+    return {{color_name_hash(color_names[Indices],
+                             color_name_length(color_names[Indices]))...}};
+}
+
+// compile time generated hashes, so that name lookup compares a word
+// per candidate instead of running string comparisons down the list
+static constexpr auto color_name_hashes =
+    make_color_name_hashes(std::make_index_sequence<std::size(color_names)>());
+
+static int find_color_name(StringView color)
+{
+    const uint32_t hash = color_name_hash(color.data(), (size_t)(int)color.length());
+    for (int i = 0; i < (int)std::size(color_names); ++i)
+    {
+        if (color_name_hashes[i] == hash and color == color_names[i])
+            return i;
+    }
+    return -1;
+}
+
 bool is_color_name(StringView color)
 {
-    return contains(color_names, color);
+    return find_color_name(color) != -1;
 }
 
 Color str_to_color(StringView color)
 {
-    auto it = find_if(color_names, [&](const char* c){ return color == c; });
-    if (it != std::end(color_names))
-        return static_cast<Color::NamedColor>(it - color_names);
+    if (int index = find_color_name(color); index != -1)
+        return static_cast<Color::NamedColor>(index);
 
     auto hval = [&color](char c) -> int
     {
@@ -7,7 +7,9 @@
 #include "flags.hh"
 #include "file.hh"
 #include "optional.hh"
+#include "option_manager.hh"
 #include "option_types.hh"
+#include "profile.hh"
 #include "ranges.hh"
 #include "register_manager.hh"
 #include "shell_manager.hh"
@@ -38,6 +40,7 @@ void CommandManager::register_command(String command_name,
                                  flags,
                                  std::move(helper),
                                  std::move(completer) };
+    m_completion_index_outdated = true;
 }
 
 bool CommandManager::module_defined(StringView module_name) const
@@ -286,7 +289,7 @@ Token parse_percent_token(Reader& reader, bool throw_on_unterminated)
 
 auto expand_option(Option& opt, std::true_type)
 {
-    return opt.get_as_string(Quoting::Raw);
+    return opt.get_as_string(Quoting::Raw).str();
 }
 
 auto expand_option(Option& opt, std::false_type)
@@ -319,6 +322,18 @@ std::conditional_t<single, String, Vector<String>>
 expand_token(const Token& token, const Context& context, const ShellContext& shell_context)
 {
     using IsSingle = std::integral_constant<bool, single>;
+    // funnel single string results through an explicit move, the braced
+    // return forms copied big expansions into their result storage
+    auto one = [](String str) -> std::conditional_t<single, String, Vector<String>> {
+        if constexpr (single)
+            return str;
+        else
+        {
+            Vector<String> res;
+            res.push_back(std::move(str));
+            return res;
+        }
+    };
     auto& content = token.content;
     switch (token.type)
     {
@@ -336,7 +351,7 @@ expand_token(const Token& token, const Context& context, const ShellContext& she
             ++trailing_eol_count;
         }
         str.resize(str.length() - trailing_eol_count, 0);
-        return {str};
+        return one(std::move(str));
     }
     case Token::Type::RegisterExpand:
         return expand_register(content, context, IsSingle{});
@@ -346,8 +361,8 @@ expand_token(const Token& token, const Context& context, const ShellContext& she
     {
         auto it = shell_context.env_vars.find(content);
         if (it != shell_context.env_vars.end())
-            return {it->value};
-        return {ShellManager::instance().get_val(content, context, Quoting::Kakoune)};
+            return one(it->value);
+        return one(ShellManager::instance().get_val(content, context, Quoting::Kakoune));
     }
     case Token::Type::ArgExpand:
     {
@@ -358,15 +373,15 @@ expand_token(const Token& token, const Context& context, const ShellContext& she
         const int arg = str_to_int(content)-1;
         if (arg < 0)
             throw runtime_error("invalid argument index");
-        return {arg < params.size() ? params[arg] : String{}};
+        return one(arg < params.size() ? params[arg] : String{});
     }
     case Token::Type::FileExpand:
-        return {read_file(content)};
+        return one(read_file(content));
     case Token::Type::RawEval:
-        return {expand(content, context, shell_context)};
+        return one(expand(content, context, shell_context));
     case Token::Type::Raw:
     case Token::Type::RawQuoted:
-        return {content};
+        return one(content);
     default: kak_assert(false);
     }
     return {};
@@ -460,6 +475,45 @@ String expand(StringView str, const Context& context,
     return expand_impl(str, context, shell_context, [](String s){ return s; });
 }
 
+Vector<Token> parse_expansions(StringView str)
+{
+    Vector<Token> result;
+    Reader reader{str};
+    auto beg = str.begin();
+    auto add_literal = [&](const char* end) {
+        if (end != beg)
+            result.push_back({Token::Type::Raw, beg - str.begin(), {},
+                              StringView{beg, end}.str()});
+    };
+    while (reader)
+    {
+        if (*reader == '%')
+        {
+            if (reader.peek_next() == '%')
+            {
+                add_literal((++reader).pos); // keep the first '%'
+                beg = (++reader).pos;        // and skip the second
+            }
+            else
+            {
+                add_literal(reader.pos);
+                result.push_back(parse_percent_token(reader, true));
+                beg = reader.pos;
+            }
+        }
+        else
+            ++reader;
+    }
+    add_literal(reader.pos);
+    return result;
+}
+
+String expand_single_token(const Token& token, const Context& context,
+                           const ShellContext& shell_context)
+{
+    return expand_token<true>(token, context, shell_context);
+}
+
 String expand(StringView str, const Context& context,
               const ShellContext& shell_context,
               const FunctionRef<String (String)>& postprocess)
@@ -497,6 +551,14 @@ void CommandManager::execute_single_command(CommandParameters params,
     ++m_command_depth;
     auto pop_cmd = on_scope_end([this] { --m_command_depth; });
 
+    // only the outermost command is timed, nested commands account into
+    // its wall time
+    ProfileTimer profile_timer{context, ProfileCategory::Command, m_command_depth == 1};
+
+    // coalesce option change notifications, a command (or a sourced script)
+    // setting many options triggers a single watcher cascade per option
+    OptionTransaction option_transaction;
+
     ParameterList param_view(params.begin()+1, params.end());
     auto command_it = find_command(context, params[0]);
     if (command_it == m_commands.end())
@@ -524,16 +586,48 @@ void CommandManager::execute_single_command(CommandParameters params,
     }
 }
 
-void CommandManager::execute(StringView command_line,
-                             Context& context, const ShellContext& shell_context)
+namespace
 {
+
+// Tokenization is independent from the execution context (expansions
+// stay symbolic until expand_token), so command strings that run over
+// and over (mappings, macro bodies, hook commands) only need parsing
+// once. Entries are refcounted as executing a command can recursively
+// fill or flush the cache.
+struct ParsedCommandLine : RefCountable
+{
+    Vector<Token, MemoryDomain::Commands> tokens;
+};
+
+RefPtr<ParsedCommandLine> parse_command_line(StringView command_line)
+{
+    static HashMap<String, RefPtr<ParsedCommandLine>, MemoryDomain::Commands> cache;
+
+    if (auto it = cache.find(command_line); it != cache.end())
+        return it->value;
+
+    RefPtr<ParsedCommandLine> parsed{new ParsedCommandLine{}};
     CommandParser parser(command_line);
+    while (Optional<Token> token = parser.read_token(true))
+        // balanced quoting yields NoCopy strings aliasing the command
+        // line, deep copy so tokens do not outlive their source string
+        parsed->tokens.push_back({token->type, token->pos, token->coord,
+                                  String{token->content.begin(), token->content.end()}});
+
+    if (cache.size() >= 1024)
+        cache.clear();
+    cache.insert({command_line.str(), parsed});
+    return parsed;
+}
+
+}
 
+void CommandManager::execute(StringView command_line,
+                             Context& context, const ShellContext& shell_context)
+{
     BufferCoord command_coord;
     Vector<String, MemoryDomain::Commands> params;
-    while (Optional<Token> token_opt = parser.read_token(true))
-    {
-        auto& token = *token_opt;
+    auto process_token = [&](const Token& token) {
         if (params.empty())
             command_coord = token.coord;
 
@@ -552,6 +646,24 @@ void CommandManager::execute(StringView command_line,
                           std::make_move_iterator(tokens.begin()),
                           std::make_move_iterator(tokens.end()));
         }
+    };
+
+    // Large command lines are sourced files, executed once per process;
+    // streaming their tokens keeps balanced quotes aliasing the mapped
+    // file instead of deep copying every block into the parse cache.
+    constexpr ByteCount parse_cache_max_size = 8192;
+    if (command_line.length() <= parse_cache_max_size)
+    {
+        // keep a reference as recursive executions may flush the cache
+        auto parsed = parse_command_line(command_line);
+        for (auto& token : parsed->tokens)
+            process_token(token);
+    }
+    else
+    {
+        CommandParser parser(command_line);
+        while (Optional<Token> token = parser.read_token(true))
+            process_token(*token);
     }
     execute_single_command(params, context, shell_context, command_coord);
 }
@@ -610,17 +722,43 @@ Optional<CommandInfo> CommandManager::command_info(const Context& context, Strin
     return res;
 }
 
+void CommandManager::update_completion_index() const
+{
+    if (not m_completion_index_outdated)
+        return;
+
+    m_completion_index.clear();
+    m_completion_index.reserve(m_commands.size());
+    for (auto& cmd : m_commands)
+    {
+        if (not (cmd.value.flags & CommandFlags::Hidden))
+            m_completion_index.push_back({cmd.key, used_letters(cmd.key)});
+    }
+    m_completion_index_outdated = false;
+}
+
 Completions CommandManager::complete_command_name(const Context& context, StringView query) const
 {
-    auto commands = m_commands
-            | filter([](const CommandMap::Item& cmd) { return not (cmd.value.flags & CommandFlags::Hidden); })
-            | transform(&CommandMap::Item::key);
+    update_completion_index();
 
-    auto aliases = context.aliases().flatten_aliases()
-            | transform(&HashItem<String, String>::key)
-            | filter([](auto& alias) { return alias.length() > 3; });
+    const UsedLetters query_letters = used_letters(query);
+    NBestMatches<> best{max_menu_candidates};
+    for (auto& [name, letters] : m_completion_index)
+    {
+        if (RankedMatch match{name, letters, query, query_letters})
+            best.push(match);
+    }
+    for (auto& alias : context.aliases().flatten_aliases())
+    {
+        if (alias.key.length() > 3)
+            if (RankedMatch match{alias.key, used_letters(alias.key), query, query_letters})
+                best.push(match);
+    }
 
-    return {0, query.length(), Kakoune::complete(query, query.length(), concatenated(commands, aliases))};
+    CandidateList candidates;
+    for (auto& m : std::move(best).sorted())
+        candidates.push_back(m.candidate().str());
+    return {0, query.length(), std::move(candidates)};
 }
 
 Completions CommandManager::complete_module_name(StringView query) const
@@ -151,6 +151,18 @@ private:
     String m_last_complete_command;
     int m_command_depth = 0;
 
+    void update_completion_index() const;
+
+    struct NameAndLetters
+    {
+        StringView name;
+        UsedLetters letters;
+    };
+    // visible command names with their letters masks precomputed, rebuilt
+    // lazily after registrations instead of on every prompt keystroke
+    mutable Vector<NameAndLetters, MemoryDomain::Commands> m_completion_index;
+    mutable bool m_completion_index_outdated = true;
+
     struct Module
     {
         bool loaded;
@@ -170,6 +182,14 @@ String expand(StringView str, const Context& context,
               const ShellContext& shell_context,
               const FunctionRef<String (String)>& postprocess);
 
+// Split str into literal (Raw) tokens and the percent expansions expand()
+// would evaluate, so that callers can cache the parse across evaluations
+Vector<Token> parse_expansions(StringView str);
+
+// Expand a single non literal token parsed by parse_expansions
+String expand_single_token(const Token& token, const Context& context,
+                           const ShellContext& shell_context);
+
 }
 
 #endif // command_manager_hh_INCLUDED
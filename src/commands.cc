@@ -3,22 +3,26 @@
 #include "buffer.hh"
 #include "buffer_manager.hh"
 #include "buffer_utils.hh"
+#include "cancel.hh"
 #include "client.hh"
 #include "client_manager.hh"
 #include "command_manager.hh"
 #include "completion.hh"
 #include "context.hh"
+#include "env_vars.hh"
 #include "event_manager.hh"
 #include "face_registry.hh"
 #include "file.hh"
 #include "hash_map.hh"
 #include "highlighter.hh"
+#include "highlighter_group.hh"
 #include "highlighters.hh"
 #include "insert_completer.hh"
 #include "normal.hh"
 #include "option_manager.hh"
 #include "option_types.hh"
 #include "parameters_parser.hh"
+#include "profile.hh"
 #include "ranges.hh"
 #include "ranked_match.hh"
 #include "regex.hh"
@@ -26,6 +30,7 @@
 #include "remote.hh"
 #include "shell_manager.hh"
 #include "string.hh"
+#include "thread_pool.hh"
 #include "user_interface.hh"
 #include "window.hh"
 
@@ -924,8 +929,27 @@ const CommandDesc add_highlighter_cmd = {
 
         String name{slash.base(), path.end()};
         Highlighter& parent = get_highlighter(context, {path.begin(), slash.base() - 1});
+
+        RefPtr<Highlighter> highlighter;
+        if (it->value.shareable)
+        {
+            // identical definitions of immutable highlighters are interned
+            // so that adding the same highlighter to many scopes (a window
+            // scoped one per window for example) shares a single object
+            static HashMap<String, RefPtr<Highlighter>, MemoryDomain::Highlight> shared;
+            String key{type};
+            for (auto& param : highlighter_params)
+                key += format("\x1f{}\x1f{}", param.length(), param);
+            auto& shared_hl = shared[std::move(key)];
+            if (not shared_hl)
+                shared_hl = it->value.factory(highlighter_params, &parent);
+            highlighter = shared_hl;
+        }
+        else
+            highlighter = it->value.factory(highlighter_params, &parent);
+
         parent.add_child(name.empty() ? auto_name(parser.positionals_from(1)) : std::move(name),
-                            it->value.factory(highlighter_params, &parent));
+                         std::move(highlighter));
 
         // TODO: better, this will fail if we touch scopes highlighters that impact multiple windows
         if (context.has_window())
@@ -1308,7 +1332,9 @@ const CommandDesc debug_cmd = {
         [](const Context& context, CompletionFlags flags,
            const String& prefix, ByteCount cursor_pos) -> Completions {
                auto c = {"info", "buffers", "options", "memory", "shared-strings",
-                         "profile-hash-maps", "faces", "mappings", "regex"};
+                         "profile-hash-maps", "faces", "mappings", "regex",
+                         "highlighters", "profile", "trace", "frame-times",
+                         "env", "threads"};
                return { 0_byte, cursor_pos, complete(prefix, cursor_pos, c) };
     }),
     [](const ParametersParser& parser, Context& context, const ShellContext&)
@@ -1339,23 +1365,100 @@ const CommandDesc debug_cmd = {
         }
         else if (parser[0] == "memory")
         {
-            auto total = 0;
-            write_to_debug_buffer("Memory usage:");
-            for (int domain = 0; domain < (int)MemoryDomain::Count; ++domain)
+            struct MemorySnapshot { MemoryStats stats[(size_t)MemoryDomain::Count]; };
+            static HashMap<String, MemorySnapshot> snapshots;
+
+            if (parser.positional_count() == 1)
             {
-                auto& stats = memory_stats[domain];
-                total += stats.allocated_bytes;
-                write_to_debug_buffer(
-                    format("  {}: {} bytes, {} alloc active, {} alloc total",
-                           domain_name((MemoryDomain)domain),
-                           stats.allocated_bytes,
-                           stats.allocation_count,
-                           stats.total_allocation_count));
+                auto total = 0;
+                write_to_debug_buffer("Memory usage:");
+                for (int domain = 0; domain < (int)MemoryDomain::Count; ++domain)
+                {
+                    auto& stats = memory_stats[domain];
+                    total += stats.allocated_bytes;
+                    String pool_info;
+                    if (auto& pool = pool_stats[domain]; pool.hits + pool.misses != 0)
+                        pool_info = format(", pool hits {}/{}", pool.hits, pool.hits + pool.misses);
+                    write_to_debug_buffer(
+                        format("  {}: {} bytes, {} alloc active, {} alloc total{}",
+                               domain_name((MemoryDomain)domain),
+                               stats.allocated_bytes,
+                               stats.allocation_count,
+                               stats.total_allocation_count,
+                               pool_info));
+                }
+                write_to_debug_buffer(format("  Total: {}", total));
+                #if defined(__GLIBC__) || defined(__CYGWIN__)
+                write_to_debug_buffer(format("  Malloced: {}", mallinfo().uordblks));
+                #endif
             }
-            write_to_debug_buffer(format("  Total: {}", total));
-            #if defined(__GLIBC__) || defined(__CYGWIN__)
-            write_to_debug_buffer(format("  Malloced: {}", mallinfo().uordblks));
-            #endif
+            else if (parser[1] == "snapshot")
+            {
+                if (parser.positional_count() != 3)
+                    throw runtime_error("expected a snapshot name");
+                auto& snapshot = snapshots[parser[2]];
+                std::copy(std::begin(memory_stats), std::end(memory_stats),
+                          std::begin(snapshot.stats));
+                write_to_debug_buffer(format("memory snapshot '{}' recorded", parser[2]));
+            }
+            else if (parser[1] == "diff")
+            {
+                if (parser.positional_count() != 4)
+                    throw runtime_error("expected two snapshot names");
+                auto get = [](const String& name) -> const MemorySnapshot& {
+                    auto it = snapshots.find(name);
+                    if (it == snapshots.end())
+                        throw runtime_error(format("no such snapshot: '{}'", name));
+                    return it->value;
+                };
+                const auto& from = get(parser[2]);
+                const auto& to = get(parser[3]);
+                write_to_debug_buffer(format("Memory diff {} -> {}:", parser[2], parser[3]));
+                for (int domain = 0; domain < (int)MemoryDomain::Count; ++domain)
+                {
+                    auto delta = [&](size_t MemoryStats::*member) {
+                        return (ssize_t)(to.stats[domain].*member) -
+                               (ssize_t)(from.stats[domain].*member);
+                    };
+                    const auto bytes = delta(&MemoryStats::allocated_bytes);
+                    const auto active = delta(&MemoryStats::allocation_count);
+                    const auto total = delta(&MemoryStats::total_allocation_count);
+                    if (bytes == 0 and active == 0 and total == 0)
+                        continue;
+                    auto with_sign = [](ssize_t v) {
+                        return format("{}{}", v > 0 ? "+" : "", v);
+                    };
+                    write_to_debug_buffer(
+                        format("  {}: {} bytes, {} alloc active, {} alloc total",
+                               domain_name((MemoryDomain)domain), with_sign(bytes),
+                               with_sign(active), with_sign(total)));
+                }
+            }
+            else if (parser[1] == "sample")
+            {
+                if (parser.positional_count() != 3)
+                    throw runtime_error("expected a sampling rate, 0 disables sampling");
+                set_alloc_sampling((size_t)std::max(0, str_to_int(parser[2])));
+            }
+            else if (parser[1] == "samples")
+            {
+                auto samples = alloc_samples() | gather<Vector<AllocSiteSample>>();
+                std::sort(samples.begin(), samples.end(),
+                          [](const AllocSiteSample& lhs, const AllocSiteSample& rhs) {
+                              return lhs.count > rhs.count;
+                          });
+                write_to_debug_buffer(format("Allocation samples (every {} allocations):",
+                                             alloc_sample_rate));
+                if (samples.empty())
+                    write_to_debug_buffer("  no samples recorded, is sampling enabled?");
+                for (auto& sample : samples)
+                    write_to_debug_buffer(format(" * {} samples, {} bytes, domain {}:\n{}",
+                                                 sample.count, sample.total_bytes,
+                                                 domain_name(sample.domain),
+                                                 sample.backtrace.desc()));
+            }
+            else
+                throw runtime_error(format("no such memory command: '{}'", parser[1]));
         }
         else if (parser[0] == "shared-strings")
         {
@@ -1385,13 +1488,109 @@ const CommandDesc debug_cmd = {
                                           keymaps.get_mapping(key, m).docstring));
             }
         }
-        else if (parser[0] == "regex")
+        else if (parser[0] == "highlighters")
+        {
+            write_highlighter_timings_to_debug_buffer();
+        }
+        else if (parser[0] == "profile")
         {
             if (parser.positional_count() != 2)
+                throw runtime_error("expected start, stop or report");
+
+            if (parser[1] == "start")
+                start_profiling();
+            else if (parser[1] == "stop")
+                stop_profiling();
+            else if (parser[1] == "report")
+                report_profiling();
+            else
+                throw runtime_error(format("no such profile command: '{}'", parser[1]));
+        }
+        else if (parser[0] == "env")
+        {
+            if (parser.positional_count() == 1)
+            {
+                write_to_debug_buffer("Environment snapshot:");
+                for (auto& [name, value] : env_vars_snapshot())
+                    write_to_debug_buffer(format(" * {}={}", name, value));
+            }
+            else if (parser[1] == "refresh")
+                refresh_env_vars_snapshot();
+            else
+                throw runtime_error(format("no such env command: '{}'", parser[1]));
+        }
+        else if (parser[0] == "frame-times")
+        {
+            write_to_debug_buffer("Frame times (rolling window):");
+            for (auto& client : ClientManager::instance())
+            {
+                auto times = client->frame_times() | gather<Vector<Clock::duration>>();
+                if (times.empty())
+                {
+                    write_to_debug_buffer(format(" * {}: no frames drawn", client->context().name()));
+                    continue;
+                }
+                std::sort(times.begin(), times.end());
+                auto ms = [](Clock::duration d) {
+                    const auto us = (size_t)std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+                    return format("{}.{}", us / 1000, (us / 100) % 10);
+                };
+                write_to_debug_buffer(
+                    format(" * {}: {} frames, last {} ms, p50 {} ms, p99 {} ms, max {} ms",
+                           client->context().name(), times.size(),
+                           ms(client->last_frame_duration()),
+                           ms(times[(times.size() - 1) / 2]),
+                           ms(times[(times.size() - 1) * 99 / 100]),
+                           ms(times.back())));
+            }
+        }
+        else if (parser[0] == "trace")
+        {
+            if (parser.positional_count() < 2)
+                throw runtime_error("expected start, stop or dump <filename>");
+
+            if (parser[1] == "start")
+                start_tracing();
+            else if (parser[1] == "stop")
+                stop_tracing();
+            else if (parser[1] == "dump")
+            {
+                if (parser.positional_count() != 3)
+                    throw runtime_error("expected a filename");
+                dump_trace(parse_filename(parser[2]));
+            }
+            else
+                throw runtime_error(format("no such trace command: '{}'", parser[1]));
+        }
+        else if (parser[0] == "threads")
+        {
+            auto& pool = ThreadPool::instance();
+            const auto stats = pool.worker_stats();
+            if (stats.empty())
+            {
+                write_to_debug_buffer("Thread pool: no workers spawned (nothing was scheduled yet)");
+                return;
+            }
+            auto ms = [](Clock::duration d) {
+                return (size_t)std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+            };
+            const auto uptime = ms(pool.uptime());
+            write_to_debug_buffer(format("Thread pool: {} workers, up {} ms:", stats.size(), uptime));
+            for (size_t i = 0; i < stats.size(); ++i)
+                write_to_debug_buffer(format(" * worker {}: {} tasks run, {} stolen, busy {} ms ({}%)",
+                                             i, stats[i].executed, stats[i].stolen, ms(stats[i].busy),
+                                             uptime == 0 ? 0 : ms(stats[i].busy) * 100 / uptime));
+        }
+        else if (parser[0] == "regex")
+        {
+            if (parser.positional_count() == 1)
+                write_to_debug_buffer(format("Regex execution: {} instructions executed, {} threads spawned",
+                                             regex_executed_instructions, regex_spawned_threads));
+            else if (parser.positional_count() != 2)
                 throw runtime_error("expected a regex");
-
-            write_to_debug_buffer(format(" * {}:\n{}",
-                                  parser[1], dump_regex(compile_regex(parser[1], RegexCompileFlags::None))));
+            else
+                write_to_debug_buffer(format(" * {}:\n{}",
+                                      parser[1], dump_regex(compile_regex(parser[1], RegexCompileFlags::None))));
         }
         else
             throw runtime_error(format("no such debug command: '{}'", parser[0]));
@@ -1486,7 +1685,7 @@ const CommandDesc set_option_cmd = {
         {
             OptionManager& options = get_scope(params[start], context).options();
             return {0_byte, params[start + 2].length(),
-                    {options[params[start + 1]].get_as_string(Quoting::Kakoune)},
+                    {options[params[start + 1]].get_as_string(Quoting::Kakoune).str()},
                     Completions::Flags::Quoted};
         }
         return Completions{};
@@ -1872,7 +2071,7 @@ void context_wrap(const ParametersParser& parser, Context& context, StringView d
         if (auto index = jump_list.current_index();
             collapse_jumps and index > prev_index and
             contains(BufferManager::instance(), &jump->buffer()))
-            jump_list.push(std::move(*jump), prev_index);
+            jump_list.push(std::move(*jump), (size_t)c.options()["max_jumps"].get<int>(), prev_index);
     }
 }
 
@@ -1901,7 +2100,10 @@ const CommandDesc exec_string_cmd = {
             }
 
             for (auto& key : keys)
+            {
+                cancellation_point();
                 context.input_handler().handle_key(key);
+            }
         });
     }
 };
@@ -2215,6 +2417,23 @@ const CommandDesc try_catch_cmd = {
     }
 };
 
+const CommandDesc with_option_transaction_cmd = {
+    "with-option-transaction",
+    nullptr,
+    "with-option-transaction <commands>: execute commands as a single option\n"
+    "transaction, watchers (hooks, highlighters...) are notified once per\n"
+    "modified option when the transaction ends",
+    single_param,
+    CommandFlags::None,
+    CommandHelper{},
+    CommandCompleter{},
+    [](const ParametersParser& parser, Context& context, const ShellContext& shell_context)
+    {
+        OptionTransaction transaction;
+        CommandManager::instance().execute(parser[0], context, shell_context);
+    }
+};
+
 static Completions complete_face(const Context& context, CompletionFlags flags,
                                  const String& prefix, ByteCount cursor_pos)
 {
@@ -2334,6 +2553,83 @@ const CommandDesc select_cmd = {
     }
 };
 
+const CommandDesc sort_selections_cmd = {
+    "sort-selections",
+    nullptr,
+    "sort-selections [-reverse]: sort the selections content, replacing each "
+    "selection with the content at its new position",
+    ParameterDesc{
+        {{"reverse", {false, "sort in descending order"}}},
+        ParameterDesc::Flags::None, 0, 0
+    },
+    CommandFlags::None,
+    CommandHelper{},
+    CommandCompleter{},
+    [](const ParametersParser& parser, Context& context, const ShellContext&)
+    {
+        auto strings = context.selections_content();
+        std::sort(strings.begin(), strings.end(),
+                  [](const String& lhs, const String& rhs) { return lhs < rhs; });
+        if (parser.get_switch("reverse"))
+            std::reverse(strings.begin(), strings.end());
+
+        ScopedEdition edition(context);
+        context.selections().insert(strings, InsertMode::Replace);
+    }
+};
+
+const CommandDesc grep_buffers_cmd = {
+    "grep-buffers",
+    nullptr,
+    "grep-buffers <regex>: search <regex> in all buffers already in memory "
+    "and fill the *grep* buffer with the matching lines",
+    single_param,
+    CommandFlags::None,
+    CommandHelper{},
+    CommandCompleter{},
+    [](const ParametersParser& parser, Context& context, const ShellContext&)
+    {
+        const Regex regex{parser[0]};
+        // matching lines need no capture information, scan each line of
+        // the contiguous line storage with the cheapest vm configuration
+        ThreadedRegexVM<const char*, RegexMode::Forward | RegexMode::Search |
+                                     RegexMode::AnyMatch | RegexMode::NoSaves> vm{*regex.impl()};
+
+        String content;
+        size_t matches = 0;
+        for (auto& buffer : BufferManager::instance())
+        {
+            if (buffer->flags() & (Buffer::Flags::Debug | Buffer::Flags::Fifo) or
+                buffer->name() == "*grep*")
+                continue;
+            auto& name = buffer->display_name();
+            for (LineCount line = 0; line < buffer->line_count(); ++line)
+            {
+                const StringView l = (*buffer)[line];
+                if (not vm.exec(l.begin(), l.end()-1, l.begin(), l.end()-1,
+                                RegexExecFlags::None))
+                    continue;
+                content += format("{}:{}:{}", name, line+1, l); // l ends with the eol
+                ++matches;
+            }
+        }
+
+        if (matches == 0)
+            throw runtime_error("nothing matched");
+
+        auto& manager = BufferManager::instance();
+        if (Buffer* existing = manager.get_buffer_ifp("*grep*"))
+        {
+            ClientManager::instance().ensure_no_client_uses_buffer(*existing);
+            manager.delete_buffer(*existing);
+        }
+        Buffer* grep_buffer = manager.create_buffer("*grep*", Buffer::Flags::NoUndo, content);
+        grep_buffer->options().get_local_option("filetype").set(String{"grep"});
+        context.print_status({format("{} matching lines", matches),
+                              context.faces()["Information"]});
+    }
+};
+
 const CommandDesc change_directory_cmd = {
     "change-directory",
     "cd",
@@ -2374,6 +2670,61 @@ const CommandDesc rename_session_cmd = {
     }
 };
 
+const CommandDesc fork_session_cmd = {
+    "fork-session",
+    nullptr,
+    "fork-session <name>: fork a pre-warmed server for session <name>, "
+    "inheriting the current server state (parsed configuration, compiled "
+    "highlighters) instead of paying the full startup cost",
+    single_param,
+    CommandFlags::None,
+    CommandHelper{},
+    CommandCompleter{},
+    [](const ParametersParser& parser, Context&, const ShellContext&)
+    {
+        Server::instance().fork_session(parser[0]);
+    }
+};
+
+const CommandDesc save_session_cmd = {
+    "save-session",
+    nullptr,
+    "save-session <filename>: write a script to <filename> which, when "
+    "sourced, reopens the current buffer list and restores buffer scoped "
+    "options and register contents",
+    single_param,
+    CommandFlags::None,
+    CommandHelper{},
+    filename_completer<false>,
+    [](const ParametersParser& parser, Context& context, const ShellContext&)
+    {
+        String script;
+        for (auto& buffer : BufferManager::instance())
+        {
+            if (not (buffer->flags() & Buffer::Flags::File) or
+                (buffer->flags() & Buffer::Flags::Debug))
+                continue;
+
+            script += format("try %\\{\n    edit -existing {}\n", quote(buffer->name()));
+            for (auto& option : buffer->options().local_options())
+                script += format("    set-option buffer {} {}\n", option->name(),
+                                 option->get_as_string(Quoting::Kakoune));
+            script += "}\n";
+        }
+
+        for (auto c : StringView{"abcdefghijklmnopqrstuvwxyz\"^@/|:\\"})
+        {
+            auto content = RegisterManager::instance()[c].save(context);
+            if (content.empty() or (content.size() == 1 and content[0].empty()))
+                continue;
+            script += format("set-register {} {}\n", quote(String{(Codepoint)c}),
+                             join(content | transform(quoter(Quoting::Kakoune)), ' ', false));
+        }
+
+        write_to_file(parse_filename(parser[0]), script);
+    }
+};
+
 const CommandDesc fail_cmd = {
     "fail",
     nullptr,
@@ -2553,13 +2904,18 @@ void register_commands()
     register_command(on_key_cmd);
     register_command(info_cmd);
     register_command(try_catch_cmd);
+    register_command(with_option_transaction_cmd);
     register_command(set_face_cmd);
     register_command(unset_face_cmd);
     register_command(rename_client_cmd);
     register_command(set_register_cmd);
     register_command(select_cmd);
+    register_command(sort_selections_cmd);
+    register_command(grep_buffers_cmd);
     register_command(change_directory_cmd);
     register_command(rename_session_cmd);
+    register_command(fork_session_cmd);
+    register_command(save_session_cmd);
     register_command(fail_cmd);
     register_command(declare_user_mode_cmd);
     register_command(enter_user_mode_cmd);
@@ -66,24 +66,74 @@ inline Completions offset_pos(Completions completion, ByteCount offset)
             std::move(completion.candidates), completion.flags};
 }
 
+// Streaming n-best selection: matches are pushed as they are generated and
+// only the `max_count` best ranked ones are kept (in a binary heap with the
+// worst kept match on top), so selecting from a large candidate space needs
+// memory proportional to the selection rather than to the space. Generators
+// able to bound the rank of their remaining candidates can stop generating
+// once `full()` and the bound cannot beat `floor()`.
+template<typename Match = RankedMatch>
+class NBestMatches
+{
+public:
+    explicit NBestMatches(size_t max_count) : m_max_count{max_count} {}
+
+    void push(Match match)
+    {
+        auto worse = [](const Match& lhs, const Match& rhs) { return rhs < lhs; };
+        if (m_matches.size() < m_max_count)
+        {
+            m_matches.push_back(std::move(match));
+            std::push_heap(m_matches.begin(), m_matches.end(), worse);
+        }
+        else if (m_max_count != 0 and match < m_matches.front())
+        {
+            std::pop_heap(m_matches.begin(), m_matches.end(), worse);
+            m_matches.back() = std::move(match);
+            std::push_heap(m_matches.begin(), m_matches.end(), worse);
+        }
+    }
+
+    bool full() const { return m_matches.size() == m_max_count; }
+    const Match& floor() const { return m_matches.front(); }
+
+    // kept matches, best first
+    Vector<Match, MemoryDomain::Completion> sorted() &&
+    {
+        std::sort(m_matches.begin(), m_matches.end());
+        return std::move(m_matches);
+    }
+
+private:
+    Vector<Match, MemoryDomain::Completion> m_matches;
+    size_t m_max_count;
+};
+
+// completion menus cannot usefully be cycled through much further anyway,
+// and this bounds the work of ranking and of sending the menu to the ui
+constexpr size_t max_menu_candidates = 512;
+
 template<typename Container>
 CandidateList complete(StringView query, ByteCount cursor_pos,
-                       const Container& container)
+                       const Container& container,
+                       size_t max_count = max_menu_candidates)
 {
     using std::begin;
     static_assert(not std::is_same<decltype(*begin(container)), String>::value,
                   "complete require long lived strings, not temporaries");
 
     query = query.substr(0, cursor_pos);
-    Vector<RankedMatch> matches;
+    // the used letters bitmasks reject most non matching candidates
+    // before the full subsequence scoring runs
+    const UsedLetters query_letters = used_letters(query);
+    NBestMatches<> best{max_count};
     for (const auto& str : container)
     {
-        if (RankedMatch match{str, query})
-            matches.push_back(match);
+        if (RankedMatch match{str, used_letters(str), query, query_letters})
+            best.push(match);
     }
-    std::sort(matches.begin(), matches.end());
     CandidateList res;
-    for (auto& m : matches)
+    for (auto& m : std::move(best).sorted())
         res.push_back(m.candidate().str());
     return res;
 }
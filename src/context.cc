@@ -4,6 +4,8 @@
 #include "client.hh"
 #include "face_registry.hh"
 #include "buffer_manager.hh"
+#include "option_manager.hh"
+#include "option_types.hh"
 #include "register_manager.hh"
 #include "window.hh"
 
@@ -77,7 +79,7 @@ void Context::print_status(DisplayLine status) const
         client().print_status(std::move(status));
 }
 
-void JumpList::push(SelectionList jump, Optional<size_t> index)
+void JumpList::push(SelectionList jump, size_t max_jumps, Optional<size_t> index)
 {
     if (index)
     {
@@ -90,6 +92,8 @@ void JumpList::push(SelectionList jump, Optional<size_t> index)
     m_jumps.erase(std::remove(begin(m_jumps), end(m_jumps), jump),
                       end(m_jumps));
     m_jumps.push_back(jump);
+    if (m_jumps.size() > max_jumps)
+        m_jumps.erase(m_jumps.begin(), m_jumps.end() - max_jumps);
     m_current = m_jumps.size();
 }
 
@@ -114,11 +118,12 @@ const SelectionList& JumpList::backward(Context& context, int count)
     if ((int)m_current - count < 0)
         throw runtime_error("no previous jump");
 
+    const size_t max_jumps = (size_t)context.options()["max_jumps"].get<int>();
     const SelectionList& current = context.selections();
     if (m_current != m_jumps.size() and
         m_jumps[m_current] != current)
     {
-        push(current);
+        push(current, max_jumps);
         m_current -= count;
         SelectionList& res = m_jumps[m_current];
         res.update();
@@ -131,7 +136,7 @@ const SelectionList& JumpList::backward(Context& context, int count)
     {
         if (m_current == m_jumps.size())
         {
-            push(current);
+            push(current, max_jumps);
             if (--m_current == 0)
                 throw runtime_error("no previous jump");
         }
@@ -164,6 +169,12 @@ void JumpList::forget_buffer(Buffer& buffer)
     }
 }
 
+void Context::push_jump(bool force)
+{
+    if (force or not (m_flags & Flags::Draft))
+        m_jump_list.push(selections(), (size_t)options()["max_jumps"].get<int>());
+}
+
 void Context::change_buffer(Buffer& buffer)
 {
     if (has_buffer() and &buffer == &this->buffer())
@@ -231,6 +242,7 @@ Vector<String> Context::selections_content() const
 {
     auto& buf = buffer();
     Vector<String> contents;
+    contents.reserve(selections().size());
     for (auto& sel : selections())
         contents.push_back(buf.string(sel.min(), buf.char_next(sel.max())));
     return contents;
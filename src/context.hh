@@ -21,7 +21,7 @@ class AliasRegistry;
 
 struct JumpList
 {
-    void push(SelectionList jump, Optional<size_t> index = {});
+    void push(SelectionList jump, size_t max_jumps, Optional<size_t> index = {});
     const SelectionList& forward(Context& context, int count);
     const SelectionList& backward(Context& context, int count);
     void forget_buffer(Buffer& buffer);
@@ -121,14 +121,15 @@ public:
     NestedBool& history_disabled() { return m_history_disabled; }
     const NestedBool& history_disabled() const { return m_history_disabled; }
 
+    // set while replaying many keys at once (macros), transient ui
+    // updates and idle timer scheduling are skipped until the batch ends
+    NestedBool& batched_keys() { return m_batched_keys; }
+    const NestedBool& batched_keys() const { return m_batched_keys; }
+
     Flags flags() const { return m_flags; }
 
     JumpList& jump_list() { return m_jump_list; }
-    void push_jump(bool force = false)
-    {
-        if (force or not (m_flags & Flags::Draft))
-            m_jump_list.push(selections());
-    }
+    void push_jump(bool force = false);
 
     template<typename Func>
     void set_last_select(Func&& last_select) { m_last_select = std::forward<Func>(last_select); }
@@ -162,6 +163,7 @@ private:
     NestedBool m_hooks_disabled;
     NestedBool m_keymaps_disabled;
     NestedBool m_history_disabled;
+    NestedBool m_batched_keys;
 };
 
 struct ScopedEdition
@@ -23,8 +23,8 @@ struct Snake
     enum Op { Add, Del, RevAdd, RevDel } op;
 };
 
-template<typename Iterator, typename Equal>
-Snake find_end_snake_of_further_reaching_dpath(Iterator a, int N, Iterator b, int M,
+template<typename IteratorA, typename IteratorB, typename Equal>
+Snake find_end_snake_of_further_reaching_dpath(IteratorA a, int N, IteratorB b, int M,
                                                const int* V, const int D, const int k, Equal eq)
 {
     const bool add = k == -D or (k != D and V[k-1] < V[k+1]);
@@ -44,15 +44,16 @@ Snake find_end_snake_of_further_reaching_dpath(Iterator a, int N, Iterator b, in
     return { x, y, u, v, add ? Snake::Add : Snake::Del };
 }
 
-template<typename Iterator, typename Equal>
-Snake find_middle_snake(Iterator a, int N, Iterator b, int M,
+template<typename IteratorA, typename IteratorB, typename Equal>
+Snake find_middle_snake(IteratorA a, int N, IteratorB b, int M,
                         int* V1, int* V2, int cost_limit, Equal eq)
 {
     const int delta = N - M;
     V1[1] = 0;
     V2[1] = 0;
 
-    std::reverse_iterator<Iterator> ra{a + N}, rb{b + M};
+    std::reverse_iterator<IteratorA> ra{a + N};
+    std::reverse_iterator<IteratorB> rb{b + M};
     const int max_D = std::min((M + N + 1) / 2 + 1, cost_limit);
     for (int D = 0; D < max_D; ++D)
     {
@@ -121,9 +122,9 @@ inline void append_diff(Vector<Diff>& diffs, Diff diff)
         diffs.push_back(diff);
 }
 
-template<typename Iterator, typename Equal>
-void find_diff_rec(Iterator a, int begA, int endA,
-                   Iterator b, int begB, int endB,
+template<typename IteratorA, typename IteratorB, typename Equal>
+void find_diff_rec(IteratorA a, int begA, int endA,
+                   IteratorB b, int begB, int endB,
                    int* V1, int* V2, int cost_limit,
                    Equal eq, Vector<Diff>& diffs)
 {
@@ -172,18 +173,42 @@ void find_diff_rec(Iterator a, int begA, int endA,
     append_diff(diffs, {Diff::Keep, suffix_len, 0});
 }
 
-template<typename Iterator, typename Equal = std::equal_to<>>
-Vector<Diff> find_diff(Iterator a, int N, Iterator b, int M, Equal eq = Equal{})
+template<typename IteratorA, typename IteratorB, typename Equal = std::equal_to<>>
+Vector<Diff> find_diff(IteratorA a, int N, IteratorB b, int M, Equal eq = Equal{})
 {
-    const int max = 2 * (N + M) + 1;
-    Vector<int> data(2*max);
-    Vector<Diff> diffs;
     constexpr int cost_limit = 1000;
-    find_diff_rec(a, 0, N, b, 0, M, &data[N+M], &data[max + N+M], cost_limit, eq, diffs);
+    // paths are explored up to cost_limit edits, so the diagonal vectors
+    // only need that many entries on each side of the middle diagonal,
+    // not one per element
+    const int max_d = std::min((N + M + 1) / 2 + 1, cost_limit);
+    const int size = 2 * (max_d + 1) + 1;
+    Vector<int> data(2*size);
+    Vector<Diff> diffs;
+    find_diff_rec(a, 0, N, b, 0, M, &data[max_d+1], &data[size + max_d+1], cost_limit, eq, diffs);
 
     return diffs;
 }
 
+template<typename IteratorA, typename IteratorB, typename Equal, typename Hash>
+Vector<Diff> find_diff(IteratorA a, int N, IteratorB b, int M, Equal eq, Hash hash)
+{
+    // hash every element once and compare hashes, so that each probe of
+    // the O(ND) loop costs a word comparison; elements are only compared
+    // when their hashes are equal
+    Vector<size_t> hashes(N + M);
+    for (int i = 0; i < N; ++i)
+        hashes[i] = hash(a[i]);
+    for (int i = 0; i < M; ++i)
+        hashes[N + i] = hash(b[i]);
+
+    const size_t* ha = hashes.data();
+    const size_t* hb = hashes.data() + N;
+    return find_diff(ha, N, hb, M,
+                     [&](const size_t& lhs, const size_t& rhs) {
+                         return lhs == rhs and eq(a[&lhs - ha], b[&rhs - hb]);
+                     });
+}
+
 }
 
 #endif // diff_hh_INCLUDED
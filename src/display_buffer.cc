@@ -206,6 +206,13 @@ void DisplayLine::trim(ColumnCount first_col, ColumnCount col_count)
     compute_range();
 }
 
+void DisplayLine::reset(DisplayAtom atom)
+{
+    m_atoms.clear();
+    m_atoms.push_back(std::move(atom));
+    compute_range();
+}
+
 const BufferRange init_range{ {INT_MAX, INT_MAX}, {INT_MIN, INT_MIN} };
 
 void DisplayLine::compute_range()
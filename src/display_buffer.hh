@@ -120,6 +120,10 @@ public:
     iterator erase(iterator beg, iterator end);
     void     push_back(DisplayAtom atom);
 
+    // Reset the line to the given atom, reusing the atom storage
+    // allocated by previous uses of the line
+    void     reset(DisplayAtom atom);
+
     // remove first_col from the begining of the line, and make sure
     // the line is less that col_count character
     void trim(ColumnCount first_col, ColumnCount col_count);
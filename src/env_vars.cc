@@ -7,7 +7,7 @@ extern char **environ;
 namespace Kakoune
 {
 
-EnvVarMap get_env_vars()
+static EnvVarMap get_env_vars()
 {
     EnvVarMap env_vars;
     for (char** it = environ; *it; ++it)
@@ -22,4 +22,22 @@ EnvVarMap get_env_vars()
     return env_vars;
 }
 
+static EnvVarMap env_snapshot;
+static bool env_snapshot_valid = false;
+
+const EnvVarMap& env_vars_snapshot()
+{
+    if (not env_snapshot_valid)
+    {
+        env_snapshot = get_env_vars();
+        env_snapshot_valid = true;
+    }
+    return env_snapshot;
+}
+
+void refresh_env_vars_snapshot()
+{
+    env_snapshot_valid = false;
+}
+
 }
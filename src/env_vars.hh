@@ -9,7 +9,12 @@ namespace Kakoune
 class String;
 using EnvVarMap = HashMap<String, String, MemoryDomain::EnvVars>;
 
-EnvVarMap get_env_vars();
+// Snapshot of the process environment, built on first use and shared by
+// reference so callers do not rebuild the map on every access; the
+// entries view environ directly, which is stable as the server never
+// calls setenv past startup. `debug env refresh` invalidates it.
+const EnvVarMap& env_vars_snapshot();
+void refresh_env_vars_snapshot();
 
 }
 
@@ -1,7 +1,9 @@
 #include "event_manager.hh"
 
 #include "flags.hh"
+#include "profile.hh"
 #include "ranges.hh"
+#include "string_utils.hh"
 
 #include <unistd.h>
 
@@ -71,6 +73,7 @@ EventManager::~EventManager()
 
 bool EventManager::handle_next_events(EventMode mode, sigset_t* sigmask, bool block)
 {
+    TraceTimer trace_timer{"event loop"};
     int max_fd = 0;
     fd_set rfds, wfds, efds;
     FD_ZERO(&rfds); FD_ZERO(&wfds); FD_ZERO(&efds);
@@ -111,8 +114,12 @@ bool EventManager::handle_next_events(EventMode mode, sigset_t* sigmask, bool bl
             ts = timespec{ (time_t)secs.count(), (long)(nsecs - secs).count() };
         }
     }
-    int res = pselect(max_fd + 1, &rfds, &wfds, &efds,
+    int res;
+    {
+        TraceTimer select_timer{"select"};
+        res = pselect(max_fd + 1, &rfds, &wfds, &efds,
                       not block or with_timeout ? &ts : nullptr, sigmask);
+    }
 
     // copy forced fds *after* select, so that signal handlers can write to
     // m_forced_fd, interupt select, and directly be serviced.
@@ -120,29 +127,43 @@ bool EventManager::handle_next_events(EventMode mode, sigset_t* sigmask, bool bl
     fd_set forced = m_forced_fd;
     FD_ZERO(&m_forced_fd);
 
-    for (int fd = 0; fd < max_fd + 1; ++fd)
+    // iterate over a copy of the watchers, as callbacks may mutate the list
+    auto watchers = m_fd_watchers;
+    for (auto& watcher : watchers)
     {
-        auto events =  FD_ISSET(fd, &forced) ? FdEvents::Read : FdEvents::None;
-        if (res > 0)
+        if (not contains(m_fd_watchers, watcher))
+            continue;
+
+        const int fd = watcher->fd();
+        if (fd == -1)
+            continue;
+
+        auto events = FD_ISSET(fd, &forced) ? FdEvents::Read : FdEvents::None;
+        if (res > 0 and fd <= max_fd)
             events |= (FD_ISSET(fd, &rfds) ? FdEvents::Read : FdEvents::None) |
                       (FD_ISSET(fd, &wfds) ? FdEvents::Write : FdEvents::None) |
                       (FD_ISSET(fd, &efds) ? FdEvents::Except : FdEvents::None);
 
         if (events != FdEvents::None)
         {
-            auto it = find_if(m_fd_watchers,
-                              [fd](const FDWatcher* w){return w->fd() == fd; });
-            if (it != m_fd_watchers.end())
-                (*it)->run(events, mode);
+            char name[32];
+            TraceTimer watcher_timer{format_to(name, "fd {}", fd)};
+            watcher->run(events, mode);
         }
     }
 
     TimePoint now = Clock::now();
-    auto timers = m_timers; // copy timers in case m_timers gets mutated
-    for (auto& timer : timers)
+    if (any_of(m_timers, [now](Timer* timer) { return timer->next_date() <= now; }))
     {
-        if (contains(m_timers, timer) and timer->next_date() <= now)
-            timer->run(mode);
+        auto timers = m_timers; // copy timers in case m_timers gets mutated
+        for (auto& timer : timers)
+        {
+            if (contains(m_timers, timer) and timer->next_date() <= now)
+            {
+                TraceTimer timer_timer{"timer"};
+                timer->run(mode);
+            }
+        }
     }
 
     return res > 0;
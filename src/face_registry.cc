@@ -1,13 +1,14 @@
 #include "face_registry.hh"
 
 #include "exception.hh"
+#include "hash.hh"
 #include "ranges.hh"
 #include "string_utils.hh"
 
 namespace Kakoune
 {
 
-static FaceRegistry::FaceSpec parse_face(StringView facedesc)
+static FaceRegistry::FaceSpec do_parse_face(StringView facedesc)
 {
     constexpr StringView invalid_face_error = "invalid face description, expected <fg>[,<bg>][+<attr>][@base] or just [base]";
     if (all_of(facedesc, [](char c){ return is_word(c); }) and not is_color_name(facedesc))
@@ -56,6 +57,22 @@ static FaceRegistry::FaceSpec parse_face(StringView facedesc)
     return spec;
 }
 
+// Parsing a face description is pure, so the results are shared across
+// registries; colorscheme switching redefines the same specs over and
+// over and hits the cache after the first load.
+static const FaceRegistry::FaceSpec& parse_face(StringView facedesc)
+{
+    static HashMap<String, FaceRegistry::FaceSpec, MemoryDomain::Faces> cache;
+    if (auto it = cache.find(facedesc); it != cache.end())
+        return it->value;
+
+    constexpr size_t max_cached_specs = 512;
+    if (cache.size() == max_cached_specs)
+        cache.clear();
+
+    return cache.insert({facedesc.str(), do_parse_face(facedesc)});
+}
+
 String to_string(Attribute attributes)
 {
     if (attributes == Attribute::Normal)
@@ -87,9 +104,34 @@ String to_string(Face face)
     return format("{},{}{}", face.fg, face.bg, face.attributes);
 }
 
+size_t FaceRegistry::tree_version() const
+{
+    // any modification increments exactly one version in the chain,
+    // so the sum changes whenever a face we can resolve through does
+    size_t version = m_version;
+    for (auto* reg = m_parent.get(); reg != nullptr; reg = reg->m_parent.get())
+        version += reg->m_version;
+    return version;
+}
+
 Face FaceRegistry::operator[](StringView facedesc) const
 {
-    return resolve_spec(parse_face(facedesc));
+    if (const size_t version = tree_version(); m_resolved_version != version)
+    {
+        m_resolved.clear();
+        m_resolved_version = version;
+    }
+
+    if (auto it = m_resolved.find(facedesc); it != m_resolved.end())
+        return it->value;
+
+    constexpr size_t max_cached_faces = 512;
+    if (m_resolved.size() == max_cached_faces)
+        m_resolved.clear();
+
+    const Face face = resolve_spec(parse_face(facedesc));
+    m_resolved.insert({facedesc.str(), face});
+    return face;
 }
 
 Face FaceRegistry::resolve_spec(const FaceSpec& spec) const
@@ -127,6 +169,7 @@ void FaceRegistry::add_face(StringView name, StringView facedesc, bool override)
         any_of(name, [](char c){ return not is_word(c); }))
         throw runtime_error(format("invalid face name: '{}'", name));
 
+    ++m_version;
     FaceSpec spec = parse_face(facedesc);
     auto it = m_faces.find(spec.base);
     if (spec.base == name and it != m_faces.end())
@@ -147,6 +190,7 @@ void FaceRegistry::add_face(StringView name, StringView facedesc, bool override)
 
 void FaceRegistry::remove_face(StringView name)
 {
+    ++m_version;
     m_faces.remove(name);
 }
 
@@ -179,4 +223,12 @@ FaceRegistry::FaceRegistry()
       }
 {}
 
+uint32_t compute_faces_hash(const FaceRegistry& faces)
+{
+    uint32_t hash = 0;
+    for (auto&& face : faces.flatten_faces() | transform(&FaceRegistry::FaceMap::Item::value))
+        hash = combine_hash(hash, face.base.empty() ? hash_value(face.face) : hash_value(face.base));
+    return hash;
+}
+
 }
@@ -42,16 +42,27 @@ public:
 
 private:
     Face resolve_spec(const FaceSpec& spec) const;
+    size_t tree_version() const;
 
     friend class Scope;
     FaceRegistry();
 
     SafePtr<FaceRegistry> m_parent;
     FaceMap m_faces;
+    size_t m_version = 0;
+
+    // cache fully resolved face descriptions, invalidated whenever a
+    // face changes in this registry or one of its parents
+    mutable HashMap<String, Face, MemoryDomain::Faces> m_resolved;
+    mutable size_t m_resolved_version = -1;
 };
 
 String to_string(Face face);
 
+// Hash of every face reachable from the registry, used to detect that
+// cached rendering results are still valid
+uint32_t compute_faces_hash(const FaceRegistry& faces);
+
 }
 
 #endif // face_registry_hh_INCLUDED
@@ -19,6 +19,8 @@
 #include <pwd.h>
 #include <sys/mman.h>
 #include <sys/select.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #if defined(__FreeBSD__)
@@ -204,6 +206,58 @@ String read_file(StringView filename, bool text)
     return read_fd(fd, text);
 }
 
+// returns the filter command able to decompress the given content, or
+// nullptr when it is not in a supported compressed format
+static const char* decompression_filter(StringView data)
+{
+    auto starts_with = [&](StringView magic) {
+        return data.length() >= magic.length() and
+               memcmp(data.begin(), magic.begin(), (size_t)(int)magic.length()) == 0;
+    };
+    if (starts_with("\x1f\x8b"))
+        return "gzip";
+    if (starts_with("\x28\xb5\x2f\xfd"))
+        return "zstd";
+    return nullptr;
+}
+
+// decompress the file referenced by fd by streaming it through the given
+// filter running in a child process, which overlaps decompression with
+// our own reading and line parsing
+static String decompress(int fd, const char* filter)
+{
+    int pipe_fds[2];
+    if (pipe(pipe_fds) == -1)
+        throw runtime_error(format("unable to create pipe: {}", strerror(errno)));
+
+    const pid_t pid = fork();
+    if (pid == -1)
+    {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        throw runtime_error(format("unable to fork: {}", strerror(errno)));
+    }
+    if (pid == 0)
+    {
+        dup2(fd, 0);
+        dup2(pipe_fds[1], 1);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        execlp(filter, filter, "-d", "-c", (const char*)nullptr);
+        _exit(127);
+    }
+    close(pipe_fds[1]);
+    auto close_fd = on_scope_end([&]{ close(pipe_fds[0]); });
+
+    String content = read_fd(pipe_fds[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (not WIFEXITED(status) or WEXITSTATUS(status) != 0)
+        throw runtime_error(format("unable to decompress with {}", filter));
+    return content;
+}
+
 MappedFile::MappedFile(StringView filename)
     : data{nullptr}
 {
@@ -224,13 +278,26 @@ MappedFile::MappedFile(StringView filename)
 
     if (st.st_size > std::numeric_limits<int>::max())
         throw runtime_error("file is too big");
+
+    // the whole mapping is about to be scanned for line ends, tell the
+    // kernel so it reads ahead instead of faulting page by page
+    posix_madvise((void*)data, st.st_size, POSIX_MADV_SEQUENTIAL);
+    posix_madvise((void*)data, st.st_size, POSIX_MADV_WILLNEED);
+
+    if (const char* filter = decompression_filter({data, (int)st.st_size}))
+    {
+        decompressed = decompress(fd, filter);
+        munmap((void*)data, st.st_size);
+        data = decompressed.empty() ? nullptr : decompressed.data();
+        st.st_size = (int)decompressed.length();
+    }
 }
 
 MappedFile::~MappedFile()
 {
     if (fd != -1)
     {
-        if (data != nullptr)
+        if (data != nullptr and decompressed.empty())
             munmap((void*)data, st.st_size);
         close(fd);
     }
@@ -272,45 +339,60 @@ void write_to_file(StringView filename, StringView data)
     write(fd, data);
 }
 
-struct BufferedWriter
+// Gathers views into large writev batches; the referenced memory must
+// stay valid until the writer is flushed, which buffer line storage
+// guarantees during a save. Compared to copying every line through an
+// intermediate buffer this writes big buffers with a fraction of the
+// syscalls and no memcpy.
+struct GatheringWriter
 {
-    BufferedWriter(int fd)
-      : m_fd{fd}, m_exception_count{std::uncaught_exceptions()} {}
+    GatheringWriter(int fd) : m_fd{fd} {}
 
-    ~BufferedWriter() noexcept(false)
+    void write(StringView data)
     {
-        if (m_pos != 0 and m_exception_count == std::uncaught_exceptions())
-            Kakoune::write(m_fd, {m_buffer, m_pos});
+        if (data.empty())
+            return;
+        m_iov[m_count++] = { (void*)data.data(), (size_t)(int)data.length() };
+        if (m_count == max_iov)
+            flush();
     }
 
-    void write(StringView data)
+    void flush()
     {
-        while (not data.empty())
+        iovec* vec = m_iov;
+        int count = m_count;
+        while (count != 0)
         {
-            const ByteCount length = data.length();
-            const ByteCount write_len = std::min(length, size - m_pos);
-            memcpy(m_buffer + (int)m_pos, data.data(), (int)write_len);
-            m_pos += write_len;
-            if (m_pos == size)
+            ssize_t written = ::writev(m_fd, vec, count);
+            if (written == -1)
+                throw file_access_error(format("fd: {}", m_fd), strerror(errno));
+            while (count != 0 and written >= (ssize_t)vec->iov_len)
             {
-                Kakoune::write(m_fd, {m_buffer, size});
-                m_pos = 0;
+                written -= vec->iov_len;
+                ++vec;
+                --count;
+            }
+            if (count != 0)
+            {
+                vec->iov_base = (char*)vec->iov_base + written;
+                vec->iov_len -= written;
             }
-            data = data.substr(write_len);
         }
+        m_count = 0;
     }
 
 private:
-    static constexpr ByteCount size = 4096;
+    static constexpr int max_iov = 256; // well under POSIX's IOV_MAX minimum
     int m_fd;
-    int m_exception_count;
-    ByteCount m_pos = 0;
-    char m_buffer[(int)size];
+    int m_count = 0;
+    iovec m_iov[max_iov];
 };
 
-
 void write_buffer_to_fd(Buffer& buffer, int fd)
 {
+    if (buffer.flags() & Buffer::Flags::Loading)
+        throw runtime_error("buffer is still loading");
+
     auto eolformat = buffer.options()["eolformat"].get<EolFormat>();
     StringView eoldata;
     if (eolformat == EolFormat::Crlf)
@@ -319,7 +401,7 @@ void write_buffer_to_fd(Buffer& buffer, int fd)
         eoldata = "\n";
 
 
-    BufferedWriter writer{fd};
+    GatheringWriter writer{fd};
     if (buffer.options()["BOM"].get<ByteOrderMark>() == ByteOrderMark::Utf8)
         writer.write("\xEF\xBB\xBF");
 
@@ -331,6 +413,7 @@ void write_buffer_to_fd(Buffer& buffer, int fd)
         writer.write(linedata.substr(0, linedata.length()-1));
         writer.write(eoldata);
     }
+    writer.flush();
 }
 
 int open_temp_file(StringView filename, char (&buffer)[PATH_MAX])
@@ -375,6 +458,13 @@ void write_buffer_to_file(Buffer& buffer, StringView filename,
             throw runtime_error("unable to restore file permissions");
     });
 
+    // an in place overwrite truncates the file; if the buffer still reads
+    // its lines from a mapping of that same file, drop the views first or
+    // accessing them afterwards would fault
+    if (not replace and (buffer.flags() & Buffer::Flags::File) and
+        real_path(filename) == buffer.name())
+        buffer.materialize_backing();
+
     char temp_filename[PATH_MAX];
     const int fd = replace ? open_temp_file(filename, temp_filename)
                            : open(zfilename, O_CREAT | O_WRONLY | O_TRUNC, 0644);
@@ -496,6 +586,56 @@ Vector<String> list_files(StringView directory)
                       });
 }
 
+using TimeSpec = decltype(stat::st_mtim);
+
+// session level cache of directory listings used by filename completion,
+// keyed by path and invalidated when the directory mtime changes, so that
+// repeated completions against the same tree do not hit the filesystem on
+// every keystroke
+static const Vector<String>& read_dir_cached(StringView dirname)
+{
+    struct Cached
+    {
+        TimeSpec mtim = {};
+        Vector<String> entries;
+    };
+    static HashMap<String, Cached, MemoryDomain::Completion> dir_cache;
+
+    auto& cache = dir_cache[dirname.str()];
+
+    char buffer[PATH_MAX+1];
+    format_to(buffer, "{}", dirname.empty() ? StringView{"./"} : dirname);
+    struct stat st;
+    if (stat(buffer, &st) != 0)
+    {
+        cache.mtim = {};
+        cache.entries.clear();
+        return cache.entries;
+    }
+
+    if (memcmp(&cache.mtim, &st.st_mtim, sizeof(TimeSpec)) != 0)
+    {
+        cache.entries = list_files(dirname, [](const dirent&, const struct stat&) { return true; });
+        memcpy(&cache.mtim, &st.st_mtim, sizeof(TimeSpec));
+    }
+    return cache.entries;
+}
+
+// with a query to rank against, only the best candidates are worth
+// displaying; a bounded partial sort avoids fully ordering huge
+// directory or PATH listings on each keystroke
+static void rank_matches(Vector<RankedMatch>& matches, bool bounded)
+{
+    constexpr size_t max_count = 100;
+    if (bounded and matches.size() > max_count)
+    {
+        std::partial_sort(matches.begin(), matches.begin() + max_count, matches.end());
+        matches.erase(matches.begin() + max_count, matches.end());
+    }
+    else
+        std::sort(matches.begin(), matches.end());
+}
+
 static CandidateList candidates(ConstArrayView<RankedMatch> matches, StringView dirname)
 {
     CandidateList res;
@@ -516,20 +656,18 @@ CandidateList complete_filename(StringView prefix, const Regex& ignored_regex,
         not regex_match(fileprefix.begin(), fileprefix.end(), ignored_regex);
     const bool only_dirs = (flags & FilenameFlags::OnlyDirectories);
 
-    auto filter = [&ignored_regex, check_ignored_regex, only_dirs](const dirent& entry, struct stat& st)
-    {
-        StringView name{entry.d_name};
-        return (not check_ignored_regex or not regex_match(name.begin(), name.end(), ignored_regex)) and
-               (not only_dirs or S_ISDIR(st.st_mode));
-    };
-    auto files = list_files(parsed_dirname, filter);
     Vector<RankedMatch> matches;
-    for (auto& file : files)
+    for (auto& file : read_dir_cached(parsed_dirname))
     {
+        const bool is_dir = file.back() == '/';
+        StringView name = is_dir ? file.substr(0_byte, file.length()-1) : StringView{file};
+        if ((check_ignored_regex and regex_match(name.begin(), name.end(), ignored_regex)) or
+            (only_dirs and not is_dir))
+            continue;
         if (RankedMatch match{file, fileprefix})
             matches.push_back(match);
     }
-    std::sort(matches.begin(), matches.end());
+    rank_matches(matches, not fileprefix.empty());
     const bool expand = (flags & FilenameFlags::Expand);
     return candidates(matches, expand ? parsed_dirname : dirname);
 }
@@ -555,11 +693,10 @@ CandidateList complete_command(StringView prefix, ByteCount cursor_pos)
             if (RankedMatch match{file, real_prefix})
                 matches.push_back(match);
         }
-        std::sort(matches.begin(), matches.end());
+        rank_matches(matches, not real_prefix.empty());
         return candidates(matches, dirname);
     }
 
-    using TimeSpec = decltype(stat::st_mtim);
 
     struct CommandCache
     {
@@ -596,7 +733,7 @@ CandidateList complete_command(StringView prefix, ByteCount cursor_pos)
                 matches.push_back(match);
         }
     }
-    std::sort(matches.begin(), matches.end());
+    rank_matches(matches, not fileprefix.empty());
     auto it = std::unique(matches.begin(), matches.end());
     matches.erase(it, matches.end());
     return candidates(matches, "");
@@ -48,8 +48,14 @@ struct MappedFile
 
     operator StringView() const;
 
+    bool is_decompressed() const { return not decompressed.empty(); }
+
     int fd;
     const char* data;
+    // when the file is in a supported compressed format, data refers to
+    // this transparently decompressed content instead of the mapping,
+    // and st.st_size is its length
+    String decompressed;
     struct stat st {};
 };
 
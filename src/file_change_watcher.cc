@@ -0,0 +1,112 @@
+#include "file_change_watcher.hh"
+
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+namespace Kakoune
+{
+
+#if defined(__linux__)
+
+FileChangeWatcher::FileChangeWatcher()
+    : m_watcher{inotify_init1(IN_NONBLOCK | IN_CLOEXEC), FdEvents::Read,
+                [this](FDWatcher&, FdEvents, EventMode) { read_events(); }}
+{}
+
+FileChangeWatcher::~FileChangeWatcher()
+{
+    m_watcher.close_fd();
+}
+
+bool FileChangeWatcher::watch(StringView filename)
+{
+    if (m_watcher.fd() == -1)
+        return false;
+
+    auto it = m_watches.find(filename);
+    if (it != m_watches.end() and it->value.wd != -1)
+        return true;
+
+    const int wd = inotify_add_watch(m_watcher.fd(), filename.zstr(),
+                                     IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                                     IN_MOVE_SELF | IN_DELETE_SELF);
+    if (wd == -1)
+        return false;
+
+    if (it != m_watches.end())
+        it->value.wd = wd;
+    else
+        // report the file as changed on the first poll, events that
+        // happened before the watch was added cannot have been seen
+        m_watches.insert({filename.str(), Watch{wd, true}});
+    return true;
+}
+
+void FileChangeWatcher::unwatch(StringView filename)
+{
+    auto it = m_watches.find(filename);
+    if (it == m_watches.end())
+        return;
+
+    if (it->value.wd != -1)
+        inotify_rm_watch(m_watcher.fd(), it->value.wd);
+    m_watches.remove(filename);
+}
+
+bool FileChangeWatcher::poll_changed(StringView filename)
+{
+    auto it = m_watches.find(filename);
+    if (it == m_watches.end())
+        return false;
+
+    const bool changed = it->value.changed;
+    it->value.changed = false;
+    return changed;
+}
+
+void FileChangeWatcher::read_events()
+{
+    alignas(inotify_event) char buffer[4096];
+    ssize_t len;
+    while ((len = read(m_watcher.fd(), buffer, sizeof buffer)) > 0)
+    {
+        for (const char* ptr = buffer; ptr < buffer + len;
+             ptr += sizeof(inotify_event) + reinterpret_cast<const inotify_event*>(ptr)->len)
+        {
+            auto* event = reinterpret_cast<const inotify_event*>(ptr);
+            for (auto& watch : m_watches)
+            {
+                if (watch.value.wd != event->wd)
+                    continue;
+                watch.value.changed = true;
+                if (event->mask & IN_IGNORED)
+                    // the kernel dropped the watch (file deleted or moved
+                    // away), watch() will re-add it on its next call
+                    watch.value.wd = -1;
+            }
+        }
+    }
+}
+
+#else
+
+FileChangeWatcher::FileChangeWatcher()
+    : m_watcher{-1, FdEvents::Read, {}}
+{}
+
+FileChangeWatcher::~FileChangeWatcher() = default;
+
+bool FileChangeWatcher::watch(StringView) { return false; }
+
+void FileChangeWatcher::unwatch(StringView) {}
+
+bool FileChangeWatcher::poll_changed(StringView) { return false; }
+
+void FileChangeWatcher::read_events() {}
+
+#endif
+
+}
@@ -0,0 +1,47 @@
+#ifndef file_change_watcher_hh_INCLUDED
+#define file_change_watcher_hh_INCLUDED
+
+#include "event_manager.hh"
+#include "hash_map.hh"
+#include "string.hh"
+#include "utils.hh"
+
+namespace Kakoune
+{
+
+// Monitors files through the platform file watching facility (inotify on
+// linux), so that checking whether a buffer needs reloading does not need
+// to stat its file every time, which can block for a long time on remote
+// filesystems. Callers are told to fall back to timestamp polling when
+// the platform or the filesystem does not support watching.
+class FileChangeWatcher : public Singleton<FileChangeWatcher>
+{
+public:
+    FileChangeWatcher();
+    ~FileChangeWatcher();
+
+    // start monitoring the given file, returns false if it cannot be
+    // watched, in which case the caller has to keep polling its timestamp
+    bool watch(StringView filename);
+    // stop monitoring the given file
+    void unwatch(StringView filename);
+
+    // did the file see any filesystem event since this was last called
+    bool poll_changed(StringView filename);
+
+private:
+    void read_events();
+
+    struct Watch
+    {
+        int wd;
+        bool changed;
+    };
+
+    FDWatcher m_watcher;
+    HashMap<String, Watch, MemoryDomain::Events> m_watches;
+};
+
+}
+
+#endif // file_change_watcher_hh_INCLUDED
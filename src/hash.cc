@@ -7,64 +7,67 @@ namespace Kakoune
 {
 
 [[gnu::always_inline]]
-static inline uint32_t rotl(uint32_t x, int8_t r)
+static inline uint64_t rotl(uint64_t x, int8_t r)
 {
-    return (x << r) | (x >> (32 - r));
+    return (x << r) | (x >> (64 - r));
 }
 
+constexpr uint64_t prime1 = 0x9e3779b185ebca87;
+constexpr uint64_t prime2 = 0xc2b2ae3d27d4eb4f;
+constexpr uint64_t prime3 = 0x165667b19e3779f9;
+constexpr uint64_t prime4 = 0x85ebca77c2b2ae63;
+constexpr uint64_t prime5 = 0x27d4eb2f165667c5;
+
 [[gnu::always_inline]]
-static inline uint32_t fmix(uint32_t h)
+static inline uint64_t avalanche(uint64_t h)
 {
-    h ^= h >> 16;
-    h *= 0x85ebca6b;
-    h ^= h >> 13;
-    h *= 0xc2b2ae35;
-    h ^= h >> 16;
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
 
     return h;
 }
 
-// murmur3 hash, based on https://github.com/PeterScott/murmur3
+// xxHash64 based hash, processing 8 bytes per round; our keys (option,
+// face and command names, words) are almost all short strings for which
+// the wide loads beat 4 bytes per round murmur3
 size_t hash_data(const char* input, size_t len)
 {
-    const uint8_t* data = reinterpret_cast<const uint8_t*>(input);
-    uint32_t hash = 0x1235678;
-    constexpr uint32_t c1 = 0xcc9e2d51;
-    constexpr uint32_t c2 = 0x1b873593;
-
-    const int nblocks = len / 4;
-    const uint8_t* blocks = data + nblocks*4;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(input);
+    const uint8_t* const end = p + len;
 
-    for (int i = -nblocks; i; ++i)
+    uint64_t hash = 0x1235678 + prime5 + len;
+    while (end - p >= 8)
     {
-        uint32_t key;
-        memcpy(&key, blocks + 4*i, 4);
-        key *= c1;
-        key = rotl(key, 15);
-        key *= c2;
+        uint64_t key;
+        memcpy(&key, p, 8);
+        key *= prime2;
+        key = rotl(key, 31);
+        key *= prime1;
 
         hash ^= key;
-        hash = rotl(hash, 13);
-        hash = hash * 5 + 0xe6546b64;
+        hash = rotl(hash, 27) * prime1 + prime4;
+        p += 8;
     }
 
-    const uint8_t* tail = data + nblocks * 4;
-    uint32_t key = 0;
-    switch (len & 3)
+    if (end - p >= 4)
     {
-        case 3: key ^= tail[2] << 16; /* fallthrough */
-        case 2: key ^= tail[1] << 8;  /* fallthrough */
-        case 1: key ^= tail[0];
-                key *= c1;
-                key = rotl(key,15);
-                key *= c2;
-                hash ^= key;
+        uint32_t key;
+        memcpy(&key, p, 4);
+        hash ^= (uint64_t)key * prime1;
+        hash = rotl(hash, 23) * prime2 + prime3;
+        p += 4;
     }
 
-    hash ^= len;
-    hash = fmix(hash);
+    while (p != end)
+    {
+        hash ^= *p++ * prime5;
+        hash = rotl(hash, 11) * prime1;
+    }
 
-    return hash;
+    return avalanche(hash);
 }
 
 }
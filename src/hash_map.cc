@@ -6,6 +6,7 @@
 #include "unit_tests.hh"
 
 #include <random>
+#include <string>
 #include <unordered_map>
 
 namespace Kakoune
@@ -124,6 +125,39 @@ void do_profile(size_t count, StringView type)
                                  c));
 }
 
+template<typename Map, typename Key>
+void do_profile_strings(size_t count, StringView type)
+{
+    std::random_device dev;
+    std::default_random_engine re{dev()};
+
+    Vector<Key> keys;
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto key = format("short_key_{}", i);
+        keys.push_back(Key{key.begin(), key.end()});
+    }
+    std::shuffle(keys.begin(), keys.end(), re);
+
+    Map map;
+    auto start = Clock::now();
+
+    for (auto& key : keys)
+        map.insert({key, size_t{0}});
+    auto after_insert = Clock::now();
+
+    size_t found = 0;
+    for (auto& key : keys)
+        found += map.find(key) != map.end();
+    auto after_find = Clock::now();
+
+    using namespace std::chrono;
+    write_to_debug_buffer(format("{} strings ({}) -- inserts: {}us, finds: {}us ({})", type, count,
+                                 duration_cast<microseconds>(after_insert - start).count(),
+                                 duration_cast<microseconds>(after_find - after_insert).count(),
+                                 found));
+}
+
 void profile_hash_maps()
 {
     for (auto i : { 1000, 10000, 100000, 1000000, 10000000 })
@@ -131,6 +165,11 @@ void profile_hash_maps()
         do_profile<std::unordered_map<size_t, size_t>>(i, "UnorderedMap");
         do_profile<HashMap<size_t, size_t>>(i, "     HashMap");
     }
+    for (auto i : { 1000, 10000, 100000, 1000000 })
+    {
+        do_profile_strings<std::unordered_map<std::string, size_t>, std::string>(i, "UnorderedMap");
+        do_profile_strings<HashMap<String, size_t>, String>(i, "     HashMap");
+    }
 }
 
 }
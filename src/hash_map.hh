@@ -176,8 +176,17 @@ struct HashMap
 
     constexpr Value& insert(Item item)
     {
+        const auto hash = hash_value(item.key);
+        return insert(std::move(item), hash);
+    }
+
+    // callers that already computed the key hash can pass it along
+    // to avoid hashing the key a second time
+    constexpr Value& insert(Item item, size_t hash)
+    {
+        kak_assert(hash == hash_value(item.key));
         m_index.reserve(m_items.size()+1);
-        m_index.add(hash_value(item.key), (int)m_items.size());
+        m_index.add(hash, (int)m_items.size());
         m_items.push_back(std::move(item));
         return m_items.back().value;
     }
@@ -190,13 +199,18 @@ struct HashMap
     template<typename KeyType, typename = EnableIfHashCompatible<KeyType>>
     constexpr int find_index(const KeyType& key, size_t hash) const
     {
-        for (auto slot = m_index.compute_slot(hash); slot < m_index.size(); ++slot)
+        const auto target_slot = m_index.compute_slot(hash);
+        for (auto slot = target_slot; slot < m_index.size(); ++slot)
         {
             auto& entry = m_index[slot];
             if (entry.index == -1)
                 return -1;
             if (entry.hash == hash and m_items[entry.index].key == key)
                 return entry.index;
+            // robin hood insertion keeps clusters sorted by target slot,
+            // an entry displaced less than us means the key is absent
+            if (m_index.compute_slot(entry.hash) > target_slot)
+                return -1;
         }
         return -1;
     }
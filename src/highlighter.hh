@@ -8,6 +8,7 @@
 #include "flags.hh"
 #include "hash_map.hh"
 #include "array_view.hh"
+#include "ref_ptr.hh"
 #include "string.hh"
 #include "utils.hh"
 
@@ -59,7 +60,7 @@ struct HighlightContext
     HighlighterIdList disabled_ids;
 };
 
-struct Highlighter
+struct Highlighter : RefCountable
 {
     Highlighter(HighlightPass passes) : m_passes{passes} {}
     virtual ~Highlighter() = default;
@@ -67,9 +68,15 @@ struct Highlighter
     void highlight(HighlightContext context, DisplayBuffer& display_buffer, BufferRange range);
     void compute_display_setup(HighlightContext context, DisplaySetup& setup) const;
 
+    // Whether highlighting may change on lines that no buffer, selection
+    // or face change touched (partner brackets, register or option driven
+    // content); Window's display line recycling bails out when such a
+    // highlighter is present, as it only refreshes the touched lines.
+    virtual bool depends_on_whole_frame() const { return false; }
+
     virtual bool has_children() const;
     virtual Highlighter& get_child(StringView path);
-    virtual void add_child(String name, std::unique_ptr<Highlighter>&& hl);
+    virtual void add_child(String name, RefPtr<Highlighter>&& hl);
     virtual void remove_child(StringView id);
     virtual Completions complete_child(StringView path, ByteCount cursor_pos, bool group) const;
     virtual void fill_unique_ids(Vector<StringView>& unique_ids) const;
@@ -83,13 +90,22 @@ private:
     const HighlightPass m_passes;
 };
 
+template<typename HighlighterType, typename... Args>
+RefPtr<Highlighter> make_highlighter_ref(Args&&... args)
+{
+    return RefPtr<Highlighter>{new HighlighterType(std::forward<Args>(args)...)};
+}
+
 using HighlighterParameters = ConstArrayView<String>;
-using HighlighterFactory = std::unique_ptr<Highlighter> (*)(HighlighterParameters params, Highlighter* parent);
+using HighlighterFactory = RefPtr<Highlighter> (*)(HighlighterParameters params, Highlighter* parent);
 
 struct HighlighterFactoryAndDocstring
 {
     HighlighterFactory factory;
     String docstring;
+    // immutable leaf highlighters can be shared by reference between
+    // scopes, mutable containers and parent dependent ones cannot
+    bool shareable = false;
 };
 
 struct HighlighterRegistry : HashMap<String, HighlighterFactoryAndDocstring, MemoryDomain::Highlight>,
@@ -1,15 +1,77 @@
 #include "highlighter_group.hh"
 
+#include "buffer_utils.hh"
+#include "clock.hh"
+#include "context.hh"
+#include "option_manager.hh"
+#include "option_types.hh"
 #include "ranges.hh"
+#include "regex_impl.hh"
 #include "string_utils.hh"
 
+#include <algorithm>
+#include <chrono>
+
 namespace Kakoune
 {
 
+struct HighlighterTiming
+{
+    size_t count = 0;
+    std::chrono::microseconds total{0};
+    std::chrono::microseconds max{0};
+    size_t regex_steps = 0;
+    size_t regex_threads = 0;
+};
+
+static HashMap<String, HighlighterTiming, MemoryDomain::Highlight>& highlighter_timings()
+{
+    static HashMap<String, HighlighterTiming, MemoryDomain::Highlight> timings;
+    return timings;
+}
+
+void write_highlighter_timings_to_debug_buffer()
+{
+    auto& timings = highlighter_timings();
+    write_to_debug_buffer("Highlighter timings (accumulated while the profile debug flag is set):");
+    auto sorted = timings | transform([](auto& item) {
+                      return std::pair<StringView, const HighlighterTiming*>{item.key, &item.value}; })
+                          | gather<Vector<std::pair<StringView, const HighlighterTiming*>>>();
+    std::sort(sorted.begin(), sorted.end(),
+              [](auto& lhs, auto& rhs) { return lhs.second->total > rhs.second->total; });
+    for (auto& [name, timing] : sorted)
+        write_to_debug_buffer(format(" * {}: {} calls, {} us total, {} us mean, {} us max, {} regex steps, {} regex threads",
+                                     name, timing->count, (size_t)timing->total.count(),
+                                     (size_t)(timing->total.count() / (long)timing->count),
+                                     (size_t)timing->max.count(),
+                                     timing->regex_steps, timing->regex_threads));
+    timings.clear();
+}
+
 void HighlighterGroup::do_highlight(HighlightContext context, DisplayBuffer& display_buffer, BufferRange range)
 {
+    if (not (context.context.options()["debug"].get<DebugFlags>() & DebugFlags::Profile))
+    {
+        for (auto& hl : m_highlighters)
+            hl.value->highlight(context, display_buffer, range);
+        return;
+    }
+
     for (auto& hl : m_highlighters)
+    {
+        const auto start = Clock::now();
+        const auto steps = regex_executed_instructions;
+        const auto threads = regex_spawned_threads;
         hl.value->highlight(context, display_buffer, range);
+        const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+
+        auto& timing = highlighter_timings()[hl.key];
+        ++timing.count;
+        timing.total += duration;
+        timing.max = std::max(timing.max, duration);
+        timing.regex_steps += regex_executed_instructions - steps;
+        timing.regex_threads += regex_spawned_threads - threads;
+    }
 }
 
 void HighlighterGroup::do_compute_display_setup(HighlightContext context, DisplaySetup& setup) const
@@ -18,13 +80,19 @@ void HighlighterGroup::do_compute_display_setup(HighlightContext context, Displa
         hl.value->compute_display_setup(context, setup);
 }
 
+bool HighlighterGroup::depends_on_whole_frame() const
+{
+    return any_of(m_highlighters, [](auto& hl)
+                  { return hl.value->depends_on_whole_frame(); });
+}
+
 void HighlighterGroup::fill_unique_ids(Vector<StringView>& unique_ids) const
 {
     for (auto& hl : m_highlighters)
         hl.value->fill_unique_ids(unique_ids);
 }
 
-void HighlighterGroup::add_child(String name, std::unique_ptr<Highlighter>&& hl)
+void HighlighterGroup::add_child(String name, RefPtr<Highlighter>&& hl)
 {
     if ((hl->passes() & passes()) != hl->passes())
         throw runtime_error{"cannot add that highlighter to this group, passes don't match"};
@@ -74,21 +142,31 @@ Completions HighlighterGroup::complete_child(StringView path, ByteCount cursor_p
 
 void Highlighters::highlight(HighlightContext context, DisplayBuffer& display_buffer, BufferRange range)
 {
-    Vector<StringView> disabled_ids(context.disabled_ids.begin(), context.disabled_ids.end());
-    m_group.fill_unique_ids(disabled_ids);
-
+    // the disabled ids only matter for the parent scopes, they are
+    // already unique in our own group
     if (m_parent)
+    {
+        Vector<StringView> disabled_ids(context.disabled_ids.begin(), context.disabled_ids.end());
+        m_group.fill_unique_ids(disabled_ids);
         m_parent->highlight({context.context, context.setup, context.pass, disabled_ids}, display_buffer, range);
+    }
     m_group.highlight(context, display_buffer, range);
 }
 
-void Highlighters::compute_display_setup(HighlightContext context, DisplaySetup& setup) const
+bool Highlighters::depends_on_whole_frame() const
 {
-    Vector<StringView> disabled_ids(context.disabled_ids.begin(), context.disabled_ids.end());
-    m_group.fill_unique_ids(disabled_ids);
+    return m_group.depends_on_whole_frame() or
+           (m_parent and m_parent->depends_on_whole_frame());
+}
 
+void Highlighters::compute_display_setup(HighlightContext context, DisplaySetup& setup) const
+{
     if (m_parent)
+    {
+        Vector<StringView> disabled_ids(context.disabled_ids.begin(), context.disabled_ids.end());
+        m_group.fill_unique_ids(disabled_ids);
         m_parent->compute_display_setup({context.context, context.setup, context.pass, disabled_ids}, setup);
+    }
     m_group.compute_display_setup(context, setup);
 }
 
@@ -15,13 +15,19 @@ struct child_not_found : public runtime_error
     using runtime_error::runtime_error;
 };
 
+// Write the per-highlighter timings accumulated while the profile debug
+// flag was set to the debug buffer, then reset them
+void write_highlighter_timings_to_debug_buffer();
+
 class HighlighterGroup : public Highlighter
 {
 public:
     HighlighterGroup(HighlightPass passes) : Highlighter{passes} {}
 
+    bool depends_on_whole_frame() const override;
+
     bool has_children() const override { return true; }
-    void add_child(String name, std::unique_ptr<Highlighter>&& hl) override;
+    void add_child(String name, RefPtr<Highlighter>&& hl) override;
     void remove_child(StringView id) override;
 
     Highlighter& get_child(StringView path) override;
@@ -34,7 +40,7 @@ protected:
     void do_highlight(HighlightContext context, DisplayBuffer& display_buffer, BufferRange range) override;
     void do_compute_display_setup(HighlightContext context, DisplaySetup& setup) const override;
 
-    using HighlighterMap = HashMap<String, std::unique_ptr<Highlighter>, MemoryDomain::Highlight>;
+    using HighlighterMap = HashMap<String, RefPtr<Highlighter>, MemoryDomain::Highlight>;
     HighlighterMap m_highlighters;
 };
 
@@ -49,6 +55,8 @@ public:
     void highlight(HighlightContext context, DisplayBuffer& display_buffer, BufferRange range);
     void compute_display_setup(HighlightContext context, DisplaySetup& setup) const;
 
+    bool depends_on_whole_frame() const;
+
 private:
     friend class Scope;
     Highlighters() : m_group{HighlightPass::All} {}
@@ -27,12 +27,15 @@ namespace Kakoune
 using Utf8Iterator = utf8::iterator<BufferIterator>;
 
 template<typename Func>
-std::unique_ptr<Highlighter> make_highlighter(Func func, HighlightPass pass = HighlightPass::Colorize)
+RefPtr<Highlighter> make_highlighter(Func func, HighlightPass pass = HighlightPass::Colorize,
+                                     bool whole_frame = false)
 {
     struct SimpleHighlighter : public Highlighter
     {
-        SimpleHighlighter(Func func, HighlightPass pass)
-          : Highlighter{pass}, m_func{std::move(func)} {}
+        SimpleHighlighter(Func func, HighlightPass pass, bool whole_frame)
+          : Highlighter{pass}, m_func{std::move(func)}, m_whole_frame{whole_frame} {}
+
+        bool depends_on_whole_frame() const override { return m_whole_frame; }
 
     private:
         void do_highlight(HighlightContext context, DisplayBuffer& display_buffer, BufferRange range) override
@@ -40,8 +43,9 @@ std::unique_ptr<Highlighter> make_highlighter(Func func, HighlightPass pass = Hi
             m_func(context, display_buffer, range);
         }
         Func m_func;
+        bool m_whole_frame;
     };
-    return std::make_unique<SimpleHighlighter>(std::move(func), pass);
+    return make_highlighter_ref<SimpleHighlighter>(std::move(func), pass, whole_frame);
 }
 
 template<typename T>
@@ -220,7 +224,7 @@ auto apply_face = [](const Face& face)
     };
 };
 
-static std::unique_ptr<Highlighter> create_fill_highlighter(HighlighterParameters params, Highlighter*)
+static RefPtr<Highlighter> create_fill_highlighter(HighlighterParameters params, Highlighter*)
 {
     if (params.size() != 1)
         throw runtime_error("wrong parameter count");
@@ -299,7 +303,7 @@ public:
         ++m_regex_version;
     }
 
-    static std::unique_ptr<Highlighter> create(HighlighterParameters params, Highlighter*)
+    static RefPtr<Highlighter> create(HighlighterParameters params, Highlighter*)
     {
         if (params.size() < 2)
             throw runtime_error("wrong parameter count");
@@ -322,18 +326,19 @@ public:
             faces.emplace_back(capture, String{colon+1, spec.end()});
         }
 
-        return std::make_unique<RegexHighlighter>(std::move(re), std::move(faces));
+        return make_highlighter_ref<RegexHighlighter>(std::move(re), std::move(faces));
     }
 
 private:
-    // stores the range for each highlighted capture of each match
+    // stores the range for each highlighted capture of each match, sorted
+    // by position, in groups of m_faces.size() entries per match
     using MatchList = Vector<BufferRange, MemoryDomain::Highlight>;
     struct Cache
     {
         size_t m_timestamp = -1;
         size_t m_regex_version = -1;
-        struct RangeAndMatches { BufferRange range; MatchList matches; };
-        Vector<RangeAndMatches, MemoryDomain::Highlight> m_matches;
+        LineRangeSet m_ranges;
+        MatchList m_matches;
     };
     BufferSideCache<Cache> m_cache;
 
@@ -355,9 +360,14 @@ private:
             m_faces.emplace(m_faces.begin(), 0, String{});
     }
 
-    void add_matches(const Buffer& buffer, MatchList& matches, BufferRange range)
+    void add_matches(const Buffer& buffer, MatchList& matches, LineRange lines)
     {
-        kak_assert(matches.size() % m_faces.size() == 0);
+        const size_t stride = m_faces.size();
+        kak_assert(matches.size() % stride == 0);
+        const size_t pivot = matches.size();
+        const BufferRange range{{lines.begin, 0},
+                                lines.end == buffer.line_count() ?
+                                    buffer.end_coord() : BufferCoord{lines.end, 0}};
         for (auto&& match : RegexIterator{get_iterator(buffer, range.begin),
                                           get_iterator(buffer, range.end),
                                           buffer.begin(), buffer.end(), m_regex,
@@ -372,72 +382,102 @@ private:
                 matches.push_back({sub.first.coord(), sub.second.coord()});
             }
         }
+
+        // Move the new matches into place to keep the list sorted; thanks
+        // to the ensure_first_face_is_capture_0 method, each group starts
+        // with its match position.
+        size_t insert_idx = 0;
+        while (insert_idx < pivot and matches[insert_idx].begin < range.begin)
+            insert_idx += stride;
+        std::rotate(matches.begin() + insert_idx, matches.begin() + pivot, matches.end());
     }
 
-    const MatchList& get_matches(const Buffer& buffer, BufferRange display_range, BufferRange buffer_range)
+    // Shift cached matches that are unaffected by the modifications and
+    // drop the others along with their line range coverage, so only the
+    // lines around the edits get re-matched; the spill accounts for
+    // patterns matching up to a few lines around an edited one.
+    void update_matches(const Buffer& buffer, ConstArrayView<LineModification> modifs, Cache& cache)
     {
-        Cache& cache = m_cache.get(buffer);
-        auto& matches = cache.m_matches;
+        const LineCount spill = 3;
+        Vector<LineRange, MemoryDomain::Highlight> dirty;
+        for (auto& modif : modifs)
+        {
+            LineRange range{std::max(0_line, modif.new_line - spill),
+                            std::min(buffer.line_count(), modif.new_line + modif.num_added + spill)};
+            if (not dirty.empty() and range.begin <= dirty.back().end)
+                dirty.back().end = std::max(dirty.back().end, range.end);
+            else
+                dirty.push_back(range);
+        }
 
-        if (cache.m_regex_version != m_regex_version or
-            cache.m_timestamp != buffer.timestamp() or
-            matches.size() > 1000)
+        const size_t stride = m_faces.size();
+        auto& matches = cache.m_matches;
+        auto ins_pos = matches.begin();
+        for (auto it = matches.begin(); it != matches.end(); it += stride)
         {
-            matches.clear();
-            cache.m_timestamp = buffer.timestamp();
-            cache.m_regex_version = m_regex_version;
+            BufferRange group = *it; // the group starts with capture 0
+            auto modif_it = std::upper_bound(modifs.begin(), modifs.end(), group.begin.line,
+                                             [](const LineCount& l, const LineModification& c)
+                                             { return l < c.old_line; });
+            LineCount diff = 0;
+            bool removed = false;
+            if (modif_it != modifs.begin())
+            {
+                auto& prev = *(modif_it-1);
+                removed = group.begin.line < prev.old_line + prev.num_removed;
+                diff = prev.diff();
+            }
+            // matches extending into a later modification are out of date as well
+            if (not removed and modif_it != modifs.end())
+                removed = modif_it->old_line <= group.end.line;
+            if (not removed)
+            {
+                auto dirty_it = std::lower_bound(dirty.begin(), dirty.end(), group.begin.line + diff,
+                                                 [](const LineRange& r, const LineCount& l)
+                                                 { return r.end <= l; });
+                removed = dirty_it != dirty.end() and dirty_it->begin <= group.end.line + diff;
+            }
+            if (removed)
+                continue;
+
+            for (size_t i = 0; i < stride; ++i, ++ins_pos)
+                *ins_pos = BufferRange{{it[i].begin.line + diff, it[i].begin.column},
+                                       {it[i].end.line + diff, it[i].end.column}};
         }
+        matches.erase(ins_pos, matches.end());
 
-        const LineCount line_offset = 3;
-        BufferRange range{std::max<BufferCoord>(buffer_range.begin, display_range.begin.line - line_offset),
-                          std::min<BufferCoord>(buffer_range.end, display_range.end.line + line_offset)};
+        cache.m_ranges.update(modifs);
+        for (auto& range : dirty)
+            cache.m_ranges.remove_range(range);
+    }
 
-        auto it = std::upper_bound(matches.begin(), matches.end(), range.begin,
-                                   [](const BufferCoord& lhs, const Cache::RangeAndMatches& rhs)
-                                   { return lhs < rhs.range.end; });
+    const MatchList& get_matches(const Buffer& buffer, BufferRange display_range, BufferRange buffer_range)
+    {
+        Cache& cache = m_cache.get(buffer);
+        auto& matches = cache.m_matches;
 
-        if (it == matches.end() or it->range.begin > range.end)
+        if (cache.m_regex_version != m_regex_version or matches.size() > 1000)
         {
-            it = matches.insert(it, Cache::RangeAndMatches{range, {}});
-            add_matches(buffer, it->matches, range);
+            cache = Cache{};
+            cache.m_timestamp = buffer.timestamp();
+            cache.m_regex_version = m_regex_version;
         }
-        else if (it->matches.empty())
+        else if (cache.m_timestamp != buffer.timestamp())
         {
-            it->range = range;
-            add_matches(buffer, it->matches, range);
+            update_matches(buffer, compute_line_modifications(buffer, cache.m_timestamp), cache);
+            cache.m_timestamp = buffer.timestamp();
         }
-        else
-        {
-            // Here we extend the matches, that is not strictly valid,
-            // but may work nicely with every reasonable regex, and
-            // greatly reduces regex parsing. To change if we encounter
-            // regex that do not work great with that.
-            BufferRange& old_range = it->range;
-            MatchList& matches = it->matches;
 
-            // Thanks to the ensure_first_face_is_capture_0 method, we know
-            // these point to the first/last matches capture 0.
-            auto first_end = matches.begin()->end;
-            auto last_end = (matches.end() - m_faces.size())->end;
-
-            // add regex matches from new begin to old first match end
-            if (range.begin < old_range.begin)
-            {
-                matches.erase(matches.begin(), matches.begin() + m_faces.size());
-                size_t pivot = matches.size();
-                old_range.begin = range.begin;
-                add_matches(buffer, matches, {range.begin, first_end});
-
-                std::rotate(matches.begin(), matches.begin() + pivot, matches.end());
-            }
-            // add regex matches from old last match begin to new end
-            if (old_range.end < range.end)
-            {
-                old_range.end = range.end;
-                add_matches(buffer, matches, {last_end, range.end});
-            }
-        }
-        return it->matches;
+        const LineCount line_offset = 3;
+        const LineRange lines{std::max(buffer_range.begin.line, std::max(0_line, display_range.begin.line - line_offset)),
+                              std::min(std::min(buffer_range.end.line + 1, display_range.end.line + line_offset + 1),
+                                       buffer.line_count())};
+        if (lines.begin < lines.end)
+            cache.m_ranges.add_range(lines, [&, this](LineRange range) {
+                if (range.begin < range.end)
+                    add_matches(buffer, matches, range);
+            });
+        return matches;
     }
 };
 
@@ -448,35 +488,59 @@ public:
     DynamicRegexHighlighter(RegexGetter regex_getter, FaceGetter face_getter)
       : Highlighter{HighlightPass::Colorize},
         m_regex_getter(std::move(regex_getter)),
-        m_face_getter(std::move(face_getter)),
-        m_highlighter(Regex{}, FacesSpec{}) {}
+        m_face_getter(std::move(face_getter)) {}
+
+    // the regex and faces come from registers or options, which can
+    // change the matches on every line without touching the buffer
+    bool depends_on_whole_frame() const override { return true; }
 
     void do_highlight(HighlightContext context, DisplayBuffer& display_buffer, BufferRange range) override
     {
         Regex regex = m_regex_getter(context.context);
-        FacesSpec face = regex.empty() ? FacesSpec{} : m_face_getter(context.context, regex);
-        if (regex != m_last_regex or face != m_last_face)
+        if (regex.empty())
+            return;
+        FacesSpec faces = m_face_getter(context.context, regex);
+        if (faces.empty())
+            return;
+
+        // the expression can expand to different regexes per client
+        // (window scoped options, registers...); one sub highlighter per
+        // recently seen value keeps each buffer side match cache valid
+        // instead of resetting a shared one every time the value alternates
+        auto it = m_highlighters.find(regex.str());
+        if (it == m_highlighters.end())
         {
-            m_last_regex = std::move(regex);
-            m_last_face = face;
-            if (not m_last_regex.empty())
-                m_highlighter.reset(m_last_regex, m_last_face);
+            constexpr size_t max_highlighters = 4;
+            while (m_highlighters.size() >= max_highlighters)
+                m_highlighters.remove(m_highlighters.item(0).key);
+
+            auto& entry = m_highlighters.insert(
+                {regex.str(), Entry{faces, std::make_unique<RegexHighlighter>(std::move(regex), faces)}});
+            entry.highlighter->highlight(context, display_buffer, range);
+            return;
         }
-        if (not m_last_regex.empty() and not m_last_face.empty())
-            m_highlighter.highlight(context, display_buffer, range);
+
+        if (it->value.faces != faces)
+        {
+            it->value.faces = faces;
+            it->value.highlighter->reset(std::move(regex), std::move(faces));
+        }
+        it->value.highlighter->highlight(context, display_buffer, range);
     }
 
 private:
-    Regex       m_last_regex;
     RegexGetter m_regex_getter;
-
-    FacesSpec   m_last_face;
     FaceGetter  m_face_getter;
 
-    RegexHighlighter m_highlighter;
+    struct Entry
+    {
+        FacesSpec faces;
+        std::unique_ptr<RegexHighlighter> highlighter;
+    };
+    HashMap<String, Entry, MemoryDomain::Highlight> m_highlighters;
 };
 
-std::unique_ptr<Highlighter> create_dynamic_regex_highlighter(HighlighterParameters params, Highlighter*)
+RefPtr<Highlighter> create_dynamic_regex_highlighter(HighlighterParameters params, Highlighter*)
 {
     if (params.size() < 2)
         throw runtime_error("wrong parameter count");
@@ -492,7 +556,7 @@ std::unique_ptr<Highlighter> create_dynamic_regex_highlighter(HighlighterParamet
     }
 
     auto make_hl = [](auto& regex_getter, auto& face_getter) {
-        return std::make_unique<DynamicRegexHighlighter<std::decay_t<decltype(regex_getter)>,
+        return make_highlighter_ref<DynamicRegexHighlighter<std::decay_t<decltype(regex_getter)>,
                                                         std::decay_t<decltype(face_getter)>>>(
             std::move(regex_getter), std::move(face_getter));
     };
@@ -541,7 +605,7 @@ std::unique_ptr<Highlighter> create_dynamic_regex_highlighter(HighlighterParamet
     return make_hl(get_regex, get_face);
 }
 
-std::unique_ptr<Highlighter> create_line_highlighter(HighlighterParameters params, Highlighter*)
+RefPtr<Highlighter> create_line_highlighter(HighlighterParameters params, Highlighter*)
 {
     if (params.size() != 2)
         throw runtime_error("wrong parameter count");
@@ -585,10 +649,11 @@ std::unique_ptr<Highlighter> create_line_highlighter(HighlighterParameters param
             it->push_back({ String{' ', remaining}, face });
     };
 
-    return make_highlighter(std::move(func));
+    // the expression re-evaluates every frame and can point anywhere
+    return make_highlighter(std::move(func), HighlightPass::Colorize, true);
 }
 
-std::unique_ptr<Highlighter> create_column_highlighter(HighlighterParameters params, Highlighter*)
+RefPtr<Highlighter> create_column_highlighter(HighlighterParameters params, Highlighter*)
 {
     if (params.size() != 2)
         throw runtime_error("wrong parameter count");
@@ -645,7 +710,8 @@ std::unique_ptr<Highlighter> create_column_highlighter(HighlighterParameters par
         }
     };
 
-    return make_highlighter(std::move(func));
+    // the expression re-evaluates every frame and can point anywhere
+    return make_highlighter(std::move(func), HighlightPass::Colorize, true);
 }
 
 struct WrapHighlighter : Highlighter
@@ -659,6 +725,22 @@ struct WrapHighlighter : Highlighter
 
     struct SplitPos{ ByteCount byte; ColumnCount column; };
 
+    struct Cache
+    {
+        // wrap points for a single buffer line, valid as long as the line
+        // storage is unchanged and the same widths are requested
+        struct LineLayout
+        {
+            StringDataPtr storage;
+            ColumnCount wrap_column = -1;
+            ColumnCount prefix_len = -1;
+            Vector<SplitPos, MemoryDomain::Highlight> splits;
+        };
+        size_t timestamp = 0;
+        int tabstop = 0;
+        Vector<LineLayout, MemoryDomain::Highlight> lines;
+    };
+
     void do_highlight(HighlightContext context, DisplayBuffer& display_buffer, BufferRange) override
     {
         if (contains(context.disabled_ids, ms_id))
@@ -674,23 +756,24 @@ struct WrapHighlighter : Highlighter
         const LineCount win_height = context.context.window().dimensions().line;
         const ColumnCount marker_len = zero_if_greater(m_marker.column_length(), wrap_column);
         const Face face_marker = context.context.faces()["StatusLineInfo"];
+        auto& cache = update_cache(buffer, tabstop);
         for (auto it = display_buffer.lines().begin();
              it != display_buffer.lines().end(); ++it)
         {
             const LineCount buf_line = it->range().begin.line;
-            const ByteCount line_length = buffer[buf_line].length();
             const ColumnCount indent = m_preserve_indent ?
                 zero_if_greater(line_indent(buffer, tabstop, buf_line), wrap_column) : 0_col;
             const ColumnCount prefix_len = std::max(marker_len, indent);
 
-            auto pos = next_split_pos(buffer, wrap_column, prefix_len, tabstop, buf_line, {0, 0});
-            if (pos.byte == line_length)
+            auto splits = line_splits(cache, buffer, wrap_column, prefix_len, tabstop, buf_line);
+            if (splits.empty())
                 continue;
 
+            auto split_it = splits.begin();
             for (auto atom_it = it->begin();
-                 pos.byte != line_length and atom_it != it->end(); )
+                 split_it != splits.end() and atom_it != it->end(); )
             {
-                const BufferCoord coord{buf_line, pos.byte};
+                const BufferCoord coord{buf_line, split_it->byte};
                 if (!atom_it->has_buffer_range() or
                     coord < atom_it->begin() or coord >= atom_it->end())
                 {
@@ -729,7 +812,7 @@ struct WrapHighlighter : Highlighter
                 }
                 it = display_buffer.lines().insert(it+1, new_line);
 
-                pos = next_split_pos(buffer, wrap_column - prefix_len, prefix_len, tabstop, buf_line, pos);
+                ++split_it;
                 atom_it = it->begin();
             }
         }
@@ -748,19 +831,10 @@ struct WrapHighlighter : Highlighter
         const auto& cursor = context.context.selections().main().cursor();
         const int tabstop = context.context.options()["tabstop"].get<int>();
 
+        auto& cache = update_cache(buffer, tabstop);
         auto line_wrap_count = [&](LineCount line, ColumnCount prefix_len) {
-            LineCount count = 0;
-            const ByteCount line_length = buffer[line].length();
-            SplitPos pos{0, 0};
-            while (true)
-            {
-                pos = next_split_pos(buffer, wrap_column - (pos.byte == 0 ? 0_col : prefix_len),
-                                     prefix_len, tabstop, line, pos);
-                if (pos.byte == line_length)
-                    break;
-                ++count;
-            }
-            return count;
+            return LineCount{(int)line_splits(cache, buffer, wrap_column, prefix_len,
+                                              tabstop, line).size()};
         };
 
         const auto win_height = context.context.window().dimensions().line;
@@ -787,21 +861,19 @@ struct WrapHighlighter : Highlighter
             if (buf_line == cursor.line)
             {
                 SplitPos pos{0, 0};
-                for (LineCount count = 0; true; ++count)
+                LineCount count = 0;
+                for (auto& split : line_splits(cache, buffer, wrap_column, prefix_len, tabstop, buf_line))
                 {
-                    auto next_pos = next_split_pos(buffer, wrap_column - (pos.byte != 0 ? prefix_len : 0_col),
-                                                   prefix_len, tabstop, buf_line, pos);
-                    if (next_pos.byte > cursor.column)
-                    {
-                        setup.cursor_pos = DisplayCoord{
-                            win_line + count,
-                            get_column(buffer, tabstop, cursor) -
-                            pos.column + (pos.byte != 0 ? indent : 0_col)
-                        };
+                    if (split.byte > cursor.column)
                         break;
-                    }
-                    pos = next_pos;
+                    pos = split;
+                    ++count;
                 }
+                setup.cursor_pos = DisplayCoord{
+                    win_line + count,
+                    get_column(buffer, tabstop, cursor) -
+                    pos.column + (pos.byte != 0 ? indent : 0_col)
+                };
                 kak_assert(setup.cursor_pos.column >= 0 and setup.cursor_pos.column < setup.window_range.column);
             }
             const auto wrap_count = line_wrap_count(buf_line, prefix_len);
@@ -826,6 +898,55 @@ struct WrapHighlighter : Highlighter
         unique_ids.push_back(ms_id);
     }
 
+    Cache& update_cache(const Buffer& buffer, int tabstop) const
+    {
+        auto& cache = m_cache.get(buffer);
+        if (cache.timestamp == 0 or cache.tabstop != tabstop)
+        {
+            cache.lines.clear();
+            cache.tabstop = tabstop;
+        }
+        else if (cache.timestamp != buffer.timestamp())
+        {
+            for (auto& modif : compute_line_modifications(buffer, cache.timestamp))
+            {
+                auto begin = std::min(cache.lines.begin() + (int)modif.new_line, cache.lines.end());
+                auto end = std::min(begin + (int)modif.num_removed, cache.lines.end());
+                cache.lines.insert(cache.lines.erase(begin, end),
+                                   (size_t)(int)modif.num_added, Cache::LineLayout{});
+            }
+        }
+        cache.lines.resize((size_t)(int)buffer.line_count());
+        cache.timestamp = buffer.timestamp();
+        return cache;
+    }
+
+    ConstArrayView<SplitPos> line_splits(Cache& cache, const Buffer& buffer, ColumnCount wrap_column,
+                                         ColumnCount prefix_len, int tabstop, LineCount line) const
+    {
+        auto& layout = cache.lines[(size_t)(int)line];
+        const auto& storage = buffer.line_storage(line);
+        if (layout.storage != storage or layout.wrap_column != wrap_column or
+            layout.prefix_len != prefix_len)
+        {
+            layout.storage = storage;
+            layout.wrap_column = wrap_column;
+            layout.prefix_len = prefix_len;
+            layout.splits.clear();
+            const ByteCount line_length = buffer[line].length();
+            SplitPos pos{0, 0};
+            while (true)
+            {
+                pos = next_split_pos(buffer, wrap_column - (pos.byte == 0 ? 0_col : prefix_len),
+                                     prefix_len, tabstop, line, pos);
+                if (pos.byte == line_length)
+                    break;
+                layout.splits.push_back(pos);
+            }
+        }
+        return layout.splits;
+    }
+
     SplitPos next_split_pos(const Buffer& buffer,  ColumnCount wrap_column, ColumnCount prefix_len,
                             int tabstop, LineCount line, SplitPos current) const
     {
@@ -910,7 +1031,7 @@ struct WrapHighlighter : Highlighter
         return get_column(buffer, tabstop, {line, col});
     }
 
-    static std::unique_ptr<Highlighter> create(HighlighterParameters params, Highlighter*)
+    static RefPtr<Highlighter> create(HighlighterParameters params, Highlighter*)
     {
         static const ParameterDesc param_desc{
             { { "word", { false, "" } },
@@ -925,7 +1046,7 @@ struct WrapHighlighter : Highlighter
         if (auto width = parser.get_switch("width"))
             max_width = str_to_int(*width);
 
-        return std::make_unique<WrapHighlighter>(max_width, (bool)parser.get_switch("word"),
+        return make_highlighter_ref<WrapHighlighter>(max_width, (bool)parser.get_switch("word"),
                                                  (bool)parser.get_switch("indent"),
                                                  parser.get_switch("marker").value_or("").str());
     }
@@ -936,6 +1057,7 @@ struct WrapHighlighter : Highlighter
     const bool m_preserve_indent;
     const ColumnCount m_max_width;
     const String m_marker;
+    mutable BufferSideCache<Cache> m_cache;
 };
 
 constexpr StringView WrapHighlighter::ms_id;
@@ -1004,7 +1126,7 @@ struct ShowWhitespacesHighlighter : Highlighter
         m_spc{std::move(spc)}, m_lf{std::move(lf)}, m_nbsp{std::move(nbsp)}
     {}
 
-    static std::unique_ptr<Highlighter> create(HighlighterParameters params, Highlighter*)
+    static RefPtr<Highlighter> create(HighlighterParameters params, Highlighter*)
     {
         static const ParameterDesc param_desc{
             { { "tab", { true, "" } },
@@ -1023,7 +1145,7 @@ struct ShowWhitespacesHighlighter : Highlighter
             return value.str();
         };
 
-        return std::make_unique<ShowWhitespacesHighlighter>(
+        return make_highlighter_ref<ShowWhitespacesHighlighter>(
             get_param("tab", "→"), get_param("tabpad", " "), get_param("spc", "·"),
             get_param("lf", "¬"), get_param("nbsp", "⍽"));
     }
@@ -1060,7 +1182,7 @@ private:
                             const ColumnCount column = get_column(buffer, tabstop, coord);
                             const ColumnCount count = tabstop - (column % tabstop) -
                                                       std::max(win_column - column, 0_col);
-                            atom_it->replace(m_tab + String(m_tabpad[(CharCount)0], count - m_tab.column_length()));
+                            atom_it->replace(tab_string(count));
                         }
                         else if (cp == ' ')
                             atom_it->replace(m_spc);
@@ -1076,7 +1198,21 @@ private:
         }
     }
 
+    // the glyph set is fixed at construction, so the possible tab
+    // expansions only vary by their padded width
+    const String& tab_string(ColumnCount count)
+    {
+        const size_t index = (size_t)(int)std::max(0_col, count);
+        if (index >= m_tab_strings.size())
+            m_tab_strings.resize(index+1);
+        String& str = m_tab_strings[index];
+        if (str.empty())
+            str = m_tab + String(m_tabpad[(CharCount)0], count - m_tab.column_length());
+        return str;
+    }
+
     const String m_tab, m_tabpad, m_spc, m_lf, m_nbsp;
+    Vector<String, MemoryDomain::Highlight> m_tab_strings;
 };
 
 struct LineNumbersHighlighter : Highlighter
@@ -1087,7 +1223,7 @@ struct LineNumbersHighlighter : Highlighter
         m_hl_cursor_line{hl_cursor_line},
         m_separator{std::move(separator)} {}
 
-    static std::unique_ptr<Highlighter> create(HighlighterParameters params, Highlighter*)
+    static RefPtr<Highlighter> create(HighlighterParameters params, Highlighter*)
     {
         static const ParameterDesc param_desc{
             { { "relative", { false, "" } },
@@ -1101,9 +1237,12 @@ struct LineNumbersHighlighter : Highlighter
         if (separator.length() > 10)
             throw runtime_error("separator length is limited to 10 bytes");
 
-        return std::make_unique<LineNumbersHighlighter>((bool)parser.get_switch("relative"), (bool)parser.get_switch("hlcursor"), separator.str());
+        return make_highlighter_ref<LineNumbersHighlighter>((bool)parser.get_switch("relative"), (bool)parser.get_switch("hlcursor"), separator.str());
     }
 
+    // relative numbers shift on every displayed line when the cursor moves
+    bool depends_on_whole_frame() const override { return m_relative; }
+
 private:
     static constexpr StringView ms_id = "line-numbers";
 
@@ -1118,8 +1257,6 @@ private:
         const Face face_absolute = faces["LineNumberCursor"];
         int digit_count = compute_digit_count(context.context);
 
-        char format[16];
-        format_to(format, "%{}d", digit_count);
         const int main_line = (int)context.context.selections().main().cursor().line + 1;
         int last_line = -1;
         for (auto& line : display_buffer.lines())
@@ -1128,11 +1265,9 @@ private:
             const bool is_cursor_line = main_line == current_line;
             const int line_to_format = (m_relative and not is_cursor_line) ?
                                        current_line - main_line : current_line;
-            char buffer[16];
-            snprintf(buffer, 16, format, std::abs(line_to_format));
             const auto atom_face = last_line == current_line ? face_wrapped :
                 ((m_hl_cursor_line and is_cursor_line) ? face_absolute : face);
-            line.insert(line.begin(), {buffer, atom_face});
+            line.insert(line.begin(), {line_number_string(std::abs(line_to_format), digit_count), atom_face});
             line.insert(line.begin() + 1, {m_separator, face});
 
             last_line = current_line;
@@ -1162,9 +1297,44 @@ private:
         return digit_count;
     }
 
+    // formatted line numbers only depend on the value and the padding,
+    // cache them so scrolling does not reformat the same numbers
+    const String& line_number_string(int number, int digit_count)
+    {
+        if (digit_count != m_cached_digit_count)
+        {
+            m_number_strings.clear();
+            m_cached_digit_count = digit_count;
+        }
+
+        constexpr int max_cached_numbers = 1 << 14;
+        String* str = nullptr;
+        if (number < max_cached_numbers)
+        {
+            if ((size_t)number >= m_number_strings.size())
+                m_number_strings.resize(number+1);
+            str = &m_number_strings[number];
+        }
+        else
+            str = &m_scratch_number;
+
+        if (str->empty() or str == &m_scratch_number)
+        {
+            char format[16];
+            format_to(format, "%{}d", digit_count);
+            char buffer[16];
+            snprintf(buffer, 16, format, number);
+            *str = buffer;
+        }
+        return *str;
+    }
+
    const bool m_relative;
    const bool m_hl_cursor_line;
    const String m_separator;
+   Vector<String, MemoryDomain::Highlight> m_number_strings;
+   String m_scratch_number;
+   int m_cached_digit_count = 0;
 };
 
 constexpr StringView LineNumbersHighlighter::ms_id;
@@ -1228,9 +1398,11 @@ void show_matching_char(HighlightContext context, DisplayBuffer& display_buffer,
     }
 }
 
-std::unique_ptr<Highlighter> create_matching_char_highlighter(HighlighterParameters params, Highlighter*)
+RefPtr<Highlighter> create_matching_char_highlighter(HighlighterParameters params, Highlighter*)
 {
-    return make_highlighter(show_matching_char);
+    // the matching char face lands on the partner bracket, which can be
+    // arbitrarily far from the cursor that selected it
+    return make_highlighter(show_matching_char, HighlightPass::Colorize, true);
 }
 
 void highlight_selections(HighlightContext context, DisplayBuffer& display_buffer, BufferRange)
@@ -1349,7 +1521,7 @@ struct FlagLinesHighlighter : Highlighter
           m_option_name{std::move(option_name)},
           m_default_face{std::move(default_face)} {}
 
-    static std::unique_ptr<Highlighter> create(HighlighterParameters params, Highlighter*)
+    static RefPtr<Highlighter> create(HighlighterParameters params, Highlighter*)
     {
         if (params.size() != 2)
             throw runtime_error("wrong parameter count");
@@ -1360,9 +1532,12 @@ struct FlagLinesHighlighter : Highlighter
         // throw if wrong option type
         GlobalScope::instance().options()[option_name].get<LineAndSpecList>();
 
-        return std::make_unique<FlagLinesHighlighter>(option_name, default_face);
+        return make_highlighter_ref<FlagLinesHighlighter>(option_name, default_face);
     }
 
+    // the flags live in an option that can change between any two frames
+    bool depends_on_whole_frame() const override { return true; }
+
 private:
     void do_highlight(HighlightContext context, DisplayBuffer& display_buffer, BufferRange) override
     {
@@ -1370,46 +1545,46 @@ private:
         auto& buffer = context.context.buffer();
         update_line_specs_ifn(buffer, line_flags);
 
-        auto def_face = context.context.faces()[m_default_face];
-        Vector<DisplayLine> display_lines;
-        auto& lines = line_flags.list;
-        try
-        {
-            for (auto& line : lines)
-            {
-                display_lines.push_back(parse_display_line(std::get<1>(line), context.context.faces()));
-                for (auto& atom : display_lines.back())
-                    atom.face = merge_faces(def_face, atom.face);
-            }
-        }
-        catch (runtime_error& err)
-        {
-            write_to_debug_buffer(format("Error while evaluating line flag: {}", err.what()));
+        auto width = flags_width(context.context, line_flags);
+        if (not width)
             return;
-        }
 
-        ColumnCount width = 0;
-        for (auto& l : display_lines)
-             width = std::max(width, l.length());
-        const DisplayAtom empty{String{' ', width}, def_face};
+        auto def_face = context.context.faces()[m_default_face];
+        const DisplayAtom empty{String{' ', *width}, def_face};
+        auto& lines = line_flags.list;
         for (auto& line : display_buffer.lines())
         {
+            // lines are sorted by option_list_postprocess and kept
+            // sorted by update_line_specs_ifn
             int line_num = (int)line.range().begin.line + 1;
-            auto it = find_if(lines,
-                              [&](const LineAndSpec& l)
-                              { return std::get<0>(l) == line_num; });
-            if (it == lines.end())
+            auto it = std::lower_bound(lines.begin(), lines.end(), line_num,
+                                       [](const LineAndSpec& l, int line_num)
+                                       { return std::get<0>(l) < line_num; });
+            if (it == lines.end() or std::get<0>(*it) != line_num)
                 line.insert(line.begin(), empty);
             else
             {
-                DisplayLine& display_line = display_lines[it - lines.begin()];
-                DisplayAtom padding_atom{String(' ', width - display_line.length()), def_face};
-                auto it = std::copy(std::make_move_iterator(display_line.begin()),
-                                    std::make_move_iterator(display_line.end()),
-                                    std::inserter(line, line.begin()));
-
-                if (padding_atom.length() != 0)
-                    *it++ = std::move(padding_atom);
+                // flags_width already parsed every spec, but only against the
+                // faces current at that time; a face removed since then makes
+                // the parse fail again
+                try
+                {
+                    DisplayLine display_line = parse_display_line(std::get<1>(*it), context.context.faces());
+                    for (auto& atom : display_line)
+                        atom.face = merge_faces(def_face, atom.face);
+
+                    DisplayAtom padding_atom{String(' ', *width - display_line.length()), def_face};
+                    auto out_it = std::copy(std::make_move_iterator(display_line.begin()),
+                                            std::make_move_iterator(display_line.end()),
+                                            std::inserter(line, line.begin()));
+
+                    if (padding_atom.length() != 0)
+                        *out_it++ = std::move(padding_atom);
+                }
+                catch (runtime_error& err)
+                {
+                    write_to_debug_buffer(format("Error while evaluating line flag: {}", err.what()));
+                }
             }
         }
     }
@@ -1420,23 +1595,51 @@ private:
         auto& buffer = context.context.buffer();
         update_line_specs_ifn(buffer, line_flags);
 
-        ColumnCount width = 0;
+        auto width = flags_width(context.context, line_flags);
+        if (not width)
+            return;
+
+        setup.window_range.column -= std::min(*width, setup.window_range.column);
+    }
+
+    struct Cache
+    {
+        size_t spec_hash = -1;
+        Optional<ColumnCount> width; // unset when the specs failed to parse
+    };
+
+    // the width of the flags column is the maximum width over every spec,
+    // not just the displayed ones, so cache it against the spec strings
+    // instead of reparsing the whole list every frame
+    Optional<ColumnCount> flags_width(const Context& context, const LineAndSpecList& line_flags) const
+    {
+        size_t spec_hash = 0;
+        for (auto& line : line_flags.list)
+            spec_hash = combine_hash(spec_hash, hash_value(std::get<1>(line)));
+
+        auto& cache = m_cache.get(context.buffer());
+        if (cache.spec_hash == spec_hash)
+            return cache.width;
+
+        cache.spec_hash = spec_hash;
+        cache.width.reset();
         try
         {
+            ColumnCount width = 0;
             for (auto& line : line_flags.list)
-                width = std::max(parse_display_line(std::get<1>(line), context.context.faces()).length(), width);
+                width = std::max(parse_display_line(std::get<1>(line), context.faces()).length(), width);
+            cache.width = width;
         }
         catch (runtime_error& err)
         {
             write_to_debug_buffer(format("Error while evaluating line flag: {}", err.what()));
-            return;
         }
-
-        setup.window_range.column -= std::min(width, setup.window_range.column);
+        return cache.width;
     }
 
     String m_option_name;
     String m_default_face;
+    mutable BufferSideCache<Cache> m_cache;
 };
 
 String option_to_string(InclusiveBufferRange range)
@@ -1494,7 +1697,7 @@ struct RangesHighlighter : Highlighter
         : Highlighter{HighlightPass::Colorize}
         , m_option_name{std::move(option_name)} {}
 
-    static std::unique_ptr<Highlighter> create(HighlighterParameters params, Highlighter*)
+    static RefPtr<Highlighter> create(HighlighterParameters params, Highlighter*)
     {
         if (params.size() != 1)
             throw runtime_error("wrong parameter count");
@@ -1503,9 +1706,12 @@ struct RangesHighlighter : Highlighter
         // throw if wrong option type
         GlobalScope::instance().options()[option_name].get<RangeAndStringList>();
 
-        return std::make_unique<RangesHighlighter>(option_name);
+        return make_highlighter_ref<RangesHighlighter>(option_name);
     }
 
+    // the ranges live in an option that can change between any two frames
+    bool depends_on_whole_frame() const override { return true; }
+
 private:
     void do_highlight(HighlightContext context, DisplayBuffer& display_buffer, BufferRange) override
     {
@@ -1536,7 +1742,7 @@ struct ReplaceRangesHighlighter : Highlighter
         : Highlighter{HighlightPass::Colorize}
         , m_option_name{std::move(option_name)} {}
 
-    static std::unique_ptr<Highlighter> create(HighlighterParameters params, Highlighter*)
+    static RefPtr<Highlighter> create(HighlighterParameters params, Highlighter*)
     {
         if (params.size() != 1)
             throw runtime_error("wrong parameter count");
@@ -1545,9 +1751,12 @@ struct ReplaceRangesHighlighter : Highlighter
         // throw if wrong option type
         GlobalScope::instance().options()[option_name].get<RangeAndStringList>();
 
-        return std::make_unique<ReplaceRangesHighlighter>(option_name);
+        return make_highlighter_ref<ReplaceRangesHighlighter>(option_name);
     }
 
+    // the ranges live in an option that can change between any two frames
+    bool depends_on_whole_frame() const override { return true; }
+
 private:
     void do_highlight(HighlightContext context, DisplayBuffer& display_buffer, BufferRange) override
     {
@@ -1599,7 +1808,7 @@ HighlightPass parse_passes(StringView str)
     return passes;
 }
 
-std::unique_ptr<Highlighter> create_highlighter_group(HighlighterParameters params, Highlighter*)
+RefPtr<Highlighter> create_highlighter_group(HighlighterParameters params, Highlighter*)
 {
     static const ParameterDesc param_desc{
         { { "passes", { true, "" } } },
@@ -1608,7 +1817,7 @@ std::unique_ptr<Highlighter> create_highlighter_group(HighlighterParameters para
     ParametersParser parser{params, param_desc};
     HighlightPass passes = parse_passes(parser.get_switch("passes").value_or("colorize"));
 
-    return std::make_unique<HighlighterGroup>(passes);
+    return make_highlighter_ref<HighlighterGroup>(passes);
 }
 
 struct ReferenceHighlighter : Highlighter
@@ -1616,7 +1825,7 @@ struct ReferenceHighlighter : Highlighter
     ReferenceHighlighter(HighlightPass passes, String name)
         : Highlighter{passes}, m_name{std::move(name)} {}
 
-    static std::unique_ptr<Highlighter> create(HighlighterParameters params, Highlighter*)
+    static RefPtr<Highlighter> create(HighlighterParameters params, Highlighter*)
     {
         static const ParameterDesc param_desc{
             { { "passes", { true, "" } } },
@@ -1624,7 +1833,19 @@ struct ReferenceHighlighter : Highlighter
         };
         ParametersParser parser{params, param_desc};
         HighlightPass passes = parse_passes(parser.get_switch("passes").value_or("colorize"));
-        return std::make_unique<ReferenceHighlighter>(passes, parser[0]);
+        return make_highlighter_ref<ReferenceHighlighter>(passes, parser[0]);
+    }
+
+    bool depends_on_whole_frame() const override
+    {
+        try
+        {
+            return DefinedHighlighters::instance().get_child(m_name).depends_on_whole_frame();
+        }
+        catch (child_not_found&)
+        {
+            return false;
+        }
     }
 
 private:
@@ -1849,6 +2070,12 @@ public:
                               *default_region_it->value);
     }
 
+    bool depends_on_whole_frame() const override
+    {
+        return any_of(m_regions, [](auto& region)
+                      { return region.value->depends_on_whole_frame(); });
+    }
+
     bool has_children() const override { return true; }
 
     Highlighter& get_child(StringView path) override
@@ -1864,14 +2091,14 @@ public:
             return it->value->get_child({sep_it+1, path.end()});
     }
 
-    void add_child(String name, std::unique_ptr<Highlighter>&& hl) override
+    void add_child(String name, RefPtr<Highlighter>&& hl) override
     {
         if (not dynamic_cast<RegionHighlighter*>(hl.get()))
             throw runtime_error{"only region highlighter can be added as child of a regions highlighter"};
         if (m_regions.contains(name))
             throw runtime_error{format("duplicate id: '{}'", name)};
 
-        std::unique_ptr<RegionHighlighter> region_hl{dynamic_cast<RegionHighlighter*>(hl.release())};
+        RefPtr<RegionHighlighter> region_hl{dynamic_cast<RegionHighlighter*>(hl.get())};
         if (region_hl->is_default())
         {
             if (not m_default_region.empty())
@@ -1906,11 +2133,11 @@ public:
         return { 0, 0, complete(path, cursor_pos, container) };
     }
 
-    static std::unique_ptr<Highlighter> create(HighlighterParameters params, Highlighter*)
+    static RefPtr<Highlighter> create(HighlighterParameters params, Highlighter*)
     {
         if (not params.empty())
             throw runtime_error{"unexpected parameters"};
-        return std::make_unique<RegionsHighlighter>();
+        return make_highlighter_ref<RegionsHighlighter>();
     }
 
     static bool is_regions(Highlighter* parent)
@@ -1922,7 +2149,7 @@ public:
         return false;
     }
 
-    static std::unique_ptr<Highlighter> create_region(HighlighterParameters params, Highlighter* parent)
+    static RefPtr<Highlighter> create_region(HighlighterParameters params, Highlighter* parent)
     {
         if (not is_regions(parent))
             throw runtime_error{"region highlighter can only be added to a regions parent"};
@@ -1953,10 +2180,10 @@ public:
             recurse = Regex{*recurse_switch, flags};
 
         auto delegate = it->value.factory(parser.positionals_from(3), nullptr);
-        return std::make_unique<RegionHighlighter>(std::move(delegate), Regex{parser[0], flags}, Regex{parser[1], flags}, recurse, match_capture);
+        return make_highlighter_ref<RegionHighlighter>(std::move(delegate), Regex{parser[0], flags}, Regex{parser[1], flags}, recurse, match_capture);
     }
 
-    static std::unique_ptr<Highlighter> create_default_region(HighlighterParameters params, Highlighter* parent)
+    static RefPtr<Highlighter> create_default_region(HighlighterParameters params, Highlighter* parent)
     {
         if (not is_regions(parent))
             throw runtime_error{"default-region highlighter can only be added to a regions parent"};
@@ -1965,7 +2192,7 @@ public:
         ParametersParser parser{params, param_desc};
 
         auto delegate = HighlighterRegistry::instance()[parser[0]].factory(parser.positionals_from(1), nullptr);
-        return std::make_unique<RegionHighlighter>(std::move(delegate));
+        return make_highlighter_ref<RegionHighlighter>(std::move(delegate));
     }
 
 private:
@@ -1977,13 +2204,19 @@ private:
     };
     using RegionList = Vector<Region, MemoryDomain::Highlight>;
 
+    struct CachedRegions
+    {
+        RegionList list;
+        bool complete = false;
+    };
+
     struct Cache
     {
         size_t buffer_timestamp = 0;
         size_t regions_timestamp = 0;
         LineRangeSet ranges;
         std::unique_ptr<RegionMatches[]> matches;
-        HashMap<BufferRange, RegionList, MemoryDomain::Highlight> regions;
+        HashMap<BufferRange, CachedRegions, MemoryDomain::Highlight> regions;
     };
 
     using RegionAndMatch = std::pair<size_t, RegexMatchList::const_iterator>;
@@ -2004,7 +2237,8 @@ private:
         return res;
     }
 
-    bool update_matches(Cache& cache, const Buffer& buffer, LineRange range)
+    // returns the first line whose matches might differ from the cached ones
+    Optional<LineCount> update_matches(Cache& cache, const Buffer& buffer, LineRange range)
     {
         const size_t buffer_timestamp = buffer.timestamp();
         if (cache.buffer_timestamp == 0 or
@@ -2019,11 +2253,15 @@ private:
             cache.ranges.reset(range);
             cache.buffer_timestamp = buffer_timestamp;
             cache.regions_timestamp = m_regions_timestamp;
-            return true;
+            return LineCount{0};
         }
         else
         {
-            bool modified = false;
+            Optional<LineCount> first_dirty;
+            auto mark_dirty = [&](LineCount line) {
+                if (not first_dirty or line < *first_dirty)
+                    first_dirty = line;
+            };
             if (cache.buffer_timestamp != buffer_timestamp)
             {
                 auto modifs = compute_line_modifications(buffer, cache.buffer_timestamp);
@@ -2036,7 +2274,8 @@ private:
 
                 cache.ranges.update(modifs);
                 cache.buffer_timestamp = buffer_timestamp;
-                modified = true;
+                if (not modifs.empty())
+                    mark_dirty(modifs[0].new_line);
             }
 
             cache.ranges.add_range(range, [&, this](const LineRange& range) {
@@ -2044,25 +2283,55 @@ private:
                     return;
                 for (size_t i = 0; i < m_regions.size(); ++i)
                     m_regions.item(i).value->add_matches(buffer, range, cache.matches[i]);
-                modified = true;
+                mark_dirty(range.begin);
             });
-            return modified;
+            return first_dirty;
         }
     }
 
     const RegionList& get_regions_for_range(const Buffer& buffer, BufferRange range)
     {
         Cache& cache = m_cache.get(buffer);
-        if (update_matches(cache, buffer, {range.begin.line, std::min(buffer.line_count(), range.end.line + 1)}))
-            cache.regions.clear();
+        if (auto dirty = update_matches(cache, buffer, {range.begin.line, std::min(buffer.line_count(), range.end.line + 1)}))
+        {
+            // matches before the dirty line are unchanged and region pairing
+            // is strictly left to right, so regions ending before it are
+            // still valid; drop the rest and resume pairing from there
+            for (auto& entry : cache.regions)
+            {
+                if (entry.key.end.line < *dirty)
+                    continue;
+                auto& cached = entry.value;
+                cached.list.erase(std::lower_bound(cached.list.begin(), cached.list.end(), *dirty,
+                                                   [](const Region& r, LineCount l) { return r.end.line < l; }),
+                                  cached.list.end());
+                cached.complete = false;
+            }
+        }
 
         auto it = cache.regions.find(range);
-        if (it != cache.regions.end())
-            return it->value;
+        if (it != cache.regions.end() and it->value.complete)
+            return it->value.list;
+
+        if (it == cache.regions.end())
+        {
+            constexpr size_t max_cached_ranges = 8;
+            while (cache.regions.size() >= max_cached_ranges)
+                cache.regions.remove(cache.regions.item(0).key);
+        }
 
-        RegionList& regions = cache.regions[range];
+        CachedRegions& cached = cache.regions[range];
+        RegionList& regions = cached.list;
 
-        for (auto begin = find_next_begin(cache, range.begin),
+        auto resume_pos = range.begin;
+        if (not regions.empty())
+        {
+            resume_pos = regions.back().end;
+            if (resume_pos == regions.back().begin) // empty begin and end matches
+                ++resume_pos.column;
+        }
+
+        for (auto begin = find_next_begin(cache, resume_pos),
                   end = RegionAndMatch{ 0, cache.matches[0].begin_matches.end() };
              begin != end; )
         {
@@ -2093,12 +2362,13 @@ private:
             }
             begin = find_next_begin(cache, end_coord);
         }
+        cached.complete = true;
         return regions;
     }
 
     struct RegionHighlighter : public Highlighter
     {
-        RegionHighlighter(std::unique_ptr<Highlighter>&& delegate,
+        RegionHighlighter(RefPtr<Highlighter>&& delegate,
                           Regex begin, Regex end, Regex recurse,
                           bool match_capture)
             : Highlighter{delegate->passes()},
@@ -2108,11 +2378,16 @@ private:
        {
        }
 
-        RegionHighlighter(std::unique_ptr<Highlighter>&& delegate)
+        RegionHighlighter(RefPtr<Highlighter>&& delegate)
             : Highlighter{delegate->passes()}, m_delegate{std::move(delegate)}, m_default{true}
        {
        }
 
+        bool depends_on_whole_frame() const override
+        {
+            return m_delegate->depends_on_whole_frame();
+        }
+
         bool has_children() const override
         {
             return m_delegate->has_children();
@@ -2123,7 +2398,7 @@ private:
             return m_delegate->get_child(path);
         }
 
-        void add_child(String name, std::unique_ptr<Highlighter>&& hl) override
+        void add_child(String name, RefPtr<Highlighter>&& hl) override
         {
             return m_delegate->add_child(name, std::move(hl));
         }
@@ -2165,7 +2440,7 @@ private:
         Highlighter& delegate() { return *m_delegate; }
 
     private:
-        std::unique_ptr<Highlighter> m_delegate;
+        RefPtr<Highlighter> m_delegate;
 
         Regex m_begin;
         Regex m_end;
@@ -2174,7 +2449,7 @@ private:
         bool  m_default = false;
     };
 
-    HashMap<String, std::unique_ptr<RegionHighlighter>, MemoryDomain::Highlight> m_regions;
+    HashMap<String, RefPtr<RegionHighlighter>, MemoryDomain::Highlight> m_regions;
     String m_default_region;
 
     size_t m_regions_timestamp = 0;
@@ -2183,7 +2458,7 @@ private:
 
 void setup_builtin_highlighters(HighlighterGroup& group)
 {
-    group.add_child("tabulations"_str, std::make_unique<TabulationHighlighter>());
+    group.add_child("tabulations"_str, make_highlighter_ref<TabulationHighlighter>());
     group.add_child("unprintable"_str, make_highlighter(expand_unprintable));
     group.add_child("selections"_str,  make_highlighter(highlight_selections));
 }
@@ -2196,30 +2471,30 @@ void register_highlighters()
         "number-lines",
         { LineNumbersHighlighter::create,
           "Display line numbers \n"
-          "Parameters: -relative, -hlcursor, -separator <separator text>\n" } });
+          "Parameters: -relative, -hlcursor, -separator <separator text>\n", true } });
     registry.insert({
         "show-matching",
         { create_matching_char_highlighter,
-          "Apply the MatchingChar face to the char matching the one under the cursor" } });
+          "Apply the MatchingChar face to the char matching the one under the cursor", true } });
     registry.insert({
         "show-whitespaces",
         { ShowWhitespacesHighlighter::create,
           "Display whitespaces using symbols \n"
-          "Parameters: -tab <separator> -tabpad <separator> -lf <separator> -spc <separator> -nbsp <separator>\n" } });
+          "Parameters: -tab <separator> -tabpad <separator> -lf <separator> -spc <separator> -nbsp <separator>\n", true } });
     registry.insert({
         "fill",
         { create_fill_highlighter,
-          "Fill the whole highlighted range with the given face" } });
+          "Fill the whole highlighted range with the given face", true } });
     registry.insert({
         "regex",
         { RegexHighlighter::create,
           "Parameters: <regex> <capture num>:<face> <capture num>:<face>...\n"
-          "Highlights the matches for captures from the regex with the given faces" } });
+          "Highlights the matches for captures from the regex with the given faces", true } });
     registry.insert({
         "dynregex",
         { create_dynamic_regex_highlighter,
           "Parameters: <expr> <capture num>:<face> <capture num>:<face>...\n"
-          "Evaluate expression at every redraw to gather a regex" } });
+          "Evaluate expression at every redraw to gather a regex", true } });
     registry.insert({
         "group",
         { create_highlighter_group,
@@ -2231,29 +2506,29 @@ void register_highlighters()
         "flag-lines",
         { FlagLinesHighlighter::create,
           "Parameters: <face> <option name>\n"
-          "Display flags specified in the line-spec option <option name> with <face>"} });
+          "Display flags specified in the line-spec option <option name> with <face>", true } });
     registry.insert({
         "ranges",
         { RangesHighlighter::create,
           "Parameters: <option name>\n"
           "Use the range-specs option given as parameter to highlight buffer\n"
-          "each spec is interpreted as a face to apply to the range\n" } });
+          "each spec is interpreted as a face to apply to the range\n", true } });
     registry.insert({
         "replace-ranges",
         { ReplaceRangesHighlighter::create,
           "Parameters: <option name>\n"
           "Use the range-specs option given as parameter to highlight buffer\n"
-          "each spec is interpreted as a display line to display in place of the range\n" } });
+          "each spec is interpreted as a display line to display in place of the range\n", true } });
     registry.insert({
         "line",
         { create_line_highlighter,
           "Parameters: <value string> <face>\n"
-          "Highlight the line given by evaluating <value string> with <face>" } });
+          "Highlight the line given by evaluating <value string> with <face>", true } });
     registry.insert({
         "column",
         { create_column_highlighter,
           "Parameters: <value string> <face>\n"
-          "Highlight the column given by evaluating <value string> with <face>" } });
+          "Highlight the column given by evaluating <value string> with <face>", true } });
     registry.insert({
         "wrap",
         { WrapHighlighter::create,
@@ -2261,14 +2536,14 @@ void register_highlighters()
           "Wrap lines to window width, or max_width if given and window is wider,\n"
           "wrap at word boundaries instead of codepoint boundaries if -word is given\n"
           "insert marker_text at start of wrapped lines if given\n"
-          "preserve line indent in wrapped parts if -indent is given\n"} });
+          "preserve line indent in wrapped parts if -indent is given\n", true } });
     registry.insert({
         "ref",
         { ReferenceHighlighter::create,
           "Parameters: [-passes <passes>] <path>\n"
           "Reference the highlighter at <path> in shared highlighters\n"
           "<passes> is a flags(colorize|move|wrap) defaulting to colorize\n"
-          "which specify what kind of highlighters can be referenced" } });
+          "which specify what kind of highlighters can be referenced", true } });
     registry.insert({
         "regions",
         { RegionsHighlighter::create,
@@ -8,6 +8,7 @@
 #include "face_registry.hh"
 #include "option.hh"
 #include "option_types.hh"
+#include "profile.hh"
 #include "ranges.hh"
 #include "regex.hh"
 
@@ -19,9 +20,20 @@ struct HookManager::HookData
     String group;
     HookFlags flags;
     Regex filter;
+    bool literal_filter; // filter has no metacharacter, compare as string
     String commands;
 };
 
+// most hook filters are plain literals ('filetype=cpp', an option name,
+// a key); matching those by string comparison sidesteps a regex exec
+// per registered hook on every dispatch
+static bool is_literal_regex(StringView re)
+{
+    return not std::any_of(re.begin(), re.end(), [](char c) {
+        return contains(StringView{"\\^$.|?*+()[]{}"}, c);
+    });
+}
+
 HookManager::HookManager() : m_parent(nullptr) {}
 HookManager::HookManager(HookManager& parent) : SafeCountable{}, m_parent(&parent) {}
 HookManager::~HookManager() = default;
@@ -29,7 +41,8 @@ HookManager::~HookManager() = default;
 void HookManager::add_hook(Hook hook, String group, HookFlags flags, Regex filter, String commands)
 {
     auto& hooks = m_hooks[to_underlying(hook)];
-    hooks.emplace_back(new HookData{std::move(group), flags, std::move(filter), std::move(commands)});
+    const bool literal_filter = is_literal_regex(filter.str());
+    hooks.emplace_back(new HookData{std::move(group), flags, std::move(filter), literal_filter, std::move(commands)});
 }
 
 void HookManager::remove_hooks(const Regex& regex)
@@ -66,6 +79,13 @@ void HookManager::run_hook(Hook hook, StringView param, Context& context)
 {
     auto& hook_list = m_hooks[to_underlying(hook)];
 
+    if (hook_list.empty()) // bail out early, most hook types have no hook registered
+    {
+        if (m_parent)
+            m_parent->run_hook(hook, param, context);
+        return;
+    }
+
     const bool only_always = context.hooks_disabled();
     auto& disabled_hooks = context.options()["disabled_hooks"].get<Regex>();
 
@@ -73,17 +93,29 @@ void HookManager::run_hook(Hook hook, StringView param, Context& context)
     Vector<ToRun> hooks_to_run; // The m_hooks_trash vector ensure hooks wont die during this method
     for (auto& hook : hook_list)
     {
+        // filters without capture groups can use the capture-free vm, as
+        // capture 0 of a full match is always the whole param
+        const bool capturing = hook->filter.impl()->save_count > 2;
         MatchResults<const char*> captures;
         if ((not only_always or (hook->flags & HookFlags::Always)) and
             (hook->group.empty() or disabled_hooks.empty() or
              not regex_match(hook->group.begin(), hook->group.end(), disabled_hooks))
-            and regex_match(param.begin(), param.end(), captures, hook->filter))
+            and (hook->literal_filter ? param == hook->filter.str()
+                 : capturing ? regex_match(param.begin(), param.end(), captures, hook->filter)
+                             : regex_match(param.begin(), param.end(), hook->filter)))
+        {
+            if (not capturing)
+                captures.values() = { param.begin(), param.end() };
             hooks_to_run.push_back({ hook.get(), std::move(captures) });
+        }
     }
 
     if (m_parent)
         m_parent->run_hook(hook, param, context);
 
+    if (hooks_to_run.empty()) // no filter matched, nothing to execute or profile
+        return;
+
     auto hook_name = enum_desc(Meta::Type<Hook>{})[to_underlying(hook)].name;
     if (contains(m_running_hooks, std::make_pair(hook, param)))
     {
@@ -99,6 +131,10 @@ void HookManager::run_hook(Hook hook, StringView param, Context& context)
             m_hooks_trash.clear();
     });
 
+    ProfileTimer profile_timer{context, ProfileCategory::Hook};
+    char trace_name[64];
+    TraceTimer trace_timer{format_to(trace_name, "hook {}", hook_name)};
+
     const DebugFlags debug_flags = context.options()["debug"].get<DebugFlags>();
     const bool profile = debug_flags & DebugFlags::Profile;
     auto start_time = profile ? Clock::now() : TimePoint{};
@@ -30,6 +30,7 @@ public:
     InputMode& operator=(const InputMode&) = delete;
 
     void handle_key(Key key) { RefPtr<InputMode> keep_alive{this}; on_key(key); }
+    void paste(StringView content) { RefPtr<InputMode> keep_alive{this}; on_paste(content); }
 
     virtual void on_enabled() {}
     virtual void on_disabled(bool temporary) {}
@@ -55,6 +56,7 @@ public:
 
 protected:
     virtual void on_key(Key key) = 0;
+    virtual void on_paste(StringView content);
 
     void push_mode(InputMode* new_mode)
     {
@@ -69,6 +71,15 @@ private:
     InputHandler& m_input_handler;
 };
 
+void InputMode::on_paste(StringView content)
+{
+    // default to inserting the content in the buffer as a single edit
+    // instead of treating it as keys
+    ScopedEdition edition{context()};
+    String str{content.begin(), content.end()};
+    context().selections().insert(str, InsertMode::InsertCursor);
+}
+
 namespace InputModes
 {
 
@@ -237,14 +248,18 @@ public:
         });
 
         const bool transient = context().flags() & Context::Flags::Draft;
+        const bool batched = (bool)context().batched_keys();
 
         if (m_mouse_handler.handle_key(key, context()))
         {
-            context().print_status({});
-            if (context().has_client())
-                context().client().info_hide();
+            if (not batched)
+            {
+                context().print_status({});
+                if (context().has_client())
+                    context().client().info_hide();
+            }
 
-            if (not transient)
+            if (not transient and not batched)
                 m_idle_timer.set_next_date(Clock::now() + get_idle_timeout(context()));
         }
         else if (auto cp = key.codepoint(); cp and isdigit(*cp))
@@ -289,9 +304,12 @@ public:
                      m_state = State::PopOnEnabled;
             });
 
-            context().print_status({});
-            if (context().has_client())
-                context().client().info_hide();
+            if (not batched)
+            {
+                context().print_status({});
+                if (context().has_client())
+                    context().client().info_hide();
+            }
 
             // Hack to parse keys sent by terminals using the 8th bit to mark the
             // meta key. In normal mode, give priority to a potential alt-key than
@@ -305,10 +323,13 @@ public:
             do_restore_hooks = true;
             if (auto command = get_normal_command(key))
             {
-                auto autoinfo = context().options()["autoinfo"].get<AutoInfo>();
-                if (autoinfo & AutoInfo::Normal and context().has_client())
-                    context().client().info_show(key_to_str(key), command->docstring.str(),
-                                                 {}, InfoStyle::Prompt);
+                if (not batched)
+                {
+                    auto autoinfo = context().options()["autoinfo"].get<AutoInfo>();
+                    if (autoinfo & AutoInfo::Normal and context().has_client())
+                        context().client().info_show(key_to_str(key), command->docstring.str(),
+                                                     {}, InfoStyle::Prompt);
+                }
 
                 // reset m_params now to be reentrant
                 NormalParams params = m_params;
@@ -319,7 +340,7 @@ public:
         }
 
         context().hooks().run_hook(Hook::NormalKey, key_to_str(key), context());
-        if (enabled() and not transient) // The hook might have changed mode
+        if (enabled() and not transient and not batched) // The hook might have changed mode
             m_idle_timer.set_next_date(Clock::now() + get_idle_timeout(context()));
     }
 
@@ -328,10 +349,12 @@ public:
         AtomList atoms;
         auto num_sel = context().selections().size();
         auto main_index = context().selections().main_index();
+        static constexpr auto sel_fmt = compile_format("{} sel");
+        static constexpr auto sels_fmt = compile_format("{} sels ({})");
         if (num_sel == 1)
-            atoms.emplace_back(format("{} sel", num_sel), context().faces()["StatusLineInfo"]);
+            atoms.emplace_back(format(sel_fmt, num_sel), context().faces()["StatusLineInfo"]);
         else
-            atoms.emplace_back(format("{} sels ({})", num_sel, main_index + 1), context().faces()["StatusLineInfo"]);
+            atoms.emplace_back(format(sels_fmt, num_sel, main_index + 1), context().faces()["StatusLineInfo"]);
 
         if (m_params.count != 0)
         {
@@ -970,6 +993,18 @@ public:
             m_idle_timer.set_next_date(Clock::now() + get_idle_timeout(context()));
     }
 
+    void on_paste(StringView content) override
+    {
+        m_line_editor.insert(content);
+        clear_completions();
+        m_refresh_completion_pending = true;
+
+        display();
+        m_line_changed = true;
+        if (enabled() and not (context().flags() & Context::Flags::Draft))
+            m_idle_timer.set_next_date(Clock::now() + get_idle_timeout(context()));
+    }
+
     void set_prompt_face(Face face)
     {
         if (face != m_prompt_face)
@@ -1004,8 +1039,14 @@ private:
                 return;
             m_current_completion = -1;
             const String& line = m_line_editor.line();
-            m_completions = m_completer(context(), flags, line,
-                                        line.byte_count_to(m_line_editor.cursor_pos()));
+            const ByteCount cursor_pos = line.byte_count_to(m_line_editor.cursor_pos());
+            if (not refine_completions(line, cursor_pos, flags))
+            {
+                m_completions = m_completer(context(), flags, line, cursor_pos);
+                m_cached_completions = m_completions;
+                m_cached_line = line;
+                m_cached_flags = flags;
+            }
             const bool menu = (bool)(m_completions.flags & Completions::Flags::Menu);
             if (context().has_client())
             {
@@ -1035,6 +1076,39 @@ private:
         } catch (runtime_error&) {}
     }
 
+    // When the query merely grew at the end of the line, the matches are a
+    // subset of what the completer last returned, so re-rank that already
+    // computed set instead of running the completer from scratch.
+    bool refine_completions(const String& line, ByteCount cursor_pos,
+                            CompletionFlags flags)
+    {
+        const auto& cached = m_cached_completions;
+        if (cached.candidates.empty() or
+            (cached.flags & Completions::Flags::Menu) or
+            flags != m_cached_flags)
+            return false;
+
+        if (cursor_pos != line.length() or
+            cached.end != m_cached_line.length() or
+            line.length() < m_cached_line.length() or
+            not prefix_match(line, m_cached_line))
+            return false;
+
+        // appended separators can widen the candidate set (a filename
+        // completer descends into a new directory); only plain word
+        // characters are guaranteed to narrow it
+        if (not all_of(line.substr(m_cached_line.length()),
+                       [](char c) { return is_word(c); }))
+            return false;
+
+        auto query = line.substr(cached.start, cursor_pos - cached.start);
+        m_completions = Completions{cached.start, cursor_pos,
+                                    complete(query, query.length(),
+                                             cached.candidates),
+                                    cached.flags};
+        return true;
+    }
+
     void clear_completions()
     {
         m_current_completion = -1;
@@ -1078,6 +1152,11 @@ private:
     const String   m_prompt;
     Face           m_prompt_face;
     Completions    m_completions;
+    // last result actually computed by the completer, kept so that
+    // refine_completions can filter it while the query keeps growing
+    Completions    m_cached_completions;
+    String         m_cached_line;
+    CompletionFlags m_cached_flags = CompletionFlags::None;
     int            m_current_completion = -1;
     bool           m_prefix_in_completions = false;
     String         m_prefix;
@@ -1188,7 +1267,8 @@ public:
     {
         auto& buffer = context().buffer();
 
-        const bool transient = context().flags() & Context::Flags::Draft;
+        const bool transient = (context().flags() & Context::Flags::Draft) or
+                               (bool)context().batched_keys();
         bool update_completions = true;
         bool moved = false;
         if (m_mouse_handler.handle_key(key, context()))
@@ -1367,6 +1447,16 @@ public:
             m_idle_timer.set_next_date(Clock::now() + get_idle_timeout(context()));
     }
 
+    void on_paste(StringView content) override
+    {
+        insert(String{content.begin(), content.end()});
+
+        const bool transient = (context().flags() & Context::Flags::Draft) or
+                               (bool)context().batched_keys();
+        if (enabled() and not transient)
+            m_idle_timer.set_next_date(Clock::now() + get_idle_timeout(context()));
+    }
+
     DisplayLine mode_line() const override
     {
         auto num_sel = context().selections().size();
@@ -1686,6 +1776,14 @@ void InputHandler::handle_key(Key key)
     }
 }
 
+void InputHandler::paste(StringView content)
+{
+    ++m_handle_key_level;
+    auto dec = on_scope_end([this]{ --m_handle_key_level; });
+
+    current_mode().paste(content);
+}
+
 void InputHandler::start_recording(char reg)
 {
     kak_assert(m_recording_reg == 0);
@@ -85,6 +85,9 @@ public:
     // process the given key
     void handle_key(Key key);
 
+    // process pasted content as a single insertion
+    void paste(StringView content);
+
     void start_recording(char reg);
     bool is_recording() const;
     void stop_recording();
@@ -5,6 +5,7 @@
 #include "client.hh"
 #include "command_manager.hh"
 #include "changes.hh"
+#include "completion.hh"
 #include "context.hh"
 #include "display_buffer.hh"
 #include "face_registry.hh"
@@ -115,17 +116,22 @@ InsertCompletion complete_word(const SelectionList& sels,
 
         const Buffer* buffer;
     };
-    Vector<RankedMatchAndBuffer> matches;
+    constexpr size_t max_count = 100;
+    // Gather best max_count matches, streaming candidates through the
+    // selector as word dbs enumerate them instead of materializing them all
+    NBestMatches<RankedMatchAndBuffer> best{max_count};
 
     auto& word_db = get_word_db(buffer);
     for (auto& m : word_db.find_matching(prefix))
-        matches.push_back({ m, &buffer });
-
-    // Remove words that are being edited
-    for (auto& word_count : sel_word_counts)
     {
-        if (word_db.get_word_occurences(word_count.key) <= word_count.value)
-            unordered_erase(matches, word_count.key);
+        if (m.candidate() == prefix)
+            continue;
+        // skip words that are being edited
+        if (auto it = sel_word_counts.find(m.candidate());
+            it != sel_word_counts.end() and
+            word_db.get_word_occurences(m.candidate()) <= it->value)
+            continue;
+        best.push({ m, &buffer });
     }
 
     if (other_buffers)
@@ -134,36 +140,42 @@ InsertCompletion complete_word(const SelectionList& sels,
         {
             if (buf.get() == &buffer or buf->flags() & Buffer::Flags::Debug)
                 continue;
+            ConstArrayView<Codepoint> buf_word_chars = buf->options()["extra_word_chars"].get<Vector<Codepoint, MemoryDomain::Options>>();
+            // when both buffers agree on what characters make a word, the
+            // other word db only contains valid candidates already
+            const bool same_word_chars = buf_word_chars.size() == extra_word_chars.size() and
+                std::equal(buf_word_chars.begin(), buf_word_chars.end(), extra_word_chars.begin());
             for (auto& m : get_word_db(*buf).find_matching(prefix) |
                            // filter out words that are not considered words for the current buffer
                            filter([&](auto& rm) {
                                auto&& c = rm.candidate();
-                               return std::all_of(utf8::iterator{c.begin(), c},
+                               return same_word_chars or
+                                      std::all_of(utf8::iterator{c.begin(), c},
                                                   utf8::iterator{c.end(), c},
                                                   is_word_pred); }))
-                matches.push_back({ m, buf.get() });
+            {
+                if (m.candidate() != prefix)
+                    best.push({ m, buf.get() });
+            }
         }
     }
 
     using StaticWords = Vector<String, MemoryDomain::Options>;
     for (auto& word : options["static_words"].get<StaticWords>())
-        if (RankedMatch match{word, prefix})
-            matches.emplace_back(match, nullptr);
+        if (RankedMatch match{word, prefix}; match and match.candidate() != prefix)
+            best.push({ match, nullptr });
 
-    unordered_erase(matches, prefix);
+    auto matches = std::move(best).sorted();
     const auto longest = accumulate(matches, 0_char,
                                     [](const CharCount& lhs, const RankedMatchAndBuffer& rhs)
                                     { return std::max(lhs, rhs.candidate().char_length()); });
 
-    constexpr size_t max_count = 100;
-    // Gather best max_count matches
     InsertCompletion::CandidateList candidates;
-    candidates.reserve(std::min(matches.size(), max_count));
-
-    for_n_best(matches, max_count, [](auto& lhs, auto& rhs) { return rhs < lhs; },
-               [&](RankedMatchAndBuffer& m) {
+    candidates.reserve(matches.size());
+    for (auto& m : matches)
+    {
         if (not candidates.empty() and candidates.back().completion == m.candidate())
-            return false;
+            continue;
         DisplayLine menu_entry;
         if (other_buffers && m.buffer)
         {
@@ -176,8 +188,7 @@ InsertCompletion complete_word(const SelectionList& sels,
             menu_entry.push_back({ m.candidate().str(), {} });
 
         candidates.push_back({m.candidate().str(), "", std::move(menu_entry)});
-        return true;
-    });
+    }
 
     return { std::move(candidates), word_begin, cursor_pos, buffer.timestamp() };
 }
@@ -292,39 +303,34 @@ InsertCompletion complete_option(const SelectionList& sels,
                 using RankedMatch::operator<;
 
                 StringView on_select;
-                DisplayLine menu_entry;
+                StringView menu;
             };
 
-            Vector<RankedMatchAndInfo> matches;
+            constexpr size_t max_count = 100;
+            // Gather best max_count matches as they are generated
+            NBestMatches<RankedMatchAndInfo> best{max_count};
 
             for (auto& candidate : opt.list)
             {
                 if (RankedMatchAndInfo match{std::get<0>(candidate), query})
                 {
                     match.on_select = std::get<1>(candidate);
-                    auto& menu = std::get<2>(candidate);
-                    match.menu_entry = not menu.empty() ?
-                        parse_display_line(expand_tabs(menu, tabstop, column), faces)
-                      : DisplayLine{ expand_tabs(menu, tabstop, column), {} };
-
-                    matches.push_back(std::move(match));
+                    match.menu = std::get<2>(candidate);
+                    best.push(std::move(match));
                 }
             }
 
-            constexpr size_t max_count = 100;
-            // Gather best max_count matches
-            auto greater = [](auto& lhs, auto& rhs) { return rhs < lhs; };
-            auto first = matches.begin(), last = matches.end();
-            std::make_heap(first, last, greater);
             InsertCompletion::CandidateList candidates;
-            candidates.reserve(std::min(matches.size(), max_count));
-            candidates.reserve(matches.size());
-            while (candidates.size() < max_count and first != last)
+            for (auto& m : std::move(best).sorted())
             {
-                if (candidates.empty() or candidates.back().completion != first->candidate())
-                    candidates.push_back({ first->candidate().str(), first->on_select.str(),
-                                           std::move(first->menu_entry) });
-                std::pop_heap(first, last--, greater);
+                if (not candidates.empty() and candidates.back().completion == m.candidate())
+                    continue;
+                // only the displayed candidates need their menu entry parsed
+                auto menu_entry = not m.menu.empty() ?
+                    parse_display_line(expand_tabs(m.menu, tabstop, column), faces)
+                  : DisplayLine{ expand_tabs(m.menu, tabstop, column), {} };
+                candidates.push_back({ m.candidate().str(), m.on_select.str(),
+                                       std::move(menu_entry) });
             }
 
             return { std::move(candidates), coord, end, timestamp };
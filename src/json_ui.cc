@@ -23,36 +23,55 @@ struct invalid_rpc_request : runtime_error {
         : runtime_error(format("invalid json rpc request ({})", message)) {}
 };
 
+// Serialization appends into a single output buffer whose capacity is
+// retained across calls; draw payloads for a full window fit without
+// reallocating after the first frame, and string escaping copies clean
+// runs in bulk.
 template<typename T>
-String to_json(ArrayView<const T> array)
+void to_json(String& out, ArrayView<const T> array)
 {
-    return "[" + join(array | transform([](auto&& elem) { return to_json(elem); }), ", ") + "]";
+    out += '[';
+    bool first = true;
+    for (auto&& elem : array)
+    {
+        if (not first)
+            out += ", ";
+        first = false;
+        to_json(out, elem);
+    }
+    out += ']';
 }
 
 template<typename T, MemoryDomain D>
-String to_json(const Vector<T, D>& vec) { return to_json(ArrayView<const T>{vec}); }
+void to_json(String& out, const Vector<T, D>& vec) { to_json(out, ArrayView<const T>{vec}); }
 
 template<typename K, typename V, MemoryDomain D>
-String to_json(const HashMap<K, V, D>& map)
+void to_json(String& out, const HashMap<K, V, D>& map)
 {
-    return "{" + join(map | transform([](auto&& i) { return format("{}: {}", to_json(i.key), to_json(i.value)); }),
-                      ',', false) + "}";
+    out += '{';
+    bool first = true;
+    for (auto&& item : map)
+    {
+        if (not first)
+            out += ',';
+        first = false;
+        to_json(out, item.key);
+        out += ": ";
+        to_json(out, item.value);
+    }
+    out += '}';
 }
 
-String to_json(int i) { return to_string(i); }
-String to_json(bool b) { return b ? "true" : "false"; }
-String to_json(StringView str)
+void to_json(String& out, int i) { out += to_string(i); }
+void to_json(String& out, bool b) { out += b ? "true" : "false"; }
+void to_json(String& out, StringView str)
 {
-    String res;
-    res.reserve(str.length() + 4);
-    res += '"';
+    out += '"';
     for (auto it = str.begin(), end = str.end(); it != end; )
     {
-        auto next = std::find_if(it, end, [](char c) {
-            return c == '\\' or c == '"' or (c >= 0 and c <= 0x1F);
-        });
+        auto next = find_first_of_bytes(it, end, R"(\")", 0x20);
 
-        res += StringView{it, next};
+        out += StringView{it, next};
         if (next == end)
             break;
 
@@ -60,25 +79,25 @@ String to_json(StringView str)
         if (*next >= 0 and *next <= 0x1F)
             sprintf(buf, "\\u%04x", *next);
 
-        res += buf;
+        out += buf;
         it = next+1;
     }
-    res += '"';
-    return res;
+    out += '"';
 }
 
-String to_json(Color color)
+void to_json(String& out, Color color)
 {
     if (color.color == Kakoune::Color::RGB)
     {
         char buffer[10];
         sprintf(buffer, R"("#%02x%02x%02x")", color.r, color.g, color.b);
-        return buffer;
+        out += buffer;
     }
-    return to_json(to_string(color));
+    else
+        to_json(out, StringView{to_string(color)});
 }
 
-String to_json(Attribute attributes)
+void to_json(String& out, Attribute attributes)
 {
     struct Attr { Attribute attr; StringView name; }
     attrs[] {
@@ -93,86 +112,99 @@ String to_json(Attribute attributes)
         { Attribute::FinalAttr, "final_attr" },
     };
 
-    return "[" + join(attrs |
-                      filter([=](const Attr& a) { return attributes & a.attr; }) |
-                      transform([](const Attr& a) { return to_json(a.name); }),
-                      ',', false) + "]";
+    out += '[';
+    bool first = true;
+    for (auto& attr : attrs)
+    {
+        if (not (attributes & attr.attr))
+            continue;
+        if (not first)
+            out += ',';
+        first = false;
+        to_json(out, attr.name);
+    }
+    out += ']';
 }
 
-String to_json(Face face)
+void to_json(String& out, Face face)
 {
-    return format(R"(\{ "fg": {}, "bg": {}, "attributes": {} })",
-                  to_json(face.fg), to_json(face.bg), to_json(face.attributes));
+    out += R"({ "fg": )";
+    to_json(out, face.fg);
+    out += R"(, "bg": )";
+    to_json(out, face.bg);
+    out += R"(, "attributes": )";
+    to_json(out, face.attributes);
+    out += " }";
 }
 
-String to_json(const DisplayAtom& atom)
+void to_json(String& out, const DisplayAtom& atom)
 {
-    return format(R"(\{ "face": {}, "contents": {} })", to_json(atom.face), to_json(atom.content()));
+    out += R"({ "face": )";
+    to_json(out, atom.face);
+    out += R"(, "contents": )";
+    to_json(out, atom.content());
+    out += " }";
 }
 
-String to_json(const DisplayLine& line)
+void to_json(String& out, const DisplayLine& line)
 {
-    return to_json(line.atoms());
+    to_json(out, line.atoms());
 }
 
-String to_json(DisplayCoord coord)
+void to_json(String& out, DisplayCoord coord)
 {
-    return format(R"(\{ "line": {}, "column": {} })", coord.line, coord.column);
+    out += format(R"(\{ "line": {}, "column": {} })", coord.line, coord.column);
 }
 
-String to_json(MenuStyle style)
+void to_json(String& out, MenuStyle style)
 {
     switch (style)
     {
-        case MenuStyle::Prompt: return R"("prompt")";
-        case MenuStyle::Search: return R"("search")";
-        case MenuStyle::Inline: return R"("inline")";
+        case MenuStyle::Prompt: out += R"("prompt")"; return;
+        case MenuStyle::Search: out += R"("search")"; return;
+        case MenuStyle::Inline: out += R"("inline")"; return;
     }
-    return "";
 }
 
-String to_json(InfoStyle style)
+void to_json(String& out, InfoStyle style)
 {
     switch (style)
     {
-        case InfoStyle::Prompt: return R"("prompt")";
-        case InfoStyle::Inline: return R"("inline")";
-        case InfoStyle::InlineAbove: return R"("inlineAbove")";
-        case InfoStyle::InlineBelow: return R"("inlineBelow")";
-        case InfoStyle::MenuDoc: return R"("menuDoc")";
-        case InfoStyle::Modal: return R"("modal")";
+        case InfoStyle::Prompt: out += R"("prompt")"; return;
+        case InfoStyle::Inline: out += R"("inline")"; return;
+        case InfoStyle::InlineAbove: out += R"("inlineAbove")"; return;
+        case InfoStyle::InlineBelow: out += R"("inlineBelow")"; return;
+        case InfoStyle::MenuDoc: out += R"("menuDoc")"; return;
+        case InfoStyle::Modal: out += R"("modal")"; return;
     }
-    return "";
 }
 
-String to_json(CursorMode mode)
+void to_json(String& out, CursorMode mode)
 {
     switch (mode)
     {
-        case CursorMode::Prompt: return R"("prompt")";
-        case CursorMode::Buffer: return R"("buffer")";
+        case CursorMode::Prompt: out += R"("prompt")"; return;
+        case CursorMode::Buffer: out += R"("buffer")"; return;
     }
-    return "";
-}
-
-String concat()
-{
-    return "";
-}
-
-template<typename First, typename... Args>
-String concat(First&& first, Args&&... args)
-{
-    if (sizeof...(Args) != 0)
-        return to_json(first) + ", " + concat(args...);
-    return to_json(first);
 }
 
 template<typename... Args>
 void rpc_call(StringView method, Args&&... args)
 {
-    auto q = format(R"(\{ "jsonrpc": "2.0", "method": "{}", "params": [{}] }{})",
-                    method, concat(std::forward<Args>(args)...), "\n");
+    static String q;
+    q.clear();
+    q += R"({ "jsonrpc": "2.0", "method": ")";
+    q += method;
+    q += R"(", "params": [)";
+    [[maybe_unused]] bool first = true;
+    [[maybe_unused]] auto write_arg = [&](auto&& arg) {
+        if (not first)
+            q += ", ";
+        first = false;
+        to_json(q, arg);
+    };
+    (write_arg(std::forward<Args>(args)), ...);
+    q += "] }\n";
 
     write(1, q);
 }
@@ -254,6 +286,11 @@ void JsonUI::set_on_key(OnKeyCallback callback)
     m_on_key = std::move(callback);
 }
 
+void JsonUI::set_on_paste(OnPasteCallback callback)
+{
+    m_on_paste = std::move(callback);
+}
+
 using JsonArray = Vector<Value>;
 using JsonObject = HashMap<String, Value>;
 
@@ -407,6 +444,15 @@ void JsonUI::eval_json(const Value& json)
                 m_on_key(key);
         }
     }
+    else if (method == "paste")
+    {
+        if (params.size() != 1)
+            throw invalid_rpc_request("paste needs the pasted content");
+        else if (not params[0].is_a<String>())
+            throw invalid_rpc_request("pasted content is not a string");
+
+        m_on_paste(params[0].as<String>());
+    }
     else if (method == "mouse")
     {
         if (params.size() != 3)
@@ -486,28 +532,33 @@ void JsonUI::parse_requests(EventMode mode)
     if (not m_on_key)
         return;
 
-    while (not m_requests.empty())
+    // consume complete requests by advancing a cursor, the unconsumed
+    // tail is copied out once at the end instead of after each request
+    const char* pos = m_requests.begin();
+    while (pos != m_requests.end())
     {
-        const char* pos = nullptr;
+        const char* next = nullptr;
         try
         {
-            auto [json, new_pos] = parse_json(m_requests);
-            pos = new_pos;
+            auto [json, new_pos] = parse_json(pos, m_requests.end());
+            next = new_pos;
             if (json)
                 eval_json(json);
         }
         catch (runtime_error& error)
         {
             write(2, format("error while handling requests '{}': '{}'\n",
-                            m_requests, error.what()));
+                            StringView{pos, m_requests.end()}, error.what()));
             // try to salvage request by dropping its first line
-            pos = std::min(m_requests.end(), find(m_requests, '\n')+1);
+            next = std::min<const char*>(m_requests.end(), find(StringView{pos, m_requests.end()}, '\n')+1);
         }
-        if (not pos)
+        if (not next)
             break; // unterminated request ?
 
-        m_requests = String{pos, m_requests.end()};
+        pos = next;
     }
+    if (pos != m_requests.begin())
+        m_requests = String{pos, m_requests.end()};
 }
 
 UnitTest test_json_parser{[]()
@@ -14,11 +14,17 @@ void KeymapManager::map_key(Key key, KeymapMode mode,
                             KeyList mapping, String docstring)
 {
     m_mapping[KeyAndMode{key, mode}] = {std::move(mapping), std::move(docstring)};
+    if (is_flat(key, mode))
+        m_flat_mapped[(int)mode][key.key / 64] |= uint64_t{1} << (key.key % 64);
+    ++m_version;
 }
 
 void KeymapManager::unmap_key(Key key, KeymapMode mode)
 {
     m_mapping.remove(KeyAndMode{key, mode});
+    if (is_flat(key, mode))
+        m_flat_mapped[(int)mode][key.key / 64] &= ~(uint64_t{1} << (key.key % 64));
+    ++m_version;
 }
 
 void KeymapManager::unmap_keys(KeymapMode mode)
@@ -34,30 +40,58 @@ void KeymapManager::unmap_keys(KeymapMode mode)
     }
 }
 
+void KeymapManager::update_merged() const
+{
+    const size_t version = tree_version();
+    if (m_merged_version == version)
+        return;
+
+    m_merged.clear();
+    for (auto& row : m_merged_flat)
+        row[0] = row[1] = 0;
+
+    // nearer scopes shadow their parents, so only record the first
+    // mapping found for a given key and mode
+    for (auto* manager = this; manager; manager = manager->m_parent)
+    {
+        for (auto& map : manager->m_mapping)
+        {
+            if (not m_merged.contains(map.key))
+                m_merged.insert({map.key, &map.value});
+        }
+        for (int mode = 0; mode < num_flat_modes; ++mode)
+        {
+            m_merged_flat[mode][0] |= manager->m_flat_mapped[mode][0];
+            m_merged_flat[mode][1] |= manager->m_flat_mapped[mode][1];
+        }
+    }
+    m_merged_version = version;
+}
+
 bool KeymapManager::is_mapped(Key key, KeymapMode mode) const
 {
-    return m_mapping.find(KeyAndMode{key, mode}) != m_mapping.end() or
-           (m_parent and m_parent->is_mapped(key, mode));
+    update_merged();
+    if (is_flat(key, mode))
+        return m_merged_flat[(int)mode][key.key / 64] & (uint64_t{1} << (key.key % 64));
+    return m_merged.contains(KeyAndMode{key, mode});
 }
 
 const KeymapManager::KeymapInfo&
 KeymapManager::get_mapping(Key key, KeymapMode mode) const
 {
-    auto it = m_mapping.find(KeyAndMode{key, mode});
-    if (it != m_mapping.end())
-        return it->value;
-    kak_assert(m_parent);
-    return m_parent->get_mapping(key, mode);
+    update_merged();
+    auto it = m_merged.find(KeyAndMode{key, mode});
+    kak_assert(it != m_merged.end());
+    return *it->value;
 }
 
 KeymapManager::KeyList KeymapManager::get_mapped_keys(KeymapMode mode) const
 {
+    update_merged();
     KeyList res;
-    if (m_parent)
-        res = m_parent->get_mapped_keys(mode);
-    for (auto& map : m_mapping)
+    for (auto& map : m_merged)
     {
-        if (map.key.second == mode and not contains(res, map.key.first))
+        if (map.key.second == mode)
             res.emplace_back(map.key.first);
     }
     return res;
@@ -59,10 +59,39 @@ private:
     // the only one allowed to construct a root map manager
     friend class Scope;
 
+    static constexpr Codepoint max_flat_key = 128;
+    static constexpr int num_flat_modes = (int)KeymapMode::FirstUserMode;
+
+    static bool is_flat(Key key, KeymapMode mode)
+    {
+        return key.modifiers == Key::Modifiers::None and
+               key.key < max_flat_key and mode < KeymapMode::FirstUserMode;
+    }
+
+    size_t tree_version() const
+    {
+        return m_parent ? m_version + m_parent->tree_version() : m_version;
+    }
+    void update_merged() const;
+
     KeymapManager* m_parent;
     using KeyAndMode = std::pair<Key, KeymapMode>;
     HashMap<KeyAndMode, KeymapInfo, MemoryDomain::Mapping> m_mapping;
 
+    // presence bitmaps for unmodified basic plane keys, they make the
+    // common "key is not mapped" answer of the per keystroke dispatch a
+    // few bit tests instead of hash lookups
+    uint64_t m_flat_mapped[num_flat_modes][2] = {};
+
+    size_t m_version = 0;
+
+    // mappings visible from this scope merged into one flat structure,
+    // invalidated whenever a mapping changes in this manager or one of
+    // its parents so that the per keystroke path never walks the chain
+    mutable HashMap<KeyAndMode, const KeymapInfo*, MemoryDomain::Mapping> m_merged;
+    mutable uint64_t m_merged_flat[num_flat_modes][2] = {};
+    mutable size_t m_merged_version = -1;
+
     UserModeList m_user_modes;
 };
 
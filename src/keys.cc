@@ -80,9 +80,59 @@ static constexpr KeyAndName keynamemap[] = {
     { "minus", '-' },
 };
 
+// Compile time built index over keynamemap: open addressed slots of
+// entry indices, so parsing a key name probes a couple of entries
+// instead of comparing against the whole table.
+struct KeyNameIndex
+{
+    static constexpr size_t slot_count = 64;
+
+    static constexpr size_t hash(const char* data, size_t len)
+    {
+        size_t h = 0;
+        for (size_t i = 0; i < len; ++i)
+            h = h * 33 + (unsigned char)data[i];
+        return h % slot_count;
+    }
+
+    constexpr KeyNameIndex() : slots{}
+    {
+        for (auto& slot : slots)
+            slot = -1;
+        for (int i = 0; i < (int)(sizeof(keynamemap) / sizeof(keynamemap[0])); ++i)
+        {
+            size_t len = 0;
+            while (keynamemap[i].name[len] != 0)
+                ++len;
+            auto slot = hash(keynamemap[i].name, len);
+            while (slots[slot] != -1)
+                slot = (slot + 1) % slot_count;
+            slots[slot] = i;
+        }
+    }
+
+    int8_t slots[slot_count];
+};
+
+static constexpr KeyNameIndex keyname_index{};
+
+static const KeyAndName* find_key_name(StringView desc)
+{
+    for (auto slot = KeyNameIndex::hash(desc.data(), (size_t)(int)desc.length());
+         keyname_index.slots[slot] != -1;
+         slot = (slot + 1) % KeyNameIndex::slot_count)
+    {
+        auto& candidate = keynamemap[keyname_index.slots[slot]];
+        if (candidate.name == desc)
+            return &candidate;
+    }
+    return nullptr;
+}
+
 KeyList parse_keys(StringView str)
 {
     KeyList result;
+    result.reserve((size_t)(int)str.char_length()); // upper bound, <...> descriptors yield one key
     using Utf8It = utf8::iterator<const char*>;
     for (Utf8It it{str.begin(), str}, str_end{str.end(), str}; it < str_end; ++it)
     {
@@ -121,9 +171,7 @@ KeyList parse_keys(StringView str)
             desc = StringView{dash+1, desc.end()};
         }
 
-        auto name_it = find_if(keynamemap, [&desc](const KeyAndName& item)
-                                           { return item.name == desc; });
-        if (name_it != std::end(keynamemap))
+        if (auto* name_it = find_key_name(desc))
             result.push_back(canonicalize_ifn({ modifier, name_it->key }));
         else if (desc.char_length() == 1)
             result.push_back(canonicalize_ifn({ modifier, desc[0_char] }));
@@ -166,29 +214,36 @@ String key_to_str(Key key)
         default: break;
     }
 
-    bool named = false;
-    String res;
+    // settle on the key name first so the result is assembled in a single
+    // pass, prepending modifiers through temporaries reallocates per prefix
+    char buffer[8];
+    StringView name;
+    bool named = true;
     auto it = find_if(keynamemap, [&key](const KeyAndName& item)
                                   { return item.key == key.key; });
     if (it != std::end(keynamemap))
-    {
-        named = true;
-        res = it->name;
-    }
+        name = it->name;
     else if (key.key >= Key::F1 and key.key <= Key::F12)
+        name = format_to(buffer, "F{}", (int)(key.key - Key::F1 + 1));
+    else
     {
-        named = true;
-        res = "F" + to_string((int)(key.key - Key::F1 + 1));
+        char* out = buffer;
+        utf8::dump(out, key.key);
+        name = {buffer, out};
+        named = (bool)(key.modifiers & (Key::Modifiers::Shift | Key::Modifiers::Alt |
+                                        Key::Modifiers::Control));
     }
-    else
-        res = String{key.key};
-
-    if (key.modifiers & Key::Modifiers::Shift)   { res = "s-" + res; named = true; }
-    if (key.modifiers & Key::Modifiers::Alt)     { res = "a-" + res; named = true; }
-    if (key.modifiers & Key::Modifiers::Control) { res = "c-" + res; named = true; }
 
+    String res;
+    res.reserve(name.length() + (named ? 8 : 0));
+    if (named)
+        res += "<";
+    if (key.modifiers & Key::Modifiers::Control) res += "c-";
+    if (key.modifiers & Key::Modifiers::Alt)     res += "a-";
+    if (key.modifiers & Key::Modifiers::Shift)   res += "s-";
+    res += name;
     if (named)
-        res = StringView{'<'} + res + StringView{'>'};
+        res += ">";
     return res;
 }
 
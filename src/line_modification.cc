@@ -22,69 +22,180 @@ static LineModification make_line_modif(const Buffer::Change& change)
     return { change.begin.line, change.begin.line, num_removed, num_added };
 }
 
+// Tree of line modifications ordered by new_line, balanced with random
+// priorities (a treap). Shifts of new_line are propagated lazily so that
+// moving every modification situated after a change costs O(log n)
+// instead of renumbering the whole tail, which made merging long
+// descending change sequences (undo of many selections edits) quadratic.
+struct LineModificationTree
+{
+    static constexpr int none = -1;
+
+    struct Node
+    {
+        LineModification modif;
+        LineCount shift; // pending new_line shift for this node and its subtree
+        uint32_t priority;
+        int left;
+        int right;
+    };
+
+    Vector<Node> nodes;
+    int root = none;
+    uint32_t random_state = 0x12345678;
+
+    int new_node(const LineModification& modif)
+    {
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        nodes.push_back({modif, 0_line, random_state, none, none});
+        return (int)nodes.size() - 1;
+    }
+
+    void apply_shift(int index, LineCount shift)
+    {
+        if (index != none)
+            nodes[index].shift += shift;
+    }
+
+    void push_down(int index)
+    {
+        Node& node = nodes[index];
+        if (node.shift == 0)
+            return;
+        node.modif.new_line += node.shift;
+        apply_shift(node.left, node.shift);
+        apply_shift(node.right, node.shift);
+        node.shift = 0;
+    }
+
+    // split into the nodes with new_line <= line and those with new_line > line
+    void split(int index, LineCount line, int& left, int& right)
+    {
+        if (index == none)
+        {
+            left = right = none;
+            return;
+        }
+        push_down(index);
+        if (nodes[index].modif.new_line <= line)
+        {
+            left = index;
+            split(nodes[index].right, line, nodes[index].right, right);
+        }
+        else
+        {
+            right = index;
+            split(nodes[index].left, line, left, nodes[index].left);
+        }
+    }
+
+    int merge(int left, int right)
+    {
+        if (left == none)
+            return right;
+        if (right == none)
+            return left;
+        if (nodes[left].priority > nodes[right].priority)
+        {
+            push_down(left);
+            nodes[left].right = merge(nodes[left].right, right);
+            return left;
+        }
+        push_down(right);
+        nodes[right].left = merge(left, nodes[right].left);
+        return right;
+    }
+
+    // index of the node with the greatest new_line, which gets materialized
+    int rightmost(int index)
+    {
+        push_down(index);
+        while (nodes[index].right != none)
+        {
+            index = nodes[index].right;
+            push_down(index);
+        }
+        return index;
+    }
+
+    template<typename Func>
+    void for_each(int index, Func func)
+    {
+        if (index == none)
+            return;
+        push_down(index);
+        for_each(nodes[index].left, func);
+        func(nodes[index].modif);
+        for_each(nodes[index].right, func);
+    }
+};
+
 Vector<LineModification> compute_line_modifications(const Buffer& buffer, size_t timestamp)
 {
-    Vector<LineModification> res;
+    LineModificationTree tree;
+    constexpr int none = LineModificationTree::none;
     for (auto& buf_change : buffer.changes_since(timestamp))
     {
         auto change = make_line_modif(buf_change);
 
-        auto pos = std::upper_bound(res.begin(), res.end(), change.new_line,
-                                    [](const LineCount& l, const LineModification& c)
-                                    { return l < c.new_line; });
+        int left = none, right = none;
+        tree.split(tree.root, change.new_line, left, right);
 
-        if (pos != res.begin())
+        int pos = none;
+        if (left != none)
         {
-            auto& prev = *(pos-1);
-            if (change.new_line <= prev.new_line + prev.num_added)
+            const int prev = tree.rightmost(left);
+            const auto prev_modif = tree.nodes[prev].modif;
+            if (change.new_line <= prev_modif.new_line + prev_modif.num_added)
             {
-                --pos;
                 const LineCount removed_from_previously_added_by_pos =
-                    clamp(pos->new_line + pos->num_added - change.new_line,
-                          0_line, std::min(pos->num_added, change.num_removed));
+                    clamp(prev_modif.new_line + prev_modif.num_added - change.new_line,
+                          0_line, std::min(prev_modif.num_added, change.num_removed));
 
-                pos->num_removed += change.num_removed - removed_from_previously_added_by_pos;
-                pos->num_added += change.num_added - removed_from_previously_added_by_pos;
+                tree.nodes[prev].modif.num_removed += change.num_removed - removed_from_previously_added_by_pos;
+                tree.nodes[prev].modif.num_added += change.num_added - removed_from_previously_added_by_pos;
+                pos = prev;
             }
             else
             {
-                change.old_line -= prev.diff();
-                pos = res.insert(pos, change);
+                change.old_line -= prev_modif.diff();
+                pos = tree.new_node(change);
+                left = tree.merge(left, pos);
             }
         }
         else
-            pos = res.insert(pos, change);
+            left = pos = tree.new_node(change);
 
-        auto next = pos + 1;
         auto diff = buf_change.end.line - buf_change.begin.line;
         if (buf_change.type == Buffer::Change::Erase)
         {
-            auto delend = std::upper_bound(next, res.end(), change.new_line + change.num_removed,
-                                           [](const LineCount& l, const LineModification& c)
-                                           { return l < c.new_line; });
+            int removed = none, tail = none;
+            tree.split(right, change.new_line + change.num_removed, removed, tail);
 
-            for (auto it = next; it != delend; ++it)
-            {
+            auto& pos_modif = tree.nodes[pos].modif;
+            tree.for_each(removed, [&](const LineModification& m) {
                 const LineCount removed_from_previously_added_by_it =
-                    std::min(it->num_added, change.new_line + change.num_removed - it->new_line);
+                    std::min(m.num_added, change.new_line + change.num_removed - m.new_line);
 
-                pos->num_removed += it->num_removed - removed_from_previously_added_by_it;
-                pos->num_added += it->num_added - removed_from_previously_added_by_it;
-            }
-            next = res.erase(next, delend);
+                pos_modif.num_removed += m.num_removed - removed_from_previously_added_by_it;
+                pos_modif.num_added += m.num_added - removed_from_previously_added_by_it;
+            });
 
-            if (diff != 0)
-            {
-                for (auto it = next; it != res.end(); ++it)
-                    it->new_line -= diff;
-            }
+            tree.apply_shift(tail, -diff);
+            tree.root = tree.merge(left, tail);
         }
-        else if (diff != 0)
+        else
         {
-            for (auto it = next; it != res.end(); ++it)
-                it->new_line += diff;
+            tree.apply_shift(right, diff);
+            tree.root = tree.merge(left, right);
         }
     }
+
+    Vector<LineModification> res;
+    res.reserve(tree.nodes.size());
+    tree.for_each(tree.root, [&](const LineModification& m) { res.push_back(m); });
     return res;
 }
 
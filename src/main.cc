@@ -1,8 +1,10 @@
 #include "assert.hh"
 #include "backtrace.hh"
+#include "benchmarks.hh"
 #include "buffer.hh"
 #include "buffer_manager.hh"
 #include "buffer_utils.hh"
+#include "cancel.hh"
 #include "client_manager.hh"
 #include "command_manager.hh"
 #include "commands.hh"
@@ -10,6 +12,7 @@
 #include "event_manager.hh"
 #include "face_registry.hh"
 #include "file.hh"
+#include "file_change_watcher.hh"
 #include "highlighters.hh"
 #include "insert_completer.hh"
 #include "json_ui.hh"
@@ -24,14 +27,18 @@
 #include "shared_string.hh"
 #include "shell_manager.hh"
 #include "string.hh"
+#include "thread_pool.hh"
 #include "unit_tests.hh"
 #include "window.hh"
 #include "clock.hh"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <locale.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <pwd.h>
 
@@ -175,10 +182,18 @@ static const EnvVarDesc builtin_env_vars[] = { {
         "version", false,
         [](StringView name, const Context& context, Quoting quoting) -> String
         { return version; }
+    }, {
+        "regex_steps", false,
+        [](StringView name, const Context& context, Quoting quoting) -> String
+        { return to_string(regex_executed_instructions); }
+    }, {
+        "regex_threads", false,
+        [](StringView name, const Context& context, Quoting quoting) -> String
+        { return to_string(regex_spawned_threads); }
     }, {
         "opt_", true,
         [](StringView name, const Context& context, Quoting quoting)
-        { return context.options()[name.substr(4_byte)].get_as_string(quoting); }
+        { return context.options()[name.substr(4_byte)].get_as_string(quoting).str(); }
     }, {
         "main_reg_", true,
         [](StringView name, const Context& context, Quoting quoting)
@@ -204,6 +219,12 @@ static const EnvVarDesc builtin_env_vars[] = { {
         "client_pid", false,
         [](StringView name, const Context& context, Quoting quoting) -> String
         { return to_string(context.client().pid()); }
+    }, {
+        "frame_time_ms", false,
+        [](StringView name, const Context& context, Quoting quoting) -> String
+        { const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+              context.client().last_frame_duration()).count();
+          return format("{}.{}", (size_t)us / 1000, ((size_t)us / 100) % 10); }
     }, {
         "client_list", false,
         [](StringView name, const Context& context, Quoting quoting) -> String
@@ -290,17 +311,25 @@ void register_registers()
 
     using StringList = Vector<String, MemoryDomain::Registers>;
 
-    register_manager.add_register('%', make_dyn_reg(
+    register_manager.add_register('%', make_dyn_reg_with_main(
         [](const Context& context)
-        { return StringList{{context.buffer().display_name()}}; }));
+        { return StringList{{context.buffer().display_name()}}; },
+        [](const Context& context, size_t)
+        { return context.buffer().display_name(); }));
 
-    register_manager.add_register('.', make_dyn_reg(
+    register_manager.add_register('.', make_dyn_reg_with_main(
         [](const Context& context) {
-            auto content = context.selections_content();
-            return StringList{content.begin(), content.end()};
-         }));
-
-    register_manager.add_register('#', make_dyn_reg(
+            auto& buffer = context.buffer();
+            StringList contents;
+            contents.reserve(context.selections().size());
+            for (auto& sel : context.selections())
+                contents.push_back(buffer.string(sel.min(), buffer.char_next(sel.max())));
+            return contents;
+         },
+        [](const Context& context, size_t main_index)
+        { return content(context.buffer(), context.selections()[main_index]); }));
+
+    register_manager.add_register('#', make_dyn_reg_with_main(
         [](const Context& context) {
             const size_t count = context.selections().size();
             StringList res;
@@ -308,11 +337,13 @@ void register_registers()
             for (size_t i = 1; i < count+1; ++i)
                 res.push_back(to_string((int)i));
             return res;
-        }));
+        },
+        [](const Context&, size_t main_index)
+        { return to_string((int)main_index + 1); }));
 
     for (size_t i = 0; i < 10; ++i)
     {
-        register_manager.add_register('0'+i, make_dyn_reg(
+        register_manager.add_register('0'+i, make_dyn_reg_with_main(
             [i](const Context& context) {
                 StringList result;
                 for (auto& sel : context.selections())
@@ -331,6 +362,10 @@ void register_registers()
                         sel.captures().resize(i+1);
                     sel.captures()[i] = values[std::min(sel_index, values.size()-1)];
                 }
+            },
+            [i](const Context& context, size_t main_index) {
+                auto& sel = context.selections()[main_index];
+                return i < sel.captures().size() ? sel.captures()[i] : String{};
             }));
     }
 
@@ -359,6 +394,12 @@ static void check_timeout(const int& timeout)
         throw runtime_error{"the minimum acceptable timeout is 50 milliseconds"};
 }
 
+static void check_max_jumps(const int& max_jumps)
+{
+    if (max_jumps < 1)
+        throw runtime_error{"max_jumps should be strictly positive"};
+}
+
 static void check_extra_word_chars(const Vector<Codepoint, MemoryDomain::Options>& extra_chars)
 {
     if (any_of(extra_chars, is_blank))
@@ -424,6 +465,15 @@ void register_options()
     reg.declare_option<int, check_timeout>(
         "fs_check_timeout", "timeout, in milliseconds, between file system buffer modification checks",
         500);
+    reg.declare_option<int>(
+        "redraw_interval", "minimum time, in milliseconds, between two redraws of a client, "
+        "coalescing redraw triggers in between; 0 means redraw as soon as needed", 0);
+    reg.declare_option<int, check_max_jumps>(
+        "max_jumps", "maximum number of jumps kept in the jump list", 100);
+    reg.declare_option<int>(
+        "history_size_limit", "memory budget, in bytes, for a buffer undo history; "
+        "when exceeded the oldest undo groups are merged away at the next commit, "
+        "0 means unlimited", 100 * 1024 * 1024);
     reg.declare_option("ui_options",
                        "space separated list of <key>=<value> options that are "
                        "passed to and interpreted by the user interface\n"
@@ -498,6 +548,7 @@ std::unique_ptr<UserInterface> make_ui(UIType ui_type)
         void set_cursor(CursorMode, DisplayCoord) override {}
         void refresh(bool) override {}
         void set_on_key(OnKeyCallback) override {}
+        void set_on_paste(OnPasteCallback) override {}
         void set_ui_options(const Options&) override {}
     };
 
@@ -601,7 +652,7 @@ int run_client(StringView session, StringView name, StringView client_init,
     try
     {
         EventManager event_manager;
-        RemoteClient client{session, name, make_ui(ui_type), getpid(), get_env_vars(),
+        RemoteClient client{session, name, make_ui(ui_type), getpid(), env_vars_snapshot(),
                             client_init, std::move(init_coord)};
         if (suspend)
             raise(SIGTSTP);
@@ -657,8 +708,22 @@ int run_server(StringView session, StringView server_init,
         set_signal_handler(SIGTERM, [](int) { terminate = true; });
     }
 
+    // with -debug profile, time each startup phase so that regressions
+    // can be pinned down instead of "startup feels slower"
+    struct StartupPhase { StringView name; Clock::duration duration; };
+    Vector<StartupPhase> startup_profile;
+    bool profile_startup = (bool)(debug_flags & DebugFlags::Profile);
+    auto phase_start = Clock::now();
+    auto record_phase = [&](StringView name) {
+        const auto now = Clock::now();
+        if (profile_startup)
+            startup_profile.push_back({name, now - phase_start});
+        phase_start = now;
+    };
+
     EventManager        event_manager;
     Server              server{session.empty() ? to_string(getpid()) : session.str()};
+    FileChangeWatcher   file_change_watcher;
 
     StringRegistry      string_registry;
     GlobalScope         global_scope;
@@ -669,6 +734,7 @@ int run_server(StringView session, StringView server_init,
     DefinedHighlighters defined_highlighters;
     ClientManager       client_manager;
     BufferManager       buffer_manager;
+    ThreadPool          thread_pool;
 
     register_options();
     register_registers();
@@ -679,15 +745,15 @@ int run_server(StringView session, StringView server_init,
 
     write_to_debug_buffer("*** This is the debug buffer, where debug info will be written ***");
 
-    const auto start_time = Clock::now();
-    UnitTest::run_all_tests();
+    record_phase("session setup");
 
-    if (debug_flags & DebugFlags::Profile)
-    {
-        using namespace std::chrono;
-        write_to_debug_buffer(format("running the unit tests took {} ms",
-                                     duration_cast<milliseconds>(Clock::now() - start_time).count()));
-    }
+    // unit test asserts are compiled out in release builds, where running
+    // them would only burn startup time; debug builds still run them on
+    // every server start
+#ifdef KAK_DEBUG
+    UnitTest::run_all_tests();
+    record_phase("unit tests");
+#endif
 
     GlobalScope::instance().options().get_local_option("readonly").set<bool>(flags & ServerFlags::ReadOnly);
 
@@ -704,6 +770,7 @@ int run_server(StringView session, StringView server_init,
         write_to_debug_buffer(format("error while parsing kakrc:\n"
                                      "    {}", error.what()));
     }
+    record_phase("sourcing kakrc");
 
     if (not server_init.empty()) try
     {
@@ -716,11 +783,13 @@ int run_server(StringView session, StringView server_init,
         write_to_debug_buffer(format("error while running server init commands:\n"
                                      "    {}", error.what()));
     }
+    record_phase("server init commands");
 
     {
         Context empty_context{Context::EmptyContextFlag{}};
         global_scope.hooks().run_hook(Hook::KakBegin, session, empty_context);
     }
+    record_phase("KakBegin hooks");
 
     if (not files.empty()) try
     {
@@ -746,14 +815,16 @@ int run_server(StringView session, StringView server_init,
     {
          write_to_debug_buffer(format("error while opening command line files: {}", error.what()));
     }
+    record_phase("opening command line files");
 
     try
     {
         if (not (flags & ServerFlags::Daemon))
         {
             local_client = client_manager.create_client(
-                 create_local_ui(ui_type), getpid(), {}, get_env_vars(), client_init, std::move(init_coord),
+                 create_local_ui(ui_type), getpid(), {}, env_vars_snapshot(), client_init, std::move(init_coord),
                  [](int status) { local_client_exit = status; });
+            record_phase("local client setup");
 
             if (startup_error and local_client)
                 local_client->print_status({
@@ -769,8 +840,34 @@ int run_server(StringView session, StringView server_init,
                (not client_manager.empty() or server.negotiating() or
                 (flags & ServerFlags::Daemon)))
         {
+            // cancellation requests not consumed by a long operation are
+            // stale once we get back here
+            clear_cancel();
+
             client_manager.redraw_clients();
 
+            if (profile_startup)
+            {
+                record_phase("first draw");
+                profile_startup = false;
+                std::sort(startup_profile.begin(), startup_profile.end(),
+                          [](const StartupPhase& lhs, const StartupPhase& rhs)
+                          { return lhs.duration > rhs.duration; });
+
+                using namespace std::chrono;
+                Clock::duration total{};
+                String report = "startup profile (sorted by duration):";
+                for (auto& phase : startup_profile)
+                {
+                    report += format("\n    {}: {} us", phase.name,
+                                     (size_t)duration_cast<microseconds>(phase.duration).count());
+                    total += phase.duration;
+                }
+                report += format("\n    total: {} us",
+                                 (size_t)duration_cast<microseconds>(total).count());
+                write_to_debug_buffer(report);
+            }
+
             // Loop so that eventual inputs happening during the processing are handled as
             // well, avoiding unneeded redraws.
             bool allow_blocking = not client_manager.has_pending_inputs();
@@ -814,6 +911,34 @@ int run_server(StringView session, StringView server_init,
                     throw convert_to_client_mode{ std::move(session), std::move(client_name), std::move(buffer_name), std::move(selections) };
                 }
             }
+
+            if (auto session_name = server.take_pending_fork_session())
+            {
+                if (pid_t pid = fork())
+                    write_to_debug_buffer(pid == -1 ?
+                        format("unable to fork session '{}': {}", *session_name, strerror(errno)) :
+                        format("forked session '{}' (pid {})", *session_name, pid));
+                else
+                {
+                    // child: drop the clients and connections inherited
+                    // from the template server, the warm state (parsed
+                    // kakrc, compiled regexes and highlighters) is kept
+                    try
+                    {
+                        local_client = nullptr;
+                        client_manager.clear(false);
+                        server.reset_session(std::move(*session_name));
+                    }
+                    catch (runtime_error& error)
+                    {
+                        write_stderr(format("unable to setup forked session: {}\n", error.what()));
+                        exit(-1);
+                    }
+                    // run as a daemon, waiting for clients to connect
+                    flags |= ServerFlags::Daemon;
+                    set_signal_handler(SIGTERM, [](int) { terminate = true; });
+                }
+            }
         }
     }
     catch (const kill_session& kill)
@@ -829,7 +954,24 @@ int run_server(StringView session, StringView server_init,
     return local_client_exit;
 }
 
-int run_filter(StringView keystr, ConstArrayView<StringView> files, bool quiet, StringView suffix_backup)
+int run_benchmarks()
+{
+    StringRegistry  string_registry;
+    GlobalScope     global_scope;
+    EventManager    event_manager;
+    ShellManager    shell_manager{builtin_env_vars};
+    CommandManager  command_manager;
+    RegisterManager register_manager;
+    BufferManager   buffer_manager;
+
+    register_options();
+    register_registers();
+
+    Benchmark::run_all_benchmarks();
+    return 0;
+}
+
+int run_filter(StringView keystr, ConstArrayView<StringView> files, bool quiet, StringView suffix_backup, size_t workers)
 {
     StringRegistry  string_registry;
     GlobalScope     global_scope;
@@ -841,6 +983,7 @@ int run_filter(StringView keystr, ConstArrayView<StringView> files, bool quiet,
     register_options();
     register_registers();
 
+    int exit_status = 0;
     try
     {
         auto keys = parse_keys(keystr);
@@ -865,9 +1008,12 @@ int run_filter(StringView keystr, ConstArrayView<StringView> files, bool quiet,
             }
         };
 
-        for (auto& file : files)
+        auto filter_file = [&](StringView file)
         {
             Buffer* buffer = open_file_buffer(file, Buffer::Flags::NoHooks);
+            // no event loop runs here, so progressive loads of large files
+            // must be finished before the keys apply
+            while (buffer->extend_load((size_t)-1)) {}
             if (not suffix_backup.empty())
                 write_buffer_to_file(*buffer, buffer->name() + suffix_backup,
                                      WriteMethod::Overwrite, WriteFlags::None);
@@ -875,6 +1021,39 @@ int run_filter(StringView keystr, ConstArrayView<StringView> files, bool quiet,
             write_buffer_to_file(*buffer, buffer->name(),
                                  WriteMethod::Overwrite, WriteFlags::None);
             buffer_manager.delete_buffer(*buffer);
+            // keep memory use flat when filtering many files
+            buffer_manager.clear_buffer_trash();
+        };
+
+        workers = std::min(workers, files.size());
+        if (workers > 1)
+        {
+            // each file is filtered independently, split them
+            // round-robin across forked workers
+            Vector<pid_t> children;
+            for (size_t worker = 0; worker < workers; ++worker)
+            {
+                if (pid_t pid = fork())
+                    children.push_back(pid);
+                else
+                {
+                    for (size_t i = worker; i < files.size(); i += workers)
+                        filter_file(files[i]);
+                    exit(0);
+                }
+            }
+            for (auto pid : children)
+            {
+                int status = 0;
+                waitpid(pid, &status, 0);
+                if (status != 0)
+                    exit_status = -1;
+            }
+        }
+        else
+        {
+            for (auto& file : files)
+                filter_file(file);
         }
         if (not isatty(0))
         {
@@ -888,10 +1067,11 @@ int run_filter(StringView keystr, ConstArrayView<StringView> files, bool quiet,
     catch (runtime_error& err)
     {
         write_stderr(format("error: {}\n", err.what()));
+        exit_status = -1;
     }
 
     buffer_manager.clear_buffer_trash();
-    return 0;
+    return exit_status;
 }
 
 int run_pipe(StringView session)
@@ -958,7 +1138,7 @@ int main(int argc, char* argv[])
     set_signal_handler(SIGQUIT, signal_handler);
     set_signal_handler(SIGTERM, signal_handler);
     set_signal_handler(SIGPIPE, [](int){});
-    set_signal_handler(SIGINT, [](int){});
+    set_signal_handler(SIGINT, [](int){ request_cancel(); });
     set_signal_handler(SIGCHLD, [](int){});
 
     const ParameterDesc param_desc{
@@ -972,11 +1152,13 @@ int main(int argc, char* argv[])
                    { "f", { true,  "filter: for each file, select the entire buffer and execute the given keys" } },
                    { "i", { true, "backup the files on which a filter is applied using the given suffix" } },
                    { "q", { false, "in filter mode, be quiet about errors applying keys" } },
+                   { "j", { true, "in filter mode, process the files with the given number of parallel workers" } },
                    { "ui", { true, "set the type of user interface to use (ncurses, dummy, or json)" } },
                    { "l", { false, "list existing sessions" } },
                    { "clear", { false, "clear dead sessions" } },
                    { "debug", { true, "initial debug option value" } },
                    { "version", { false, "display kakoune version and exit" } },
+                   { "bench", { false, "run the benchmark suite and exit" } },
                    { "ro", { false, "readonly mode" } },
                    { "help", { false, "display a help message and quit" } } }
     };
@@ -1014,6 +1196,9 @@ int main(int argc, char* argv[])
             return 0;
         }
 
+        if (parser.get_switch("bench"))
+            return run_benchmarks();
+
         const bool list_sessions = (bool)parser.get_switch("l");
         const bool clear_sessions = (bool)parser.get_switch("clear");
         if (list_sessions or clear_sessions)
@@ -1054,12 +1239,25 @@ int main(int argc, char* argv[])
                 return -1;
             }
 
+            size_t workers = 1;
+            if (auto count = parser.get_switch("j"))
+            {
+                const int value = str_to_int(*count);
+                if (value < 1)
+                {
+                    write_stderr("error: -j expects a positive worker count\n");
+                    return -1;
+                }
+                workers = (size_t)value;
+            }
+
             Vector<StringView> files;
             for (size_t i = 0; i < parser.positional_count(); ++i)
                 files.emplace_back(parser[i]);
 
             return run_filter(*keys, files, (bool)parser.get_switch("q"),
-                              parser.get_switch("i").value_or(StringView{}));
+                              parser.get_switch("i").value_or(StringView{}),
+                              workers);
         }
 
         Vector<StringView> files;
@@ -1,8 +1,95 @@
 #include "memory.hh"
 
+#include <cstring>
+
 namespace Kakoune
 {
 
 MemoryStats memory_stats[(size_t)MemoryDomain::Count] = {};
+PoolStats pool_stats[(size_t)MemoryDomain::Count] = {};
+
+size_t alloc_sample_rate = 0;
+size_t alloc_sample_countdown = 0;
+
+namespace
+{
+
+// fixed capacity so that recording a sample never allocates itself,
+// which would recurse into on_alloc
+constexpr size_t max_alloc_sites = 256;
+AllocSiteSample alloc_sites[max_alloc_sites];
+size_t alloc_site_count = 0;
+
+}
+
+void set_alloc_sampling(size_t every_nth)
+{
+    alloc_sample_rate = every_nth;
+    alloc_sample_countdown = every_nth;
+    alloc_site_count = 0;
+}
+
+void record_alloc_sample(MemoryDomain domain, size_t size)
+{
+    alloc_sample_countdown = alloc_sample_rate;
+    Backtrace backtrace;
+    for (size_t i = 0; i < alloc_site_count; ++i)
+    {
+        auto& site = alloc_sites[i];
+        if (site.domain == domain and
+            site.backtrace.num_frames == backtrace.num_frames and
+            memcmp(site.backtrace.stackframes, backtrace.stackframes,
+                   backtrace.num_frames * sizeof(void*)) == 0)
+        {
+            ++site.count;
+            site.total_bytes += size;
+            return;
+        }
+    }
+    if (alloc_site_count < max_alloc_sites)
+        alloc_sites[alloc_site_count++] = {backtrace, domain, 1, size};
+}
+
+ConstArrayView<AllocSiteSample> alloc_samples()
+{
+    return {alloc_sites, alloc_site_count};
+}
+
+namespace
+{
+
+struct FreeBlock { FreeBlock* next; };
+
+constexpr size_t pool_bucket_count = pool_max_size / pool_granularity;
+FreeBlock* pool_free_lists[(size_t)MemoryDomain::Count][pool_bucket_count] = {};
+
+size_t pool_bucket(size_t size)
+{
+    return (size + pool_granularity - 1) / pool_granularity - 1;
+}
+
+}
+
+void* pool_allocate(MemoryDomain domain, size_t size)
+{
+    const size_t bucket = pool_bucket(size);
+    auto& stats = pool_stats[(size_t)domain];
+    if (auto* block = pool_free_lists[(size_t)domain][bucket])
+    {
+        pool_free_lists[(size_t)domain][bucket] = block->next;
+        ++stats.hits;
+        return block;
+    }
+    ++stats.misses;
+    return ::operator new((bucket + 1) * pool_granularity);
+}
+
+void pool_deallocate(MemoryDomain domain, void* ptr, size_t size)
+{
+    auto* block = static_cast<FreeBlock*>(ptr);
+    auto& free_list = pool_free_lists[(size_t)domain][pool_bucket(size)];
+    block->next = free_list;
+    free_list = block;
+}
 
 }
@@ -5,7 +5,9 @@
 #include <new>
 #include <utility>
 
+#include "array_view.hh"
 #include "assert.hh"
+#include "backtrace.hh"
 #include "meta.hh"
 
 namespace Kakoune
@@ -85,12 +87,31 @@ struct MemoryStats
 
 extern MemoryStats memory_stats[(size_t)MemoryDomain::Count];
 
+// Allocation site sampling: when enabled every Nth allocation records a
+// backtrace, aggregated per call site (see `debug memory sample`).
+struct AllocSiteSample
+{
+    Backtrace backtrace;
+    MemoryDomain domain;
+    size_t count;
+    size_t total_bytes;
+};
+
+extern size_t alloc_sample_rate;
+extern size_t alloc_sample_countdown;
+
+void set_alloc_sampling(size_t every_nth);
+void record_alloc_sample(MemoryDomain domain, size_t size);
+ConstArrayView<AllocSiteSample> alloc_samples();
+
 inline void on_alloc(MemoryDomain domain, size_t size)
 {
     auto& stats = memory_stats[(int)domain];
     stats.allocated_bytes += size;
     ++stats.allocation_count;
     ++stats.total_allocation_count;
+    if (alloc_sample_rate != 0 and --alloc_sample_countdown == 0)
+        record_alloc_sample(domain, size);
 }
 
 inline void on_dealloc(MemoryDomain domain, size_t size)
@@ -101,6 +122,33 @@ inline void on_dealloc(MemoryDomain domain, size_t size)
     --stats.allocation_count;
 }
 
+// Opt-in per domain size class freelists: hot domains churn through
+// many small allocations of recurring sizes (selections, display atoms,
+// regex threads), which the pools serve in O(1) from recycled blocks.
+constexpr bool is_pooled(MemoryDomain domain)
+{
+    return domain == MemoryDomain::String or
+           domain == MemoryDomain::Selections or
+           domain == MemoryDomain::Display or
+           domain == MemoryDomain::Highlight or
+           domain == MemoryDomain::Regex or
+           domain == MemoryDomain::WordDB;
+}
+
+constexpr size_t pool_granularity = 32;
+constexpr size_t pool_max_size = 512;
+
+struct PoolStats
+{
+    size_t hits;
+    size_t misses;
+};
+
+extern PoolStats pool_stats[(size_t)MemoryDomain::Count];
+
+void* pool_allocate(MemoryDomain domain, size_t size);
+void pool_deallocate(MemoryDomain domain, void* ptr, size_t size);
+
 template<typename T, MemoryDomain domain>
 struct Allocator
 {
@@ -117,6 +165,8 @@ struct Allocator
     {
         size_t size = sizeof(T) * n;
         on_alloc(domain, size);
+        if (is_pooled(domain) and size != 0 and size <= pool_max_size)
+            return reinterpret_cast<T*>(pool_allocate(domain, size));
         return reinterpret_cast<T*>(::operator new(size));
     }
 
@@ -124,6 +174,8 @@ struct Allocator
     {
         size_t size = sizeof(T) * n;
         on_dealloc(domain, size);
+        if (is_pooled(domain) and size != 0 and size <= pool_max_size)
+            return pool_deallocate(domain, ptr, size);
         ::operator delete(ptr);
     }
 };
@@ -34,6 +34,7 @@ void NCursesUI::Window::create(const DisplayCoord& p, const DisplayCoord& s)
     pos = p;
     size = s;
     win = (NCursesWin*)newpad((int)size.line, (int)size.column);
+    m_active_face.reset();
 }
 
 void NCursesUI::Window::destroy()
@@ -109,11 +110,14 @@ void NCursesUI::Window::draw_line(Palette& palette,
 
 void NCursesUI::Window::set_face(Palette& palette, Face face, const Face& default_face)
 {
+    face = merge_faces(default_face, face);
+    if (m_active_face == face)
+        return;
+    m_active_face = face;
+
     if (m_active_pair != -1)
         wattroff(win, COLOR_PAIR(m_active_pair));
 
-    face = merge_faces(default_face, face);
-
     if (face.fg != Color::Default or face.bg != Color::Default)
     {
         m_active_pair = palette.get_color_pair(face);
@@ -368,7 +372,11 @@ NCursesUI::NCursesUI()
             return;
 
         while (auto key = get_next_key())
-            m_on_key(*key);
+        {
+            // pasted content was delivered to m_on_paste instead
+            if (*key != Key{Key::Invalid})
+                m_on_key(*key);
+        }
       }},
       m_assistant(assistant_clippy)
 {
@@ -415,7 +423,7 @@ void NCursesUI::redraw(bool force)
 
     m_info.refresh(false);
 
-    Window screen{{}, static_cast<NCursesWin*>(newscr)};
+    Window screen{{}, static_cast<NCursesWin*>(newscr), -1, {}};
     if (m_cursor.mode == CursorMode::Prompt)
         screen.move_cursor({m_status_on_top ? 0 : m_dimensions.line, m_cursor.coord.column});
     else
@@ -448,25 +456,74 @@ void NCursesUI::draw(const DisplayBuffer& display_buffer,
 
     const DisplayCoord dim = dimensions();
     const LineCount line_offset = content_line_offset();
+
+    // range atoms reference buffer content that might have changed or
+    // disappeared since the last frame, so compare against an owned
+    // snapshot of what was actually rendered
+    auto render = [](const DisplayLine& line) {
+        DrawnLine drawn;
+        drawn.reserve(line.atoms().size());
+        for (const DisplayAtom& atom : line)
+            drawn.push_back({atom.face, atom.content().str()});
+        return drawn;
+    };
+
+    // compare without snapshotting, so unchanged lines (the vast
+    // majority of a typical frame) are skipped without allocating
+    auto changed = [](const DrawnLine& drawn, const DisplayLine& line) {
+        return drawn.size() != line.atoms().size() or
+               not std::equal(drawn.begin(), drawn.end(), line.atoms().begin(),
+                              [](const DrawnAtom& drawn_atom, const DisplayAtom& atom) {
+                                  return drawn_atom.face == atom.face and
+                                         drawn_atom.content == atom.content();
+                              });
+    };
+
+    const bool full_redraw = not m_drawn.valid or
+                             default_face != m_drawn.default_face or
+                             line_offset != m_drawn.line_offset;
+    if (full_redraw)
+        m_drawn.lines.clear();
+
     LineCount line_index = line_offset;
+    size_t drawn_index = 0;
     for (const DisplayLine& line : display_buffer.lines())
     {
-        m_window.move_cursor(line_index);
-        m_window.clear_to_end_of_line();
-        m_window.draw_line(m_palette, line, 0, dim.column, default_face);
+        if (drawn_index >= m_drawn.lines.size() or
+            changed(m_drawn.lines[drawn_index], line))
+        {
+            m_window.move_cursor(line_index);
+            m_window.clear_to_end_of_line();
+            m_window.draw_line(m_palette, line, 0, dim.column, default_face);
+            if (drawn_index < m_drawn.lines.size())
+                m_drawn.lines[drawn_index] = render(line);
+            else
+                m_drawn.lines.push_back(render(line));
+        }
         ++line_index;
+        ++drawn_index;
     }
 
-    m_window.set_background_color(m_palette, padding_face);
-    m_window.set_face(m_palette, padding_face, default_face);
-
-    while (line_index < dim.line + line_offset)
+    if (full_redraw or padding_face != m_drawn.padding_face or
+        drawn_index < m_drawn.lines.size())
     {
-        m_window.move_cursor(line_index++);
-        m_window.clear_to_end_of_line();
-        m_window.add_str('~');
+        m_window.set_background_color(m_palette, padding_face);
+        m_window.set_face(m_palette, padding_face, default_face);
+
+        while (line_index < dim.line + line_offset)
+        {
+            m_window.move_cursor(line_index++);
+            m_window.clear_to_end_of_line();
+            m_window.add_str('~');
+        }
     }
 
+    m_drawn.lines.erase(m_drawn.lines.begin() + drawn_index, m_drawn.lines.end());
+    m_drawn.default_face = default_face;
+    m_drawn.padding_face = padding_face;
+    m_drawn.line_offset = line_offset;
+    m_drawn.valid = true;
+
     m_dirty = true;
 }
 
@@ -570,6 +627,8 @@ void NCursesUI::check_resize(bool force)
     set_resize_pending();
     clearok(curscr, true);
     werase(curscr);
+
+    m_drawn.valid = false; // the window content was lost
 }
 
 Optional<Key> NCursesUI::get_next_key()
@@ -756,6 +815,23 @@ Optional<Key> NCursesUI::get_next_key()
             return Key{mod, coord};
         };
 
+        if (c == '~' and params[0] == 200)
+        {
+            // bracketed paste, read the pasted content as a single event
+            constexpr StringView end_mark = "\033[201~";
+            String content;
+            m_window.set_blocking(true);
+            do
+            {
+                content += (char)m_window.get_char();
+            } while (content.length() < end_mark.length() or
+                     StringView{content}.substr(content.length() - end_mark.length()) != end_mark);
+            m_window.set_blocking(false);
+            content.resize(content.length() - end_mark.length(), 0);
+            if (m_on_paste)
+                m_on_paste(content);
+            return Key{Key::Invalid};
+        }
         if (c >= 'A' and c <= 'F')
             return Key{parse_mask(params[1]), direction[c - 'A']};
         if (c == '~' and 2 <= params[0] and params[0] <= 24)
@@ -1190,6 +1266,7 @@ void NCursesUI::info_show(StringView title, StringView content,
 {
     info_hide();
 
+    const bool same_text = m_info.title == title and m_info.content == content;
     m_info.title = title.str();
     m_info.content = content.str();
     m_info.anchor = anchor;
@@ -1197,61 +1274,86 @@ void NCursesUI::info_show(StringView title, StringView content,
     m_info.style = style;
 
     const Rect rect = {content_line_offset(), m_dimensions};
-    InfoBox info_box;
+
+    // settle the width budget and flavour of the box first, so that the
+    // wrapped layout can be cached: repositioning (anchor moved, menu
+    // shown or hidden, ...) then reuses it instead of re-measuring the
+    // text
+    ColumnCount max_width = m_dimensions.column;
+    bool bubble = false;
+    bool assistant = false;
+    if (style == InfoStyle::Prompt)
+    {
+        bubble = true;
+        assistant = not m_assistant.empty();
+    }
+    else if (style == InfoStyle::Modal)
+        bubble = true;
+    else if (style == InfoStyle::MenuDoc)
+    {
+        if (not m_menu)
+            return;
+        max_width = std::max(m_dimensions.column - (m_menu.pos.column + m_menu.size.column),
+                             m_menu.pos.column);
+    }
+    else
+        max_width = m_dimensions.column - anchor.column;
+
+    if (not bubble and max_width < 4)
+        return;
+
+    if (not same_text or max_width != m_info.box_max_width or
+        bubble != m_info.box_bubble or assistant != m_info.box_assistant)
+    {
+        InfoBox info_box = bubble ?
+            make_info_box(m_info.title, m_info.content, max_width,
+                          assistant ? m_assistant : ConstArrayView<StringView>{})
+          : make_simple_info_box(m_info.content, max_width);
+        m_info.box_size = info_box.size;
+        m_info.box_contents = std::move(info_box.contents);
+        m_info.box_max_width = max_width;
+        m_info.box_bubble = bubble;
+        m_info.box_assistant = assistant;
+    }
+    const auto box_size = m_info.box_size;
+
     if (style == InfoStyle::Prompt)
     {
-        info_box = make_info_box(m_info.title, m_info.content, m_dimensions.column, m_assistant);
         anchor = DisplayCoord{m_status_on_top ? 0 : m_dimensions.line, m_dimensions.column-1};
-        anchor = compute_pos(anchor, info_box.size, rect, m_menu, style == InfoStyle::InlineAbove);
+        anchor = compute_pos(anchor, box_size, rect, m_menu, style == InfoStyle::InlineAbove);
     }
     else if (style == InfoStyle::Modal)
     {
-        info_box = make_info_box(m_info.title, m_info.content, m_dimensions.column, {});
         auto half = [](const DisplayCoord& c) { return DisplayCoord{c.line / 2, c.column / 2}; };
-        anchor = rect.pos + half(rect.size) - half(info_box.size);
+        anchor = rect.pos + half(rect.size) - half(box_size);
     }
     else if (style == InfoStyle::MenuDoc)
     {
-        if (not m_menu)
-            return;
-
         const auto right_max_width = m_dimensions.column - (m_menu.pos.column + m_menu.size.column);
-        const auto left_max_width = m_menu.pos.column;
-        const auto max_width = std::max(right_max_width, left_max_width);
-        if (max_width < 4)
-            return;
-
-        info_box = make_simple_info_box(m_info.content, max_width);
         anchor.line = m_menu.pos.line;
-        if (info_box.size.column <= right_max_width or right_max_width >= left_max_width)
+        if (box_size.column <= right_max_width or right_max_width >= m_menu.pos.column)
             anchor.column = m_menu.pos.column + m_menu.size.column;
         else
-            anchor.column = m_menu.pos.column - info_box.size.column;
+            anchor.column = m_menu.pos.column - box_size.column;
     }
     else
     {
-        const ColumnCount max_width = m_dimensions.column - anchor.column;
-        if (max_width < 4)
-            return;
-
-        info_box = make_simple_info_box(m_info.content, max_width);
-        anchor = compute_pos(anchor, info_box.size, rect, m_menu, style == InfoStyle::InlineAbove);
-
+        anchor = compute_pos(anchor, box_size, rect, m_menu, style == InfoStyle::InlineAbove);
         anchor.line += content_line_offset();
     }
 
     // The info box does not fit
-    if (anchor < rect.pos or anchor + info_box.size > rect.pos + rect.size)
+    if (anchor < rect.pos or anchor + box_size > rect.pos + rect.size)
         return;
 
-    m_info.create(anchor, info_box.size);
+    m_info.create(anchor, box_size);
 
     m_info.set_background_color(m_palette, face);
-    for (auto line = 0_line; line < info_box.size.line; ++line)
+    for (auto line = 0_line; line < box_size.line; ++line)
     {
         m_info.move_cursor(line);
         m_info.clear_to_end_of_line();
-        m_info.add_str(info_box.contents[(int)line]);
+        m_info.add_str(m_info.box_contents[(int)line]);
     }
     m_dirty = true;
 }
@@ -1271,6 +1373,11 @@ void NCursesUI::set_on_key(OnKeyCallback callback)
     EventManager::instance().force_signal(0);
 }
 
+void NCursesUI::set_on_paste(OnPasteCallback callback)
+{
+    m_on_paste = std::move(callback);
+}
+
 DisplayCoord NCursesUI::dimensions()
 {
     return m_dimensions;
@@ -1307,6 +1414,8 @@ void NCursesUI::enable_mouse(bool enabled)
             fputs("\033[?1006h", stdout);
         // force enable report focus events
         fputs("\033[?1004h", stdout);
+        // enable bracketed paste
+        fputs("\033[?2004h", stdout);
         // enable mouse
         fputs("\033[?1000h", stdout);
         // force enable report mouse position
@@ -1315,6 +1424,7 @@ void NCursesUI::enable_mouse(bool enabled)
     else
     {
         mousemask(0, nullptr);
+        fputs("\033[?2004l", stdout);
         fputs("\033[?1002l", stdout);
         fputs("\033[?1000l", stdout);
         fputs("\033[?1004l", stdout);
@@ -1327,6 +1437,7 @@ void NCursesUI::set_ui_options(const Options& options)
 {
     {
         auto it = options.find("ncurses_assistant"_sv);
+        const auto prev_assistant = m_assistant.pointer();
         if (it == options.end() or it->value == "clippy")
             m_assistant = assistant_clippy;
         else if (it->value == "cat")
@@ -1335,6 +1446,8 @@ void NCursesUI::set_ui_options(const Options& options)
             m_assistant = assistant_dilbert;
         else if (it->value == "none" or it->value == "off")
             m_assistant = ConstArrayView<StringView>{};
+        if (m_assistant.pointer() != prev_assistant)
+            m_info.box_max_width = -1; // drop the cached info layout
     }
 
     {
@@ -1364,6 +1477,9 @@ void NCursesUI::set_ui_options(const Options& options)
             m_window.m_active_pair = -1;
             m_menu.m_active_pair = -1;
             m_info.m_active_pair = -1;
+            m_window.m_active_face.reset();
+            m_menu.m_active_face.reset();
+            m_info.m_active_face.reset();
         }
     }
 
@@ -51,6 +51,7 @@ public:
 
     DisplayCoord dimensions() override;
     void set_on_key(OnKeyCallback callback) override;
+    void set_on_paste(OnPasteCallback callback) override;
     void set_ui_options(const Options& options) override;
 
     static void abort();
@@ -112,12 +113,36 @@ private:
 
         NCursesWin* win = nullptr;
         int m_active_pair = -1;
+        // last face applied to the window, used to skip attribute
+        // changes between atoms sharing the same face
+        Optional<Face> m_active_face;
     };
 
     Window m_window;
 
     DisplayCoord m_dimensions;
 
+    struct DrawnAtom
+    {
+        Face face;
+        String content;
+
+        bool operator==(const DrawnAtom& other) const
+        { return face == other.face and content == other.content; }
+    };
+    using DrawnLine = Vector<DrawnAtom, MemoryDomain::Display>;
+
+    // rendered content of the last frame, used to skip drawing
+    // lines that did not change
+    struct Drawn
+    {
+        Vector<DrawnLine, MemoryDomain::Display> lines;
+        Face default_face;
+        Face padding_face;
+        LineCount line_offset = 0;
+        bool valid = false;
+    } m_drawn;
+
     void mark_dirty(const Window& win);
 
     struct Menu : Window
@@ -143,6 +168,15 @@ private:
         Face face;
         DisplayCoord anchor;
         InfoStyle style;
+
+        // wrapped layout cache, rebuilt only when the text or the width
+        // budget changes so that repositioning (anchor moved, menu
+        // toggled, ...) does not re-measure long documentation strings
+        DisplayCoord box_size;
+        Vector<String> box_contents;
+        ColumnCount box_max_width = -1;
+        bool box_bubble = false;
+        bool box_assistant = false;
     } m_info;
 
     struct Cursor
@@ -153,6 +187,7 @@ private:
 
     FDWatcher m_stdin_watcher;
     OnKeyCallback m_on_key;
+    OnPasteCallback m_on_paste;
 
     bool m_status_on_top = false;
     ConstArrayView<StringView> m_assistant;
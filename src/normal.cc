@@ -3,6 +3,7 @@
 #include "buffer.hh"
 #include "buffer_manager.hh"
 #include "buffer_utils.hh"
+#include "cancel.hh"
 #include "changes.hh"
 #include "client_manager.hh"
 #include "command_manager.hh"
@@ -13,6 +14,7 @@
 #include "face_registry.hh"
 #include "file.hh"
 #include "flags.hh"
+#include "hash.hh"
 #include "option_manager.hh"
 #include "option_types.hh"
 #include "ranges.hh"
@@ -426,20 +428,38 @@ Codepoint swap_case(Codepoint cp)
 template<Codepoint (*func)(Codepoint)>
 void for_each_codepoint(Context& context, NormalParams)
 {
-    using Utf8It = utf8::iterator<BufferIterator>;
-
     ScopedEdition edition(context);
     Buffer& buffer = context.buffer();
     SelectionList& selections = context.selections();
     Vector<String> strings;
     for (auto& sel : selections)
     {
+        // Convert line by line over the contiguous line storage, with a
+        // direct byte path for ascii; decoding through a buffer iterator
+        // per codepoint dominates whole buffer case conversions.
+        const BufferCoord min = sel.min();
+        const BufferCoord end = buffer.char_next(sel.max());
         String str;
-        for (auto begin = Utf8It{buffer.iterator_at(sel.min()), buffer},
-                  end = Utf8It{buffer.iterator_at(sel.max()), buffer}+1;
-             begin != end; ++begin)
-            utf8::dump(std::back_inserter(str), func(*begin));
-
+        str.reserve(buffer.distance(min, end));
+        for (LineCount line = min.line; line <= end.line and line < buffer.line_count(); ++line)
+        {
+            const StringView content = buffer[line];
+            const ByteCount first = line == min.line ? min.column : 0;
+            const ByteCount last = line == end.line ?
+                std::min(end.column, content.length()) : content.length();
+            for (const char* it = content.begin() + (int)first,
+                     *line_end = content.begin() + (int)last; it != line_end; )
+            {
+                if (const unsigned char byte = *it; byte < 0x80)
+                {
+                    str.push_back((char)func(byte));
+                    ++it;
+                }
+                else
+                    utf8::dump(std::back_inserter(str),
+                               func(utf8::read_codepoint(it, line_end)));
+            }
+        }
         strings.push_back(std::move(str));
     }
     selections.insert(strings, InsertMode::Replace);
@@ -509,7 +529,10 @@ BufferCoord apply_diff(Buffer& buffer, BufferCoord pos, StringView before, Strin
     const auto lines_after = after | split_after<StringView>('\n') | gather<Vector<StringView>>();
 
     auto diffs = find_diff(lines_before.begin(), (int)lines_before.size(),
-                           lines_after.begin(), (int)lines_after.size());
+                           lines_after.begin(), (int)lines_after.size(),
+                           std::equal_to<>{},
+                           [](StringView line)
+                           { return hash_data(line.data(), (size_t)(int)line.length()); });
 
     auto byte_count = [](auto&& lines, int first, int count) {
         return std::accumulate(&lines[first], &lines[first+count], 0_byte,
@@ -752,6 +775,17 @@ constexpr RegexCompileFlags direction_flags(RegexMode mode)
         RegexCompileFlags::None : RegexCompileFlags::Backward | RegexCompileFlags::NoForward;
 }
 
+// Per prompt cache of incremental search results, letting search as you
+// type reuse the selections computed for a pattern already tried in this
+// prompt (backspacing, retyping) instead of rescanning the buffer. An
+// empty optional records that the pattern had no match.
+struct IncSearchCache
+{
+    using Result = Optional<std::pair<Vector<Selection>, size_t>>;
+    HashMap<String, Result, MemoryDomain::Selections> results;
+    size_t timestamp = 0;
+};
+
 template<RegexMode mode = RegexMode::Forward, typename T>
 void regex_prompt(Context& context, String prompt, char reg, T func)
 {
@@ -786,7 +820,8 @@ void regex_prompt(Context& context, String prompt, char reg, T func)
                        [&](auto&& m) { candidates.push_back(m.candidate().str()); return true; });
             return {(int)(word.begin() - regex.begin()), pos,  std::move(candidates) };
         },
-        [=, func=T(std::move(func))](StringView str, PromptEvent event, Context& context) mutable {
+        [=, func=T(std::move(func)), cache=IncSearchCache{}](StringView str, PromptEvent event, Context& context) mutable {
+            bool cache_result = false;
             try
             {
                 if (event != PromptEvent::Change and context.has_client())
@@ -809,8 +844,29 @@ void regex_prompt(Context& context, String prompt, char reg, T func)
                 if (event == PromptEvent::Validate)
                     context.push_jump();
 
+                cache_result = incsearch and event == PromptEvent::Change and not str.empty();
+                if (cache_result)
+                {
+                    if (cache.timestamp != context.buffer().timestamp())
+                        cache.results.clear();
+                    cache.timestamp = context.buffer().timestamp();
+                    if (auto it = cache.results.find(str); it != cache.results.end())
+                    {
+                        if (auto& result = it->value)
+                            context.selections_write_only().set(Vector<Selection>{result->first}, result->second);
+                        return;
+                    }
+                }
+
                 if (not str.empty() or event == PromptEvent::Validate)
                     func(Regex{str.empty() ? default_regex : str, direction_flags(mode)}, event, context);
+
+                if (cache_result)
+                {
+                    auto& sels = context.selections();
+                    cache.results.insert({str.str(), std::pair{Vector<Selection>{sels.begin(), sels.end()},
+                                                               sels.main_index()}});
+                }
             }
             catch (regex_error& err)
             {
@@ -822,6 +878,8 @@ void regex_prompt(Context& context, String prompt, char reg, T func)
             catch (runtime_error&)
             {
                 context.selections_write_only() = selections;
+                if (cache_result)
+                    cache.results.insert({str.str(), IncSearchCache::Result{}});
                 // only validation should propagate errors,
                 // incremental search should not.
                 if (event == PromptEvent::Validate)
@@ -1547,12 +1605,28 @@ void replay_macro(Context& context, NormalParams params)
     running_macros[idx] = true;
     auto stop = on_scope_end([&]{ running_macros[idx] = false; });
 
-    auto keys = parse_keys(reg_val[0]);
+    // replay from preparsed keys, only reparsing when the register content
+    // changed since the last run; the entry cannot be invalidated while we
+    // iterate it as recursive calls on the same register are refused above
+    static struct { String text; KeyList keys; } parse_cache[27];
+    auto& cached = parse_cache[idx];
+    if (cached.text != reg_val[0])
+    {
+        cached.keys = parse_keys(reg_val[0]);
+        cached.text = reg_val[0];
+    }
+    const KeyList& keys = cached.keys;
     ScopedEdition edition(context);
+    // batch the whole replay, suppressing per key status updates, autoinfo
+    // and idle timer scheduling until the count completes
+    ScopedSetBool batched{context.batched_keys()};
     do
     {
         for (auto& key : keys)
+        {
+            cancellation_point();
             context.input_handler().handle_key(key);
+        }
     } while (--params.count > 0);
 }
 
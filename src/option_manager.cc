@@ -1,15 +1,72 @@
 #include "option_manager.hh"
 
 #include "assert.hh"
+#include "buffer_utils.hh"
 #include "flags.hh"
+#include "ranges.hh"
 #include "scope.hh"
 
+#include <algorithm>
+
 namespace Kakoune
 {
 
+static int option_transaction_depth = 0;
+static Vector<std::pair<OptionManager*, String>, MemoryDomain::Options> pending_option_changes;
+
+OptionTransaction::OptionTransaction()
+{
+    ++option_transaction_depth;
+}
+
+OptionTransaction::~OptionTransaction()
+{
+    if (--option_transaction_depth != 0)
+        return;
+
+    // pop the entries one by one, a notification destroying a scope
+    // removes that scope's remaining entries from the list
+    while (not pending_option_changes.empty())
+    {
+        auto [manager, name] = std::move(pending_option_changes.front());
+        pending_option_changes.erase(pending_option_changes.begin());
+        try
+        {
+            manager->on_option_changed((*manager)[name]);
+        }
+        catch (runtime_error& error)
+        {
+            write_to_debug_buffer(format("error in option change notification for '{}': {}",
+                                         name, error.what()));
+        }
+    }
+}
+
+bool OptionTransaction::active()
+{
+    return option_transaction_depth != 0;
+}
+
+void OptionTransaction::add_pending(OptionManager& manager, StringView name)
+{
+    if (any_of(pending_option_changes,
+               [&](auto& pending) { return pending.first == &manager and
+                                           pending.second == name; }))
+        return;
+    pending_option_changes.push_back({&manager, name.str()});
+}
+
+void OptionTransaction::forget(OptionManager& manager)
+{
+    pending_option_changes.erase(
+        std::remove_if(pending_option_changes.begin(), pending_option_changes.end(),
+                       [&](auto& pending) { return pending.first == &manager; }),
+        pending_option_changes.end());
+}
+
 OptionDesc::OptionDesc(String name, String docstring, OptionFlags flags)
     : m_name(std::move(name)), m_docstring(std::move(docstring)),
-    m_flags(flags) {}
+    m_flags(flags), m_letters(used_letters(m_name)) {}
 
 Option::Option(const OptionDesc& desc, OptionManager& manager)
     : m_manager(manager), m_desc(desc) {}
@@ -22,6 +79,8 @@ OptionManager::OptionManager(OptionManager& parent)
 
 OptionManager::~OptionManager()
 {
+    OptionTransaction::forget(*this);
+
     if (m_parent)
         m_parent->unregister_watcher(*this);
 
@@ -99,6 +158,12 @@ void OptionManager::on_option_changed(const Option& option)
     if (&option.manager() != this and m_options.contains(option.name()))
         return;
 
+    if (OptionTransaction::active())
+    {
+        OptionTransaction::add_pending(*this, option.name());
+        return;
+    }
+
     // The watcher list might get mutated during calls to on_option_changed
     auto watchers = m_watchers;
     for (auto* watcher : watchers)
@@ -111,11 +176,21 @@ void OptionManager::on_option_changed(const Option& option)
 CandidateList OptionsRegistry::complete_option_name(StringView prefix,
                                                     ByteCount cursor_pos) const
 {
-    using OptionPtr = std::unique_ptr<const OptionDesc>;
-    return complete(prefix, cursor_pos, m_descs |
-                    filter([](const OptionPtr& desc)
-                           { return not (desc->flags() & OptionFlags::Hidden); }) |
-                    transform(&OptionDesc::name));
+    const StringView query = prefix.substr(0, cursor_pos);
+    const UsedLetters query_letters = used_letters(query);
+    NBestMatches<> best{max_menu_candidates};
+    for (auto& desc : m_descs)
+    {
+        if (desc->flags() & OptionFlags::Hidden)
+            continue;
+        // the letters masks are computed once at option declaration
+        if (RankedMatch match{desc->name(), desc->letters(), query, query_letters})
+            best.push(match);
+    }
+    CandidateList res;
+    for (auto& m : std::move(best).sorted())
+        res.push_back(m.candidate().str());
+    return res;
 }
 
 }
@@ -4,6 +4,7 @@
 #include "completion.hh"
 #include "exception.hh"
 #include "hash_map.hh"
+#include "optional.hh"
 #include "option.hh"
 #include "ranges.hh"
 #include "utils.hh"
@@ -36,11 +37,13 @@ public:
     const String& docstring() const { return m_docstring; }
 
     OptionFlags flags() const { return m_flags; }
+    UsedLetters letters() const { return m_letters; }
 
 private:
     String m_name;
     String m_docstring;
     OptionFlags  m_flags;
+    UsedLetters m_letters;
 };
 
 class Option : public UseMemoryDomain<MemoryDomain::Options>
@@ -53,7 +56,9 @@ public:
     template<typename T> void set(const T& val, bool notify=true);
     template<typename T> bool is_of_type() const;
 
-    virtual String get_as_string(Quoting quoting) const = 0;
+    // the returned view points into a serialization cached by the option,
+    // it is invalidated by the next change of the option value
+    virtual StringView get_as_string(Quoting quoting) const = 0;
     virtual Vector<String> get_as_strings() const = 0;
     virtual void set_from_strings(ConstArrayView<String> strs) = 0;
     virtual void add_from_strings(ConstArrayView<String> strs) = 0;
@@ -81,6 +86,24 @@ public:
     virtual void on_option_changed(const Option& option) = 0;
 };
 
+// While at least one transaction is active, option change notifications
+// are delayed and coalesced, watchers get notified once per modified
+// option when the outermost transaction ends.
+class OptionTransaction
+{
+public:
+    OptionTransaction();
+    ~OptionTransaction();
+    OptionTransaction(const OptionTransaction&) = delete;
+    OptionTransaction& operator=(const OptionTransaction&) = delete;
+
+private:
+    friend class OptionManager;
+    static bool active();
+    static void add_pending(OptionManager& manager, StringView name);
+    static void forget(OptionManager& manager);
+};
+
 class OptionManager final : private OptionManagerWatcher
 {
 public:
@@ -93,6 +116,12 @@ public:
 
     void unset_option(StringView name);
 
+    // only the options set in this very scope, not inherited ones
+    auto local_options() const
+    {
+        return m_options | transform(&OptionMap::Item::value);
+    }
+
     auto flatten_options() const
     {
         auto merge = [](auto&& first, const OptionMap& second) {
@@ -137,21 +166,25 @@ public:
         if (m_value != value)
         {
             m_value = std::move(value);
+            invalidate_str_cache();
             if (notify)
                 manager().on_option_changed(*this);
         }
     }
     const T& get() const { return m_value; }
-    T& get_mutable() { return m_value; }
+    T& get_mutable() { invalidate_str_cache(); return m_value; }
 
     Vector<String> get_as_strings() const override
     {
         return option_to_strings(m_value);
     }
 
-    String get_as_string(Quoting quoting) const override
+    StringView get_as_string(Quoting quoting) const override
     {
-        return option_to_string(m_value, quoting);
+        auto& cache = m_str_cache[(size_t)quoting];
+        if (not cache)
+            cache = option_to_string(m_value, quoting);
+        return *cache;
     }
 
     void set_from_strings(ConstArrayView<String> strs) override
@@ -162,12 +195,16 @@ public:
     void add_from_strings(ConstArrayView<String> strs) override
     {
         if (option_add_from_strings(m_value, strs))
+        {
+            invalidate_str_cache();
             m_manager.on_option_changed(*this);
+        }
     }
 
     void update(const Context& context) override
     {
         option_update(m_value, context);
+        invalidate_str_cache();
     }
 
     bool has_same_value(const Option& other) const override
@@ -176,7 +213,16 @@ public:
     }
 private:
     virtual void validate(const T& value) const {}
+    void invalidate_str_cache()
+    {
+        for (auto& cache : m_str_cache)
+            cache.reset();
+    }
+
     T m_value;
+    // serializations of the value, one per Quoting, computed on first
+    // access so that repeated reads of big options do not re-serialize
+    mutable Optional<String> m_str_cache[3];
 };
 
 template<typename T, void (*validator)(const T&)>
@@ -203,7 +249,11 @@ template<typename T> const T& Option::get() const
 
 template<typename T> T& Option::get_mutable()
 {
-    return const_cast<T&>(get<T>());
+    auto* typed_opt = dynamic_cast<TypedOption<T>*>(this);
+    if (not typed_opt)
+        throw runtime_error(format("option '{}' is not of type '{}'", name(),
+                                   option_type_name(Meta::Type<T>{})));
+    return typed_opt->get_mutable();
 }
 
 template<typename T> void Option::set(const T& val, bool notify)
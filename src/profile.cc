@@ -0,0 +1,175 @@
+#include "profile.hh"
+
+#include "buffer_utils.hh"
+#include "context.hh"
+#include "file.hh"
+#include "hash_map.hh"
+#include "string_utils.hh"
+#include "vector.hh"
+
+#include <chrono>
+
+namespace Kakoune
+{
+
+namespace
+{
+
+constexpr StringView category_names[] = {
+    "command", "hook", "highlight", "redraw", "shell"
+};
+static_assert(std::size(category_names) == (size_t)ProfileCategory::Count);
+
+struct ProfileStats
+{
+    size_t count = 0;
+    Clock::duration total{};
+};
+
+struct ClientStats
+{
+    ProfileStats categories[(size_t)ProfileCategory::Count];
+};
+
+bool profiling = false;
+Clock::time_point profiling_start;
+HashMap<String, ClientStats> profile_counters;
+
+struct TraceEvent
+{
+    char name[32];
+    Clock::time_point start;
+    Clock::duration duration;
+};
+
+// fixed size ring, the oldest events are overwritten so a dump always
+// covers the most recent activity
+constexpr size_t trace_ring_capacity = 32 * 1024;
+bool tracing = false;
+Clock::time_point tracing_start;
+Vector<TraceEvent> trace_ring;
+size_t trace_ring_pos = 0;
+bool trace_ring_wrapped = false;
+
+}
+
+bool profiling_active()
+{
+    return profiling;
+}
+
+void start_profiling()
+{
+    profile_counters.clear();
+    profiling_start = Clock::now();
+    profiling = true;
+}
+
+void stop_profiling()
+{
+    if (not profiling)
+        throw runtime_error("profiling is not active");
+    profiling = false;
+}
+
+void report_profiling()
+{
+    using namespace std::chrono;
+    const auto covered = profiling ? Clock::now() - profiling_start
+                                   : Clock::duration{};
+    write_to_debug_buffer(format("Profiling report{}:",
+                                 profiling ? format(" ({} ms so far)",
+                                                    (size_t)duration_cast<milliseconds>(covered).count())
+                                           : ""));
+    if (profile_counters.empty())
+        write_to_debug_buffer("  no samples recorded, is profiling started?");
+
+    for (auto& [client, stats] : profile_counters)
+    {
+        write_to_debug_buffer(format(" * client {}:", client));
+        for (size_t i = 0; i < (size_t)ProfileCategory::Count; ++i)
+        {
+            auto& category = stats.categories[i];
+            if (category.count == 0)
+                continue;
+            const auto us = duration_cast<microseconds>(category.total).count();
+            write_to_debug_buffer(format("    {}: {} calls, {} us total, {} us mean",
+                                         category_names[i], category.count,
+                                         (size_t)us, (size_t)us / category.count));
+        }
+    }
+}
+
+void record_profile_sample(const Context& context, ProfileCategory category,
+                           Clock::duration duration)
+{
+    StringView client = not context.name().empty() ?
+                        StringView{context.name()} : "*server*";
+    auto& stats = profile_counters[client.str()].categories[(size_t)category];
+    ++stats.count;
+    stats.total += duration;
+}
+
+bool tracing_active()
+{
+    return tracing;
+}
+
+void start_tracing()
+{
+    trace_ring.resize(trace_ring_capacity);
+    trace_ring_pos = 0;
+    trace_ring_wrapped = false;
+    tracing_start = Clock::now();
+    tracing = true;
+}
+
+void stop_tracing()
+{
+    if (not tracing)
+        throw runtime_error("tracing is not active");
+    tracing = false;
+}
+
+void record_trace_event(StringView name, Clock::time_point start,
+                        Clock::duration duration)
+{
+    auto& event = trace_ring[trace_ring_pos];
+    const size_t len = std::min((size_t)(int)name.length(), sizeof(event.name) - 1);
+    memcpy(event.name, name.data(), len);
+    event.name[len] = '\0';
+    event.start = start;
+    event.duration = duration;
+    if (++trace_ring_pos == trace_ring.size())
+    {
+        trace_ring_pos = 0;
+        trace_ring_wrapped = true;
+    }
+}
+
+void dump_trace(StringView filename)
+{
+    using namespace std::chrono;
+    if (trace_ring.empty())
+        throw runtime_error("no trace recorded, is tracing started?");
+
+    auto event_json = [](const TraceEvent& event) {
+        return format("  \\{\"name\": \"{}\", \"ph\": \"X\", \"ts\": {}, \"dur\": {}, \"pid\": 1, \"tid\": 1}",
+                      event.name,
+                      (size_t)duration_cast<microseconds>(event.start - tracing_start).count(),
+                      (size_t)duration_cast<microseconds>(event.duration).count());
+    };
+
+    String json = "[\n";
+    const size_t begin = trace_ring_wrapped ? trace_ring_pos : 0;
+    const size_t count = trace_ring_wrapped ? trace_ring.size() : trace_ring_pos;
+    for (size_t i = 0; i < count; ++i)
+    {
+        json += event_json(trace_ring[(begin + i) % trace_ring.size()]);
+        json += (i + 1 != count) ? ",\n" : "\n";
+    }
+    json += "]\n";
+    write_to_file(filename, json);
+}
+
+}
@@ -0,0 +1,101 @@
+#ifndef profile_hh_INCLUDED
+#define profile_hh_INCLUDED
+
+#include "clock.hh"
+#include "string.hh"
+
+#include <cstring>
+
+namespace Kakoune
+{
+
+class Context;
+
+// Subsystems covered by the in-editor profiler, one counter per
+// category and per client (see `debug profile start/stop/report`).
+enum class ProfileCategory : int
+{
+    Command,
+    Hook,
+    Highlight,
+    Redraw,
+    Shell,
+    Count,
+};
+
+bool profiling_active();
+void start_profiling();
+void stop_profiling();
+// write the aggregated wall times and call counts to the debug buffer
+void report_profiling();
+
+void record_profile_sample(const Context& context, ProfileCategory category,
+                           Clock::duration duration);
+
+// Scoped timer around a subsystem entry point; when profiling is
+// inactive it costs a single flag test.
+struct ProfileTimer
+{
+    ProfileTimer(const Context& context, ProfileCategory category, bool enabled = true)
+        : m_context{context}, m_category{category},
+          m_active{enabled and profiling_active()},
+          m_start{m_active ? Clock::now() : Clock::time_point{}} {}
+
+    ~ProfileTimer()
+    {
+        if (m_active and profiling_active())
+            record_profile_sample(m_context, m_category, Clock::now() - m_start);
+    }
+
+    ProfileTimer(const ProfileTimer&) = delete;
+    ProfileTimer& operator=(const ProfileTimer&) = delete;
+
+private:
+    const Context& m_context;
+    ProfileCategory m_category;
+    bool m_active;
+    Clock::time_point m_start;
+};
+
+bool tracing_active();
+void start_tracing();
+void stop_tracing();
+// write the recorded events as a chrome://tracing json array
+void dump_trace(StringView filename);
+
+void record_trace_event(StringView name, Clock::time_point start,
+                        Clock::duration duration);
+
+// Scoped recorder for the trace ring; the name is copied so it may
+// point into a temporary buffer, long names are truncated.
+struct TraceTimer
+{
+    TraceTimer(StringView name)
+        : m_active{tracing_active()}
+    {
+        if (not m_active)
+            return;
+        const size_t len = std::min((size_t)(int)name.length(), sizeof(m_name) - 1);
+        memcpy(m_name, name.data(), len);
+        m_name[len] = '\0';
+        m_start = Clock::now();
+    }
+
+    ~TraceTimer()
+    {
+        if (m_active and tracing_active())
+            record_trace_event(m_name, m_start, Clock::now() - m_start);
+    }
+
+    TraceTimer(const TraceTimer&) = delete;
+    TraceTimer& operator=(const TraceTimer&) = delete;
+
+private:
+    char m_name[32];
+    bool m_active;
+    Clock::time_point m_start;
+};
+
+}
+
+#endif // profile_hh_INCLUDED
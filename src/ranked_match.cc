@@ -29,11 +29,6 @@ UsedLetters used_letters(StringView str)
     return res;
 }
 
-bool matches(UsedLetters query, UsedLetters letters)
-{
-    return (query & letters) == query;
-}
-
 using Utf8It = utf8::iterator<const char*>;
 
 static int count_word_boundaries_match(StringView candidate, StringView query)
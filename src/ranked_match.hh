@@ -17,6 +17,11 @@ inline UsedLetters to_lower(UsedLetters letters)
     return ((letters & upper_mask) >> 26) | (letters & (~upper_mask));
 }
 
+inline bool matches(UsedLetters query, UsedLetters letters)
+{
+    return (query & letters) == query;
+}
+
 struct RankedMatch
 {
     RankedMatch(StringView candidate, StringView query);
@@ -1,14 +1,68 @@
 #include "regex.hh"
+#include "hash_map.hh"
 #include "ranges.hh"
 
+#include <algorithm>
+
 namespace Kakoune
 {
 
+namespace
+{
+
+struct RegexCacheKey
+{
+    String str;
+    RegexCompileFlags flags;
+
+    friend size_t hash_value(const RegexCacheKey& key)
+    {
+        return hash_values(key.str, (int)key.flags);
+    }
+
+    friend bool operator==(const RegexCacheKey& lhs, const RegexCacheKey& rhs)
+    {
+        return lhs.flags == rhs.flags and lhs.str == rhs.str;
+    }
+};
+
+struct RegexCacheEntry
+{
+    RefPtr<CompiledRegex> impl;
+    size_t last_use;
+};
+
+}
+
 Regex::Regex(StringView re, RegexCompileFlags flags)
-    : m_impl{new CompiledRegex{}},
-      m_str{re.str()}
+    : m_str{re.str()}
 {
-    *m_impl = compile_regex(re, flags);
+    // Process wide cache of compiled programs: highlighters, hooks and
+    // interactive commands keep reconstructing Regex objects for the same
+    // patterns, and compilation is orders of magnitude costlier than a
+    // lookup. Past a fixed budget the least recently used entry goes.
+    static constexpr size_t max_cached_regexes = 256;
+    static HashMap<RegexCacheKey, RegexCacheEntry, MemoryDomain::Regex> cache;
+    static size_t use_clock = 0;
+
+    ++use_clock;
+    RegexCacheKey key{m_str, flags};
+    if (auto it = cache.find(key); it != cache.end())
+    {
+        it->value.last_use = use_clock;
+        m_impl = it->value.impl;
+        return;
+    }
+
+    m_impl = RefPtr<CompiledRegex>{new CompiledRegex{compile_regex(re, flags)}};
+    if (cache.size() >= max_cached_regexes)
+    {
+        auto lru = std::min_element(cache.begin(), cache.end(),
+                                    [](auto& lhs, auto& rhs)
+                                    { return lhs.value.last_use < rhs.value.last_use; });
+        cache.unordered_remove(lru->key);
+    }
+    cache.insert({std::move(key), {m_impl, use_clock}});
 }
 
 int Regex::named_capture_index(StringView name) const
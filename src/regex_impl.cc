@@ -1,6 +1,7 @@
 #include "regex_impl.hh"
 
 #include "exception.hh"
+#include "ranges.hh"
 #include "string.hh"
 #include "unicode.hh"
 #include "unit_tests.hh"
@@ -12,6 +13,7 @@
 
 #include <cstdio>
 #include <cstring>
+#include <limits>
 
 namespace Kakoune
 {
@@ -19,6 +21,12 @@ namespace Kakoune
 constexpr Codepoint CompiledRegex::StartDesc::other;
 constexpr Codepoint CompiledRegex::StartDesc::count;
 
+size_t regex_executed_instructions = 0;
+size_t regex_spawned_threads = 0;
+
+static bool is_character_class_ranges(const CharacterClass& character_class, Codepoint cp);
+static void compute_character_class_ascii_map(CharacterClass& character_class);
+
 struct ParsedRegex
 {
     enum Op : char
@@ -536,6 +544,8 @@ private:
             character_class.ranges.empty())
             return new_node(ParsedRegex::CharacterType, (Codepoint)character_class.ctypes);
 
+        compute_character_class_ascii_map(character_class);
+
         auto class_id = m_parsed_regex.character_classes.size();
         m_parsed_regex.character_classes.push_back(std::move(character_class));
 
@@ -1017,6 +1027,19 @@ private:
             not contains(start_desc.map, false))
             return nullptr;
 
+        if (not start_desc.map[CompiledRegex::StartDesc::other])
+        {
+            // a single accepted ascii char enables memchr based skipping
+            int single = 0;
+            for (Codepoint cp = 1; cp < CompiledRegex::StartDesc::count; ++cp)
+            {
+                if (start_desc.map[cp])
+                    single = single == 0 ? (int)cp : -1;
+            }
+            if (single > 0)
+                start_desc.only_char = (char)single;
+        }
+
         return std::make_unique<CompiledRegex::StartDesc>(start_desc);
     }
 
@@ -1030,6 +1053,48 @@ private:
     ParsedRegex& m_parsed_regex;
 };
 
+bool is_line_local(const CompiledRegex& program)
+{
+    for (auto& inst : program.instructions)
+    {
+        switch (inst.op)
+        {
+            case CompiledRegex::Literal:
+            case CompiledRegex::Literal_IgnoreCase:
+                if (inst.param == '\n')
+                    return false;
+                break;
+            case CompiledRegex::Class:
+                if (is_character_class(program.character_classes[inst.param], '\n'))
+                    return false;
+                break;
+            case CompiledRegex::CharacterType:
+                if (is_ctype((CharacterType)inst.param, '\n'))
+                    return false;
+                break;
+            case CompiledRegex::AnyChar:
+            // word boundaries and lookarounds inspect characters on the
+            // other side of a line break, subject anchors change meaning
+            case CompiledRegex::WordBoundary:
+            case CompiledRegex::NotWordBoundary:
+            case CompiledRegex::SubjectBegin:
+            case CompiledRegex::SubjectEnd:
+            case CompiledRegex::LookAhead:
+            case CompiledRegex::NegativeLookAhead:
+            case CompiledRegex::LookBehind:
+            case CompiledRegex::NegativeLookBehind:
+            case CompiledRegex::LookAhead_IgnoreCase:
+            case CompiledRegex::NegativeLookAhead_IgnoreCase:
+            case CompiledRegex::LookBehind_IgnoreCase:
+            case CompiledRegex::NegativeLookBehind_IgnoreCase:
+                return false;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
 String dump_regex(const CompiledRegex& program)
 {
     String res;
@@ -1151,12 +1216,41 @@ String dump_regex(const CompiledRegex& program)
     return res;
 }
 
+// A pattern without any metacharacter can only match its own text, so it
+// gets recorded on the program and execution bypasses the vm with a plain
+// substring scan (see ThreadedRegexVM::exec_literal). A (?i) prefix over a
+// pure ascii literal is still eligible, as case insensitive.
+static void detect_literal(StringView re, CompiledRegex& program)
+{
+    bool ignore_case = false;
+    if (re.substr(0_byte, 4_byte) == "(?i)")
+    {
+        ignore_case = true;
+        re = re.substr(4_byte);
+    }
+    if (re.empty())
+        return;
+
+    constexpr StringView meta = R"(\^$.*+?()[]{}|)";
+    for (auto c : re)
+    {
+        if (contains(meta, c) or (ignore_case and (unsigned char)c >= 128))
+            return;
+    }
+
+    for (auto c : re)
+        program.literal += ignore_case ? to_lower(c) : c;
+    program.literal_ignore_case = ignore_case;
+}
+
 CompiledRegex compile_regex(StringView re, RegexCompileFlags flags)
 {
-    return RegexCompiler{RegexParser::parse(re), flags}.get_compiled_regex();
+    CompiledRegex program = RegexCompiler{RegexParser::parse(re), flags}.get_compiled_regex();
+    detect_literal(re, program);
+    return program;
 }
 
-bool is_character_class(const CharacterClass& character_class, Codepoint cp)
+static bool is_character_class_ranges(const CharacterClass& character_class, Codepoint cp)
 {
     if (character_class.ignore_case)
         cp = to_lower(cp);
@@ -1172,6 +1266,19 @@ bool is_character_class(const CharacterClass& character_class, Codepoint cp)
     return found != character_class.negative;
 }
 
+static void compute_character_class_ascii_map(CharacterClass& character_class)
+{
+    for (Codepoint cp = 0; cp < CharacterClass::ascii_count; ++cp)
+        character_class.ascii_map[cp] = is_character_class_ranges(character_class, cp);
+}
+
+bool is_character_class(const CharacterClass& character_class, Codepoint cp)
+{
+    if (cp < CharacterClass::ascii_count)
+        return character_class.ascii_map[cp];
+    return is_character_class_ranges(character_class, cp);
+}
+
 bool is_ctype(CharacterType ctype, Codepoint cp)
 {
     return ((ctype & CharacterType::Whitespace)              and     is_blank(cp))            or
@@ -1,6 +1,7 @@
 #ifndef regex_impl_hh_INCLUDED
 #define regex_impl_hh_INCLUDED
 
+#include "cancel.hh"
 #include "exception.hh"
 #include "flags.hh"
 #include "ref_ptr.hh"
@@ -9,6 +10,9 @@
 #include "vector.hh"
 #include "utils.hh"
 
+#include <cstring>
+#include <type_traits>
+
 namespace Kakoune
 {
 
@@ -35,10 +39,15 @@ struct CharacterClass
 {
     struct Range { Codepoint min, max; };
 
+    static constexpr Codepoint ascii_count = 128;
+
     Vector<Range, MemoryDomain::Regex> ranges;
     CharacterType ctypes = CharacterType::None;
     bool negative = false;
     bool ignore_case = false;
+    // precomputed at compile time so matching an ascii codepoint is a
+    // single table load instead of a range search and ctype tests
+    bool ascii_map[ascii_count] = {};
 };
 
 bool is_character_class(const CharacterClass& character_class, Codepoint cp);
@@ -116,14 +125,34 @@ struct CompiledRegex : RefCountable, UseMemoryDomain<MemoryDomain::Regex>
         static constexpr Codepoint count = 128;
         static constexpr Codepoint other = 0;
         bool map[count];
+        // set at compile time when the map accepts a single ascii char and
+        // rejects everything else, which allows skipping with memchr
+        char only_char = 0;
     };
 
     std::unique_ptr<StartDesc> forward_start_desc;
     std::unique_ptr<StartDesc> backward_start_desc;
+
+    // Set when the whole pattern is one plain literal (stored lowercase
+    // for literal_ignore_case, which is only eligible for pure ascii
+    // literals); execution then bypasses the vm with a substring scan.
+    String literal;
+    bool literal_ignore_case = false;
 };
 
 String dump_regex(const CompiledRegex& program);
 
+// Cumulative execution counters, flushed by ThreadedRegexVM after every
+// run; hooks can sample the %val{regex_steps} delta around a frame to
+// flag pathological expressions (see also `debug regex`).
+extern size_t regex_executed_instructions;
+extern size_t regex_spawned_threads;
+
+// Returns true when no match of the program can contain or cross an end
+// of line, which allows callers to scan a buffer range line by line over
+// the contiguous line storage instead of through buffer iterators.
+bool is_line_local(const CompiledRegex& program);
+
 enum class RegexCompileFlags
 {
     None     = 0,
@@ -191,12 +220,13 @@ public:
 
     ~ThreadedRegexVM()
     {
+        const size_t size = saves_size(m_program.save_count);
         for (auto* saves : m_saves)
         {
             for (size_t i = m_program.save_count-1; i > 0; --i)
                 saves->pos[i].~Iterator();
             saves->~Saves();
-            operator delete(saves);
+            release_saves_block(saves, size);
         }
     }
 
@@ -207,6 +237,9 @@ public:
         if (flags & RegexExecFlags::NotInitialNull and begin == end)
             return false;
 
+        if (not m_program.literal.empty())
+            return exec_literal(begin, end);
+
         constexpr bool search = (mode & RegexMode::Search);
 
         ConstArrayView<CompiledRegex::Instruction> instructions{m_program.instructions};
@@ -259,6 +292,49 @@ private:
         Iterator pos[1];
     };
 
+    static constexpr size_t saves_size(size_t count)
+    {
+        return sizeof(Saves) + (count-1) * sizeof(Iterator);
+    }
+
+    // Saves blocks are pooled between VM instances: highlighters and
+    // search primitives construct a VM per match attempt, and the blocks
+    // a previous VM released are almost always the size the next one
+    // asks for, so the steady state loop stops hitting the allocator.
+    struct SavesBlock { void* ptr; size_t size; };
+
+    static Vector<SavesBlock, MemoryDomain::Regex>& saves_block_pool()
+    {
+        static Vector<SavesBlock, MemoryDomain::Regex> pool;
+        return pool;
+    }
+
+    static void* acquire_saves_block(size_t size)
+    {
+        auto& pool = saves_block_pool();
+        for (auto& block : pool)
+        {
+            if (block.size == size)
+            {
+                void* ptr = block.ptr;
+                std::swap(block, pool.back());
+                pool.pop_back();
+                return ptr;
+            }
+        }
+        return operator new (size);
+    }
+
+    static void release_saves_block(void* ptr, size_t size)
+    {
+        constexpr size_t max_pooled_blocks = 256;
+        auto& pool = saves_block_pool();
+        if (pool.size() < max_pooled_blocks)
+            pool.push_back({ptr, size});
+        else
+            operator delete(ptr);
+    }
+
     template<bool copy>
     int16_t new_saves(Iterator* pos)
     {
@@ -278,7 +354,7 @@ private:
             return res;
         }
 
-        void* ptr = operator new (sizeof(Saves) + (count-1) * sizeof(Iterator));
+        void* ptr = acquire_saves_block(saves_size(count));
         Saves* saves = new (ptr) Saves{1, 0, {copy ? pos[0] : Iterator{}}};
         for (size_t i = 1; i < count; ++i)
             new (&saves->pos[i]) Iterator{copy ? pos[i] : Iterator{}};
@@ -308,6 +384,9 @@ private:
 
     using StartDesc = CompiledRegex::StartDesc;
     using Sentinel = typename SentinelType<Iterator>::Type;
+    // stands for the codepoint at the end of the subject, where no
+    // character can be consumed; never a valid decoded codepoint
+    static constexpr Codepoint end_cp = (Codepoint)-1;
     struct ExecConfig
     {
         const Sentinel begin;
@@ -319,7 +398,9 @@ private:
     };
 
     // Steps a thread until it consumes the current character, matches or fail
-    void step_thread(const Iterator& pos, uint16_t current_step, Thread thread, const ExecConfig& config)
+    // cp is the codepoint at pos, decoded once per position by the caller so
+    // that the threads probing it do not each pay the utf8 decoding
+    void step_thread(const Iterator& pos, Codepoint cp, uint16_t current_step, Thread thread, const ExecConfig& config)
     {
         auto failed = [this, &thread]() {
             release_saves(thread.saves);
@@ -334,6 +415,7 @@ private:
         auto* instructions = m_program.instructions.data();
         while (true)
         {
+            ++m_executed_instructions;
             auto& inst = instructions[thread.inst++];
             // if this instruction was already executed for this step in another thread,
             // then this thread is redundant and can be dropped
@@ -344,17 +426,17 @@ private:
             switch (inst.op)
             {
                 case CompiledRegex::Literal:
-                    if (pos != config.end and inst.param == codepoint(pos, config))
+                    if (inst.param == cp) // end of data is encoded as an invalid codepoint
                         return consumed();
                     return failed();
                 case CompiledRegex::Literal_IgnoreCase:
-                    if (pos != config.end and inst.param == to_lower(codepoint(pos, config)))
+                    if (cp != end_cp and inst.param == to_lower(cp))
                         return consumed();
                     return failed();
                 case CompiledRegex::AnyChar:
                     return consumed();
                 case CompiledRegex::AnyCharExceptNewLine:
-                    if (pos != config.end and codepoint(pos, config) != '\n')
+                    if (cp != end_cp and cp != '\n')
                         return consumed();
                     return failed();
                 case CompiledRegex::Jump:
@@ -364,6 +446,7 @@ private:
                 {
                     if (thread.saves >= 0)
                         ++m_saves[thread.saves]->refcount;
+                    ++m_spawned_threads;
                     m_threads.push_current({static_cast<int16_t>(inst.param), thread.saves});
                     break;
                 }
@@ -371,6 +454,7 @@ private:
                 {
                     if (thread.saves >= 0)
                         ++m_saves[thread.saves]->refcount;
+                    ++m_spawned_threads;
                     m_threads.push_current({thread.inst, thread.saves});
                     thread.inst = static_cast<uint16_t>(inst.param);
                     break;
@@ -390,14 +474,14 @@ private:
                     break;
                 }
                 case CompiledRegex::Class:
-                    if (pos == config.end)
+                    if (cp == end_cp)
                         return failed();
-                    return is_character_class(m_program.character_classes[inst.param], codepoint(pos, config)) ?
+                    return is_character_class(m_program.character_classes[inst.param], cp) ?
                         consumed() : failed();
                 case CompiledRegex::CharacterType:
-                    if (pos == config.end)
+                    if (cp == end_cp)
                         return failed();
-                    return is_ctype((CharacterType)inst.param, codepoint(pos, config)) ?
+                    return is_ctype((CharacterType)inst.param, cp) ?
                         consumed() : failed();
                 case CompiledRegex::LineStart:
                     if (not is_line_start(pos, config))
@@ -473,6 +557,7 @@ private:
         m_threads.grow_ifn();
 
         const int16_t first_inst = forward ? 0 : m_program.first_backward_inst;
+        ++m_spawned_threads;
         m_threads.push_current({first_inst, -1});
 
         const auto& start_desc = forward ? m_program.forward_start_desc : m_program.backward_start_desc;
@@ -489,10 +574,30 @@ private:
                 for (auto& inst : config.instructions)
                     inst.last_step = 0;
                 current_step = 1; // step 0 is never valid
+
+                // long scans abort on cancellation; release the live
+                // threads first so the vm stays reusable
+                try
+                {
+                    cancellation_point(false);
+                }
+                catch (...)
+                {
+                    while (not m_threads.current_is_empty())
+                        release_saves(m_threads.pop_current().saves);
+                    for (auto& t : m_threads.next_threads())
+                        release_saves(t.saves);
+                    m_threads.clear_next();
+                    m_executed_instructions = 0;
+                    m_spawned_threads = 0;
+                    throw;
+                }
             }
 
+            const Codepoint cp = pos == config.end ?
+                end_cp : codepoint(pos, config);
             while (not m_threads.current_is_empty())
-                step_thread(pos, current_step, m_threads.pop_current(), config);
+                step_thread(pos, cp, current_step, m_threads.pop_current(), config);
 
             for (auto& thread : m_threads.next_threads())
                 m_program.instructions[thread.inst].scheduled = false;
@@ -504,6 +609,10 @@ private:
                 for (auto& t : m_threads.next_threads())
                     release_saves(t.saves);
                 m_threads.clear_next();
+                regex_executed_instructions += m_executed_instructions;
+                regex_spawned_threads += m_spawned_threads;
+                m_executed_instructions = 0;
+                m_spawned_threads = 0;
                 return m_found_match;
             }
 
@@ -512,17 +621,156 @@ private:
 
             if (search and not m_found_match)
             {
-                if (start_desc and m_threads.next_is_empty())
-                    to_next_start(pos, config, *start_desc);
-                m_threads.grow_ifn();
-                m_threads.push_next({first_inst, -1});
+                bool spawn = true;
+                if (start_desc)
+                {
+                    if (m_threads.next_is_empty())
+                        to_next_start(pos, config, *start_desc);
+                    else if (pos != config.end)
+                    {
+                        // Other threads are still running; a new one is only
+                        // worth spawning if this position can start a match,
+                        // else it would execute instructions just to fail
+                        // its first probe.
+                        const Codepoint cp = codepoint(pos, config);
+                        spawn = start_desc->map[cp < StartDesc::count ? cp : StartDesc::other];
+                    }
+                    else // a start desc implies matches consume at least one char
+                        spawn = false;
+                }
+                if (spawn)
+                {
+                    m_threads.grow_ifn();
+                    ++m_spawned_threads;
+                    m_threads.push_next({first_inst, -1});
+                }
             }
             m_threads.swap_next();
         }
     }
 
+    // The whole pattern is one plain literal: bypass the vm and scan the
+    // subject for it directly. Contiguous case sensitive subjects get
+    // memmem; everything else decodes codepoints so that case folding
+    // stays identical to what Literal_IgnoreCase instructions do.
+    bool exec_literal(const Iterator& begin, const Iterator& end)
+    {
+        release_saves(m_captures);
+        m_captures = -1;
+        m_found_match = false;
+
+        constexpr bool search = mode & RegexMode::Search;
+        const String& literal = m_program.literal;
+        const bool ignore_case = m_program.literal_ignore_case;
+
+        bool found = false;
+        Iterator match_begin{begin}, match_end{begin};
+
+        [&, this] {
+            if constexpr (std::is_same_v<Iterator, const char*>)
+            {
+                if (not ignore_case)
+                {
+                    const size_t len = (size_t)(int)literal.length();
+                    if (not search)
+                    {
+                        found = (size_t)(end - begin) == len and
+                                memcmp(begin, literal.data(), len) == 0;
+                        match_end = end;
+                    }
+                    else for (auto* p = begin; (size_t)(end - p) >= len;
+                              p = match_begin + 1)
+                    {
+                        auto* q = static_cast<const char*>(
+                            memmem(p, end - p, literal.data(), len));
+                        if (not q)
+                            break;
+                        found = true;
+                        match_begin = q;
+                        match_end = q + len;
+                        if (forward) // backward keeps the last occurrence
+                            break;
+                    }
+                    return;
+                }
+            }
+
+            auto match_at = [&](Iterator it, Iterator& out_end) {
+                for (const char* lit = literal.begin(); lit != literal.end(); )
+                {
+                    const Codepoint wanted = utf8::read_codepoint(lit, literal.end());
+                    if (it == end)
+                        return false;
+                    const Codepoint cp = utf8::read_codepoint(it, end);
+                    if ((ignore_case ? to_lower(cp) : cp) != wanted)
+                        return false;
+                }
+                out_end = it;
+                return true;
+            };
+
+            if (not search)
+            {
+                found = match_at(begin, match_end) and match_end == end;
+                match_end = end;
+            }
+            else for (Iterator pos = begin; pos != end; utf8::to_next(pos, end))
+            {
+                Iterator it_end{pos};
+                if (match_at(pos, it_end))
+                {
+                    found = true;
+                    match_begin = pos;
+                    match_end = it_end;
+                    if (forward) // backward keeps the last occurrence
+                        break;
+                }
+            }
+        }();
+
+        if (found)
+        {
+            m_found_match = true;
+            if constexpr (not (bool)(mode & RegexMode::NoSaves))
+            {
+                m_captures = new_saves<false>(nullptr);
+                m_saves[m_captures]->pos[0] = match_begin;
+                m_saves[m_captures]->pos[1] = match_end;
+            }
+        }
+        return m_found_match;
+    }
+
     void to_next_start(Iterator& start, const ExecConfig& config, const StartDesc& start_desc)
     {
+        if (forward and not start_desc.map[StartDesc::other])
+        {
+            if constexpr (forward and std::is_same_v<Iterator, const char*>)
+            {
+                if (start_desc.only_char)
+                {
+                    // the classic literal prescan: let memchr skip to the
+                    // only byte a match can possibly start on
+                    auto* res = static_cast<const char*>(
+                        memchr(start, start_desc.only_char, config.end - start));
+                    start = res ? res : config.end;
+                    return;
+                }
+            }
+
+            // Pure ascii start set: scan raw bytes without decoding
+            // codepoints; the bytes of multi byte characters all fall in the
+            // rejected other bucket so this only stops on a boundary.
+            while (start != config.end)
+            {
+                const unsigned char c = *start;
+                if (c < StartDesc::count and start_desc.map[c])
+                    return;
+                ++start;
+            }
+            return;
+        }
+
         while (start != config.end)
         {
             const Codepoint cp = read_codepoint(start, config);
@@ -633,9 +881,30 @@ private:
 
     struct DualThreadStack
     {
-        DualThreadStack() = default;
+        // The thread buffer is handed back and forth with a single entry
+        // cache so that constructing a VM per match attempt does not redo
+        // the doubling growth every time; once warm the cached buffer has
+        // the size the program needs and construction allocates nothing.
+        DualThreadStack()
+        {
+            auto& cached = cache();
+            m_data = cached.data;
+            m_capacity = cached.size;
+            cached = {};
+            m_next = m_capacity;
+        }
         DualThreadStack(const DualThreadStack&) = delete;
-        ~DualThreadStack() { delete[] m_data; }
+        ~DualThreadStack()
+        {
+            auto& cached = cache();
+            if (m_capacity > cached.size)
+            {
+                delete[] cached.data;
+                cached = {m_data, m_capacity};
+            }
+            else
+                delete[] m_data;
+        }
 
         bool current_is_empty() const { return m_current == 0; }
         bool next_is_empty() const { return m_next == m_capacity; }
@@ -673,6 +942,13 @@ private:
         }
 
     private:
+        struct CachedBuffer { Thread* data = nullptr; int32_t size = 0; };
+        static CachedBuffer& cache()
+        {
+            static CachedBuffer res;
+            return res;
+        }
+
         Thread* m_data = nullptr;
         int32_t m_capacity = 0; // Maximum capacity should be 2*instruction count, so 65536
         int32_t m_current = 0;
@@ -687,6 +963,8 @@ private:
     int16_t m_first_free = -1;
     int16_t m_captures = -1;
     bool m_found_match = false;
+    size_t m_executed_instructions = 0;
+    size_t m_spawned_threads = 0;
 };
 
 }
@@ -5,6 +5,7 @@
 #include "exception.hh"
 #include "utils.hh"
 #include "hash_map.hh"
+#include "shared_string.hh"
 #include "string.hh"
 #include "vector.hh"
 
@@ -79,33 +80,73 @@ private:
     Setter m_setter;
 };
 
+// Dynamic register whose main selection value can be retrieved without
+// materializing the whole register content, which for registers derived
+// from the selections costs one string per selection
+template<typename Getter, typename Setter, typename MainGetter>
+class DynamicRegisterWithMain : public DynamicRegister<Getter, Setter>
+{
+public:
+    DynamicRegisterWithMain(Getter getter, Setter setter, MainGetter main_getter)
+        : DynamicRegister<Getter, Setter>{std::move(getter), std::move(setter)},
+          m_main_getter{std::move(main_getter)} {}
+
+    const String& get_main(const Context& context, size_t main_index) override
+    {
+        m_main = m_main_getter(context, main_index);
+        return m_main;
+    }
+
+private:
+    MainGetter m_main_getter;
+    String m_main;
+};
+
 // Register that is used to store some kind prompt history
 class HistoryRegister : public StaticRegister
 {
 public:
-    void set(Context& context, ConstArrayView<String> values, bool restoring) override
+    void set(Context&, ConstArrayView<String> values, bool restoring) override
     {
         constexpr size_t size_limit = 100;
 
         if (restoring)
-            return StaticRegister::set(context, values, true);
+            m_history.clear();
+        m_history.reserve(size_limit);
 
         for (auto& entry : values)
         {
-            m_content.erase(std::remove(m_content.begin(), m_content.end(), entry),
-                          m_content.end());
-            m_content.push_back(entry);
+            // history entries are interned, which shares the storage of
+            // repeated entries and makes looking for a previous occurence
+            // a pointer comparison
+            auto str = intern(entry);
+            m_history.erase(std::remove(m_history.begin(), m_history.end(), str),
+                            m_history.end());
+            if (m_history.size() == size_limit)
+                m_history.erase(m_history.begin());
+            m_history.push_back(std::move(str));
         }
+        m_content.clear();
+    }
 
-        const size_t current_size = m_content.size();
-        if (current_size > size_limit)
-            m_content.erase(m_content.begin(), m_content.begin() + (current_size - size_limit));
+    ConstArrayView<String> get(const Context& context) override
+    {
+        // the Register interface hands out Strings, materialize the
+        // history lazily, only when it changed since the last access
+        if (m_content.size() != m_history.size())
+            m_content = m_history | transform([](auto& str) { return str->strview().str(); })
+                                  | gather<Vector<String, MemoryDomain::Registers>>();
+        return StaticRegister::get(context);
     }
 
-    const String& get_main(const Context&, size_t) override
+    const String& get_main(const Context& context, size_t) override
     {
-        return m_content.empty() ? String::ms_empty : m_content.back();
+        auto content = get(context);
+        return content[content.size() - 1];
     }
+
+private:
+    Vector<StringDataPtr, MemoryDomain::Registers> m_history;
 };
 
 template<typename Func>
@@ -124,6 +165,24 @@ std::unique_ptr<Register> make_dyn_reg(Getter getter, Setter setter)
     return std::make_unique<DynamicRegister<Getter, Setter>>(std::move(getter), std::move(setter));
 }
 
+template<typename Func, typename MainFunc>
+std::unique_ptr<Register> make_dyn_reg_with_main(Func func, MainFunc main_func)
+{
+    auto setter = [](Context&, ConstArrayView<String>)
+    {
+        throw runtime_error("this register is not assignable");
+    };
+    return std::make_unique<DynamicRegisterWithMain<Func, decltype(setter), MainFunc>>(
+        std::move(func), setter, std::move(main_func));
+}
+
+template<typename Getter, typename Setter, typename MainFunc>
+std::unique_ptr<Register> make_dyn_reg_with_main(Getter getter, Setter setter, MainFunc main_func)
+{
+    return std::make_unique<DynamicRegisterWithMain<Getter, Setter, MainFunc>>(
+        std::move(getter), std::move(setter), std::move(main_func));
+}
+
 class NullRegister : public Register
 {
 public:
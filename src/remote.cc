@@ -43,8 +43,23 @@ enum class MessageType : uint8_t
     SetOptions,
     Exit,
     Key,
+    DrawDelta,
+    Paste,
+    DrawDeltaRef,
+    DrawDeltaPart,
 };
 
+// Bumped when the ui messages change; the client sends its version in the
+// Connect message, the server only uses messages the client understands.
+// Version 1 introduced DrawDelta.
+// Version 2 introduced the client to server Paste message.
+// Version 3 introduced DrawDeltaRef, whose entries can reference lines of
+// the previous frame instead of resending their content.
+// Version 4 introduced DrawDeltaPart, which carries a prefix of the frame
+// that the client applies without repainting; the server flushes those
+// chunks to the socket while the rest of the frame still serializes.
+constexpr uint32_t ui_protocol_version = 4;
+
 class MsgWriter
 {
 public:
@@ -233,6 +248,12 @@ public:
         return m_write_pos >= header_size and m_write_pos == size();
     }
 
+    // a message is being received, so a disconnection would truncate it
+    bool started() const
+    {
+        return m_write_pos != 0;
+    }
+
     uint32_t size() const
     {
         kak_assert(m_write_pos >= header_size);
@@ -346,7 +367,7 @@ struct MsgReader::Reader<DisplayBuffer> {
 class RemoteUI : public UserInterface
 {
 public:
-    RemoteUI(int socket, DisplayCoord dimensions);
+    RemoteUI(int socket, DisplayCoord dimensions, uint32_t protocol_version);
     ~RemoteUI() override;
 
     bool is_ok() const override { return m_socket_watcher.fd() != -1; }
@@ -378,6 +399,9 @@ public:
     void set_on_key(OnKeyCallback callback) override
     { m_on_key = std::move(callback); }
 
+    void set_on_paste(OnPasteCallback callback) override
+    { m_on_paste = std::move(callback); }
+
     void set_ui_options(const Options& options) override;
 
     void exit(int status);
@@ -391,26 +415,57 @@ private:
         m_socket_watcher.events() |= FdEvents::Write;
     }
 
+    void flush_send_buffer();
+
     FDWatcher     m_socket_watcher;
     MsgReader     m_reader;
     DisplayCoord  m_dimensions;
     OnKeyCallback m_on_key;
+    OnPasteCallback m_on_paste;
     RemoteBuffer  m_send_buffer;
+    uint32_t      m_protocol_version;
+    Vector<size_t, MemoryDomain::Remote> m_sent_line_hashes;
 };
 
 static bool send_data(int fd, RemoteBuffer& buffer)
 {
-    while (not buffer.empty() and fd_writable(fd))
+    size_t pos = 0;
+    while (pos != buffer.size() and fd_writable(fd))
     {
-      int res = ::write(fd, buffer.data(), buffer.size());
+      int res = ::write(fd, buffer.data() + pos, buffer.size() - pos);
       if (res <= 0)
           throw disconnected{format("socket write failed: {}", strerror(errno))};
-      buffer.erase(buffer.begin(), buffer.begin() + res);
+      pos += res;
     }
+    // compact once after draining instead of memmoving the whole
+    // remaining payload after every partial write
+    buffer.erase(buffer.begin(), buffer.begin() + pos);
     return buffer.empty();
 }
 
-RemoteUI::RemoteUI(int socket, DisplayCoord dimensions)
+// try to push buffered messages to the socket right away instead of
+// waiting for the next event loop turn, whatever does not fit stays
+// buffered for the socket watcher
+void RemoteUI::flush_send_buffer()
+{
+    const int sock = m_socket_watcher.fd();
+    if (sock == -1 or m_send_buffer.empty())
+        return;
+    try
+    {
+        if (send_data(sock, m_send_buffer))
+            m_socket_watcher.events() &= ~FdEvents::Write;
+        else
+            m_socket_watcher.events() |= FdEvents::Write;
+    }
+    catch (const disconnected& err)
+    {
+        write_to_debug_buffer(format("Error while transfering remote messages: {}", err.what()));
+        m_socket_watcher.close_fd();
+    }
+}
+
+RemoteUI::RemoteUI(int socket, DisplayCoord dimensions, uint32_t protocol_version)
     : m_socket_watcher(socket,  FdEvents::Read | FdEvents::Write,
                        [this](FDWatcher& watcher, FdEvents events, EventMode) {
           const int sock = watcher.fd();
@@ -426,17 +481,25 @@ RemoteUI::RemoteUI(int socket, DisplayCoord dimensions)
                   if (not m_reader.ready())
                       continue;
 
-                   if (m_reader.type() != MessageType::Key)
+                   if (m_reader.type() == MessageType::Key)
+                   {
+                       auto key = m_reader.read<Key>();
+                       m_reader.reset();
+                       if (key.modifiers == Key::Modifiers::Resize)
+                           m_dimensions = key.coord();
+                       m_on_key(key);
+                   }
+                   else if (m_reader.type() == MessageType::Paste)
+                   {
+                       auto content = m_reader.read<String>();
+                       m_reader.reset();
+                       m_on_paste(content);
+                   }
+                   else
                    {
                        m_socket_watcher.close_fd();
                        return;
                    }
-
-                   auto key = m_reader.read<Key>();
-                   m_reader.reset();
-                   if (key.modifiers == Key::Modifiers::Resize)
-                       m_dimensions = key.coord();
-                   m_on_key(key);
               }
           }
           catch (const disconnected& err)
@@ -445,7 +508,8 @@ RemoteUI::RemoteUI(int socket, DisplayCoord dimensions)
               m_socket_watcher.close_fd();
           }
       }),
-      m_dimensions(dimensions)
+      m_dimensions(dimensions),
+      m_protocol_version(protocol_version)
 {
     write_to_debug_buffer(format("remote client connected: {}", m_socket_watcher.fd()));
 }
@@ -495,11 +559,102 @@ void RemoteUI::info_hide()
     send_message(MessageType::InfoHide);
 }
 
+static size_t hash_display_line(const DisplayLine& line)
+{
+    size_t hash = 0;
+    for (auto& atom : line)
+        hash = combine_hash(hash, hash_values(atom.content(), atom.face));
+    return hash;
+}
+
 void RemoteUI::draw(const DisplayBuffer& display_buffer,
                     const Face& default_face,
                     const Face& padding_face)
 {
-    send_message(MessageType::Draw, display_buffer, default_face, padding_face);
+    auto& lines = display_buffer.lines();
+    if (m_protocol_version < 1 or m_sent_line_hashes.empty())
+    {
+        send_message(MessageType::Draw, display_buffer, default_face, padding_face);
+        if (m_protocol_version >= 1)
+        {
+            m_sent_line_hashes.clear();
+            for (auto& line : lines)
+                m_sent_line_hashes.push_back(hash_display_line(line));
+        }
+        flush_send_buffer();
+        return;
+    }
+
+    // only transmit the lines whose rendering changed since the last
+    // frame, the client keeps a copy of what was sent
+    Vector<uint32_t, MemoryDomain::Remote> changed;
+    Vector<size_t, MemoryDomain::Remote> hashes;
+    hashes.reserve(lines.size());
+    for (uint32_t i = 0; i < lines.size(); ++i)
+    {
+        const size_t hash = hash_display_line(lines[i]);
+        hashes.push_back(hash);
+        if (i >= m_sent_line_hashes.size() or m_sent_line_hashes[i] != hash)
+            changed.push_back(i);
+    }
+
+    const bool with_refs = m_protocol_version >= 3;
+    // with protocol 4, serialize the frame as partial delta messages and
+    // flush each one while the next serializes, so the first changed
+    // lines reach the client before the whole frame is encoded
+    const uint32_t chunk_size = m_protocol_version >= 4 ?
+        32 : std::max<uint32_t>(changed.size(), 1);
+    // the client rebases every message on its current lines, so a ref must
+    // not target a previous frame line an earlier chunk overwrote, nor one
+    // past the new frame size that the client side resize dropped
+    Vector<bool, MemoryDomain::Remote> overwritten(m_sent_line_hashes.size(), false);
+    for (uint32_t begin = 0; ; begin += chunk_size)
+    {
+        const uint32_t count = std::min<uint32_t>(chunk_size, changed.size() - begin);
+        const bool last = begin + count == changed.size();
+        {
+            MsgWriter msg{m_send_buffer,
+                          not last ? MessageType::DrawDeltaPart
+                                   : with_refs ? MessageType::DrawDeltaRef
+                                               : MessageType::DrawDelta};
+            msg.write((uint32_t)lines.size(), count);
+            for (auto index : ConstArrayView<uint32_t>{changed}.subrange(begin, count))
+            {
+                // when scrolling, most changed lines exist verbatim at another
+                // position in the previous frame, reference them instead of
+                // resending their content
+                if (with_refs)
+                {
+                    if (auto it = find(m_sent_line_hashes, hashes[index]);
+                        it != m_sent_line_hashes.end() and
+                        (size_t)(it - m_sent_line_hashes.begin()) < lines.size() and
+                        not overwritten[it - m_sent_line_hashes.begin()])
+                    {
+                        msg.write(index, (uint8_t)1,
+                                  (uint32_t)(it - m_sent_line_hashes.begin()));
+                        continue;
+                    }
+                    msg.write(index, (uint8_t)0, lines[index]);
+                }
+                else
+                    msg.write(index, lines[index]);
+            }
+            if (last)
+                msg.write(default_face, padding_face);
+        }
+        m_socket_watcher.events() |= FdEvents::Write;
+        flush_send_buffer();
+        if (last)
+            break;
+        for (auto index : ConstArrayView<uint32_t>{changed}.subrange(begin, count))
+        {
+            // the previous frame line at the slot this chunk wrote is gone;
+            // slots past the previous frame never were referenceable
+            if (index < overwritten.size())
+                overwritten[index] = true;
+        }
+    }
+    m_sent_line_hashes = std::move(hashes);
 }
 
 void RemoteUI::draw_status(const DisplayLine& status_line,
@@ -572,10 +727,21 @@ static sockaddr_un session_addr(StringView session)
     return addr;
 }
 
+// draw messages for a large window can reach hundreds of kilobytes,
+// large kernel buffers let a whole frame transit with a single
+// write/read syscall pair instead of several partial ones
+static void set_socket_buffer_size(int sock)
+{
+    constexpr int buffer_size = 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+}
+
 static int connect_to(StringView session)
 {
     int sock = socket(AF_UNIX, SOCK_STREAM, 0);
     fcntl(sock, F_SETFD, FD_CLOEXEC);
+    set_socket_buffer_size(sock);
     sockaddr_un addr = session_addr(session);
     if (connect(sock, (sockaddr*)&addr, sizeof(addr.sun_path)) == -1)
         throw disconnected(format("connect to {} failed", addr.sun_path));
@@ -599,7 +765,8 @@ RemoteClient::RemoteClient(StringView session, StringView name, std::unique_ptr<
 
     {
         MsgWriter msg{m_send_buffer, MessageType::Connect};
-        msg.write(pid, name, init_command, init_coord, m_ui->dimensions(), env_vars);
+        msg.write(pid, ui_protocol_version, name, init_command, init_coord,
+                  m_ui->dimensions(), env_vars);
     }
 
     m_ui->set_on_key([this](Key key){
@@ -608,6 +775,12 @@ RemoteClient::RemoteClient(StringView session, StringView name, std::unique_ptr<
         m_socket_watcher->events() |= FdEvents::Write;
      });
 
+    m_ui->set_on_paste([this](StringView content){
+        MsgWriter msg(m_send_buffer, MessageType::Paste);
+        msg.write(content);
+        m_socket_watcher->events() |= FdEvents::Write;
+     });
+
     m_socket_watcher.reset(new FDWatcher{sock, FdEvents::Read | FdEvents::Write,
                            [this, reader = MsgReader{}](FDWatcher& watcher, FdEvents events, EventMode) mutable {
         const int sock = watcher.fd();
@@ -656,10 +829,80 @@ RemoteClient::RemoteClient(StringView session, StringView name, std::unique_ptr<
                 break;
             case MessageType::Draw:
             {
-                auto display_buffer = reader.read<DisplayBuffer>();
+                m_display_buffer = reader.read<DisplayBuffer>();
+                auto default_face = reader.read<Face>();
+                auto padding_face = reader.read<Face>();
+                m_ui->draw(m_display_buffer, default_face, padding_face);
+                break;
+            }
+            case MessageType::DrawDelta:
+            {
+                auto& lines = m_display_buffer.lines();
+                lines.resize(reader.read<uint32_t>());
+                auto changed = reader.read<uint32_t>();
+                while (changed--)
+                {
+                    auto index = reader.read<uint32_t>();
+                    auto line = reader.read<DisplayLine>();
+                    if (index < lines.size())
+                        lines[index] = std::move(line);
+                }
+                auto default_face = reader.read<Face>();
+                auto padding_face = reader.read<Face>();
+                m_ui->draw(m_display_buffer, default_face, padding_face);
+                break;
+            }
+            case MessageType::DrawDeltaPart:
+            {
+                // a prefix of the current frame, the repaint happens
+                // with the final delta message
+                auto& lines = m_display_buffer.lines();
+                auto previous = lines; // references target the previous frame
+                lines.resize(reader.read<uint32_t>());
+                auto changed = reader.read<uint32_t>();
+                while (changed--)
+                {
+                    auto index = reader.read<uint32_t>();
+                    if (reader.read<uint8_t>())
+                    {
+                        auto source = reader.read<uint32_t>();
+                        if (index < lines.size() and source < previous.size())
+                            lines[index] = previous[source];
+                    }
+                    else
+                    {
+                        auto line = reader.read<DisplayLine>();
+                        if (index < lines.size())
+                            lines[index] = std::move(line);
+                    }
+                }
+                break;
+            }
+            case MessageType::DrawDeltaRef:
+            {
+                auto& lines = m_display_buffer.lines();
+                auto previous = lines; // references target the previous frame
+                lines.resize(reader.read<uint32_t>());
+                auto changed = reader.read<uint32_t>();
+                while (changed--)
+                {
+                    auto index = reader.read<uint32_t>();
+                    if (reader.read<uint8_t>())
+                    {
+                        auto source = reader.read<uint32_t>();
+                        if (index < lines.size() and source < previous.size())
+                            lines[index] = previous[source];
+                    }
+                    else
+                    {
+                        auto line = reader.read<DisplayLine>();
+                        if (index < lines.size())
+                            lines[index] = std::move(line);
+                    }
+                }
                 auto default_face = reader.read<Face>();
                 auto padding_face = reader.read<Face>();
-                m_ui->draw(display_buffer, default_face, padding_face);
+                m_ui->draw(m_display_buffer, default_face, padding_face);
                 break;
             }
             case MessageType::DrawStatus:
@@ -734,6 +977,8 @@ private:
         const int sock = m_socket_watcher.fd();
         try
         {
+            while (true)
+            {
             while (not m_reader.ready() and fd_readable(sock))
                 m_reader.read_available(sock);
 
@@ -745,19 +990,20 @@ private:
             case MessageType::Connect:
             {
                 auto pid = m_reader.read<int>();
+                auto protocol_version = m_reader.read<uint32_t>();
                 auto name = m_reader.read<String>();
                 auto init_cmds = m_reader.read<String>();
                 auto init_coord = m_reader.read<Optional<BufferCoord>>();
                 auto dimensions = m_reader.read<DisplayCoord>();
                 auto env_vars = m_reader.read<HashMap<String, String, MemoryDomain::EnvVars>>();
-                auto* ui = new RemoteUI{sock, dimensions};
+                auto* ui = new RemoteUI{sock, dimensions, protocol_version};
                 ClientManager::instance().create_client(
                     std::unique_ptr<UserInterface>(ui), pid, std::move(name),
                     std::move(env_vars), init_cmds, init_coord,
                     [ui](int status) { ui->exit(status); });
 
                 Server::instance().remove_accepter(this);
-                break;
+                return;
             }
             case MessageType::Command:
             {
@@ -772,19 +1018,25 @@ private:
                     write_to_debug_buffer(format("error running command '{}': {}",
                                                  command, e.what()));
                 }
-                close(sock);
-                Server::instance().remove_accepter(this);
+                // keep the connection open so tooling can stream further
+                // command messages without reconnecting; closing the
+                // socket raises disconnected on the next read
+                m_reader.reset();
                 break;
             }
             default:
                 write_to_debug_buffer("invalid introduction message received");
                 close(sock);
                 Server::instance().remove_accepter(this);
+                return;
+            }
             }
         }
         catch (const disconnected& err)
         {
-            write_to_debug_buffer(format("accepting connection failed: {}", err.what()));
+            // closing between messages is how clients end the connection
+            if (m_reader.started())
+                write_to_debug_buffer(format("accepting connection failed: {}", err.what()));
             close(sock);
             Server::instance().remove_accepter(this);
         }
@@ -800,6 +1052,11 @@ Server::Server(String session_name)
     if (not all_of(m_session, is_identifier))
         throw runtime_error{format("invalid session name: '{}'", session_name)};
 
+    make_listener();
+}
+
+void Server::make_listener()
+{
     int listen_sock = socket(AF_UNIX, SOCK_STREAM, 0);
     fcntl(listen_sock, F_SETFD, FD_CLOEXEC);
     sockaddr_un addr = session_addr(m_session);
@@ -826,6 +1083,7 @@ Server::Server(String session_name)
         if (sock == -1)
             throw runtime_error("accept failed");
         fcntl(sock, F_SETFD, FD_CLOEXEC);
+        set_socket_buffer_size(sock);
 
         m_accepters.emplace_back(new Accepter{sock});
     };
@@ -850,6 +1108,35 @@ bool Server::rename_session(StringView name)
     return true;
 }
 
+void Server::fork_session(StringView name)
+{
+    if (not all_of(name, is_identifier))
+        throw runtime_error{format("invalid session name: '{}'", name)};
+    if (file_exists(session_path(name)))
+        throw runtime_error{format("session '{}' already exists", name)};
+
+    m_pending_fork_session = name.str();
+}
+
+Optional<String> Server::take_pending_fork_session()
+{
+    auto session = std::move(m_pending_fork_session);
+    m_pending_fork_session.reset();
+    return session;
+}
+
+void Server::reset_session(String name)
+{
+    kak_assert(all_of(name, is_identifier));
+
+    // close the sockets inherited from the template server, they are
+    // still owned by it, then serve the new session
+    close_session(false);
+    m_accepters.clear();
+    m_session = std::move(name);
+    make_listener();
+}
+
 void Server::close_session(bool do_unlink)
 {
     if (do_unlink)
@@ -1,6 +1,7 @@
 #ifndef remote_hh_INCLUDED
 #define remote_hh_INCLUDED
 
+#include "display_buffer.hh"
 #include "env_vars.hh"
 #include "exception.hh"
 #include "utils.hh"
@@ -41,6 +42,7 @@ private:
     std::unique_ptr<FDWatcher>     m_socket_watcher;
     RemoteBuffer                   m_send_buffer;
     Optional<int>                  m_exit_status;
+    DisplayBuffer                  m_display_buffer;
 };
 
 void send_command(StringView session, StringView command);
@@ -57,13 +59,22 @@ struct Server : public Singleton<Server>
     bool rename_session(StringView name);
     void close_session(bool do_unlink = true);
 
+    // queue forking a pre-warmed server for a new session; the fork
+    // itself happens in the main loop, outside of command execution
+    void fork_session(StringView name);
+    Optional<String> take_pending_fork_session();
+    // called in the forked child to start serving the new session
+    void reset_session(String name);
+
     bool negotiating() const { return not m_accepters.empty(); }
 
 private:
     class Accepter;
     void remove_accepter(Accepter* accepter);
+    void make_listener();
 
     String m_session;
+    Optional<String> m_pending_fork_session;
     std::unique_ptr<FDWatcher> m_listener;
     Vector<std::unique_ptr<Accepter>, MemoryDomain::Remote> m_accepters;
 };
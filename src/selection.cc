@@ -8,7 +8,8 @@ namespace Kakoune
 {
 
 SelectionList::SelectionList(Buffer& buffer, Selection s, size_t timestamp)
-    : m_selections({ std::move(s) }), m_buffer(&buffer), m_timestamp(timestamp)
+    : m_storage{new Storage{Vector<Selection>{std::move(s)}}},
+      m_buffer(&buffer), m_timestamp(timestamp)
 {
     check_invariant();
 }
@@ -17,7 +18,7 @@ SelectionList::SelectionList(Buffer& buffer, Selection s)
     : SelectionList(buffer, std::move(s), buffer.timestamp()) {}
 
 SelectionList::SelectionList(Buffer& buffer, Vector<Selection> list, size_t timestamp)
-    : m_selections(std::move(list)), m_buffer(&buffer), m_timestamp(timestamp)
+    : m_storage{new Storage{std::move(list)}}, m_buffer(&buffer), m_timestamp(timestamp)
 {
     kak_assert(size() > 0);
     m_main = size() - 1;
@@ -28,7 +29,7 @@ SelectionList::SelectionList(Buffer& buffer, Vector<Selection> list)
     : SelectionList(buffer, std::move(list), buffer.timestamp()) {}
 
 SelectionList::SelectionList(SelectionList::UnsortedTag, Buffer& buffer, Vector<Selection> list, size_t timestamp, size_t main)
-    : m_selections(std::move(list)), m_buffer(&buffer), m_timestamp(timestamp)
+    : m_storage{new Storage{std::move(list)}}, m_buffer(&buffer), m_timestamp(timestamp)
 {
     sort_and_merge_overlapping();
     check_invariant();
@@ -36,14 +37,15 @@ SelectionList::SelectionList(SelectionList::UnsortedTag, Buffer& buffer, Vector<
 
 void SelectionList::remove(size_t index)
 {
-    m_selections.erase(begin() + index);
-    if (index < m_main or m_main == m_selections.size())
+    auto& sels = detached();
+    sels.erase(sels.begin() + index);
+    if (index < m_main or m_main == sels.size())
         --m_main;
 }
 void SelectionList::set(Vector<Selection> list, size_t main)
 {
     kak_assert(main < list.size());
-    m_selections = std::move(list);
+    m_storage = RefPtr<Storage>{new Storage{std::move(list)}};
     m_main = main;
     m_timestamp = m_buffer->timestamp();
     sort_and_merge_overlapping();
@@ -257,7 +259,14 @@ void update_selections(Vector<Selection>& selections, size_t& main, Buffer& buff
 
 void SelectionList::update(bool merge)
 {
-    update_selections(m_selections, m_main, *m_buffer, m_timestamp, merge);
+    // nothing to update when the buffer did not change, avoid
+    // detaching a shared storage for nothing
+    if (m_timestamp == m_buffer->timestamp())
+    {
+        check_invariant();
+        return;
+    }
+    update_selections(detached(), m_main, *m_buffer, m_timestamp, merge);
     check_invariant();
     m_timestamp = m_buffer->timestamp();
 }
@@ -277,7 +286,7 @@ void SelectionList::check_invariant() const
 
     const auto end_coord = buffer.end_coord();
     BufferCoord last_min{0,0};
-    for (auto& sel : m_selections)
+    for (auto& sel : m_storage->selections)
     {
         auto& min = sel.min();
         kak_assert(min >= last_min);
@@ -296,7 +305,11 @@ void SelectionList::check_invariant() const
 
 void sort_selections(Vector<Selection>& selections, size_t& main_index)
 {
-    if (selections.size() == 1)
+    // most selection modifying operations (rotations, extending every
+    // selection by the same motion...) preserve the ordering, a linear
+    // check is much cheaper than the sort and leaves main_index untouched
+    if (selections.size() == 1 or
+        std::is_sorted(selections.begin(), selections.end(), compare_selections))
         return;
 
     const auto& main = selections[main_index];
@@ -323,12 +336,19 @@ void merge_overlapping_selections(Vector<Selection>& selections, size_t& main_in
 
 void SelectionList::sort()
 {
-    sort_selections(m_selections, m_main);
+    auto& sels = m_storage->selections;
+    if (sels.size() == 1 or
+        std::is_sorted(sels.begin(), sels.end(), compare_selections))
+        return;
+    sort_selections(detached(), m_main);
 }
 
 void SelectionList::merge_overlapping()
 {
-    merge_overlapping_selections(m_selections, m_main);
+    auto& sels = m_storage->selections;
+    if (std::adjacent_find(sels.begin(), sels.end(), overlaps) == sels.end())
+        return;
+    merge_overlapping_selections(detached(), m_main);
 }
 
 void SelectionList::merge_consecutive()
@@ -339,8 +359,9 @@ void SelectionList::merge_consecutive()
     auto touches = [this](const Selection& lhs, const Selection& rhs) {
         return m_buffer->char_next(lhs.max()) >= rhs.min();
     };
-    m_selections.erase(Kakoune::merge_overlapping(begin(), end(),
-                                                  m_main, touches), end());
+    auto& sels = detached();
+    sels.erase(Kakoune::merge_overlapping(sels.begin(), sels.end(),
+                                          m_main, touches), sels.end());
 }
 
 void SelectionList::sort_and_merge_overlapping()
@@ -390,18 +411,19 @@ void SelectionList::insert(ConstArrayView<String> strings, InsertMode mode,
         return;
 
     update();
+    auto& sels = detached();
 
     Vector<BufferCoord> insert_pos;
     if (mode != InsertMode::Replace)
     {
-        for (auto& sel : m_selections)
+        for (auto& sel : sels)
             insert_pos.push_back(get_insert_pos(*m_buffer, sel, mode));
     }
 
     ForwardChangesTracker changes_tracker;
-    for (size_t index = 0; index < m_selections.size(); ++index)
+    for (size_t index = 0; index < sels.size(); ++index)
     {
-        auto& sel = m_selections[index];
+        auto& sel = sels[index];
 
         sel.anchor() = changes_tracker.get_new_coord_tolerant(sel.anchor());
         sel.cursor() = changes_tracker.get_new_coord_tolerant(sel.cursor());
@@ -451,7 +473,7 @@ void SelectionList::insert(ConstArrayView<String> strings, InsertMode mode,
     // We might just have been deleting text if strings were empty,
     // in which case we could have some selections pushed out of the buffer
     if (mode == InsertMode::Replace)
-        fix_overflowing_selections(m_selections, *m_buffer);
+        fix_overflowing_selections(sels, *m_buffer);
 
     check_invariant();
     m_buffer->check_invariant();
@@ -461,21 +483,22 @@ void SelectionList::erase()
 {
     update();
     merge_overlapping();
+    auto& sels = detached();
 
-    ForwardChangesTracker changes_tracker;
-    for (auto& sel : m_selections)
+    Vector<Buffer::Replacement> replacements;
+    replacements.reserve(sels.size());
+    for (auto& sel : sels)
     {
-        sel.anchor() = changes_tracker.get_new_coord(sel.anchor());
-        kak_assert(m_buffer->is_valid(sel.anchor()));
-        sel.cursor() = changes_tracker.get_new_coord(sel.cursor());
-        kak_assert(m_buffer->is_valid(sel.cursor()));
-
-        auto pos = Kakoune::erase(*m_buffer, sel);
-        sel.anchor() = sel.cursor() = pos;
-        changes_tracker.update(*m_buffer, m_timestamp);
+        replacements.push_back({sel.min(), m_buffer->char_next(sel.max()), {}});
+        sel.anchor() = sel.cursor() = sel.min();
     }
 
-    fix_overflowing_selections(m_selections, *m_buffer);
+    m_buffer->apply(replacements);
+    // do not merge, collapsed selections are allowed to end up on the
+    // same position, as sequential erases did before
+    update(false);
+
+    fix_overflowing_selections(sels, *m_buffer);
     m_buffer->check_invariant();
 }
 
@@ -2,6 +2,7 @@
 #define selection_hh_INCLUDED
 
 #include "buffer.hh"
+#include "ref_ptr.hh"
 
 namespace Kakoune
 {
@@ -106,11 +107,11 @@ struct SelectionList
     size_t main_index() const { return m_main; }
     void set_main_index(size_t main) { kak_assert(main < size()); m_main = main; }
 
-    void push_back(const Selection& sel) { m_selections.push_back(sel); }
-    void push_back(Selection&& sel) { m_selections.push_back(std::move(sel)); }
+    void push_back(const Selection& sel) { detached().push_back(sel); }
+    void push_back(Selection&& sel) { detached().push_back(std::move(sel)); }
 
-    Selection& operator[](size_t i) { return m_selections[i]; }
-    const Selection& operator[](size_t i) const { return m_selections[i]; }
+    Selection& operator[](size_t i) { return detached()[i]; }
+    const Selection& operator[](size_t i) const { return m_storage->selections[i]; }
 
     void set(Vector<Selection> list, size_t main);
     SelectionList& operator=(Vector<Selection> list)
@@ -121,19 +122,24 @@ struct SelectionList
     }
 
     using iterator = Vector<Selection>::iterator;
-    iterator begin() { return m_selections.begin(); }
-    iterator end() { return m_selections.end(); }
+    iterator begin() { auto& sels = detached(); return sels.begin(); }
+    iterator end() { auto& sels = detached(); return sels.end(); }
 
     using const_iterator = Vector<Selection>::const_iterator;
-    const_iterator begin() const { return m_selections.begin(); }
-    const_iterator end() const { return m_selections.end(); }
+    const_iterator begin() const { return m_storage->selections.begin(); }
+    const_iterator end() const { return m_storage->selections.end(); }
 
     void remove(size_t index);
 
-    const Selection* data() const { return m_selections.data(); }
-    size_t size() const { return m_selections.size(); }
+    const Selection* data() const { return m_storage->selections.data(); }
+    size_t size() const { return m_storage->selections.size(); }
 
-    bool operator==(const SelectionList& other) const { return m_buffer == other.m_buffer and m_selections == other.m_selections; }
+    bool operator==(const SelectionList& other) const
+    {
+        return m_buffer == other.m_buffer and
+               (m_storage == other.m_storage or
+                m_storage->selections == other.m_storage->selections);
+    }
     bool operator!=(const SelectionList& other) const { return not ((*this) == other); }
 
     void sort();
@@ -151,8 +157,25 @@ struct SelectionList
     void erase();
 
 private:
+    // The selection storage is shared between copies and only detached
+    // when a copy actually modifies it, making the read only copies taken
+    // by draft contexts and the jump list cheap.
+    struct Storage : RefCountable, UseMemoryDomain<MemoryDomain::Selections>
+    {
+        Storage() = default;
+        Storage(Vector<Selection> sels) : selections{std::move(sels)} {}
+        Vector<Selection> selections;
+    };
+
+    Vector<Selection>& detached()
+    {
+        if (m_storage->refcount > 1)
+            m_storage = RefPtr<Storage>{new Storage{m_storage->selections}};
+        return m_storage->selections;
+    }
+
     size_t m_main = 0;
-    Vector<Selection> m_selections;
+    RefPtr<Storage> m_storage;
 
     SafePtr<Buffer> m_buffer;
     size_t m_timestamp;
@@ -1,14 +1,17 @@
 #include "selectors.hh"
 
 #include "buffer_utils.hh"
+#include "cancel.hh"
 #include "context.hh"
 #include "flags.hh"
+#include "line_modification.hh"
 #include "option_types.hh"
 #include "regex.hh"
 #include "selection.hh"
 #include "string.hh"
 #include "unit_tests.hh"
 #include "utf8_iterator.hh"
+#include "value.hh"
 
 #include <algorithm>
 
@@ -35,6 +38,81 @@ ConstArrayView<Codepoint> get_extra_word_chars(const Context& context)
     return context.options()["extra_word_chars"].get<Vector<Codepoint, MemoryDomain::Options>>();
 }
 
+// Per-buffer index of matching pair codepoint positions, kept up to date
+// incrementally, so that matching pair queries only visit brackets instead
+// of crawling codepoint by codepoint through the whole buffer.
+struct BracketIndex
+{
+    struct Bracket
+    {
+        ByteCount pos;
+        Codepoint cp;
+    };
+    struct IndexedLine
+    {
+        StringDataPtr storage;
+        Vector<Bracket, MemoryDomain::Selections> brackets;
+    };
+
+    size_t timestamp = 0;
+    size_t pairs_hash = 0;
+    Vector<IndexedLine, MemoryDomain::Selections> lines;
+};
+
+BracketIndex& get_bracket_index(const Buffer& buffer, ConstArrayView<Codepoint> pairs)
+{
+    static const ValueId bracket_index_id = get_free_value_id();
+    Value& cache_val = buffer.values()[bracket_index_id];
+    if (not cache_val)
+        cache_val = Value(BracketIndex{});
+    auto& index = cache_val.as<BracketIndex>();
+
+    size_t pairs_hash = 0;
+    for (auto cp : pairs)
+        pairs_hash = combine_hash(pairs_hash, hash_value(cp));
+
+    if (index.timestamp == 0 or index.pairs_hash != pairs_hash)
+    {
+        index.lines.clear();
+        index.pairs_hash = pairs_hash;
+    }
+    else if (index.timestamp != buffer.timestamp())
+    {
+        for (auto& modif : compute_line_modifications(buffer, index.timestamp))
+        {
+            auto begin = std::min(index.lines.begin() + (int)modif.new_line, index.lines.end());
+            auto end = std::min(begin + (int)modif.num_removed, index.lines.end());
+            index.lines.insert(index.lines.erase(begin, end),
+                               (size_t)(int)modif.num_added, BracketIndex::IndexedLine{});
+        }
+    }
+    index.lines.resize((size_t)(int)buffer.line_count());
+    index.timestamp = buffer.timestamp();
+    return index;
+}
+
+ConstArrayView<BracketIndex::Bracket>
+line_brackets(BracketIndex& index, const Buffer& buffer,
+              ConstArrayView<Codepoint> pairs, LineCount line)
+{
+    auto& indexed = index.lines[(size_t)(int)line];
+    const auto& storage = buffer.line_storage(line);
+    if (indexed.storage != storage)
+    {
+        indexed.storage = storage;
+        indexed.brackets.clear();
+        const StringView content = storage->strview();
+        for (const char* it = content.begin(); it != content.end(); )
+        {
+            const char* char_begin = it;
+            const Codepoint cp = utf8::read_codepoint(it, content.end());
+            if (contains(pairs, cp))
+                indexed.brackets.push_back({ByteCount{(int)(char_begin - content.begin())}, cp});
+        }
+    }
+    return indexed.brackets;
+}
+
 }
 
 Selection keep_direction(Selection res, const Selection& ref)
@@ -229,42 +307,59 @@ select_matching(const Context& context, const Selection& selection)
 {
     auto& buffer = context.buffer();
     auto& matching_pairs = context.options()["matching_pairs"].get<Vector<Codepoint, MemoryDomain::Options>>();
-    Utf8Iterator it{buffer.iterator_at(selection.cursor()), buffer};
+    auto& index = get_bracket_index(buffer, matching_pairs);
+    const BufferCoord cursor = selection.cursor();
+
+    Optional<BufferCoord> match_coord;
     auto match = matching_pairs.end();
 
-    if (forward) while (it != buffer.end())
+    if (forward) for (LineCount line = cursor.line;
+                      line < buffer.line_count() and not match_coord; ++line)
     {
-        match = find(matching_pairs, *it);
-        if (match != matching_pairs.end())
+        for (auto& bracket : line_brackets(index, buffer, matching_pairs, line))
+        {
+            if (line == cursor.line and bracket.pos < cursor.column)
+                continue;
+            match = find(matching_pairs, bracket.cp);
+            match_coord = BufferCoord{line, bracket.pos};
             break;
-        ++it;
+        }
     }
-    else while (true)
+    else for (LineCount line = cursor.line; line >= 0 and not match_coord; --line)
     {
-        match = find(matching_pairs, *it);
-        if (match != matching_pairs.end()
-            or it == buffer.begin())
+        auto brackets = line_brackets(index, buffer, matching_pairs, line);
+        for (auto it = brackets.end(); it != brackets.begin(); )
+        {
+            auto& bracket = *--it;
+            if (line == cursor.line and bracket.pos > cursor.column)
+                continue;
+            match = find(matching_pairs, bracket.cp);
+            match_coord = BufferCoord{line, bracket.pos};
             break;
-        --it;
+        }
     }
 
-    if (match == matching_pairs.end())
+    if (not match_coord)
         return {};
 
-    Utf8Iterator begin = it;
+    const BufferCoord begin = *match_coord;
 
     if (((match - matching_pairs.begin()) % 2) == 0)
     {
         int level = 0;
         const Codepoint opening = *match;
         const Codepoint closing = *(match+1);
-        while (it != buffer.end())
+        for (LineCount line = begin.line; line < buffer.line_count(); ++line)
         {
-            if (*it == opening)
-                ++level;
-            else if (*it == closing and --level == 0)
-                return utf8_range(begin, it);
-            ++it;
+            for (auto& bracket : line_brackets(index, buffer, matching_pairs, line))
+            {
+                if (line == begin.line and bracket.pos < begin.column)
+                    continue;
+                if (bracket.cp == opening)
+                    ++level;
+                else if (bracket.cp == closing and --level == 0)
+                    return Selection{begin, {line, bracket.pos}};
+            }
         }
     }
     else
@@ -272,15 +367,19 @@ select_matching(const Context& context, const Selection& selection)
         int level = 0;
         const Codepoint opening = *(match-1);
         const Codepoint closing = *match;
-        while (true)
+        for (LineCount line = begin.line; line >= 0; --line)
         {
-            if (*it == closing)
-                ++level;
-            else if (*it == opening and --level == 0)
-                return utf8_range(begin, it);
-            if (it == buffer.begin())
-                break;
-            --it;
+            auto brackets = line_brackets(index, buffer, matching_pairs, line);
+            for (auto it = brackets.end(); it != brackets.begin(); )
+            {
+                auto& bracket = *--it;
+                if (line == begin.line and bracket.pos > begin.column)
+                    continue;
+                if (bracket.cp == closing)
+                    ++level;
+                else if (bracket.cp == opening and --level == 0)
+                    return Selection{begin, {line, bracket.pos}};
+            }
         }
     }
     return {};
@@ -863,30 +962,101 @@ static bool find_next(const Buffer& buffer, const BufferIterator& pos,
                       MatchResults<BufferIterator>& matches,
                       const Regex& ex, bool& wrapped)
 {
+    // For line local regexes (literal identifiers in particular), locate
+    // the first line holding a match over the contiguous line storage,
+    // where the vm iterates raw pointers and can skip with memchr/memmem,
+    // then run the buffer iterator vm from that line only to keep its
+    // exact match selection semantics.
+    auto search = [&](BufferIterator start, RegexExecFlags flags) {
+        if (is_line_local(*ex.impl()))
+        {
+            ThreadedRegexVM<const char*, RegexMode::Forward | RegexMode::Search |
+                            RegexMode::AnyMatch | RegexMode::NoSaves> vm{*ex.impl()};
+            const BufferCoord coord = start.coord();
+            LineCount line = coord.line;
+            for (; line < buffer.line_count(); ++line)
+            {
+                const StringView l = buffer[line];
+                const ByteCount first = line == coord.line ? coord.column : 0;
+                const ByteCount limit = l.length() - 1; // the eol char position ends the subject
+                const auto line_flags = match_flags(is_bol({line, first}), is_eol(buffer, {line, limit}),
+                                                    is_bow(buffer, {line, first}), is_eow(buffer, {line, limit}));
+                if (vm.exec(l.begin() + (int)first, l.begin() + (int)limit,
+                            l.begin(), l.begin() + (int)limit, line_flags))
+                    break;
+            }
+            if (line == buffer.line_count())
+                return false;
+            if (const BufferCoord narrowed{line, line == coord.line ? coord.column : 0};
+                narrowed > coord)
+            {
+                start = buffer.iterator_at(narrowed);
+                flags = match_flags(buffer, start, buffer.end());
+            }
+        }
+        return regex_search(start, buffer.end(), buffer.begin(), buffer.end(),
+                            matches, ex, flags);
+    };
     if (pos != buffer.end() and
-        regex_search(pos, buffer.end(), buffer.begin(), buffer.end(),
-                     matches, ex, match_flags(buffer, pos, buffer.end())))
+        search(pos, match_flags(buffer, pos, buffer.end())))
         return true;
     wrapped = true;
-    return regex_search(buffer.begin(), buffer.end(), buffer.begin(), buffer.end(),
-                        matches, ex, match_flags(buffer, buffer.begin(), buffer.end()));
+    return search(buffer.begin(), match_flags(buffer, buffer.begin(), buffer.end()));
 }
 
 static bool find_prev(const Buffer& buffer, const BufferIterator& pos,
                       MatchResults<BufferIterator>& matches,
                       const Regex& ex, bool& wrapped)
 {
+    // The backward vm explores from every position so searching backward
+    // through a big buffer is dramatically slower than forward; for line
+    // local regexes, locate the last line holding a match with the fast
+    // forward engine first, then run the backward vm on that line only to
+    // keep its exact match selection semantics.
+    auto search = [&](BufferIterator end, RegexExecFlags flags) {
+        if (is_line_local(*ex.impl()))
+        {
+            // backward regexes are compiled without their forward program,
+            // so get the forward variant, usually a cache hit
+            const Regex forward_ex{ex.str()};
+            ThreadedRegexVM<const char*, RegexMode::Forward | RegexMode::Search |
+                            RegexMode::AnyMatch | RegexMode::NoSaves> vm{*forward_ex.impl()};
+            const BufferCoord coord = end.coord();
+            LineCount line = std::min(coord.line, buffer.line_count()-1);
+            for (; line >= 0; --line)
+            {
+                const StringView l = buffer[line];
+                ByteCount limit = l.length() - 1; // the eol char position ends the subject
+                if (line == coord.line)
+                    limit = std::min(limit, coord.column);
+                const auto line_flags = match_flags(is_bol({line, 0}), is_eol(buffer, {line, limit}),
+                                                    is_bow(buffer, {line, 0}), is_eow(buffer, {line, limit}));
+                if (vm.exec(l.begin(), l.begin() + (int)limit, l.begin(), l.begin() + (int)limit, line_flags))
+                    break;
+            }
+            if (line < 0)
+                return false;
+            ByteCount limit = buffer[line].length() - 1;
+            if (line == coord.line)
+                limit = std::min(limit, coord.column);
+            if (const BufferCoord narrowed{line, limit}; narrowed < coord)
+            {
+                end = buffer.iterator_at(narrowed);
+                // the search position is past the narrowed range, so an
+                // empty match at its end is not an initial null match
+                flags = match_flags(buffer, buffer.begin(), end);
+            }
+        }
+        return backward_regex_search(buffer.begin(), end, buffer.begin(), buffer.end(),
+                                     matches, ex, flags);
+    };
     if (pos != buffer.begin() and
-        backward_regex_search(buffer.begin(), pos, buffer.begin(), buffer.end(),
-                              matches, ex,
-                              match_flags(buffer, buffer.begin(), pos) |
-                              RegexExecFlags::NotInitialNull))
+        search(pos, match_flags(buffer, buffer.begin(), pos) |
+                    RegexExecFlags::NotInitialNull))
         return true;
     wrapped = true;
-    return backward_regex_search(buffer.begin(), buffer.end(), buffer.begin(), buffer.end(),
-                                 matches, ex,
-                                 match_flags(buffer, buffer.begin(), buffer.end()) |
-                                 RegexExecFlags::NotInitialNull);
+    return search(buffer.end(), match_flags(buffer, buffer.begin(), buffer.end()) |
+                                RegexExecFlags::NotInitialNull);
 }
 
 template<RegexMode mode>
@@ -926,14 +1096,84 @@ Vector<Selection> select_matches(const Buffer& buffer, ConstArrayView<Selection>
         throw runtime_error("invalid capture number");
 
     Vector<Selection> result;
+
+    // Once enough matches were found in a selection, estimate the total
+    // match count from their average spacing and reserve ahead, instead
+    // of repeatedly growing the result for buffer-wide selections.
+    auto reserve_ahead = [&](const Selection& sel, size_t found, BufferCoord last_match) {
+        constexpr size_t sample_size = 128;
+        if (found != sample_size)
+            return;
+        const size_t scanned = (size_t)(int)buffer.distance(sel.min(), last_match);
+        const size_t remaining = (size_t)(int)buffer.distance(last_match, sel.max());
+        const size_t spacing = std::max<size_t>(1, scanned / sample_size);
+        result.reserve(result.size() + remaining / spacing + 1);
+    };
+
+    if (is_line_local(*regex.impl()))
+    {
+        // No match can contain an end of line, so the range can be
+        // scanned one line at a time over the contiguous line storage,
+        // which gives the VM raw pointer iteration and literal skipping
+        ThreadedRegexVM<const char*, RegexMode::Forward | RegexMode::Search> vm{*regex.impl()};
+        for (auto& sel : selections)
+        {
+            const size_t sel_start = result.size();
+            const BufferCoord min = sel.min();
+            const BufferCoord max_end = buffer.char_next(sel.max());
+            for (LineCount line = min.line; line <= sel.max().line; ++line)
+            {
+                const StringView l = buffer[line];
+                const ByteCount first = line == min.line ? min.column : 0;
+                ByteCount last = l.length() - 1; // the eol char position ends the subject
+                if (line == max_end.line and max_end.column < last)
+                    last = max_end.column;
+                if (first > last)
+                    continue;
+
+                auto coord = [&](const char* pos) -> BufferCoord {
+                    return {line, ByteCount{(int)(pos - l.begin())}};
+                };
+                const auto flags = match_flags(is_bol({line, first}), is_eol(buffer, {line, last}),
+                                               is_bow(buffer, {line, first}), is_eow(buffer, {line, last}));
+                for (auto&& match : RegexIterator{l.begin() + (int)first, l.begin() + (int)last, vm, flags})
+                {
+                    cancellation_point();
+                    auto begin = match[capture].first;
+                    auto end = match[capture].second;
+                    const BufferCoord begin_coord = begin ? coord(begin) : BufferCoord{0, 0};
+                    if (begin_coord == max_end)
+                        continue;
+                    const BufferCoord end_coord = begin
+                        ? coord(begin == end ? end : utf8::previous(end, begin)) : BufferCoord{0, 0};
+
+                    CaptureList captures;
+                    captures.reserve(mark_count);
+                    for (const auto& submatch : match)
+                        captures.push_back(submatch.first ?
+                            String{submatch.first, submatch.second} : String{});
+
+                    result.push_back(
+                        keep_direction({ begin_coord, end_coord, std::move(captures) }, sel));
+                    reserve_ahead(sel, result.size() - sel_start, begin_coord);
+                }
+            }
+        }
+        if (result.empty())
+            throw runtime_error("nothing selected");
+        return result;
+    }
+
     ThreadedRegexVM<BufferIterator, RegexMode::Forward | RegexMode::Search> vm{*regex.impl()};
     for (auto& sel : selections)
     {
+        const size_t sel_start = result.size();
         auto sel_beg = buffer.iterator_at(sel.min());
         auto sel_end = utf8::next(buffer.iterator_at(sel.max()), buffer.end());
 
         for (auto&& match : RegexIterator{sel_beg, sel_end, vm, match_flags(buffer, sel_beg, sel_end)})
         {
+            cancellation_point();
             auto begin = match[capture].first;
             if (begin == sel_end)
                 continue;
@@ -949,6 +1189,7 @@ Vector<Selection> select_matches(const Buffer& buffer, ConstArrayView<Selection>
                 keep_direction({ begin.coord(),
                                  (begin == end ? end : utf8::previous(end, begin)).coord(),
                                  std::move(captures) }, sel));
+            reserve_ahead(sel, result.size() - sel_start, begin.coord());
         }
     }
     if (result.empty())
@@ -972,6 +1213,7 @@ Vector<Selection> split_on_matches(const Buffer& buffer, ConstArrayView<Selectio
 
         for (auto&& match : RegexIterator{begin, sel_end, vm, match_flags(buffer, begin, sel_end)})
         {
+            cancellation_point();
             BufferIterator end = match[capture].first;
             if (end == buf_end)
                 continue;
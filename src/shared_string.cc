@@ -6,6 +6,79 @@
 namespace Kakoune
 {
 
+namespace
+{
+
+// Slab pool for small StringData allocations: buffer lines are numerous
+// and of similar small sizes, so loading a big file should not pay one
+// system allocation per line. Blocks are carved out of fixed size slabs
+// and recycled through per size class free lists.
+constexpr size_t slab_granularity = 32;
+constexpr size_t slab_max_size = 512;
+constexpr size_t slab_bucket_count = slab_max_size / slab_granularity;
+constexpr size_t slab_bytes = 128 * 1024;
+
+struct FreeBlock { FreeBlock* next; };
+FreeBlock* slab_free_lists[slab_bucket_count];
+
+size_t slab_round_up(size_t size)
+{
+    return (size + slab_granularity - 1) / slab_granularity * slab_granularity;
+}
+
+// noinline keeps the global ::operator new/delete pair out of the
+// inlined bodies of the class specific operators, where GCC would flag
+// it as mismatched with them (-Wmismatched-new-delete false positive)
+[[gnu::noinline]]
+void* slab_allocate(size_t rounded) // rounded to the granularity
+{
+    if (rounded > slab_max_size)
+        return ::operator new(rounded);
+
+    const size_t bucket = rounded / slab_granularity - 1;
+    if (auto* block = slab_free_lists[bucket])
+    {
+        slab_free_lists[bucket] = block->next;
+        return block;
+    }
+
+    const size_t count = slab_bytes / rounded;
+    char* slab = static_cast<char*>(::operator new(count * rounded));
+    for (size_t i = 1; i < count; ++i)
+    {
+        auto* block = reinterpret_cast<FreeBlock*>(slab + i * rounded);
+        block->next = slab_free_lists[bucket];
+        slab_free_lists[bucket] = block;
+    }
+    return slab;
+}
+
+[[gnu::noinline]]
+void slab_deallocate(void* ptr, size_t rounded)
+{
+    if (rounded > slab_max_size)
+        return ::operator delete(ptr);
+
+    const size_t bucket = rounded / slab_granularity - 1;
+    auto* block = static_cast<FreeBlock*>(ptr);
+    block->next = slab_free_lists[bucket];
+    slab_free_lists[bucket] = block;
+}
+
+}
+
+void* StringData::operator new(size_t size)
+{
+    on_alloc(Domain, size);
+    return slab_allocate(slab_round_up(size));
+}
+
+void StringData::operator delete(void* ptr, size_t size)
+{
+    on_dealloc(Domain, size);
+    slab_deallocate(ptr, slab_round_up(size));
+}
+
 StringDataPtr StringData::create(ArrayView<const StringView> strs)
 {
     const int len = accumulate(strs, 0, [](int l, StringView s) {
@@ -23,15 +96,37 @@ StringDataPtr StringData::create(ArrayView<const StringView> strs)
     return RefPtr<StringData, PtrPolicy>{res};
 }
 
+StringDataPtr StringData::create_line(ArrayView<const StringView> strs)
+{
+    const int len = accumulate(strs, 0, [](int l, StringView s) {
+                        return l + (int)s.length();
+                    });
+    if (len == 1)
+    {
+        for (auto& str : strs)
+        {
+            if (str.empty())
+                continue;
+            if (str[0_byte] == '\n')
+            {
+                static const StringDataPtr empty_line = create({"\n"});
+                return empty_line;
+            }
+            break;
+        }
+    }
+    return create(strs);
+}
+
 StringDataPtr StringData::Registry::intern(StringView str)
 {
-    auto it = m_strings.find(str);
-    if (it != m_strings.end())
-        return StringDataPtr{it->value};
+    const size_t hash = hash_value(str);
+    if (int index = m_strings.find_index(str, hash); index >= 0)
+        return StringDataPtr{m_strings.item(index).value};
 
     auto data = StringData::create(str);
     data->refcount |= interned_flag;
-    m_strings.insert({data->strview(), data.get()});
+    m_strings.insert({data->strview(), data.get()}, hash);
     return data;
 }
 
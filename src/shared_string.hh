@@ -21,6 +21,12 @@ struct StringData : UseMemoryDomain<MemoryDomain::SharedString>
     [[gnu::always_inline]]
     StringView strview() const { return {data(), length}; }
 
+    // Small allocations (the common case, buffer lines) are served from
+    // per size class slabs instead of the system allocator.
+    static void* operator new(size_t size);
+    static void* operator new(size_t size, void* ptr) { return ptr; }
+    static void operator delete(void* ptr, size_t size);
+
 private:
     StringData(int len) : refcount(0), length(len) {}
 
@@ -57,6 +63,10 @@ public:
     };
 
     static Ptr create(ArrayView<const StringView> strs);
+
+    // For newline terminated buffer lines; empty lines are frequent
+    // enough in code buffers to share a single storage
+    static Ptr create_line(ArrayView<const StringView> strs);
 };
 
 using StringDataPtr = StringData::Ptr;
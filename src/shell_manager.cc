@@ -11,6 +11,7 @@
 #include "flags.hh"
 #include "option.hh"
 #include "option_types.hh"
+#include "profile.hh"
 #include "regex.hh"
 
 #include <cstring>
@@ -101,15 +102,29 @@ private:
     int m_fd[2];
 };
 
+const Vector<const char*>& base_environ()
+{
+    // environ is stable once the ShellManager constructor has amended
+    // PATH, snapshot it instead of walking it on every spawn
+    static const Vector<const char*> env = [] {
+        Vector<const char*> res;
+        for (char** envp = environ; *envp; ++envp)
+            res.push_back(*envp);
+        return res;
+    }();
+    return env;
+}
+
 template<typename Func>
 pid_t spawn_shell(const char* shell, StringView cmdline,
                   ConstArrayView<String> params,
                   ConstArrayView<String> kak_env,
                   Func setup_child)
 {
+    auto& base_env = base_environ();
     Vector<const char*> envptrs;
-    for (char** envp = environ; *envp; ++envp)
-        envptrs.push_back(*envp);
+    envptrs.reserve(base_env.size() + kak_env.size() + 1);
+    envptrs.assign(base_env.begin(), base_env.end());
     for (auto& env : kak_env)
         envptrs.push_back(env.c_str());
     envptrs.push_back(nullptr);
@@ -132,31 +147,58 @@ pid_t spawn_shell(const char* shell, StringView cmdline,
     return -1;
 }
 
-Vector<String> generate_env(StringView cmdline, const Context& context, const ShellContext& shell_context)
+struct CmdlineEnvVar
+{
+    String quoted;
+    String name;
+    Quoting quoting;
+    const EnvVarDesc* desc; // builtin retriever, nullptr if unknown
+};
+
+// hook scripts are static strings evaluated over and over, so the env
+// var references they contain are worth extracting once instead of
+// running the regex on each eval
+const Vector<CmdlineEnvVar>& cmdline_env_vars(StringView cmdline)
 {
     static const Regex re(R"(\bkak_(quoted_)?(\w+)\b)");
+    static HashMap<String, Vector<CmdlineEnvVar>, MemoryDomain::EnvVars> cache;
 
-    Vector<String> kak_env;
+    if (auto it = cache.find(cmdline); it != cache.end())
+        return it->value;
+
+    if (cache.size() >= 512)
+        cache.clear();
+
+    Vector<CmdlineEnvVar> vars;
     for (auto&& match : RegexIterator{cmdline.begin(), cmdline.end(), re})
     {
         StringView name{match[2].first, match[2].second};
-        Quoting quoting = match[1].matched ? Quoting::Shell : Quoting::Raw;
-
-        auto match_name = [&](const String& s) {
-            return s.substr(0_byte, name.length()) == name and
-                   s.substr(name.length(), 1_byte) == "=";
-        };
-        if (any_of(kak_env, match_name))
+        StringView quoted{match[1].first, match[1].second};
+        // the quoted and unquoted versions of a var are distinct exports
+        if (any_of(vars, [&](auto& var) { return var.quoted == quoted and var.name == name; }))
             continue;
 
-        auto var_it = shell_context.env_vars.find(name);
+        vars.push_back({quoted.str(), name.str(),
+                        match[1].matched ? Quoting::Shell : Quoting::Raw,
+                        ShellManager::instance().resolve_env_var(name)});
+    }
+    return cache.insert({cmdline.str(), std::move(vars)});
+}
+
+Vector<String> generate_env(StringView cmdline, const Context& context, const ShellContext& shell_context)
+{
+    Vector<String> kak_env;
+    for (auto& var : cmdline_env_vars(cmdline))
+    {
+        auto var_it = shell_context.env_vars.find(var.name);
+        if (var_it == shell_context.env_vars.end() and not var.desc)
+            continue;
         try
         {
             const String& value = var_it != shell_context.env_vars.end() ?
-                var_it->value : ShellManager::instance().get_val(name, context, quoting);
+                var_it->value : var.desc->func(var.name, context, var.quoting);
 
-            StringView quoted{match[1].first, match[1].second};
-            kak_env.push_back(format("kak_{}{}={}", quoted, name, value));
+            kak_env.push_back(format("kak_{}{}={}", var.quoted, var.name, value));
         } catch (runtime_error&) {}
     }
 
@@ -169,6 +211,8 @@ std::pair<String, int> ShellManager::eval(
     StringView cmdline, const Context& context, StringView input,
     Flags flags, const ShellContext& shell_context)
 {
+    ProfileTimer profile_timer{context, ProfileCategory::Shell};
+
     const DebugFlags debug_flags = context.options()["debug"].get<DebugFlags>();
     const bool profile = debug_flags & DebugFlags::Profile;
     if (debug_flags & DebugFlags::Shell)
@@ -215,18 +259,25 @@ std::pair<String, int> ShellManager::eval(
     {
         PipeReader(Pipe& pipe, String& contents)
             : FDWatcher(pipe.read_fd(), FdEvents::Read,
-                        [&contents, &pipe](FDWatcher& watcher, FdEvents, EventMode) {
-                            char buffer[1024];
+                        [&contents, &pipe, read_size = (size_t)4096,
+                         buffer = Vector<char>{}](FDWatcher& watcher, FdEvents, EventMode) mutable {
                             while (fd_readable(pipe.read_fd()))
                             {
-                                size_t size = ::read(pipe.read_fd(), buffer, 1024);
+                                // as long as the shell keeps the pipe full,
+                                // grow the reads so that large outputs cost
+                                // few syscalls
+                                constexpr size_t max_read_size = 256 * 1024;
+                                buffer.resize(read_size);
+                                const ssize_t size = ::read(pipe.read_fd(), buffer.data(), read_size);
                                 if (size <= 0)
                                 {
                                     pipe.close_read_fd();
                                     watcher.disable();
                                     return;
                                 }
-                                contents += StringView{buffer, buffer+size};
+                                if ((size_t)size == read_size)
+                                    read_size = std::min(read_size * 2, max_read_size);
+                                contents += StringView{buffer.data(), buffer.data() + size};
                             }
                         })
         {}
@@ -327,13 +378,18 @@ std::pair<String, int> ShellManager::eval(
     return { std::move(stdout_contents), WIFEXITED(status) ? WEXITSTATUS(status) : -1 };
 }
 
-String ShellManager::get_val(StringView name, const Context& context, Quoting quoting) const
+const EnvVarDesc* ShellManager::resolve_env_var(StringView name) const
 {
     auto env_var = find_if(m_env_vars, [name](const EnvVarDesc& desc) {
         return desc.prefix ? prefix_match(name, desc.str) : name == desc.str;
     });
+    return env_var != m_env_vars.end() ? env_var : nullptr;
+}
 
-    if (env_var == m_env_vars.end())
+String ShellManager::get_val(StringView name, const Context& context, Quoting quoting) const
+{
+    auto env_var = resolve_env_var(name);
+    if (not env_var)
         throw runtime_error("no such env var: " + name);
 
     return env_var->func(name, context, quoting);
@@ -48,6 +48,8 @@ public:
 
     String get_val(StringView name, const Context& context, Quoting quoting) const;
 
+    const EnvVarDesc* resolve_env_var(StringView name) const;
+
     CandidateList complete_env_var(StringView prefix, ByteCount cursor_pos) const;
 
 private:
@@ -4,7 +4,9 @@
 #include "utf8_iterator.hh"
 #include "unit_tests.hh"
 
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 
 namespace Kakoune
 {
@@ -50,26 +52,71 @@ String trim_indent(StringView str)
     return trim_whitespaces(join(s, '\n', false)).str();
 }
 
+const char* find_first_of_bytes(const char* it, const char* end,
+                                StringView bytes, unsigned char below)
+{
+    kak_assert(not bytes.empty() and below <= 0x80);
+    if (below == 0 and bytes.length() == 1)
+    {
+        // lets the libc scan a vector register at a time
+        auto* ptr = memchr(it, bytes[0], end - it);
+        return ptr ? static_cast<const char*>(ptr) : end;
+    }
+
+    if (bytes.length() <= 2)
+    {
+        // broadword scan, eight bytes at a time: zero_byte sets the high
+        // bit of every zero byte in a word, so xoring with a needle
+        // splatted across all lanes flags the needle occurrences, and
+        // the same carry trick flags bytes strictly below the threshold
+        // (valid as long as below <= 0x80)
+        constexpr uint64_t ones  = 0x0101010101010101ull;
+        constexpr uint64_t highs = 0x8080808080808080ull;
+        auto zero_byte = [](uint64_t v) { return (v - ones) & ~v & highs; };
+        const uint64_t first  = ones * (unsigned char)bytes[0];
+        const uint64_t second = ones * (unsigned char)bytes[bytes.length() - 1];
+        for (; end - it >= 8; it += 8)
+        {
+            uint64_t word;
+            memcpy(&word, it, 8);
+            uint64_t match = zero_byte(word ^ first) | zero_byte(word ^ second);
+            if (below != 0)
+                match |= (word - ones * below) & ~word & highs;
+            if (match != 0)
+                break; // rescan the chunk bytewise, endianness agnostic
+        }
+        for (; it != end; ++it)
+        {
+            if (*it == bytes[0] or *it == bytes[bytes.length() - 1] or
+                (unsigned char)*it < below)
+                return it;
+        }
+        return it;
+    }
+
+    bool in_set[256] = {};
+    for (auto c : bytes)
+        in_set[(unsigned char)c] = true;
+    for (int c = 0; c < below; ++c)
+        in_set[c] = true;
+    while (it != end and not in_set[(unsigned char)*it])
+        ++it;
+    return it;
+}
+
 String escape(StringView str, StringView characters, char escape)
 {
     String res;
     res.reserve(str.length());
-    auto cbeg = characters.begin(), cend = characters.end();
     for (auto it = str.begin(), end = str.end(); it != end; )
     {
-        auto next = std::find_first_of(it, end, cbeg, cend);
-        if (next != end)
-        {
-            res += StringView{it, next+1};
-            res.back() = escape;
-            res += *next;
-            it = next+1;
-        }
-        else
-        {
-            res += StringView{it, next};
+        auto next = find_first_of_bytes(it, end, characters);
+        res += StringView{it, next};
+        if (next == end)
             break;
-        }
+        res += escape;
+        res += *next;
+        it = next+1;
     }
     return res;
 }
@@ -116,7 +163,9 @@ String replace(StringView str, StringView substr, StringView replacement)
     String res;
     for (auto it = str.begin(); it != str.end(); )
     {
-        auto match = std::search(it, str.end(), substr.begin(), substr.end());
+        auto match = substr.length() == 1 // single byte needles dominate (shell_quote)
+            ? find_first_of_bytes(it, str.end(), substr)
+            : std::search(it, str.end(), substr.begin(), substr.end());
         res += StringView{it, match};
         if (match == str.end())
             break;
@@ -373,20 +422,47 @@ String format(StringView fmt, ArrayView<const StringView> params)
     return res;
 }
 
-String double_up(StringView s, StringView characters)
+String format(const CompiledFormat& fmt, ArrayView<const StringView> params)
 {
-    String res;
-    auto pos = s.begin();
-    for (auto it = s.begin(), end = s.end(); it != end; ++it)
+    ByteCount size = 0;
+    for (int i = 0; i < fmt.count; ++i)
     {
-        if (contains(characters, *it))
+        auto& piece = fmt.pieces[i];
+        size += piece.literal.length();
+        if (piece.param >= 0)
         {
-            res += StringView{pos, it+1};
-            res += *it;
-            pos = it+1;
+            if (piece.param >= params.size())
+                throw runtime_error("format string parameter index too big");
+            size += params[piece.param].length();
         }
     }
-    res += StringView{pos, s.end()};
+
+    String res;
+    res.reserve(size);
+    for (int i = 0; i < fmt.count; ++i)
+    {
+        auto& piece = fmt.pieces[i];
+        res += piece.literal;
+        if (piece.param >= 0)
+            res += params[piece.param];
+    }
+    return res;
+}
+
+String double_up(StringView s, StringView characters)
+{
+    String res;
+    res.reserve(s.length());
+    for (auto it = s.begin(), end = s.end(); it != end; )
+    {
+        auto next = find_first_of_bytes(it, end, characters);
+        res += StringView{it, next};
+        if (next == end)
+            break;
+        res += *next;
+        res += *next;
+        it = next+1;
+    }
     return res;
 }
 
@@ -420,6 +496,16 @@ UnitTest test_string{[]()
     kak_assert(escape(R"(\youpi:matin:tchou\:)", ":\\", '\\') == R"(\\youpi\:matin\:tchou\\\:)");
     kak_assert(unescape(R"(\\youpi\:matin\:tchou\\\:)", ":\\", '\\') == R"(\youpi:matin:tchou\:)");
 
+    auto first_of = [](StringView s, StringView bytes, unsigned char below = 0) {
+        return find_first_of_bytes(s.begin(), s.end(), bytes, below) - s.begin();
+    };
+    kak_assert(first_of("tchou kanaky", "k") == 6);        // memchr path
+    kak_assert(first_of("tchou kanaky", "xz") == 12);      // broadword, no match
+    kak_assert(first_of(R"(une chaine sans guillemets")", "\"\\") == 26);
+    kak_assert(first_of("du texte\tavec du controle", "\"\\", 0x20) == 8);
+    kak_assert(first_of("courte\"", "\"\\", 0x20) == 6);    // bytewise tail
+    kak_assert(first_of("abcdefghijklmnop'q", "'\"%") == 16); // table path
+
     kak_assert(prefix_match("tchou kanaky", "tchou"));
     kak_assert(prefix_match("tchou kanaky", "tchou kanaky"));
     kak_assert(prefix_match("tchou kanaky", "t"));
@@ -432,6 +518,13 @@ UnitTest test_string{[]()
 
     kak_assert(format("Youhou {1} {} {0} \\{}", 10, "hehe", 5) == "Youhou hehe 5 10 {}");
 
+    {
+        static constexpr auto fmt = compile_format("Youhou {1} {} {0}");
+        kak_assert(format(fmt, 10, "hehe", 5) == "Youhou hehe 5 10");
+        static constexpr auto trailing = compile_format("{} sels");
+        kak_assert(format(trailing, 3) == "3 sels");
+    }
+
     char buffer[20];
     kak_assert(format_to(buffer, "Hey {}", 15) == "Hey 15");
 
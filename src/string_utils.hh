@@ -3,6 +3,7 @@
 
 #include "string.hh"
 #include "enum.hh"
+#include "exception.hh"
 #include "vector.hh"
 #include "optional.hh"
 
@@ -12,6 +13,15 @@ namespace Kakoune
 StringView trim_whitespaces(StringView str);
 String trim_indent(StringView str);
 
+// Bulk scan for the next byte that is in `bytes` or strictly below
+// `below` (below must not exceed 0x80): single byte sets go through
+// memchr so the libc scans whole vector registers, sets of two bytes and
+// byte ranges are matched eight input bytes at a time with broadword
+// tricks. Escaping and quoting build on this to memcpy clean runs
+// instead of testing every byte against the set.
+const char* find_first_of_bytes(const char* it, const char* end,
+                                StringView bytes, unsigned char below = 0);
+
 String escape(StringView str, StringView characters, char escape);
 String unescape(StringView str, StringView characters, char escape);
 
@@ -118,6 +128,72 @@ String format(StringView fmt, Types&&... params)
     return format(fmt, ArrayView<const StringView>{detail::format_param(std::forward<Types>(params))...});
 }
 
+// A format string parsed once into literal pieces and parameter indexes.
+// Constant format strings can be compiled at compile time with a
+// `static constexpr auto fmt = compile_format("...");` variable so that
+// hot calls only sum sizes, reserve and append, instead of re-scanning
+// the format string. Escaped braces are not supported, use the dynamic
+// format() for those.
+struct CompiledFormat
+{
+    struct Piece
+    {
+        StringView literal; // literal text, followed by params[param]
+        int param;          // parameter index, or -1 for a trailing literal
+    };
+
+    static constexpr int max_pieces = 9;
+    Piece pieces[max_pieces]{};
+    int count = 0;
+};
+
+constexpr CompiledFormat compile_format(StringView fmt)
+{
+    CompiledFormat res;
+    int implicit_index = 0;
+    const char* it = fmt.data();
+    const char* end = it + (int)fmt.length();
+    const char* literal = it;
+    while (true)
+    {
+        while (it != end and *it != '{')
+            ++it;
+        if (it != literal and *(it-1) == '\\')
+            throw runtime_error("escaped braces are not supported in compiled format strings");
+        if (res.count == CompiledFormat::max_pieces)
+            throw runtime_error("too many pieces in compiled format string");
+        if (it == end)
+        {
+            res.pieces[res.count++] = {{literal, it}, -1};
+            return res;
+        }
+
+        auto closing = it + 1;
+        int explicit_index = -1;
+        for (; closing != end and *closing != '}'; ++closing)
+        {
+            if (*closing < '0' or *closing > '9')
+                throw runtime_error("format string error, invalid parameter index");
+            explicit_index = (explicit_index >= 0 ? explicit_index * 10 : 0) + (*closing - '0');
+        }
+        if (closing == end)
+            throw runtime_error("format string error, unclosed '{'");
+
+        const int index = explicit_index >= 0 ? explicit_index : implicit_index;
+        res.pieces[res.count++] = {{literal, it}, index};
+        implicit_index = index + 1;
+        it = literal = closing + 1;
+    }
+}
+
+String format(const CompiledFormat& fmt, ArrayView<const StringView> params);
+
+template<typename... Types>
+String format(const CompiledFormat& fmt, Types&&... params)
+{
+    return format(fmt, ArrayView<const StringView>{detail::format_param(std::forward<Types>(params))...});
+}
+
 StringView format_to(ArrayView<char> buffer, StringView fmt, ArrayView<const StringView> params);
 
 template<typename... Types>
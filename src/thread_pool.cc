@@ -0,0 +1,230 @@
+#include "thread_pool.hh"
+
+#include "buffer_utils.hh"
+#include "exception.hh"
+#include "unit_tests.hh"
+
+#include <atomic>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Kakoune
+{
+
+static int create_wakeup_pipe(int (&fds)[2])
+{
+    if (pipe(fds) != 0)
+        throw runtime_error("unable to create thread pool wakeup pipe");
+    for (int fd : fds)
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    // the watcher drains the pipe until empty, which must not block
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    return fds[0];
+}
+
+ThreadPool::ThreadPool()
+    : m_completion_watcher{create_wakeup_pipe(m_wakeup_fds), FdEvents::Read,
+                           [this](FDWatcher&, FdEvents, EventMode) {
+                               char buf[64];
+                               while (read(m_wakeup_fds[0], buf, sizeof(buf)) > 0) {}
+                               pump_completions();
+                           }}
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock{m_mutex};
+        m_stop = true;
+    }
+    m_wakeup.notify_all();
+    for (auto& worker : m_workers)
+        worker.thread.join();
+    // callbacks of groups that completed after the last pump are
+    // destroyed here, on the main thread, and never run
+    m_completed.clear();
+    m_completion_watcher.close_fd();
+    close(m_wakeup_fds[1]);
+}
+
+void ThreadPool::spawn_workers()
+{
+    m_started = Clock::now();
+    const size_t count = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_workers.emplace_back();
+        m_workers.back().thread = std::thread{[this, i] { worker_loop(i); }};
+    }
+}
+
+void ThreadPool::push(GroupStatePtr group, Task task)
+{
+    {
+        std::lock_guard lock{m_mutex};
+        if (m_workers.empty())
+            spawn_workers();
+
+        auto& worker = m_workers[m_next_worker];
+        m_next_worker = (m_next_worker + 1) % m_workers.size();
+        worker.tasks.emplace_back(std::move(group), std::move(task));
+    }
+    m_wakeup.notify_one();
+}
+
+void ThreadPool::worker_loop(size_t index)
+{
+    std::unique_lock lock{m_mutex};
+    auto& self = m_workers[index];
+    while (true)
+    {
+        std::pair<GroupStatePtr, Task> job;
+        if (not self.tasks.empty())
+        {
+            job = std::move(self.tasks.front());
+            self.tasks.pop_front();
+        }
+        else
+        {
+            for (auto& other : m_workers)
+            {
+                if (other.tasks.empty())
+                    continue;
+                job = std::move(other.tasks.back());
+                other.tasks.pop_back();
+                ++self.stolen;
+                break;
+            }
+        }
+
+        if (not job.second)
+        {
+            if (m_stop) // only quit once every deque ran dry
+                return;
+            m_wakeup.wait(lock);
+            continue;
+        }
+
+        lock.unlock();
+        const auto start = Clock::now();
+        try
+        {
+            job.second();
+        }
+        catch (...)
+        {
+            // off the main thread there is no safe way to surface an
+            // error, tasks are responsible for their own reporting
+        }
+        const auto busy = Clock::now() - start;
+        finish_task(*job.first);
+        job = {};
+        lock.lock();
+        ++self.executed;
+        self.busy += busy;
+    }
+}
+
+void ThreadPool::finish_task(GroupState& group)
+{
+    std::function<void ()> on_complete;
+    {
+        std::lock_guard lock{group.mutex};
+        if (--group.pending == 0)
+        {
+            on_complete = std::move(group.on_complete);
+            group.completed.notify_all();
+        }
+    }
+    if (on_complete)
+    {
+        {
+            std::lock_guard lock{m_completed_mutex};
+            m_completed.push_back(std::move(on_complete));
+        }
+        char c = 0;
+        (void)write(m_wakeup_fds[1], &c, 1);
+    }
+}
+
+void ThreadPool::pump_completions()
+{
+    while (true)
+    {
+        std::function<void ()> callback;
+        {
+            std::lock_guard lock{m_completed_mutex};
+            if (m_completed.empty())
+                return;
+            callback = std::move(m_completed.front());
+            m_completed.pop_front();
+        }
+        try
+        {
+            callback();
+        }
+        catch (runtime_error& error)
+        {
+            write_to_debug_buffer(format("error in task completion: {}", error.what()));
+        }
+    }
+}
+
+Vector<ThreadPool::WorkerStats> ThreadPool::worker_stats() const
+{
+    std::lock_guard lock{m_mutex};
+    Vector<WorkerStats> res;
+    res.reserve(m_workers.size());
+    for (auto& worker : m_workers)
+        res.push_back({worker.executed, worker.stolen, worker.busy});
+    return res;
+}
+
+Clock::duration ThreadPool::uptime() const
+{
+    std::lock_guard lock{m_mutex};
+    return m_workers.empty() ? Clock::duration{} : Clock::now() - m_started;
+}
+
+TaskGroup::TaskGroup(std::function<void ()> on_complete)
+    : m_state{std::make_shared<ThreadPool::GroupState>()}
+{
+    m_state->on_complete = std::move(on_complete);
+}
+
+TaskGroup::~TaskGroup()
+{
+    wait();
+}
+
+void TaskGroup::spawn(ThreadPool::Task task)
+{
+    {
+        std::lock_guard lock{m_state->mutex};
+        ++m_state->pending;
+    }
+    ThreadPool::instance().push(m_state, std::move(task));
+}
+
+void TaskGroup::wait()
+{
+    std::unique_lock lock{m_state->mutex};
+    m_state->completed.wait(lock, [this] { return m_state->pending == 0; });
+}
+
+UnitTest test_thread_pool{[]()
+{
+    if (not ThreadPool::has_instance())
+        return;
+
+    std::atomic<int> sum{0};
+    TaskGroup group;
+    for (int i = 1; i <= 100; ++i)
+        group.spawn([i, &sum] { sum += i; });
+    group.wait();
+    kak_assert(sum == 5050);
+}};
+
+}
@@ -0,0 +1,122 @@
+#ifndef thread_pool_hh_INCLUDED
+#define thread_pool_hh_INCLUDED
+
+#include "clock.hh"
+#include "event_manager.hh"
+#include "utils.hh"
+#include "vector.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Kakoune
+{
+
+// Single pool of worker threads shared by every parallel feature, so
+// that independent subsystems do not each grow a competing set of
+// workers. Tasks are submitted through a TaskGroup, distributed over
+// per worker deques, and an idle worker steals from the tail of a busy
+// sibling's deque. Workers are spawned on first submission, a pool
+// nobody uses costs nothing.
+//
+// Worker threads must not touch editor state: the domain allocators
+// backing String/Vector/HashMap keep unsynchronized statistics and
+// freelists, so task closures have to work on plain memory or std
+// containers (and not own domain allocated objects either, closures
+// are destroyed on the worker that ran them). Results are handed back
+// through the group completion callback, which the main event loop
+// pumps on the main thread.
+class ThreadPool : public Singleton<ThreadPool>
+{
+public:
+    using Task = std::function<void ()>;
+
+    ThreadPool();
+    ~ThreadPool();
+
+    size_t worker_count() const { return m_workers.size(); }
+
+    struct WorkerStats
+    {
+        size_t executed;
+        size_t stolen;
+        Clock::duration busy;
+    };
+    Vector<WorkerStats> worker_stats() const;
+    Clock::duration uptime() const;
+
+private:
+    friend class TaskGroup;
+
+    struct GroupState
+    {
+        std::mutex mutex;
+        std::condition_variable completed;
+        size_t pending = 0;
+        std::function<void ()> on_complete;
+    };
+    // the group state outlives both the TaskGroup and the pool queues;
+    // RefPtr's count is not atomic, hence std::shared_ptr
+    using GroupStatePtr = std::shared_ptr<GroupState>;
+
+    void push(GroupStatePtr group, Task task);
+    void spawn_workers();
+    void worker_loop(size_t index);
+    void finish_task(GroupState& group);
+    void pump_completions();
+
+    struct Worker
+    {
+        std::thread thread;
+        std::deque<std::pair<GroupStatePtr, Task>> tasks;
+        size_t executed = 0;
+        size_t stolen = 0;
+        Clock::duration busy{};
+    };
+
+    // tasks are coarse grained (a highlight pass, a background write),
+    // one mutex over all the deques keeps the scheduler simple and has
+    // not been a bottleneck at that granularity
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::deque<Worker> m_workers;
+    size_t m_next_worker = 0;
+    bool m_stop = false;
+    TimePoint m_started{};
+
+    // completion pump: the worker that finishes a group queues its
+    // callback here and tickles the pipe, the watcher below then runs
+    // it from the main event loop
+    std::mutex m_completed_mutex;
+    std::deque<std::function<void ()>> m_completed;
+    int m_wakeup_fds[2];
+    FDWatcher m_completion_watcher;
+};
+
+// A batch of tasks that completes once all of them ran. wait() blocks
+// the calling thread until then; alternatively an on_complete callback
+// given at construction runs on the main thread when the last task
+// finishes. The destructor waits for outstanding tasks, so tasks can
+// safely reference locals of the scope holding the group.
+class TaskGroup
+{
+public:
+    explicit TaskGroup(std::function<void ()> on_complete = {});
+    ~TaskGroup();
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void spawn(ThreadPool::Task task);
+    void wait();
+
+private:
+    ThreadPool::GroupStatePtr m_state;
+};
+
+}
+
+#endif // thread_pool_hh_INCLUDED
@@ -28,12 +28,25 @@ inline bool is_blank(Codepoint c) noexcept
     return c == ' ' or c == '\t' or c == '\n';
 }
 
+inline bool is_basic_alpha(Codepoint c) noexcept
+{
+    return (c >= 'a' and c <= 'z') or (c >= 'A' and c <= 'Z');
+}
+
+inline bool is_basic_digit(Codepoint c) noexcept
+{
+    return c >= '0' and c <= '9';
+}
+
 enum WordType { Word, WORD };
 
+// Classify ascii without going through the locale aware libc functions,
+// whose per codepoint call cost dominates word motions on long lines.
 template<WordType word_type = Word>
 inline bool is_word(Codepoint c, ConstArrayView<Codepoint> extra_word_chars = {'_'}) noexcept
 {
-    return iswalnum((wchar_t)c) or contains(extra_word_chars, c);
+    return (c < 128 ? is_basic_alpha(c) or is_basic_digit(c) : (bool)iswalnum((wchar_t)c)) or
+           contains(extra_word_chars, c);
 }
 
 template<>
@@ -47,16 +60,6 @@ inline bool is_punctuation(Codepoint c, ConstArrayView<Codepoint> extra_word_cha
     return not (is_word(c, extra_word_chars) or is_blank(c));
 }
 
-inline bool is_basic_alpha(Codepoint c) noexcept
-{
-    return (c >= 'a' and c <= 'z') or (c >= 'A' and c <= 'Z');
-}
-
-inline bool is_basic_digit(Codepoint c) noexcept
-{
-    return c >= '0' and c <= '9';
-}
-
 inline bool is_identifier(Codepoint c) noexcept
 {
     return is_basic_alpha(c) or is_basic_digit(c) or
@@ -65,6 +68,8 @@ inline bool is_identifier(Codepoint c) noexcept
 
 inline ColumnCount codepoint_width(Codepoint c) noexcept
 {
+    if (c >= 0x20 and c < 0x7f) // printable ascii is always single width
+        return 1;
     if (c == '\n')
         return 1;
     const auto width = wcwidth((wchar_t)c);
@@ -91,11 +96,11 @@ inline CharCategories categorize(Codepoint c, ConstArrayView<Codepoint> extra_wo
     return CharCategories::Punctuation;
 }
 
-inline Codepoint to_lower(Codepoint cp) noexcept { return towlower((wchar_t)cp); }
-inline Codepoint to_upper(Codepoint cp) noexcept { return towupper((wchar_t)cp); }
+inline Codepoint to_lower(Codepoint cp) noexcept { return cp < 128 ? (cp >= 'A' and cp <= 'Z' ? cp - 'A' + 'a' : cp) : towlower((wchar_t)cp); }
+inline Codepoint to_upper(Codepoint cp) noexcept { return cp < 128 ? (cp >= 'a' and cp <= 'z' ? cp - 'a' + 'A' : cp) : towupper((wchar_t)cp); }
 
-inline bool is_lower(Codepoint cp) noexcept { return iswlower((wchar_t)cp); }
-inline bool is_upper(Codepoint cp) noexcept { return iswupper((wchar_t)cp); }
+inline bool is_lower(Codepoint cp) noexcept { return cp < 128 ? (cp >= 'a' and cp <= 'z') : (bool)iswlower((wchar_t)cp); }
+inline bool is_upper(Codepoint cp) noexcept { return cp < 128 ? (cp >= 'A' and cp <= 'Z') : (bool)iswupper((wchar_t)cp); }
 
 inline char to_lower(char c) noexcept { return c >= 'A' and c <= 'Z' ? c - 'A' + 'a' : c; }
 inline char to_upper(char c) noexcept { return c >= 'a' and c <= 'z' ? c - 'a' + 'A' : c; }
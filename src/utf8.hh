@@ -231,11 +231,9 @@ CharCount distance(Iterator begin, const Sentinel& end) noexcept
 {
     CharCount dist = 0;
 
+    // branchless accumulation lets the compiler vectorize the byte scan
     while (begin != end)
-    {
-        if (is_character_start(read(begin)))
-            ++dist;
-    }
+        dist += (int)is_character_start(read(begin));
     return dist;
 }
 
@@ -246,7 +244,16 @@ ColumnCount column_distance(Iterator begin, const Sentinel& end) noexcept
     ColumnCount dist = 0;
 
     while (begin != end)
-        dist += codepoint_width(read_codepoint(begin, end));
+    {
+        // printable ascii is single column, no need to decode
+        if (const unsigned char c = *begin; c >= 0x20 and c < 0x7f)
+        {
+            ++dist;
+            ++begin;
+        }
+        else
+            dist += codepoint_width(read_codepoint(begin, end));
+    }
     return dist;
 }
 
@@ -17,22 +17,39 @@ struct Value
     Value() = default;
 
     template<typename T,
-             typename = std::enable_if_t<not std::is_same<Value, T>::value>>
-    Value(T&& val)
-        : m_value{new Model<std::decay_t<T>>{std::forward<T>(val)}} {}
+             typename = std::enable_if_t<not std::is_same<Value, std::decay_t<T>>::value>>
+    Value(T&& val) : m_ops{&ops<std::decay_t<T>>}
+    {
+        using Stored = std::decay_t<T>;
+        if constexpr (stored_inline<Stored>)
+            new (m_storage) Stored(std::forward<T>(val));
+        else
+            reinterpret_cast<Boxed<Stored>*&>(m_storage) =
+                new Boxed<Stored>(std::forward<T>(val));
+    }
 
     Value(const Value& val) = delete;
-    Value(Value&&) = default;
+    Value(Value&& other) noexcept { move_from(other); }
 
     Value& operator=(const Value& val) = delete;
-    Value& operator=(Value&& val) = default;
+    Value& operator=(Value&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            move_from(other);
+        }
+        return *this;
+    }
+
+    ~Value() { release(); }
 
-    explicit operator bool() const { return (bool)m_value; }
+    explicit operator bool() const { return m_ops != nullptr; }
 
     template<typename T>
     bool is_a() const
     {
-        return m_value and m_value->type() == typeid(T);
+        return m_ops and m_ops->type() == typeid(T);
     }
 
     template<typename T>
@@ -40,7 +57,10 @@ struct Value
     {
         if (not is_a<T>())
             throw bad_value_cast{};
-        return static_cast<Model<T>*>(m_value.get())->m_content;
+        if constexpr (stored_inline<T>)
+            return reinterpret_cast<T&>(m_storage);
+        else
+            return reinterpret_cast<Boxed<T>*&>(m_storage)->content;
     }
 
     template<typename T>
@@ -50,22 +70,76 @@ struct Value
     }
 
 private:
-    struct Concept
+    // payloads up to two pointers wide with a noexcept move live in the
+    // Value itself, sparing scope local state a heap allocation and a
+    // pointer chase per access; bigger ones are boxed as before, which
+    // also keeps their address stable when the owning map rehashes
+    static constexpr size_t inline_size = 2 * sizeof(void*);
+
+    template<typename T>
+    static constexpr bool stored_inline =
+        sizeof(T) <= inline_size and alignof(T) <= alignof(void*) and
+        std::is_nothrow_move_constructible<T>::value;
+
+    template<typename T>
+    struct Boxed : UseMemoryDomain<MemoryDomain::Values>
     {
-        virtual ~Concept() = default;
-        virtual const std::type_info& type() const = 0;
+        template<typename U>
+        Boxed(U&& val) : content(std::forward<U>(val)) {}
+
+        T content;
     };
 
-    template<typename T>
-    struct Model : public Concept, public UseMemoryDomain<MemoryDomain::Values>
+    struct Ops
     {
-        Model(T&& val) : m_content(std::move(val)) {}
-        const std::type_info& type() const override { return typeid(T); }
+        const std::type_info& (*type)();
+        void (*destroy)(Value& value) noexcept;
+        void (*move)(Value& dst, Value& src) noexcept;
+    };
+
+    const Ops* m_ops = nullptr;
+    alignas(void*) char m_storage[inline_size];
 
-        T m_content;
+    template<typename T>
+    static constexpr Ops ops = {
+        []() -> const std::type_info& { return typeid(T); },
+        [](Value& value) noexcept {
+            if constexpr (stored_inline<T>)
+                reinterpret_cast<T&>(value.m_storage).~T();
+            else
+                delete reinterpret_cast<Boxed<T>*&>(value.m_storage);
+        },
+        [](Value& dst, Value& src) noexcept {
+            if constexpr (stored_inline<T>)
+            {
+                auto& val = reinterpret_cast<T&>(src.m_storage);
+                new (dst.m_storage) T(std::move(val));
+                val.~T();
+            }
+            else
+                reinterpret_cast<void*&>(dst.m_storage) =
+                    reinterpret_cast<void*&>(src.m_storage);
+        },
     };
 
-    std::unique_ptr<Concept> m_value;
+    void release()
+    {
+        if (m_ops)
+        {
+            m_ops->destroy(*this);
+            m_ops = nullptr;
+        }
+    }
+
+    void move_from(Value& other) noexcept
+    {
+        if (other.m_ops)
+        {
+            m_ops = other.m_ops;
+            m_ops->move(*this, other);
+            other.m_ops = nullptr;
+        }
+    }
 };
 
 enum class ValueId : int {};
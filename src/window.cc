@@ -3,6 +3,7 @@
 #include "assert.hh"
 #include "clock.hh"
 #include "context.hh"
+#include "face_registry.hh"
 #include "highlighter.hh"
 #include "hook_manager.hh"
 #include "input_handler.hh"
@@ -10,6 +11,7 @@
 #include "buffer_utils.hh"
 #include "option.hh"
 #include "option_types.hh"
+#include "profile.hh"
 
 #include <algorithm>
 
@@ -74,14 +76,6 @@ void Window::center_column(ColumnCount buffer_column)
     display_column_at(buffer_column, m_dimensions.column/2_col);
 }
 
-static uint32_t compute_faces_hash(const FaceRegistry& faces)
-{
-    uint32_t hash = 0;
-    for (auto&& face : faces.flatten_faces() | transform(&FaceRegistry::FaceMap::Item::value))
-        hash = combine_hash(hash, face.base.empty() ? hash_value(face.face) : hash_value(face.base));
-    return hash;
-}
-
 Window::Setup Window::build_setup(const Context& context) const
 {
     Vector<BufferRange, MemoryDomain::Display> selections;
@@ -117,8 +111,100 @@ bool Window::needs_redraw(const Context& context) const
     return false;
 }
 
+static DisplayAtom initial_atom(const Buffer& buffer, const DisplaySetup& setup,
+                                int tabstop, LineCount buffer_line)
+{
+    auto beg_byte = get_byte_to_column(buffer, tabstop, {buffer_line, setup.window_pos.column});
+    auto end_byte = setup.full_lines ?
+        buffer[buffer_line].length()
+      : get_byte_to_column(buffer, tabstop, {buffer_line, setup.window_pos.column + setup.window_range.column});
+    return {buffer, {buffer_line, beg_byte}, {buffer_line, end_byte}};
+}
+
+bool Window::recycle_display_lines(const Context& context, const DisplaySetup& setup,
+                                   size_t prev_timestamp)
+{
+    auto& lines = m_display_buffer.lines();
+    if (lines.empty() or prev_timestamp != buffer().timestamp() or
+        m_dimensions != m_last_setup.dimensions or
+        setup.window_pos.column != m_last_setup.position.column or
+        compute_faces_hash(context.faces()) != m_last_setup.faces_hash or
+        m_builtin_highlighters.depends_on_whole_frame())
+        return false;
+
+    // recycling relies on a one-to-one mapping between display lines and
+    // buffer lines, which wrapping breaks
+    const LineCount prev_first = m_last_setup.position.line;
+    for (size_t i = 0; i < lines.size(); ++i)
+        if (lines[i].range().begin.line != prev_first + LineCount{(int)i})
+            return false;
+
+    // lines touched by the previous or the current selections carry
+    // selection dependent highlighting and cannot be reused as-is
+    auto on_selection = [&](LineCount line) {
+        for (auto& sel : m_last_setup.selections)
+            if (line >= std::min(sel.begin.line, sel.end.line) and
+                line <= std::max(sel.begin.line, sel.end.line))
+                return true;
+        for (auto& sel : context.selections())
+            if (line >= sel.min().line and line <= sel.max().line)
+                return true;
+        return false;
+    };
+
+    const int tabstop = context.options()["tabstop"].get<int>();
+    struct Source { bool fresh; size_t index; };
+    Vector<Source, MemoryDomain::Display> sources;
+    DisplayBuffer fresh;
+    fresh.set_timestamp(buffer().timestamp());
+    for (LineCount line = 0; line < setup.window_range.line; ++line)
+    {
+        const LineCount buffer_line = setup.window_pos.line + line;
+        if (buffer_line >= buffer().line_count())
+            break;
+        const LineCount prev_index = buffer_line - prev_first;
+        if (prev_index >= 0 and prev_index < LineCount{(int)lines.size()} and
+            not on_selection(buffer_line))
+            sources.push_back({false, (size_t)(int)prev_index});
+        else
+        {
+            sources.push_back({true, fresh.lines().size()});
+            fresh.lines().push_back(DisplayLine{AtomList{
+                initial_atom(buffer(), setup, tabstop, buffer_line)}});
+        }
+    }
+
+    const size_t fresh_count = fresh.lines().size();
+    if (fresh_count >= sources.size()) // nothing to recycle
+        return false;
+
+    if (fresh_count != 0)
+    {
+        fresh.compute_range();
+        const BufferRange range{{0,0}, buffer().end_coord()};
+        for (auto pass : { HighlightPass::Wrap, HighlightPass::Move, HighlightPass::Colorize })
+            m_builtin_highlighters.highlight({context, setup, pass, {}}, fresh, range);
+        // a line scrolled into view might need wrapping even though none of
+        // the previous frame's lines did, breaking the one-to-one mapping
+        if (fresh.lines().size() != fresh_count)
+            return false;
+        fresh.optimize();
+    }
+
+    DisplayBuffer::LineList new_lines;
+    new_lines.reserve(sources.size());
+    for (auto& source : sources)
+        new_lines.push_back(std::move(source.fresh ? fresh.lines()[source.index]
+                                                   : lines[source.index]));
+    lines = std::move(new_lines);
+    m_display_buffer.compute_range();
+    return true;
+}
+
 const DisplayBuffer& Window::update_display_buffer(const Context& context)
 {
+    ProfileTimer profile_timer{context, ProfileCategory::Highlight};
+
     const bool profile = context.options()["debug"].get<DebugFlags>() &
                         DebugFlags::Profile;
 
@@ -136,37 +222,48 @@ const DisplayBuffer& Window::update_display_buffer(const Context& context)
     }
 
     DisplayBuffer::LineList& lines = m_display_buffer.lines();
+    const size_t prev_timestamp = m_display_buffer.timestamp();
     m_display_buffer.set_timestamp(buffer().timestamp());
-    lines.clear();
 
     if (m_dimensions == DisplayCoord{0,0})
+    {
+        lines.clear();
         return m_display_buffer;
+    }
 
     kak_assert(&buffer() == &context.buffer());
     const DisplaySetup setup = compute_display_setup(context);
 
-    const int tabstop = context.options()["tabstop"].get<int>();
-    for (LineCount line = 0; line < setup.window_range.line; ++line)
+    if (not recycle_display_lines(context, setup, prev_timestamp))
     {
-        LineCount buffer_line = setup.window_pos.line + line;
-        if (buffer_line >= buffer().line_count())
-            break;
-        auto beg_byte = get_byte_to_column(buffer(), tabstop, {buffer_line, setup.window_pos.column});
-        auto end_byte = setup.full_lines ?
-            buffer()[buffer_line].length()
-          : get_byte_to_column(buffer(), tabstop, {buffer_line, setup.window_pos.column + setup.window_range.column});
-
-        // The display buffer always has at least one buffer atom, which might be empty if
-        // beg_byte == end_byte
-        lines.emplace_back(AtomList{ {buffer(), {buffer_line, beg_byte}, {buffer_line, end_byte}} });
-    }
+        const int tabstop = context.options()["tabstop"].get<int>();
+        size_t line_index = 0;
+        for (LineCount line = 0; line < setup.window_range.line; ++line)
+        {
+            LineCount buffer_line = setup.window_pos.line + line;
+            if (buffer_line >= buffer().line_count())
+                break;
+
+            // The display buffer always has at least one buffer atom, which might be empty if
+            // beg_byte == end_byte. Lines from the previous redraw are reset in place
+            // so that their atom storage gets reused, making steady state redraws
+            // allocation free.
+            DisplayAtom atom = initial_atom(buffer(), setup, tabstop, buffer_line);
+            if (line_index < lines.size())
+                lines[line_index].reset(std::move(atom));
+            else
+                lines.push_back(DisplayLine{AtomList{std::move(atom)}});
+            ++line_index;
+        }
+        lines.erase(lines.begin() + line_index, lines.end());
 
-    m_display_buffer.compute_range();
-    const BufferRange range{{0,0}, buffer().end_coord()};
-    for (auto pass : { HighlightPass::Wrap, HighlightPass::Move, HighlightPass::Colorize })
-        m_builtin_highlighters.highlight({context, setup, pass, {}}, m_display_buffer, range);
+        m_display_buffer.compute_range();
+        const BufferRange range{{0,0}, buffer().end_coord()};
+        for (auto pass : { HighlightPass::Wrap, HighlightPass::Move, HighlightPass::Colorize })
+            m_builtin_highlighters.highlight({context, setup, pass, {}}, m_display_buffer, range);
 
-    m_display_buffer.optimize();
+        m_display_buffer.optimize();
+    }
 
     set_position(setup.window_pos);
     m_last_setup = build_setup(context);
@@ -182,6 +279,45 @@ const DisplayBuffer& Window::update_display_buffer(const Context& context)
     return m_display_buffer;
 }
 
+void Window::prefetch_highlighting(const Context& context, LineCount overscan)
+{
+    if (m_dimensions == DisplayCoord{0,0})
+        return;
+
+    kak_assert(&buffer() == &context.buffer());
+
+    const DisplaySetup setup = compute_display_setup(context);
+    const BufferRange range{{0,0}, buffer().end_coord()};
+    auto warm_up = [&](LineCount begin, LineCount end) {
+        begin = std::max(0_line, begin);
+        end = std::min(buffer().line_count(), end);
+        if (begin >= end)
+            return;
+
+        DisplayBuffer display_buffer;
+        display_buffer.set_timestamp(buffer().timestamp());
+        auto& lines = display_buffer.lines();
+        for (LineCount line = begin; line < end; ++line)
+            lines.emplace_back(AtomList{ {buffer(), {line, 0}, {line, buffer()[line].length()}} });
+        display_buffer.compute_range();
+
+        // only the colorize pass maintains buffer side caches
+        m_builtin_highlighters.highlight({context, setup, HighlightPass::Colorize, {}},
+                                         display_buffer, range);
+    };
+
+    try
+    {
+        const LineCount first = setup.window_pos.line;
+        warm_up(first - overscan, first);
+        warm_up(first + setup.window_range.line, first + setup.window_range.line + overscan);
+    }
+    catch (runtime_error&)
+    {
+        // highlighting errors will be reported when the lines get displayed
+    }
+}
+
 void Window::set_position(DisplayCoord position)
 {
     m_position.line = clamp(position.line, 0_line, buffer().line_count()-1);
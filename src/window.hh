@@ -37,6 +37,10 @@ public:
 
     const DisplayBuffer& update_display_buffer(const Context& context);
 
+    // Highlight lines above and below the displayed range on idle so
+    // that scrolling hits warm highlighter caches
+    void prefetch_highlighting(const Context& context, LineCount overscan);
+
     Optional<DisplayCoord> display_position(BufferCoord coord) const;
     BufferCoord buffer_coord(DisplayCoord coord) const;
 
@@ -54,6 +58,12 @@ private:
     void on_option_changed(const Option& option) override;
     DisplaySetup compute_display_setup(const Context& context) const;
 
+    // Reuse still valid display lines from the previous frame on a pure
+    // scroll, highlighting only the damaged ones; returns false when a
+    // full update is required
+    bool recycle_display_lines(const Context& context, const DisplaySetup& setup,
+                               size_t prev_timestamp);
+
     friend class ClientManager;
     void run_hook_in_own_context(Hook hook, StringView param,
                                  String client_name = "");
@@ -36,16 +36,45 @@ struct WordSplitter
             const auto* end = m_splitter->m_content.end();
             auto extra_chars = m_splitter->m_extra_word_chars;
 
+            // scan byte per byte, ascii bytes can be classified without
+            // decoding a full codepoint which makes the common case a
+            // plain table-free byte scan
             while (true)
             {
                 m_word_begin = m_word_end;
-                while (m_word_begin != end and not is_word(utf8::codepoint(m_word_begin, end), extra_chars))
-                    utf8::to_next(m_word_begin, end);
+                while (m_word_begin != end)
+                {
+                    if (const unsigned char c = *m_word_begin; c < 0x80)
+                    {
+                        if (is_word((Codepoint)c, extra_chars))
+                            break;
+                        ++m_word_begin;
+                    }
+                    else
+                    {
+                        auto it = m_word_begin;
+                        if (is_word(utf8::read_codepoint(it, end), extra_chars))
+                            break;
+                        m_word_begin = it;
+                    }
+                }
                 m_word_end = m_word_begin;
                 CharCount word_len = 0;
-                while (m_word_end != end and is_word(utf8::codepoint(m_word_end, end), extra_chars))
+                while (m_word_end != end)
                 {
-                    utf8::to_next(m_word_end, end);
+                    if (const unsigned char c = *m_word_end; c < 0x80)
+                    {
+                        if (not is_word((Codepoint)c, extra_chars))
+                            break;
+                        ++m_word_end;
+                    }
+                    else
+                    {
+                        auto it = m_word_end;
+                        if (not is_word(utf8::read_codepoint(it, end), extra_chars))
+                            break;
+                        m_word_end = it;
+                    }
                     ++word_len;
                 }
                 if (m_word_begin == end or word_len < max_word_len)
@@ -89,7 +118,8 @@ void WordDB::add_words(StringView line, ConstArrayView<Codepoint> extra_word_cha
         {
             auto word = intern(w);
             auto view = word->strview();
-            m_words.insert({view, {std::move(word), used_letters(view), 1}});
+            const UsedLetters letters = used_letters(view);
+            m_words.insert({view, {std::move(word), letters, to_lower(letters), 1}});
         }
     }
 }
@@ -109,26 +139,33 @@ WordDB::WordDB(const Buffer& buffer)
     : m_buffer{&buffer}
 {
     buffer.options().register_watcher(*this);
+    buffer.register_change_watcher(*this);
     rebuild_db();
 }
 
 WordDB::WordDB(WordDB&& other) noexcept
     : m_buffer{std::move(other.m_buffer)},
       m_timestamp{other.m_timestamp},
+      m_dirty{other.m_dirty},
       m_words{std::move(other.m_words)},
       m_lines{std::move(other.m_lines)}
 {
     kak_assert(m_buffer);
     m_buffer->options().unregister_watcher(other);
+    m_buffer->unregister_change_watcher(other);
     other.m_buffer = nullptr;
 
     m_buffer->options().register_watcher(*this);
+    m_buffer->register_change_watcher(*this);
 }
 
 WordDB::~WordDB()
 {
     if (m_buffer)
+    {
         m_buffer->options().unregister_watcher(*this);
+        m_buffer->unregister_change_watcher(*this);
+    }
 }
 
 void WordDB::rebuild_db()
@@ -145,10 +182,15 @@ void WordDB::rebuild_db()
         add_words(m_lines.back()->strview(), extra_word_chars);
     }
     m_timestamp = buffer.timestamp();
+    m_dirty = false;
 }
 
 void WordDB::update_db()
 {
+    if (not m_dirty)
+        return;
+    m_dirty = false;
+
     auto& buffer = *m_buffer;
 
     auto modifs = compute_line_modifications(buffer, m_timestamp);
@@ -208,10 +250,18 @@ RankedMatchList WordDB::find_matching(StringView query)
 {
     update_db();
     const UsedLetters letters = used_letters(query);
+    const UsedLetters lower_letters = to_lower(letters);
+    const UsedLetters upper_letters = letters & upper_mask;
     RankedMatchList res;
     for (auto&& word : m_words)
     {
-        if (RankedMatch match{word.key, word.value.letters, query, letters})
+        // smartcase prefilter over precomputed per word masks: lowercase
+        // query letters match either case, uppercase ones require an
+        // uppercase candidate letter
+        if (not matches(lower_letters, word.value.lower_letters) or
+            not matches(upper_letters, word.value.letters & upper_mask))
+            continue;
+        if (RankedMatch match{word.key, query})
             res.push_back(match);
     }
 
@@ -1,6 +1,7 @@
 #ifndef word_db_hh_INCLUDED
 #define word_db_hh_INCLUDED
 
+#include "buffer.hh"
 #include "shared_string.hh"
 #include "hash_map.hh"
 #include "vector.hh"
@@ -12,10 +13,9 @@ namespace Kakoune
 {
 
 using RankedMatchList = Vector<RankedMatch>;
-class Buffer;
 
 // maintain a database of words available in a buffer
-class WordDB : public OptionManagerWatcher
+class WordDB : public OptionManagerWatcher, public BufferChangeWatcher
 {
 public:
     WordDB(const Buffer& buffer);
@@ -34,11 +34,15 @@ private:
     void rebuild_db();
 
     void on_option_changed(const Option& option) override;
+    void on_buffer_changed() override { m_dirty = true; }
 
     struct WordInfo
     {
         StringDataPtr word;
         UsedLetters letters;
+        // to_lower(letters), precomputed so the per query prefilter is
+        // two mask tests per word
+        UsedLetters lower_letters;
         int refcount;
     };
     using WordToInfo = HashMap<StringView, WordInfo, MemoryDomain::WordDB>;
@@ -46,6 +50,9 @@ private:
 
     SafePtr<const Buffer> m_buffer;
     size_t m_timestamp;
+    // flagged by the buffer on change so a clean access skips the
+    // change log entirely
+    bool m_dirty = true;
     WordToInfo m_words;
     Lines m_lines;
 };